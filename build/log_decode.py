@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+#
+# Decodes logging output generated by BinaryStreamLogHandler. Format strings of binary log records
+# are looked up in the ELF files of the firmware modules that generated them.
+#
+# Usage:
+#   log_decode.py -e system-part1.elf -e system-part2.elf -e user.elf [input]
+#
+# The input can be a capture file or a serial device, standard input is used by default.
+# Requires pyelftools (pip install pyelftools).
+
+import argparse
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+from elftools.elf.constants import SH_FLAGS
+
+FRAME_SIGNATURE = b'\xb1\x0c'
+FRAME_HEADER_SIZE = 16
+
+BINARY_RECORD = 1
+TEXT_MESSAGE = 2
+DIRECT_OUTPUT = 3
+
+RECORD_TRUNCATED = 0x01
+
+LEVEL_NAMES = ['TRACE', 'TRACE', 'TRACE', 'INFO', 'WARN', 'ERROR', 'PANIC']
+
+# %[flags][width][.precision][length]conversion
+SPEC_REGEX = re.compile(r'%([-+ #0]*)(\*|\d*)(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?(.)?')
+
+
+class Image:
+    def __init__(self, elf_files):
+        self.sections = []
+        for path in elf_files:
+            elf = ELFFile(open(path, 'rb'))
+            for sect in elf.iter_sections():
+                if sect['sh_flags'] & SH_FLAGS.SHF_ALLOC and sect['sh_type'] != 'SHT_NOBITS':
+                    self.sections.append((sect['sh_addr'], sect.data()))
+
+    def string(self, addr):
+        for start, data in self.sections:
+            if start <= addr < start + len(data):
+                offs = addr - start
+                end = data.find(b'\0', offs)
+                if end < 0:
+                    end = len(data)
+                return data[offs:end].decode('utf-8', 'replace')
+        return None
+
+
+class ArgReader:
+    def __init__(self, data, ptr_size):
+        self.data = data
+        self.offs = 0
+        self.ptr_size = ptr_size
+
+    def read(self, size, signed=False):
+        if self.offs + size > len(self.data):
+            raise IndexError()
+        fmt = {4: 'i', 8: 'q'}[size]
+        if not signed:
+            fmt = fmt.upper()
+        val = struct.unpack_from('<' + fmt, self.data, self.offs)[0]
+        self.offs += (size + 3) & ~3
+        return val
+
+    def read_double(self):
+        if self.offs + 8 > len(self.data):
+            raise IndexError()
+        val = struct.unpack_from('<d', self.data, self.offs)[0]
+        self.offs += 8
+        return val
+
+    def read_string(self):
+        end = self.data.find(b'\0', self.offs)
+        if end < 0:
+            raise IndexError()
+        val = self.data[self.offs:end].decode('utf-8', 'replace')
+        self.offs += (end - self.offs + 1 + 3) & ~3
+        return val
+
+
+def int_size(length, ptr_size):
+    if length in ('ll', 'j'):
+        return 8
+    if length in ('l', 'z', 't'):
+        return ptr_size
+    return 4
+
+
+def format_record(fmt, args, truncated):
+    out = []
+    pos = 0
+    for m in SPEC_REGEX.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        try:
+            if width == '*':
+                width = str(args.read(4, signed=True))
+            if prec == '*':
+                prec = str(args.read(4, signed=True))
+            spec = '%' + flags + (width or '') + ('.' + prec if prec is not None else '')
+            if conv in 'di':
+                out.append((spec + 'd') % args.read(int_size(length, args.ptr_size), signed=True))
+            elif conv in 'uoxX':
+                val = args.read(int_size(length, args.ptr_size))
+                if length == 'hh':
+                    val &= 0xff
+                elif length == 'h':
+                    val &= 0xffff
+                if conv == 'u':
+                    conv = 'd'
+                elif conv == 'o' and '#' in flags:
+                    # Python's alternate form for octal numbers differs from C's
+                    spec = spec.replace('#', '')
+                    val = ('0%o' % val) if val else '0'
+                    conv = 's'
+                out.append((spec + conv) % val)
+            elif conv == 'c':
+                out.append((spec + 's') % chr(args.read(4) & 0xff))
+            elif conv == 'p':
+                out.append((spec + 's') % ('0x%x' % args.read(args.ptr_size)))
+            elif conv in 'fFeEgG':
+                out.append((spec + conv) % args.read_double())
+            elif conv in 'aA':
+                val = args.read_double().hex()
+                out.append((spec + 's') % (val.upper() if conv == 'A' else val))
+            elif conv == 's':
+                out.append((spec + 's') % args.read_string())
+            elif conv == 'n':
+                pass
+            else:
+                out.append(m.group(0))
+        except IndexError:
+            truncated = True
+            pos = len(fmt)
+            break
+    out.append(fmt[pos:])
+    if truncated:
+        out.append('~')
+    return ''.join(out)
+
+
+def level_name(level):
+    return LEVEL_NAMES[max(0, min(level // 10, len(LEVEL_NAMES) - 1))]
+
+
+def read_exact(stream, size):
+    data = b''
+    while len(data) < size:
+        chunk = stream.read(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
+def read_frames(stream):
+    prev = b''
+    while True:
+        b = stream.read(1)
+        if not b:
+            return
+        if prev + b != FRAME_SIGNATURE:
+            prev = b
+            continue
+        prev = b''
+        header = read_exact(stream, FRAME_HEADER_SIZE - len(FRAME_SIGNATURE))
+        if header is None:
+            return
+        ftype, level, size, flags, time, fmt = struct.unpack('<BBHHII', header)
+        payload = read_exact(stream, size)
+        if payload is None:
+            return
+        yield ftype, level, flags, time, fmt, payload
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes binary logging output')
+    parser.add_argument('-e', '--elf', action='append', default=[], help='ELF file of a firmware module')
+    parser.add_argument('-p', '--pointer-size', type=int, default=4, help='pointer size of the target platform')
+    parser.add_argument('input', nargs='?', help='input file or device')
+    args = parser.parse_args()
+
+    image = Image(args.elf)
+    stream = open(args.input, 'rb') if args.input else sys.stdin.buffer
+    for ftype, level, flags, time, fmt, payload in read_frames(stream):
+        end = payload.find(b'\0')
+        if end < 0:
+            continue # Malformed frame
+        category = payload[:end].decode('utf-8', 'replace')
+        data = payload[end + 1:]
+        if ftype == DIRECT_OUTPUT:
+            sys.stdout.write(data.decode('utf-8', 'replace'))
+            continue
+        if ftype == BINARY_RECORD:
+            fmt_str = image.string(fmt)
+            if fmt_str is None:
+                msg = '<unknown format string at 0x%08x>' % fmt
+            else:
+                msg = format_record(fmt_str, ArgReader(data, args.pointer_size), flags & RECORD_TRUNCATED)
+        else:
+            msg = data.decode('utf-8', 'replace')
+        line = '%010u ' % time
+        if category:
+            line += '[%s] ' % category
+        line += '%s: %s' % (level_name(level), msg)
+        print(line)
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# Prints the contents of a log file written by the virtual device (see hal/src/gcc/log_file.h).
+# The file is a ring buffer; its contents are printed from the oldest to the newest output.
+#
+# Usage:
+#   log_file_read.py [-f] [-n LINES] device.log
+#
+# With -f, the file is polled for new output until interrupted, like `tail -f`.
+
+import argparse
+import mmap
+import struct
+import sys
+import time
+
+MAGIC = 0x474f4c56  # "VLOG"
+VERSION = 1
+HEADER_FORMAT = '<IIQQ'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+
+class LogFile:
+    def __init__(self, path):
+        self.file = open(path, 'rb')
+        self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, self.size, _ = struct.unpack_from(HEADER_FORMAT, self.map, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError('%s is not a log file' % path)
+        if len(self.map) < HEADER_SIZE + self.size:
+            raise ValueError('%s is truncated' % path)
+
+    def written(self):
+        return struct.unpack_from('<Q', self.map, 16)[0]
+
+    # Returns the data written in the [start, end) range of the stream, or None if the data has
+    # already been overwritten
+    def read(self, start, end):
+        if end - start > self.size:
+            return None
+        pos = start % self.size
+        n = min(end - start, self.size - pos)
+        data = self.map[HEADER_SIZE + pos:HEADER_SIZE + pos + n]
+        data += self.map[HEADER_SIZE:HEADER_SIZE + (end - start - n)]
+        # Make sure the data wasn't overwritten while it was being read
+        if self.written() - start > self.size:
+            return None
+        return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Print the contents of a virtual device log file.')
+    parser.add_argument('file', help='log file')
+    parser.add_argument('-f', '--follow', action='store_true', help='wait for new output')
+    parser.add_argument('-n', '--lines', type=int, help='print only the last N lines')
+    args = parser.parse_args()
+
+    log = LogFile(args.file)
+    out = sys.stdout.buffer
+    end = log.written()
+    start = max(end - log.size, 0)
+    data = log.read(start, end) or b''
+    if start > 0:
+        # Skip the partially overwritten line
+        data = data[data.find(b'\n') + 1:]
+    if args.lines is not None:
+        lines = data.splitlines(True)
+        data = b''.join(lines[-args.lines:] if args.lines > 0 else [])
+    out.write(data)
+    out.flush()
+
+    try:
+        while args.follow:
+            time.sleep(0.2)
+            written = log.written()
+            if written == end:
+                continue
+            if written < end:
+                out.write(b'\n*** log file was recreated ***\n')
+                end = 0
+            data = log.read(end, written)
+            if data is None:
+                out.write(b'\n*** %d bytes skipped ***\n' % (written - log.size - end))
+                data = log.read(max(written - log.size, 0), written) or b''
+            out.write(data)
+            out.flush()
+            end = written
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
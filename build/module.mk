@@ -45,6 +45,32 @@ ifneq (,$(LOG_MODULE_CATEGORY))
 CFLAGS += -DLOG_MODULE_CATEGORY="\"$(LOG_MODULE_CATEGORY)\""
 endif
 
+# Compile-time logging levels for specific categories, e.g. LOG_CATEGORY_LEVELS = comm.protocol:WARN
+ifneq (,$(LOG_CATEGORY_LEVELS))
+log_category_level = LOG_CATEGORY_LEVEL(\"$(word 1,$(subst :, ,$1))\",$(word 2,$(subst :, ,$1)))
+CFLAGS += -DLOG_COMPILE_TIME_CATEGORY_LEVELS="$(foreach e,$(LOG_CATEGORY_LEVELS),$(call log_category_level,$e))"
+endif
+
+# Hot-path tracing (see services/inc/trace.h)
+ifeq ("$(TRACE)","y")
+CFLAGS += -DPARTICLE_TRACE_ENABLED=1
+endif
+
+# Heap allocation profiling (see services/inc/heap_profiler.h). The allocation functions are wrapped
+# at link time, which only covers all the allocations when the firmware is linked as a single image
+ifeq ("$(HEAP_PROFILER)","y")
+ifeq ("$(MODULAR_FIRMWARE)","y")
+$(error HEAP_PROFILER=y is not supported for modular firmware, build the monolithic firmware in main/ instead)
+endif
+CFLAGS += -DHEAP_PROFILER_ENABLED=1
+LDFLAGS += -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free,--wrap=strdup
+endif
+
+# RAM copy of the emulated EEPROM contents (see services/inc/eeprom_emulation.h), enabled by default
+ifeq ("$(EEPROM_RAM_CACHE)","n")
+CFLAGS += -DEEPROM_EMULATION_RAM_CACHE=0
+endif
+
 # Adds the sources from the specified library directories
 # v1 libraries include all sources
 LIBCPPSRC += $(call target_files_dirs,$(MODULE_LIBSV1),,*.cpp)
@@ -252,6 +252,11 @@ ifeq ("$(STM32_DEVICE)","STM32F2XX")
     PLATFORM_THREADING=1
 endif
 
+ifeq ("$(PLATFORM_NAME)","gcc")
+    # the virtual device implements the concurrent HAL on pthreads, build with PLATFORM_THREADING=0 to disable
+    PLATFORM_THREADING ?= 1
+endif
+
 ifeq ("$(PLATFORM_MCU)","")
 $(error PLATFORM_MCU not defined. Check platform id $(PLATFORM_ID))
 endif
@@ -0,0 +1,51 @@
+#!/bin/bash
+#
+# Compares the benchmark results with a baseline.
+# $1 the baseline file, one JSON object per line as printed by the benchmark runner
+# $2 the results file in the same format
+#
+# A benchmark fails if it allocates more often or more bytes per operation than in the baseline,
+# or if its time per operation exceeds the baseline by more than BENCH_TIME_FACTOR (3 by default).
+# The time factor is generous since the baseline may come from a different machine.
+# Benchmarks missing from the results also fail, new ones are reported only.
+
+baseline=$1
+results=$2
+: ${BENCH_TIME_FACTOR:="3"}
+
+[ -f "$baseline" ] || { echo "Couldn't find the benchmark baseline $baseline"; exit 1; }
+[ -f "$results" ] || { echo "Couldn't find the benchmark results $results"; exit 1; }
+
+# Converts each JSON line to "name ns_per_op allocs_per_op bytes_per_op"
+function fields() {
+  sed -n 's/.*"name":"\([^"]*\)".*"ns_per_op":\([0-9.]*\).*"allocs_per_op":\([0-9.]*\).*"bytes_per_op":\([0-9.]*\).*/\1 \2 \3 \4/p' "$1"
+}
+
+awk -v factor="$BENCH_TIME_FACTOR" '
+  FNR == NR { ns[$1] = $2; allocs[$1] = $3; bytes[$1] = $4; next }
+  {
+    seen[$1] = 1
+    if (!($1 in ns)) {
+      printf "NEW      %s: %.2f ns/op, %.2f allocs/op, %.2f bytes/op\n", $1, $2, $3, $4
+      next
+    }
+    status = "ok"
+    if ($3 > allocs[$1] + 0.01 || $4 > bytes[$1] + 0.01) {
+      status = "FAILED"
+    } else if ($2 > ns[$1] * factor) {
+      status = "FAILED"
+    }
+    if (status != "ok") failed++
+    printf "%-8s %s: %.2f ns/op (baseline %.2f), %.2f allocs/op (%.2f), %.2f bytes/op (%.2f)\n",
+        status, $1, $2, ns[$1], $3, allocs[$1], $4, bytes[$1]
+  }
+  END {
+    for (name in ns) {
+      if (!(name in seen)) {
+        printf "MISSING  %s\n", name
+        failed++
+      }
+    }
+    exit failed > 0
+  }
+' <(fields "$baseline") <(fields "$results")
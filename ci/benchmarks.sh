@@ -0,0 +1,40 @@
+#!/bin/bash
+#
+# Top-level script for running the host benchmarks.
+ci_dir=$(dirname $BASH_SOURCE)
+cd $ci_dir
+bench_compare=$(pwd)/bench_compare.sh
+
+. test_setup.sh
+
+cd $testDir/bench || die "Hey where's the ./bench directory?"
+
+# clear out target directory
+[ ! -e obj ] || rm -rf obj
+
+target_file=obj/runner
+
+make runner > build.log || die "Problem building benchmarks. Please see build.log"
+
+[ -f "$target_file" ] || die "Couldn't find the benchmark executable"
+
+# One JSON object per line, see user/tests/readme.md
+$target_file > obj/bench.json
+
+result=$?
+cat obj/bench.json
+
+if [ "$result" != "0" ]; then
+    echo Some benchmarks FAILED.
+    exit 1
+fi
+
+# Check for regressions against the checked-in baseline
+$bench_compare baseline.json obj/bench.json
+
+if [ "$?" == "0" ]; then
+    echo Benchmarks completed.
+else
+    echo Some benchmarks REGRESSED, see above. Update baseline.json if the change is intended.
+    exit 1
+fi
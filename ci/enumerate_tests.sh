@@ -44,7 +44,7 @@ function excluding() {
 }
 
 function enum_platforms() {
-  enum_dirs excluding "libraries|unit|reflection" $@ 
+  enum_dirs excluding "libraries|unit|bench|reflection" $@ 
 }
 
 function enum_suites() {
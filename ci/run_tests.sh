@@ -9,7 +9,8 @@ cmd=""
 if contains "${BUILD_PLATFORM[*]}" unit-test; then
 	( source ./ci/install_boost.sh
 	./ci/build_boost.sh &&
-	./ci/unit_tests.sh ) || die
+	./ci/unit_tests.sh &&
+	./ci/benchmarks.sh ) || die
 fi
 
 ./ci/enumerate_build_matrix.sh
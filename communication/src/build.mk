@@ -31,6 +31,7 @@ CPPSRC += $(TARGET_SRC_PATH)/publisher.cpp
 CPPSRC += $(TARGET_SRC_PATH)/protocol_defs.cpp
 CPPSRC += $(TARGET_SRC_PATH)/mbedtls_communication.cpp
 CPPSRC += $(TARGET_SRC_PATH)/communication_diagnostic.cpp
+CPPSRC += $(TARGET_SRC_PATH)/connection_quality.cpp
 
 # ASM source files included in this build.
 ASRC +=
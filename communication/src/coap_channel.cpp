@@ -38,7 +38,11 @@ ProtocolError CoAPMessageStore::send_message(CoAPMessage* msg, Channel& channel)
  */
 bool CoAPMessageStore::retransmit(CoAPMessage* msg, Channel& channel, system_tick_t now)
 {
-	bool retransmit = (msg->prepare_retransmit(now));
+	// The message backs off its own retransmissions, the ACK timeout of the following messages is
+	// backed off once per message
+	if (msg->get_type()==CoAPType::CON && msg->get_transmit_count()==1)
+		g_connectionQuality.retransmission_timeout();
+	bool retransmit = (msg->prepare_retransmit(now, g_connectionQuality.ack_timeout()));
 	if (retransmit)
 	{
 		send_message(msg, channel);
@@ -46,9 +50,27 @@ bool CoAPMessageStore::retransmit(CoAPMessage* msg, Channel& channel, system_tic
 	return retransmit;
 }
 
+/**
+ * Records the round trip time of an acknowledged confirmable message. Retransmitted messages
+ * are excluded from the round trip time, since it's ambiguous which transmission was acknowledged.
+ */
+void CoAPMessageStore::message_acknowledged(const CoAPMessage& msg, system_tick_t time)
+{
+	if (msg.get_type()!=CoAPType::CON)
+		return;
+	const system_tick_t elapsed = time - msg.get_sent_time();
+	if (msg.get_transmit_count()==1)
+		g_roundTripTime.record(elapsed);
+	g_connectionQuality.message_acknowledged(elapsed, msg.get_transmit_count(), msg.get_data_length(), time);
+	if (Messages::decodeType(msg.get_data(), msg.get_data_length())==CoAPMessageType::EVENT)
+		g_publishAckLatency.record(elapsed);
+}
+
 void CoAPMessageStore::message_timeout(CoAPMessage& msg, Channel& channel)
 {
 	g_unacknowledgedMessageCounter++;
+	if (msg.get_type()==CoAPType::CON)
+		g_connectionQuality.message_timeout(msg.get_transmit_count()-1); // The count was incremented past the last transmission
 	msg.notify_timeout();
 	if (msg.is_request())
 		channel.command(MessageChannel::CLOSE);
@@ -57,25 +79,27 @@ void CoAPMessageStore::message_timeout(CoAPMessage& msg, Channel& channel)
 /**
  * Process existing messages, resending any unacknowledged requests to the given channel.
  */
-void CoAPMessageStore::process(system_tick_t time, Channel& channel)
+ProtocolError CoAPMessageStore::process(system_tick_t time, Channel& channel)
 {
-	CoAPMessage* msg = head;
-	CoAPMessage* prev = nullptr;
-	while (msg!=nullptr)
+	ProtocolError result = NO_ERROR;
+	SoftTimer* timer = nullptr;
+	while ((timer = timers.takeExpired(time))!=nullptr)
 	{
-		if (time_has_passed(time, msg->get_timeout()) && !retransmit(msg, channel, time))
-		{
-			remove(msg, prev);
-			message_timeout(*msg, channel);
-			delete msg;
-			msg = (prev==nullptr) ? head : prev->get_next();
-		}
-		else
+		CoAPMessage* msg = static_cast<CoAPMessage*>(timer->data());
+		if (retransmit(msg, channel, time))
 		{
-			prev = msg;
-			msg = msg->get_next();
+			const ProtocolError error = schedule(*msg);
+			if (!error)
+				continue;
+			// Without a timer the message would never be retransmitted or expire
+			LOG(ERROR, "unable to schedule retransmission of message id=%x: %d", msg->get_id(), (int)error);
+			result = error;
 		}
+		remove(msg->get_id());
+		message_timeout(*msg, channel);
+		delete msg;
 	}
+	return result;
 }
 
 
@@ -97,10 +121,15 @@ ProtocolError CoAPMessageStore::send(Message& msg, system_tick_t time)
 		if (coapmsg==nullptr)
 			return INSUFFICIENT_STORAGE;
 		if (coapType==CoAPType::CON)
-			coapmsg->prepare_retransmit(time);
+			coapmsg->prepare_retransmit(time, g_connectionQuality.ack_timeout());
 		else
-			coapmsg->set_expiration(time+CoAPMessage::MAX_TRANSMIT_SPAN);
-		add(*coapmsg);
+			coapmsg->set_expiration(time+g_connectionQuality.scaled_timeout(CoAPMessage::MAX_TRANSMIT_SPAN));
+		ProtocolError error = add(*coapmsg);
+		if (error)
+		{
+			delete coapmsg;
+			return error;
+		}
 	}
 	return NO_ERROR;
 }
@@ -122,6 +151,12 @@ ProtocolError CoAPMessageStore::receive(Message& msg, Channel& channel, system_t
 			}
 			channel.command(Channel::DISCARD_SESSION, nullptr);
 		}
+		else {
+			CoAPMessage* msg = from_id(id);
+			if (msg) {
+				message_acknowledged(*msg, time);
+			}
+		}
 		DEBUG("recieved ACK for message id=%x", id);
 		if (!clear_message(id)) {		// message didn't exist, means it's already been acknoweldged or is unknown.
 			msg.set_length(0);
@@ -147,8 +182,13 @@ ProtocolError CoAPMessageStore::receive(Message& msg, Channel& channel, system_t
 				return INSUFFICIENT_STORAGE;
 			// the timeout here is ideally purely academic since the application will respond immediately with an ACK/RESET
 			// which will be stored in place of this message, with it's own timeout.
-			coapmsg->set_expiration(time+CoAPMessage::MAX_TRANSMIT_SPAN);
-			add(*coapmsg);
+			coapmsg->set_expiration(time+g_connectionQuality.scaled_timeout(CoAPMessage::MAX_TRANSMIT_SPAN));
+			ProtocolError error = add(*coapmsg);
+			if (error)
+			{
+				delete coapmsg;
+				return error;
+			}
 		}
 	}
 	// else it's a NON message - pass through
@@ -23,6 +23,7 @@
 #include "timer_hal.h"
 #include "stdlib.h"
 #include "service_debug.h"
+#include "timer_queue.h"
 
 namespace particle
 {
@@ -85,7 +86,7 @@ public:
 /**
  * A CoAP message that is available for (re-)transmission.
  */
-class __attribute__((packed)) CoAPMessage
+class CoAPMessage
 {
 public:
 	enum Delivery
@@ -110,6 +111,11 @@ private:
 	 */
 	system_tick_t timeout;
 
+	/**
+	 * The time when this message was first transmitted.
+	 */
+	system_tick_t sent;
+
 	/**
 	 * The unique 16-bit ID for this message.
 	 */
@@ -125,6 +131,10 @@ private:
 	// uint8_t reserved;
 	std::function<void(Delivery)>* delivered;
 
+	/**
+	 * Timer scheduling the retransmission or expiration of this message.
+	 */
+	SoftTimer timer;
 
 	/**
 	 * How many data bytes follow.
@@ -149,6 +159,9 @@ private:
 
 public:
 
+	/**
+	 * The initial ACK timeout used until the round trip time is estimated (see ConnectionQuality).
+	 */
 	static const uint16_t ACK_TIMEOUT = 4000;
 	static const uint16_t ACK_RANDOM_FACTOR = 1500;
 	static const uint16_t ACK_RANDOM_DIVISOR = 1000;
@@ -162,7 +175,7 @@ public:
 	static const uint8_t NSTART = 1;
 
 
-	CoAPMessage(message_id_t id_) : next(nullptr), timeout(0), id(id_), transmit_count(0), delivered(nullptr), data_len(0) {
+	CoAPMessage(message_id_t id_) : next(nullptr), timeout(0), sent(0), id(id_), transmit_count(0), delivered(nullptr), timer(nullptr, this), data_len(0) {
 		message_count++;
 	}
 
@@ -196,6 +209,9 @@ public:
 	inline message_id_t get_id() const { return id; }
 	inline void removed() { next = nullptr; }
 	inline system_tick_t get_timeout() const { return timeout; }
+	inline system_tick_t get_sent_time() const { return sent; }
+	inline uint8_t get_transmit_count() const { return transmit_count; }
+	inline SoftTimer* get_timer() { return &timer; }
 
 	inline void set_delivered_handler(std::function<void(Delivery)>* handler) { this->delivered = handler; }
 
@@ -213,13 +229,16 @@ public:
 
 	/**
 	 * Prepares to retransmit this message after a timeout.
+	 * @param ack_timeout The initial ACK timeout.
 	 * @return false if the message cannot be retransmitted.
 	 */
-	bool prepare_retransmit(system_tick_t now)
+	bool prepare_retransmit(system_tick_t now, system_tick_t ack_timeout = ACK_TIMEOUT)
 	{
 		CoAPType::Enum coapType = CoAP::type(get_data());
 		if (coapType==CoAPType::CON) {
-			timeout = now + transmit_timeout(transmit_count);
+			if (!transmit_count)
+				sent = now;
+			timeout = now + transmit_timeout(transmit_count, ack_timeout);
 			transmit_count++;
 			return transmit_count <= MAX_RETRANSMIT+1;
 		}
@@ -230,9 +249,9 @@ public:
 	/**
 	 * Determines the transmit timeout for the given transmission count.
 	 */
-	static inline system_tick_t transmit_timeout(uint8_t transmit_count)
+	static inline system_tick_t transmit_timeout(uint8_t transmit_count, system_tick_t ack_timeout = ACK_TIMEOUT)
 	{
-		system_tick_t timeout = (ACK_TIMEOUT << transmit_count);
+		system_tick_t timeout = (ack_timeout << transmit_count);
 		timeout += ((timeout * (rand()%256))>>9);
 		return timeout;
 	}
@@ -326,6 +345,7 @@ class CoAPMessageStore
 	 */
 	void remove(CoAPMessage* message, CoAPMessage* previous)
 	{
+		timers.stop(message->get_timer());
 		if (previous)
 			previous->set_next(message->get_next());
 		else
@@ -334,9 +354,33 @@ class CoAPMessageStore
 	}
 
 	void message_timeout(CoAPMessage& msg, Channel& channel);
+	void message_acknowledged(const CoAPMessage& msg, system_tick_t time);
+
+	/**
+	 * Schedules the retransmission or expiration of a message at the message's timeout.
+	 */
+	ProtocolError schedule(CoAPMessage& message)
+	{
+		// Expiration of cached messages is not time critical, so it can be coalesced with other timers
+		const system_tick_t slack = (message.get_type()==CoAPType::CON) ? 0 : EXPIRATION_SLACK;
+		if (timers.start(message.get_timer(), message.get_timeout(), 0, slack)!=0)
+			return INSUFFICIENT_STORAGE;
+		return NO_ERROR;
+	}
+
+	/**
+	 * Timers of the stored messages.
+	 */
+	TimerQueue timers;
 
 public:
 
+	/**
+	 * The maximum delay in expiring messages that are not retransmitted.
+	 */
+	static const system_tick_t EXPIRATION_SLACK = 1000;
+
+
 	CoAPMessageStore() : head(nullptr) {}
 
 	~CoAPMessageStore() {
@@ -379,6 +423,9 @@ public:
 		clear_message(message.get_id());
 		if (message.get_next())
 			return INVALID_STATE;
+		ProtocolError error = schedule(message);
+		if (error)
+			return error;
 		message.set_next(head);
 		head = &message;
 		return NO_ERROR;
@@ -411,8 +458,9 @@ public:
 
 	/**
 	 * Process existing messages, resending any unacknowledged requests to the given channel.
+	 * Returns an error if a message couldn't be rescheduled, in which case it is treated as timed out.
 	 */
-	void process(system_tick_t time, Channel& channel);
+	ProtocolError process(system_tick_t time, Channel& channel);
 
 	/**
 	 * Sends the given CoAPMessage to the channel.
@@ -655,8 +703,10 @@ public:
 				error = store.receive(msg, delegateChannel, millis());
 			}
 		}
-		client.process(millis(), delegateChannel);
-		server.process(millis(), delegateChannel);
+		const ProtocolError clientError = client.process(millis(), delegateChannel);
+		const ProtocolError serverError = server.process(millis(), delegateChannel);
+		if (!error)
+			error = clientError ? clientError : serverError;
 		return error;
 	}
 
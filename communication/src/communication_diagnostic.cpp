@@ -2,3 +2,45 @@
 
 particle::SimpleIntegerDiagnosticData g_rateLimitedEventsCounter(DIAG_ID_CLOUD_RATE_LIMITED_EVENTS, DIAG_NAME_CLOUD_RATE_LIMITED_EVENTS);
 particle::SimpleIntegerDiagnosticData g_unacknowledgedMessageCounter(DIAG_ID_CLOUD_UNACKNOWLEDGED_MESSAGES, DIAG_NAME_CLOUD_UNACKNOWLEDGED_MESSAGES);
+particle::SimpleHistogramDiagnosticData g_roundTripTime(DIAG_ID_CLOUD_ROUND_TRIP_TIME, DIAG_NAME_CLOUD_ROUND_TRIP_TIME);
+particle::SimpleHistogramDiagnosticData g_publishAckLatency(DIAG_ID_CLOUD_PUBLISH_ACK_LATENCY, DIAG_NAME_CLOUD_PUBLISH_ACK_LATENCY);
+particle::SimpleTimerDiagnosticData g_handshakeDuration(DIAG_ID_CLOUD_HANDSHAKE_DURATION, DIAG_NAME_CLOUD_HANDSHAKE_DURATION);
+particle::protocol::ConnectionQuality g_connectionQuality;
+
+namespace {
+
+using namespace particle;
+
+// Exposes an estimate of the connection quality. The estimate is a 32-bit word, so it's read directly
+class ConnectionQualityDiagnosticData: public AbstractIntegerDiagnosticData {
+public:
+    ConnectionQualityDiagnosticData(DiagnosticDataId id, const char* name, const int32_t& val) :
+            AbstractIntegerDiagnosticData(id, name),
+            val_(val) {
+    }
+
+private:
+    const int32_t& val_;
+
+    virtual int get(IntType& val) override { // AbstractIntegerDiagnosticData
+        val = *(const volatile int32_t*)&val_;
+        return SYSTEM_ERROR_NONE;
+    }
+
+    virtual const volatile void* valuePtr() const override { // AbstractDiagnosticData
+        return &val_;
+    }
+};
+
+ConnectionQualityDiagnosticData g_srttDiagData(DIAG_ID_CLOUD_SMOOTHED_ROUND_TRIP_TIME, DIAG_NAME_CLOUD_SMOOTHED_ROUND_TRIP_TIME,
+        g_connectionQuality.srtt());
+ConnectionQualityDiagnosticData g_rttvarDiagData(DIAG_ID_CLOUD_ROUND_TRIP_TIME_VARIATION, DIAG_NAME_CLOUD_ROUND_TRIP_TIME_VARIATION,
+        g_connectionQuality.rttvar());
+ConnectionQualityDiagnosticData g_ackTimeoutDiagData(DIAG_ID_CLOUD_ACK_TIMEOUT, DIAG_NAME_CLOUD_ACK_TIMEOUT,
+        g_connectionQuality.ack_timeout());
+ConnectionQualityDiagnosticData g_lossRateDiagData(DIAG_ID_CLOUD_LOSS_RATE, DIAG_NAME_CLOUD_LOSS_RATE,
+        g_connectionQuality.loss_rate());
+ConnectionQualityDiagnosticData g_throughputDiagData(DIAG_ID_CLOUD_THROUGHPUT, DIAG_NAME_CLOUD_THROUGHPUT,
+        g_connectionQuality.throughput());
+
+} // namespace
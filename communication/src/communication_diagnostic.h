@@ -1,4 +1,9 @@
 #include "spark_wiring_diagnostics.h"
+#include "connection_quality.h"
 
 extern particle::SimpleIntegerDiagnosticData g_rateLimitedEventsCounter;
 extern particle::SimpleIntegerDiagnosticData g_unacknowledgedMessageCounter;
+extern particle::SimpleHistogramDiagnosticData g_roundTripTime;
+extern particle::SimpleHistogramDiagnosticData g_publishAckLatency;
+extern particle::SimpleTimerDiagnosticData g_handshakeDuration;
+extern particle::protocol::ConnectionQuality g_connectionQuality;
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "connection_quality.h"
+
+namespace particle { namespace protocol {
+
+namespace {
+
+template<typename T>
+inline T clamp(T val, T min, T max)
+{
+	return (val<min) ? min : ((val>max) ? max : val);
+}
+
+} // namespace
+
+const system_tick_t ConnectionQuality::DEFAULT_ACK_TIMEOUT;
+const system_tick_t ConnectionQuality::MIN_ACK_TIMEOUT;
+const system_tick_t ConnectionQuality::MAX_ACK_TIMEOUT;
+const system_tick_t ConnectionQuality::MIN_RTT_VARIATION;
+const unsigned ConnectionQuality::PING_TIMEOUT_FACTOR;
+const system_tick_t ConnectionQuality::MIN_PING_TIMEOUT;
+const system_tick_t ConnectionQuality::MAX_PING_TIMEOUT;
+const system_tick_t ConnectionQuality::THROUGHPUT_INTERVAL;
+
+ConnectionQuality::ConnectionQuality() :
+		srtt_scaled(0),
+		rttvar_scaled(0),
+		loss_scaled(0),
+		window_bytes(0),
+		window_start(0),
+		window_started(false),
+		srtt_ms(0),
+		rttvar_ms(0),
+		ack_timeout_ms(DEFAULT_ACK_TIMEOUT),
+		loss_rate_permille(0),
+		throughput_bps(0)
+{
+}
+
+void ConnectionQuality::message_acknowledged(system_tick_t rtt, unsigned transmissions, size_t size, system_tick_t now)
+{
+	if (transmissions==1)
+		rtt_sample(rtt);
+	for (unsigned i = 1; i<transmissions; i++)
+		transmission(true);
+	transmission(false);
+	if (!window_started)
+	{
+		window_start = now-rtt;
+		window_started = true;
+	}
+	window_bytes += size;
+	const system_tick_t elapsed = now-window_start;
+	if (elapsed>=THROUGHPUT_INTERVAL)
+	{
+		throughput_bps = (uint64_t)window_bytes*1000/elapsed;
+		window_bytes = 0;
+		window_start = now;
+	}
+}
+
+void ConnectionQuality::retransmission_timeout()
+{
+	// RTO = RTO * 2, the backed off value is kept until the next sample
+	ack_timeout_ms = (ack_timeout_ms<(int32_t)MAX_ACK_TIMEOUT/2) ? ack_timeout_ms*2 : MAX_ACK_TIMEOUT;
+}
+
+void ConnectionQuality::reset()
+{
+	*this = ConnectionQuality();
+}
+
+void ConnectionQuality::message_timeout(unsigned transmissions)
+{
+	for (unsigned i = 0; i<transmissions; i++)
+		transmission(true);
+}
+
+system_tick_t ConnectionQuality::ping_timeout(system_tick_t default_timeout) const
+{
+	if (!has_samples())
+		return default_timeout;
+	return clamp<system_tick_t>(ack_timeout_ms*PING_TIMEOUT_FACTOR, MIN_PING_TIMEOUT, MAX_PING_TIMEOUT);
+}
+
+system_tick_t ConnectionQuality::scaled_timeout(system_tick_t default_timeout) const
+{
+	if ((system_tick_t)ack_timeout_ms<=DEFAULT_ACK_TIMEOUT)
+		return default_timeout;
+	return (uint64_t)default_timeout*ack_timeout_ms/DEFAULT_ACK_TIMEOUT;
+}
+
+/**
+ * Updates the round trip time estimates as described in RFC 6298. The estimates are kept scaled,
+ * so that the smoothing doesn't lose precision with integer arithmetic.
+ */
+void ConnectionQuality::rtt_sample(system_tick_t rtt)
+{
+	if (!rtt)
+		rtt = 1; // A zero SRTT means that no samples were taken
+	if (!srtt_scaled)
+	{
+		srtt_scaled = rtt<<3; // SRTT = R
+		rttvar_scaled = rtt<<1; // RTTVAR = R/2
+	}
+	else
+	{
+		const int32_t delta = (int32_t)rtt-(int32_t)(srtt_scaled>>3);
+		const uint32_t abs_delta = (delta<0) ? -delta : delta;
+		rttvar_scaled += abs_delta-(rttvar_scaled>>2); // RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R|
+		srtt_scaled += delta; // SRTT = 7/8 * SRTT + 1/8 * R
+		if (!srtt_scaled)
+			srtt_scaled = 1;
+	}
+	srtt_ms = srtt_scaled>>3;
+	rttvar_ms = rttvar_scaled>>2;
+	// RTO = SRTT + max(G, 4 * RTTVAR)
+	const system_tick_t variation = (rttvar_scaled>MIN_RTT_VARIATION) ? rttvar_scaled : MIN_RTT_VARIATION;
+	ack_timeout_ms = clamp<system_tick_t>(srtt_ms+variation, MIN_ACK_TIMEOUT, MAX_ACK_TIMEOUT);
+}
+
+void ConnectionQuality::transmission(bool lost)
+{
+	// loss = 15/16 * loss + 1/16 * (lost ? 1000 : 0)
+	loss_scaled += (lost ? 1000 : 0)-(loss_scaled>>4);
+	loss_rate_permille = loss_scaled>>4;
+}
+
+}}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace particle { namespace protocol {
+
+/**
+ * Estimates the quality of the cloud connection from the acknowledgements of confirmable CoAP
+ * messages.
+ *
+ * - The smoothed round trip time and its variation are estimated as described in RFC 6298. Only
+ *   messages that were acknowledged on their first transmission are sampled (Karn's algorithm),
+ *   and the ACK timeout is backed off when a retransmission timer expires.
+ * - The loss rate is an exponentially weighted moving average of the fraction of transmissions
+ *   that were not acknowledged, in 1/1000ths.
+ * - The throughput is the number of acknowledged bytes per second, measured over intervals of at
+ *   least THROUGHPUT_INTERVAL milliseconds.
+ *
+ * The estimates determine the CoAP ACK timeout, the keepalive ping timeout and the lifetime of
+ * the messages that depend on retransmission timing. The system also
+ * scales the cloud reconnection backoff to the ACK timeout. Each estimate is kept in a 32-bit word,
+ * so that it can be read by the diagnostic sources from other threads.
+ */
+class ConnectionQuality
+{
+public:
+	/**
+	 * The ACK timeout used until the first round trip time sample is taken.
+	 */
+	static const system_tick_t DEFAULT_ACK_TIMEOUT = 4000;
+	static const system_tick_t MIN_ACK_TIMEOUT = 1000;
+	static const system_tick_t MAX_ACK_TIMEOUT = 16000;
+
+	/**
+	 * Lower bound for the variation term of the ACK timeout (`G` in RFC 6298). Received messages
+	 * are only processed when the system loop runs, which adds to the measured round trip time.
+	 */
+	static const system_tick_t MIN_RTT_VARIATION = 100;
+
+	/**
+	 * The ping timeout covers the first transmission of a ping and 2 retransmissions.
+	 */
+	static const unsigned PING_TIMEOUT_FACTOR = 7;
+	static const system_tick_t MIN_PING_TIMEOUT = 10000;
+	static const system_tick_t MAX_PING_TIMEOUT = 60000;
+
+	static const system_tick_t THROUGHPUT_INTERVAL = 10000;
+
+	ConnectionQuality();
+
+	/**
+	 * Records the acknowledgement of a confirmable message.
+	 *
+	 * @param rtt Time elapsed since the first transmission of the message.
+	 * @param transmissions Number of times the message was transmitted.
+	 * @param size Message size.
+	 * @param now Current time.
+	 */
+	void message_acknowledged(system_tick_t rtt, unsigned transmissions, size_t size, system_tick_t now);
+
+	/**
+	 * Records the expiry of the retransmission timer of a confirmable message. The ACK timeout is
+	 * doubled, up to MAX_ACK_TIMEOUT, and kept until the next round trip time sample is taken, as
+	 * described in RFC 6298, section 5.5-5.7. Otherwise the samples would all be discarded by
+	 * Karn's algorithm once the round trip time exceeds the ACK timeout.
+	 */
+	void retransmission_timeout();
+
+	/**
+	 * Discards the estimates, e.g. when a new session is established.
+	 */
+	void reset();
+
+	/**
+	 * Records a confirmable message that was not acknowledged.
+	 *
+	 * @param transmissions Number of times the message was transmitted.
+	 */
+	void message_timeout(unsigned transmissions);
+
+	/**
+	 * Returns `true` if at least one round trip time sample was taken.
+	 */
+	bool has_samples() const { return srtt_scaled!=0; }
+
+	/**
+	 * Smoothed round trip time in milliseconds, or 0 if no samples were taken.
+	 */
+	const int32_t& srtt() const { return srtt_ms; }
+
+	/**
+	 * Round trip time variation in milliseconds.
+	 */
+	const int32_t& rttvar() const { return rttvar_ms; }
+
+	/**
+	 * Initial timeout for the acknowledgement of a confirmable message, in milliseconds.
+	 */
+	const int32_t& ack_timeout() const { return ack_timeout_ms; }
+
+	/**
+	 * Estimated fraction of lost transmissions, in 1/1000ths.
+	 */
+	const int32_t& loss_rate() const { return loss_rate_permille; }
+
+	/**
+	 * Acknowledged bytes per second.
+	 */
+	const int32_t& throughput() const { return throughput_bps; }
+
+	/**
+	 * Returns the maximum time to wait for the acknowledgement of a ping.
+	 *
+	 * @param default_timeout Timeout to use if no round trip time samples were taken.
+	 */
+	system_tick_t ping_timeout(system_tick_t default_timeout) const;
+
+	/**
+	 * Scales a timeout that covers the retransmissions of a message, such as the CoAP
+	 * MAX_TRANSMIT_SPAN, to the current ACK timeout. The result is never shorter than the timeout
+	 * defined for DEFAULT_ACK_TIMEOUT.
+	 *
+	 * @param default_timeout Timeout for DEFAULT_ACK_TIMEOUT.
+	 */
+	system_tick_t scaled_timeout(system_tick_t default_timeout) const;
+
+private:
+	uint32_t srtt_scaled; // Smoothed round trip time * 8
+	uint32_t rttvar_scaled; // Round trip time variation * 4
+	uint32_t loss_scaled; // Loss rate * 16
+	uint32_t window_bytes; // Bytes acknowledged in the current throughput interval
+	system_tick_t window_start;
+	bool window_started;
+
+	int32_t srtt_ms;
+	int32_t rttvar_ms;
+	int32_t ack_timeout_ms;
+	int32_t loss_rate_permille;
+	int32_t throughput_bps;
+
+	void rtt_sample(system_tick_t rtt);
+	void transmission(bool lost);
+};
+
+}}
@@ -31,6 +31,7 @@ LOG_SOURCE_CATEGORY("comm.dtls")
 #include "mbedtls_util.h"
 #include "mbedtls/version.h"
 #include "timer_hal.h"
+#include "trace.h"
 #include <stdio.h>
 #include <string.h>
 #include "dtls_session_persist.h"
@@ -411,6 +412,7 @@ ProtocolError DTLSMessageChannel::notify_established()
 
 ProtocolError DTLSMessageChannel::receive(Message& message)
 {
+	TRACE_SCOPE("DTLSMessageChannel::receive");
 	if (ssl_context.state != MBEDTLS_SSL_HANDSHAKE_OVER)
 		return INVALID_STATE;
 
@@ -457,6 +459,7 @@ ProtocolError DTLSMessageChannel::receive(Message& message)
 
 ProtocolError DTLSMessageChannel::send(Message& message)
 {
+	TRACE_SCOPE("DTLSMessageChannel::send");
   if (ssl_context.state != MBEDTLS_SSL_HANDSHAKE_OVER)
     return INVALID_STATE;
 
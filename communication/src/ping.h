@@ -1,6 +1,8 @@
 #pragma once
 
 #include "protocol_defs.h"
+#include "connection_quality.h"
+#include "timer_queue.h"
 
 namespace particle { namespace protocol {
 
@@ -10,8 +12,18 @@ class Pinger
 	system_tick_t ping_interval;
 	system_tick_t ping_timeout;
 
+	/**
+	 * Adapts the ping timeout to the estimated round trip time (optional).
+	 */
+	const ConnectionQuality* quality;
+
+	/**
+	 * Expires when the ping interval has passed since the last message.
+	 */
+	SoftTimer timer;
+
 public:
-	Pinger() : expecting_ping_ack(false), ping_interval(0), ping_timeout(10000) {}
+	Pinger() : expecting_ping_ack(false), ping_interval(0), ping_timeout(10000), quality(nullptr) {}
 
 	/**
 	 * Sets the ping interval that the client will send pings to the server, and the expected maximum response time.
@@ -27,6 +39,20 @@ public:
 		this->ping_interval = interval;
 	}
 
+	/**
+	 * Sets the connection quality estimator. Once the estimator has sampled the round trip time,
+	 * its ping timeout replaces the timeout passed to init().
+	 */
+	void set_connection_quality(const ConnectionQuality* quality)
+	{
+		this->quality = quality;
+	}
+
+	system_tick_t timeout() const
+	{
+		return quality ? quality->ping_timeout(ping_timeout) : ping_timeout;
+	}
+
 	void reset()
 	{
 		expecting_ping_ack = false;
@@ -39,7 +65,7 @@ public:
 	{
 		if (expecting_ping_ack)
 		{
-			if (ping_timeout < millis_since_last_message)
+			if (timeout() < millis_since_last_message)
 			{
 				// timed out, disconnect
 				return PING_TIMEOUT;
@@ -62,6 +88,26 @@ public:
 
 	bool is_expecting_ping_ack() const { return expecting_ping_ack; }
 
+	/**
+	 * Schedules the next check of the ping interval, relative to the time of the last message.
+	 */
+	void schedule(TimerQueue& timers, system_tick_t last_message_millis)
+	{
+		if (ping_interval)
+			timers.start(&timer, last_message_millis + ping_interval + 1);
+		else
+			timers.stop(&timer);
+	}
+
+	/**
+	 * Returns true if process() needs to be called, that is, when the ping interval has passed or an
+	 * acknowledgement for a ping is expected.
+	 */
+	bool is_due() const
+	{
+		return expecting_ping_ack || (ping_interval && !timer.isActive());
+	}
+
 	void message_received() { expecting_ping_ack = false; }
 };
 
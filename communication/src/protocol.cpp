@@ -24,6 +24,8 @@ LOG_SOURCE_CATEGORY("comm.protocol")
 #include "chunked_transfer.h"
 #include "subscriptions.h"
 #include "functions.h"
+#include "communication_diagnostic.h"
+#include "trace.h"
 
 namespace particle { namespace protocol {
 
@@ -43,7 +45,7 @@ ProtocolError Protocol::send_empty_ack(Message& message, message_id_t msg_id)
 ProtocolError Protocol::handle_received_message(Message& message,
 		CoAPMessageType::Enum& message_type)
 {
-	last_message_millis = callbacks.millis();
+	message_activity();
 	pinger.message_received();
 	uint8_t* queue = message.buf();
 	message_type = Messages::decodeType(queue, message.length());
@@ -209,6 +211,8 @@ void Protocol::init(const SparkCallbacks &callbacks,
 	chunkedTransferCallbacks.init(&this->callbacks);
 	chunkedTransfer.init(&chunkedTransferCallbacks);
 
+	pinger.set_connection_quality(&g_connectionQuality);
+
 	initialized = true;
 }
 
@@ -252,9 +256,16 @@ int Protocol::begin()
 {
 	LOG_CATEGORY("comm.protocol.handshake");
 	LOG(INFO,"Establish secure connection");
+	g_handshakeDuration.start();
 	chunkedTransfer.reset();
 	pinger.reset();
 	timesync_.reset();
+	g_connectionQuality.reset();
+	if (descriptor.append_metrics && incremental_metrics)
+	{
+		// the cloud may not have the last reported values in a new session
+		descriptor.append_metrics(nullptr, nullptr, 0x20 | 2 | 1, 0, nullptr);	// reset the incremental report state
+	}
 
 	// FIXME: Pending completion handlers should be cancelled at the end of a previous session
 	ack_handlers.clear();
@@ -282,6 +293,7 @@ int Protocol::begin()
 	{
 		ping(true);
 		LOG(INFO,"resumed session - not sending HELLO message");
+		g_handshakeDuration.stop();
 		return error;
 	}
 
@@ -303,6 +315,7 @@ int Protocol::begin()
 			return error;
 	}
 	LOG(INFO,"Handshake completed");
+	g_handshakeDuration.stop();
 	channel.notify_established();
 	flags |= SKIP_SESSION_RESUME_HELLO;
 	return error;
@@ -322,7 +335,7 @@ ProtocolError Protocol::hello(bool was_ota_upgrade_successful)
 	size_t len = build_hello(message, flags);
 	message.set_length(len);
 	message.set_confirm_received(true);
-	last_message_millis = callbacks.millis();
+	message_activity();
 	return channel.send(message);
 }
 
@@ -372,10 +385,13 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum message_type,
  */
 ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type)
 {
+	TRACE_SCOPE("Protocol::event_loop");
 	// Process expired completion handlers
 	const system_tick_t t = callbacks.millis();
 	ack_handlers.update(t - last_ack_handlers_update);
 	last_ack_handlers_update = t;
+	// Process expired keepalive and time sync timers
+	timers.process(t);
 
 	Message message;
 	message_type = CoAPMessageType::NONE;
@@ -424,7 +440,10 @@ ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int
 		appender.append(char(0));	// null byte means binary data
 		appender.append(char(DESCRIBE_METRICS)); 									// uint16 describes the type of binary packet
 		appender.append(char(0));	//
-		const int flags = 1;		// binary
+		int flags = 1;				// binary
+		if (incremental_metrics) {
+			flags |= 2;				// only the changed values
+		}
 		const int page = 0;
 		descriptor.append_metrics(append_instance, &appender, flags, page, nullptr);
 	}
@@ -496,6 +515,11 @@ ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int
 											  desc_flags & DESCRIBE_APPLICATION ? "A" : "",
 											  desc_flags & DESCRIBE_METRICS ? "M" : "");
 	ProtocolError error = channel.send(message);
+	if (error==NO_ERROR && descriptor.append_metrics && (desc_flags == DESCRIBE_METRICS) && incremental_metrics)
+	{
+		// the report has been sent, so the next one can be encoded relative to it
+		descriptor.append_metrics(nullptr, nullptr, 0x10 | 2 | 1, 0, nullptr);	// commit the incremental report
+	}
 	if (error==NO_ERROR && descriptor.app_state_selector_info &&
             (desc_flags & DESCRIBE_APPLICATION || desc_flags & DESCRIBE_SYSTEM))
 	{
@@ -30,6 +30,12 @@ class Protocol
 	 */
 	MessageChannel& channel;
 
+	/**
+	 * Software timers processed by the event loop. Declared before the objects owning
+	 * the timers, so that it's destroyed after them.
+	 */
+	TimerQueue timers;
+
 	/**
 	 * The tick time of the last communication with the cloud.
 	 * todo - move this into the message channel?
@@ -129,6 +135,11 @@ class Protocol
 
 	uint8_t flags;
 
+	/**
+	 * Set to true if the diagnostics are reported in the incremental format.
+	 */
+	bool incremental_metrics;
+
 public:
 	enum Flags
 	{
@@ -200,7 +211,7 @@ protected:
 		else {
 			len = Messages::ping(message.buf(), 0);
 		}
-		last_message_millis = callbacks.millis();
+		message_activity();
 		message.set_length(len);
 		return channel.send(message);
 	}
@@ -214,17 +225,28 @@ protected:
 		{
 			return chunkedTransfer.idle(channel);
 		}
-		else
+		else if (pinger.is_due())
 		{
 			ProtocolError error = pinger.process(
 					callbacks.millis() - last_message_millis, [this]
 					{	return ping();});
 			if (error)
 				return error;
+			if (!pinger.is_expecting_ping_ack())
+				pinger.schedule(timers, last_message_millis);
 		}
 		return NO_ERROR;
 	}
 
+	/**
+	 * Records that a message has been sent or received.
+	 */
+	void message_activity()
+	{
+		last_message_millis = callbacks.millis();
+		pinger.schedule(timers, last_message_millis);
+	}
+
 	/**
 	 * The number of missed chunks to send in a single flight.
 	 */
@@ -274,11 +296,14 @@ protected:
 public:
 	Protocol(MessageChannel& channel) :
 			channel(channel),
+			last_message_millis(0),
 			product_id(PRODUCT_ID),
 			product_firmware_version(PRODUCT_FIRMWARE_VERSION),
 			publisher(this),
+			timesync_(&timers),
 			last_ack_handlers_update(0),
-			initialized(false)
+			initialized(false),
+			incremental_metrics(false)
 	{
 	}
 
@@ -290,11 +315,18 @@ public:
 	void initialize_ping(system_tick_t interval, system_tick_t timeout)
 	{
 		pinger.init(interval, timeout);
+		pinger.schedule(timers, last_message_millis);
 	}
 
 	void set_keepalive(system_tick_t interval)
 	{
 		pinger.set_interval(interval);
+		pinger.schedule(timers, last_message_millis);
+	}
+
+	void set_incremental_metrics(bool enabled)
+	{
+		incremental_metrics = enabled;
 	}
 
 	void set_handlers(CommunicationsHandlers& handlers)
@@ -100,7 +100,8 @@ namespace Connection
 {
 enum Enum
 {
-    PING = 0
+    PING = 0,
+    INCREMENTAL_METRICS = 1 // Enables incremental reporting of diagnostics
 };
 }
 
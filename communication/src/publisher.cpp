@@ -18,7 +18,8 @@
 #include "publisher.h"
 
 #include "protocol.h"
+#include "communication_diagnostic.h"
 
 void particle::protocol::Publisher::add_ack_handler(message_id_t msg_id, CompletionHandler handler) {
-    protocol->add_ack_handler(msg_id, std::move(handler), SEND_EVENT_ACK_TIMEOUT);
+    protocol->add_ack_handler(msg_id, std::move(handler), g_connectionQuality.scaled_timeout(SEND_EVENT_ACK_TIMEOUT));
 }
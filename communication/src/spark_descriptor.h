@@ -97,6 +97,9 @@ struct SparkDescriptor
      * @param appender	The appender function to call with the "append" data and the string to append
      * @param append		Opaque data to be passed to appender
      * @param flags		0x01 - append as binary daata, otherwise append as json
+     * 					0x02 - append only the values changed since the last committed report
+     * 					0x10 - commit the last incremental report once it has been sent, nothing is appended
+     * 					0x20 - discard the state of the incremental reports, nothing is appended
      * @param page		A key to select which metrics data to output. Presently unused and should be 0, which means the default metrics.
      * @param reserved	For future expansion.
      * @return
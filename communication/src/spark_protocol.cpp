@@ -575,7 +575,7 @@ bool SparkProtocol::send_event(const char *event_name, const char *data, int ttl
   // original request has been sent as confirmable or non-confirmable CoAP message. Here we register
   // completion handler only if acknowledgement was requested explicitly
   if (flags & EventType::WITH_ACK) {
-    ack_handlers.addHandler(msg_id, std::move(handler), SEND_EVENT_ACK_TIMEOUT);
+    ack_handlers.addHandler(msg_id, std::move(handler), g_connectionQuality.scaled_timeout(SEND_EVENT_ACK_TIMEOUT));
   } else {
     handler.setResult();
   }
@@ -187,6 +187,10 @@ int spark_protocol_set_connection_property(ProtocolFacade* protocol, unsigned pr
     {
         protocol->set_keepalive(data);
     }
+    else if (property_id == particle::protocol::Connection::INCREMENTAL_METRICS)
+    {
+        protocol->set_incremental_metrics(data);
+    }
     return 0;
 }
 int spark_protocol_command(ProtocolFacade* protocol, ProtocolCommands::Enum cmd, uint32_t data, void* reserved)
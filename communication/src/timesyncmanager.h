@@ -2,14 +2,26 @@
 
 #include "protocol_defs.h"
 #include "service_debug.h"
+#include "timer_queue.h"
 
 namespace particle { namespace protocol {
 
 class TimeSyncManager
 {
 public:
-    TimeSyncManager()
-        : lastSyncMillis_{0},
+    /**
+     * Time after which a pending request is abandoned, so that it can be sent again.
+     */
+    static const system_tick_t REQUEST_TIMEOUT = 60000;
+
+    /**
+     * @param timers Queue used to time out pending requests. Requests never time out if this
+     *        argument is `nullptr`.
+     */
+    explicit TimeSyncManager(TimerQueue* timers = nullptr)
+        : timers_{timers},
+          timer_{requestTimeout, this},
+          lastSyncMillis_{0},
           requestSentMillis_{0},
           lastSyncTime_{0},
           expectingResponse_{false}
@@ -20,6 +32,9 @@ public:
     {
         expectingResponse_ = false;
         requestSentMillis_ = 0;
+        if (timers_) {
+            timers_->stop(&timer_);
+        }
     }
 
     template <typename Callback>
@@ -30,6 +45,10 @@ public:
 
         requestSentMillis_ = mil;
         expectingResponse_ = true;
+        if (timers_) {
+            // The exact timeout is not important, so allow it to be coalesced with other timers
+            timers_->start(&timer_, mil + REQUEST_TIMEOUT, 0, REQUEST_TIMEOUT / 10);
+        }
         LOG(INFO, "Sending TIME request");
         return send_time_request();
     }
@@ -39,6 +58,9 @@ public:
         LOG(INFO, "Received TIME response: %lu", (unsigned long)tm);
         set_time(tm, 0, NULL);
         expectingResponse_ = false;
+        if (timers_) {
+            timers_->stop(&timer_);
+        }
         lastSyncTime_ = tm;
         lastSyncMillis_ = mil;
         return true;
@@ -55,10 +77,20 @@ public:
 
 
 private:
+    TimerQueue* timers_;
+    SoftTimer timer_;
     system_tick_t lastSyncMillis_;
     system_tick_t requestSentMillis_;
     time_t lastSyncTime_;
     bool expectingResponse_;
+
+    static void requestTimeout(SoftTimer* timer, void* data) {
+        const auto self = static_cast<TimeSyncManager*>(data);
+        if (self->expectingResponse_) {
+            LOG(WARN, "TIME request timed out");
+            self->expectingResponse_ = false;
+        }
+    }
 };
 
 
@@ -141,6 +141,47 @@ os_result_t os_thread_yield(void);
  */
 os_result_t os_thread_delay_until(system_tick_t *previousWakeTime, system_tick_t timeIncrement);
 
+/**
+ * Returns the handle of the calling thread.
+ */
+os_thread_t os_thread_current(void* reserved);
+
+typedef enum os_thread_type_t
+{
+    OS_THREAD_TYPE_OTHER = 0,
+    OS_THREAD_TYPE_IDLE = 1, // Idle thread of the scheduler
+    OS_THREAD_TYPE_TIMER = 2 // Thread running the callbacks of software timers
+} os_thread_type_t;
+
+typedef enum os_thread_stats_flag_t
+{
+    OS_THREAD_STATS_FLAG_CPU_TIME = 0x01, // The `cpu_time` field is valid
+    OS_THREAD_STATS_FLAG_STACK_FREE = 0x02 // The `stack_free` field is valid
+} os_thread_stats_flag_t;
+
+typedef struct os_thread_stats_t
+{
+    uint16_t size; // Size of this structure
+    uint8_t flags; // Flags (see os_thread_stats_flag_t)
+    uint8_t type; // Thread type (see os_thread_type_t)
+    os_thread_t thread; // Thread handle
+    const char* name; // Thread name. Can be null
+    uint32_t cpu_time; // Cumulative CPU time used by the thread, in milliseconds (wraps around)
+    uint32_t stack_free; // Minimum amount of free stack space ever observed, in bytes
+} os_thread_stats_t;
+
+typedef int (*os_thread_enum_stats_callback_t)(const os_thread_stats_t* stats, void* data);
+
+/**
+ * Enumerates the runtime statistics of all threads. The thread names are only valid for the duration
+ * of the callback invocation.
+ * @param callback  The callback to invoke for each thread. If the callback returns a non-zero
+ *                  value, the enumeration stops and that value is returned to the caller.
+ * @param data      The user data to pass to the callback.
+ * @return 0 on success.
+ */
+int os_thread_enum_stats(os_thread_enum_stats_callback_t callback, void* data, void* reserved);
+
 int os_condition_variable_create(condition_variable_t* var);
 void os_condition_variable_destroy(condition_variable_t var);
 
@@ -61,6 +61,8 @@ DYNALIB_FN(24, hal_concurrent, os_queue_destroy, int(os_queue_t, void*))
 DYNALIB_FN(25, hal_concurrent, os_queue_put, int(os_queue_t, const void* item, system_tick_t, void*))
 DYNALIB_FN(26, hal_concurrent, os_queue_take, int(os_queue_t, void* item, system_tick_t, void*))
 DYNALIB_FN(27, hal_concurrent, os_thread_exit, os_result_t(os_thread_t))
+DYNALIB_FN(28, hal_concurrent, os_thread_current, os_thread_t(void*))
+DYNALIB_FN(29, hal_concurrent, os_thread_enum_stats, int(os_thread_enum_stats_callback_t, void*, void*))
 #endif // PLATFORM_THREADING
 
 DYNALIB_END(hal_concurrent)
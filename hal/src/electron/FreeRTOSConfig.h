@@ -112,7 +112,7 @@
 #define configMINIMAL_STACK_SIZE	( ( unsigned short ) 128 )
 #define configTOTAL_HEAP_SIZE		( ( size_t ) ( 75 * 1024 ) )
 #define configMAX_TASK_NAME_LEN		( 16 )
-#define configUSE_TRACE_FACILITY	0
+#define configUSE_TRACE_FACILITY	1
 #define configUSE_16_BIT_TICKS		0
 #define configIDLE_SHOULD_YIELD		1
 #define configUSE_MUTEXES			1
@@ -159,6 +159,21 @@ configKERNEL_INTERRUPT_PRIORITY setting.  Here 15 corresponds to the lowest
 NVIC value of 255. */
 #define configLIBRARY_KERNEL_INTERRUPT_PRIORITY	15
 
+/* Per-task CPU time accounting. The run time counter is incremented every
+configRUN_TIME_COUNTER_PERIOD_US microseconds (see rtos_hook.cpp) */
+#define configGENERATE_RUN_TIME_STATS	1
+#define configRUN_TIME_COUNTER_PERIOD_US	100
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() rtos_run_time_counter()
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned long rtos_run_time_counter(void);
+#ifdef __cplusplus
+}
+#endif
+
 /* Enable stack overflow detection for debug builds (see rtos_hook.cpp) */
 #ifdef DEBUG_BUILD
 # define configCHECK_FOR_STACK_OVERFLOW 2
@@ -30,9 +30,8 @@ const void* dct_read_app_data(uint32_t offset) {
 int dct_read_app_data_copy(uint32_t offset, void* ptr, size_t size) {
     int result = -1;
     dct_lock(0);
-    const void* p = dcd().read(offset);
-    if (ptr && p) {
-        memcpy(ptr, p, size);
+    // The copying read includes the journal without rewriting the sector
+    if (ptr && dcd().read(offset, ptr, size) == 0) {
         result = 0;
     }
     dct_unlock(0);
@@ -1,9 +1,26 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "service_debug.h"
+#include "timer_hal.h"
 
 extern "C" {
 
+// Time base of the run time statistics (see configGENERATE_RUN_TIME_STATS). The microsecond counter
+// is scaled down so that the 32-bit per-task counters take days of CPU time to wrap around. The
+// kernel only calls this function from the context switch or with the scheduler suspended
+unsigned long rtos_run_time_counter(void) {
+    static uint32_t lastMicros = 0;
+    static uint32_t remainder = 0;
+    static uint32_t counter = 0;
+    const uint32_t micros = HAL_Timer_Get_Micro_Seconds();
+    // Accumulate the elapsed time, so that the counter wraps around consistently
+    const uint32_t elapsed = micros - lastMicros + remainder;
+    lastMicros = micros;
+    counter += elapsed / configRUN_TIME_COUNTER_PERIOD_US;
+    remainder = elapsed % configRUN_TIME_COUNTER_PERIOD_US;
+    return counter;
+}
+
 #ifdef DEBUG_BUILD
 void vApplicationStackOverflowHook(TaskHandle_t, char*) {
     PANIC(StackOverflow, "Stack overflow detected");
@@ -0,0 +1,638 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "concurrent_hal.h"
+#include "timer_hal.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <new>
+
+/**
+ * Implementation of the concurrent HAL for the virtual device, based on pthreads and the C++
+ * standard library.
+ *
+ * Thread priorities are ignored, since changing them requires elevated privileges on most hosts.
+ */
+
+namespace {
+
+// Minimum stack size for the threads created via this HAL. Code running on the host uses
+// considerably more stack than the same code compiled for a device
+const size_t MIN_HOST_STACK_SIZE = 256 * 1024;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Thread {
+    pthread_t thread;
+    os_thread_fn_t func;
+    void* param;
+    char name[16];
+    uint8_t type;
+    bool joined;
+    bool adopted; // Set if the thread was not created via this HAL
+};
+
+// Handle of the HAL thread executing the calling code
+thread_local Thread* g_currentThread = nullptr;
+
+Thread* adoptCurrentThread(os_thread_type_t type);
+
+void* runThread(void* data) {
+    const auto t = static_cast<Thread*>(data);
+    g_currentThread = t;
+    t->func(t->param);
+    return nullptr;
+}
+
+template<typename LockT, typename PredicateT>
+bool waitFor(std::condition_variable& cond, LockT& lock, system_tick_t timeout, PredicateT pred) {
+    if (timeout == CONCURRENT_WAIT_FOREVER) {
+        cond.wait(lock, pred);
+        return true;
+    }
+    return cond.wait_for(lock, std::chrono::milliseconds(timeout), pred);
+}
+
+struct Queue {
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::unique_ptr<char[]> data;
+    size_t itemSize;
+    size_t capacity;
+    size_t head;
+    size_t count;
+};
+
+struct Semaphore {
+    std::mutex mutex;
+    std::condition_variable cond;
+    unsigned count;
+    unsigned maxCount;
+};
+
+struct Timer {
+    void (*callback)(os_timer_t timer);
+    void* id;
+    std::chrono::milliseconds period;
+    Clock::time_point deadline;
+    bool oneShot;
+    bool active;
+    bool destroyed;
+};
+
+/**
+ * Runs timer callbacks in a dedicated thread, similarly to the FreeRTOS timer daemon task.
+ */
+class TimerService {
+public:
+    TimerService() :
+            current_(nullptr),
+            started_(false) {
+    }
+
+    void add(Timer* timer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers_.push_back(timer);
+        if (!started_) {
+            std::thread(&TimerService::run, this).detach();
+            started_ = true;
+        }
+    }
+
+    void remove(Timer* timer) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        timers_.erase(std::remove(timers_.begin(), timers_.end(), timer), timers_.end());
+        if (timer == current_) {
+            if (std::this_thread::get_id() == thread_) {
+                // The timer is being destroyed from its own callback
+                timer->destroyed = true;
+                return;
+            }
+            cond_.wait(lock, [this, timer]() {
+                return current_ != timer;
+            });
+        }
+        delete timer;
+    }
+
+    void change(Timer* timer, os_timer_change_t change, unsigned period) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        switch (change) {
+        case OS_TIMER_CHANGE_PERIOD:
+            timer->period = std::chrono::milliseconds(period);
+            // Changing the period of a dormant timer starts it, as on FreeRTOS
+            /* FALL THROUGH */
+        case OS_TIMER_CHANGE_START:
+        case OS_TIMER_CHANGE_RESET:
+            timer->deadline = Clock::now() + timer->period;
+            timer->active = true;
+            break;
+        case OS_TIMER_CHANGE_STOP:
+            timer->active = false;
+            break;
+        }
+        cond_.notify_all();
+    }
+
+    bool isActive(Timer* timer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return timer->active;
+    }
+
+private:
+    std::vector<Timer*> timers_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread::id thread_;
+    Timer* current_;
+    bool started_;
+
+    void run() {
+        adoptCurrentThread(OS_THREAD_TYPE_TIMER);
+        std::unique_lock<std::mutex> lock(mutex_);
+        thread_ = std::this_thread::get_id();
+        for (;;) {
+            Timer* next = nullptr;
+            for (Timer* t: timers_) {
+                if (t->active && (!next || t->deadline < next->deadline)) {
+                    next = t;
+                }
+            }
+            if (!next) {
+                cond_.wait(lock);
+                continue;
+            }
+            if (next->deadline > Clock::now()) {
+                // The set of timers might change while waiting, so it's scanned again on wakeup
+                cond_.wait_until(lock, next->deadline);
+                continue;
+            }
+            if (next->oneShot) {
+                next->active = false;
+            } else {
+                next->deadline += next->period;
+            }
+            current_ = next;
+            lock.unlock();
+            next->callback(next);
+            lock.lock();
+            current_ = nullptr;
+            if (next->destroyed) {
+                delete next;
+            }
+            cond_.notify_all();
+        }
+    }
+};
+
+// The service is never destroyed, since its thread may outlive static destructors
+TimerService* timerService() {
+    static TimerService* service = new TimerService();
+    return service;
+}
+
+// Threads created via this HAL, for os_thread_enum_stats()
+std::mutex& threadsMutex() {
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+}
+
+std::vector<Thread*>& threads() {
+    static std::vector<Thread*>* threads = new std::vector<Thread*>();
+    return *threads;
+}
+
+void addThread(Thread* t) {
+    std::lock_guard<std::mutex> lock(threadsMutex());
+    threads().push_back(t);
+}
+
+void removeThread(Thread* t) {
+    std::lock_guard<std::mutex> lock(threadsMutex());
+    threads().erase(std::remove(threads().begin(), threads().end(), t), threads().end());
+}
+
+// Destroys the handle of an adopted thread when the thread exits
+struct AdoptedThread {
+    Thread* thread = nullptr;
+
+    ~AdoptedThread() {
+        if (thread) {
+            removeThread(thread);
+            g_currentThread = nullptr;
+            delete thread;
+        }
+    }
+};
+
+thread_local AdoptedThread g_adoptedThread;
+
+// Threads that were not created via this HAL, such as the std::threads running the system's
+// active objects, get a handle when they first ask for it, so that they are reported by
+// os_thread_enum_stats() as well
+Thread* adoptCurrentThread(os_thread_type_t type) {
+    if (!g_currentThread) {
+        const auto t = new(std::nothrow) Thread();
+        if (!t) {
+            return nullptr;
+        }
+        t->thread = pthread_self();
+        t->type = type;
+        t->adopted = true;
+        pthread_getname_np(t->thread, t->name, sizeof(t->name));
+        addThread(t);
+        g_adoptedThread.thread = t;
+        g_currentThread = t;
+    }
+    return g_currentThread;
+}
+
+// os_thread_scheduling() cannot suspend other threads on the host. Instead, single threaded
+// sections are serialized with each other via a global recursive mutex
+std::recursive_mutex& schedulingMutex() {
+    static std::recursive_mutex* mutex = new std::recursive_mutex();
+    return *mutex;
+}
+
+} // namespace
+
+os_result_t os_thread_create(os_thread_t* result, const char* name, os_thread_prio_t priority, os_thread_fn_t fun,
+        void* thread_param, size_t stack_size) {
+    *result = nullptr;
+    const auto t = new(std::nothrow) Thread();
+    if (!t) {
+        return 1;
+    }
+    t->func = fun;
+    t->param = thread_param;
+    t->type = OS_THREAD_TYPE_OTHER;
+    t->joined = false;
+    t->adopted = false;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, std::max(stack_size, std::max(MIN_HOST_STACK_SIZE, (size_t)PTHREAD_STACK_MIN)));
+    const int ret = pthread_create(&t->thread, &attr, runThread, t);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        delete t;
+        return ret;
+    }
+    if (name) {
+        // Linux limits thread names to 15 characters
+        strncpy(t->name, name, sizeof(t->name) - 1);
+        pthread_setname_np(t->thread, t->name);
+    }
+    addThread(t);
+    *result = t;
+    return 0;
+}
+
+os_result_t os_thread_create_with_stack(os_thread_t* result, const char* name, os_thread_prio_t priority,
+        os_thread_fn_t fun, void* thread_param, size_t stack_size, void* stack) {
+    // Stacks sized for the device are too small for the host, so the provided buffer is not used
+    return os_thread_create(result, name, priority, fun, thread_param, stack_size);
+}
+
+bool os_thread_is_current(os_thread_t thread) {
+    return thread && thread == g_currentThread;
+}
+
+bool os_thread_is_current_within_stack() {
+    return true;
+}
+
+os_result_t os_thread_join(os_thread_t thread) {
+    const auto t = static_cast<Thread*>(thread);
+    if (!t || t == g_currentThread || t->joined || t->adopted) {
+        return 1;
+    }
+    const int ret = pthread_join(t->thread, nullptr);
+    if (ret == 0) {
+        t->joined = true;
+    }
+    return ret;
+}
+
+os_result_t os_thread_exit(os_thread_t thread) {
+    if (!thread || thread == g_currentThread) {
+        pthread_exit(nullptr);
+    }
+    const auto t = static_cast<Thread*>(thread);
+    if (t->adopted) {
+        return 1;
+    }
+    return pthread_cancel(t->thread);
+}
+
+os_result_t os_thread_cleanup(os_thread_t thread) {
+    const auto t = static_cast<Thread*>(thread);
+    if (!t || t->adopted) {
+        return 1; // Adopted threads are cleaned up when they exit
+    }
+    removeThread(t);
+    if (!t->joined) {
+        pthread_detach(t->thread);
+    }
+    delete t;
+    return 0;
+}
+
+os_result_t os_thread_yield(void) {
+    return sched_yield();
+}
+
+os_result_t os_thread_delay_until(system_tick_t* previousWakeTime, system_tick_t timeIncrement) {
+    if (!previousWakeTime) {
+        return 1;
+    }
+    const system_tick_t wakeTime = *previousWakeTime + timeIncrement;
+    const system_tick_t delay = wakeTime - HAL_Timer_Get_Milli_Seconds();
+    // The wake time may already be in the past, in which case the thread doesn't sleep
+    if (delay <= timeIncrement) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    }
+    *previousWakeTime = wakeTime;
+    return 0;
+}
+
+os_thread_t os_thread_current(void* reserved) {
+    return adoptCurrentThread(OS_THREAD_TYPE_OTHER);
+}
+
+int os_thread_enum_stats(os_thread_enum_stats_callback_t callback, void* data, void* reserved) {
+    // Only the threads created or adopted by this HAL are reported. The host doesn't track the stack
+    // usage, and the statistics are collected first so that the callback can create or destroy threads
+    struct Stats {
+        os_thread_stats_t stats;
+        char name[sizeof(Thread::name)];
+    };
+    std::vector<Stats> stats;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex());
+        stats.reserve(threads().size());
+        for (Thread* t: threads()) {
+            Stats s = {};
+            s.stats.size = sizeof(s.stats);
+            s.stats.thread = t;
+            s.stats.type = t->type;
+            memcpy(s.name, t->name, sizeof(s.name));
+            clockid_t clock;
+            timespec ts;
+            if (!t->joined && pthread_getcpuclockid(t->thread, &clock) == 0 && clock_gettime(clock, &ts) == 0) {
+                s.stats.flags |= OS_THREAD_STATS_FLAG_CPU_TIME;
+                s.stats.cpu_time = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+            }
+            stats.push_back(s);
+        }
+    }
+    for (Stats& s: stats) {
+        s.stats.name = s.name;
+        const int ret = callback(&s.stats, data);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+void os_thread_scheduling(bool enabled, void* reserved) {
+    if (enabled) {
+        schedulingMutex().unlock();
+    } else {
+        schedulingMutex().lock();
+    }
+}
+
+int os_condition_variable_create(condition_variable_t* var) {
+    *var = new(std::nothrow) std::condition_variable();
+    return *var == nullptr;
+}
+
+void os_condition_variable_destroy(condition_variable_t var) {
+    delete static_cast<std::condition_variable*>(var);
+}
+
+void os_condition_variable_wait(condition_variable_t var, void* lock) {
+    static_cast<std::condition_variable*>(var)->wait(*static_cast<std::unique_lock<std::mutex>*>(lock));
+}
+
+void os_condition_variable_notify_one(condition_variable_t var) {
+    static_cast<std::condition_variable*>(var)->notify_one();
+}
+
+void os_condition_variable_notify_all(condition_variable_t var) {
+    static_cast<std::condition_variable*>(var)->notify_all();
+}
+
+int os_queue_create(os_queue_t* queue, size_t item_size, size_t item_count, void* reserved) {
+    *queue = nullptr;
+    if (item_size == 0 || item_count == 0) {
+        return 1;
+    }
+    const auto q = new(std::nothrow) Queue();
+    if (!q) {
+        return 1;
+    }
+    q->data.reset(new(std::nothrow) char[item_size * item_count]);
+    if (!q->data) {
+        delete q;
+        return 1;
+    }
+    q->itemSize = item_size;
+    q->capacity = item_count;
+    q->head = 0;
+    q->count = 0;
+    *queue = q;
+    return 0;
+}
+
+int os_queue_put(os_queue_t queue, const void* item, system_tick_t delay, void* reserved) {
+    const auto q = static_cast<Queue*>(queue);
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!waitFor(q->notFull, lock, delay, [q]() { return q->count < q->capacity; })) {
+        return 1;
+    }
+    const size_t tail = (q->head + q->count) % q->capacity;
+    memcpy(q->data.get() + tail * q->itemSize, item, q->itemSize);
+    ++q->count;
+    q->notEmpty.notify_one();
+    return 0;
+}
+
+int os_queue_take(os_queue_t queue, void* item, system_tick_t delay, void* reserved) {
+    const auto q = static_cast<Queue*>(queue);
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!waitFor(q->notEmpty, lock, delay, [q]() { return q->count > 0; })) {
+        return 1;
+    }
+    memcpy(item, q->data.get() + q->head * q->itemSize, q->itemSize);
+    q->head = (q->head + 1) % q->capacity;
+    --q->count;
+    q->notFull.notify_one();
+    return 0;
+}
+
+int os_queue_destroy(os_queue_t queue, void* reserved) {
+    delete static_cast<Queue*>(queue);
+    return 0;
+}
+
+int os_mutex_create(os_mutex_t* mutex) {
+    *mutex = new(std::nothrow) std::mutex();
+    return *mutex == nullptr;
+}
+
+int os_mutex_destroy(os_mutex_t mutex) {
+    delete static_cast<std::mutex*>(mutex);
+    return 0;
+}
+
+int os_mutex_lock(os_mutex_t mutex) {
+    static_cast<std::mutex*>(mutex)->lock();
+    return 0;
+}
+
+int os_mutex_trylock(os_mutex_t mutex) {
+    return !static_cast<std::mutex*>(mutex)->try_lock();
+}
+
+int os_mutex_unlock(os_mutex_t mutex) {
+    static_cast<std::mutex*>(mutex)->unlock();
+    return 0;
+}
+
+int os_mutex_recursive_create(os_mutex_recursive_t* mutex) {
+    *mutex = new(std::nothrow) std::recursive_mutex();
+    return *mutex == nullptr;
+}
+
+int os_mutex_recursive_destroy(os_mutex_recursive_t mutex) {
+    delete static_cast<std::recursive_mutex*>(mutex);
+    return 0;
+}
+
+int os_mutex_recursive_lock(os_mutex_recursive_t mutex) {
+    static_cast<std::recursive_mutex*>(mutex)->lock();
+    return 0;
+}
+
+int os_mutex_recursive_trylock(os_mutex_recursive_t mutex) {
+    return !static_cast<std::recursive_mutex*>(mutex)->try_lock();
+}
+
+int os_mutex_recursive_unlock(os_mutex_recursive_t mutex) {
+    static_cast<std::recursive_mutex*>(mutex)->unlock();
+    return 0;
+}
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max_count, unsigned initial_count) {
+    *semaphore = nullptr;
+    if (max_count == 0 || initial_count > max_count) {
+        return 1;
+    }
+    const auto s = new(std::nothrow) Semaphore();
+    if (!s) {
+        return 1;
+    }
+    s->count = initial_count;
+    s->maxCount = max_count;
+    *semaphore = s;
+    return 0;
+}
+
+int os_semaphore_destroy(os_semaphore_t semaphore) {
+    delete static_cast<Semaphore*>(semaphore);
+    return 0;
+}
+
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    std::unique_lock<std::mutex> lock(s->mutex);
+    if (!waitFor(s->cond, lock, timeout, [s]() { return s->count > 0; })) {
+        return 1;
+    }
+    --s->count;
+    return 0;
+}
+
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved) {
+    const auto s = static_cast<Semaphore*>(semaphore);
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->count >= s->maxCount) {
+        return 1;
+    }
+    ++s->count;
+    s->cond.notify_one();
+    return 0;
+}
+
+int os_timer_create(os_timer_t* timer, unsigned period, void (*callback)(os_timer_t timer), void* timer_id,
+        bool one_shot, void* reserved) {
+    *timer = nullptr;
+    if (!callback || period == 0) {
+        return 1;
+    }
+    const auto t = new(std::nothrow) Timer();
+    if (!t) {
+        return 1;
+    }
+    t->callback = callback;
+    t->id = timer_id;
+    t->period = std::chrono::milliseconds(period);
+    t->oneShot = one_shot;
+    t->active = false;
+    t->destroyed = false;
+    timerService()->add(t);
+    *timer = t;
+    return 0;
+}
+
+int os_timer_get_id(os_timer_t timer, void** timer_id) {
+    *timer_id = static_cast<Timer*>(timer)->id;
+    return 0;
+}
+
+int os_timer_change(os_timer_t timer, os_timer_change_t change, bool fromISR, unsigned period, unsigned block,
+        void* reserved) {
+    if (change == OS_TIMER_CHANGE_PERIOD && period == 0) {
+        return 1;
+    }
+    timerService()->change(static_cast<Timer*>(timer), change, period);
+    return 0;
+}
+
+int os_timer_destroy(os_timer_t timer, void* reserved) {
+    timerService()->remove(static_cast<Timer*>(timer));
+    return 0;
+}
+
+int os_timer_is_active(os_timer_t timer, void* reserved) {
+    return timerService()->isActive(static_cast<Timer*>(timer));
+}
@@ -2,6 +2,8 @@
 
 // redefine these for the underlying concurrency primitives available in the RTOS
 
+#define OS_TIMER_INVALID_HANDLE NULL
+
 typedef int os_result_t;
 typedef int os_thread_prio_t;
 typedef void* os_thread_t;
@@ -12,3 +14,9 @@ typedef void* condition_variable_t;
 typedef void* os_semaphore_t;
 typedef void* os_mutex_recursive_t;
 typedef uintptr_t os_unique_id_t;
+
+/* Priorities are accepted for compatibility with the RTOS platforms but ignored */
+const os_thread_prio_t OS_THREAD_PRIORITY_DEFAULT = 2;
+const os_thread_prio_t OS_THREAD_PRIORITY_CRITICAL = 9;
+/* Host code needs far more stack than firmware, see os_thread_create() */
+const size_t OS_THREAD_STACK_SIZE_DEFAULT = 3*1024;
@@ -42,16 +42,81 @@
 
 #include "eeprom_file.h"
 #include "eeprom_hal.h"
+#include "log_file.h"
+#include "trace_export.h"
+#include <csignal>
+#include <cerrno>
+#include <thread>
+#include <unistd.h>
 
 using std::cout;
 
 static LoggerOutputLevel log_level = NO_LOG_LEVEL;
 
+static LogFile log_file;
+
+static std::string trace_file;
+
 void setLoggerLevel(LoggerOutputLevel level)
 {
     log_level = level;
 }
 
+bool setLoggerFile(const char* path, size_t size)
+{
+    if (!path || !*path) {
+        log_file.close();
+        return true;
+    }
+    return log_file.open(path, size);
+}
+
+static void export_trace_file()
+{
+    if (!trace_file.empty() && !exportChromeTrace(trace_file.c_str())) {
+        std::cerr << "unable to write trace file '" << trace_file << "'" << std::endl;
+    }
+}
+
+static int exit_signal_pipe[2] = { -1, -1 };
+
+static void exit_signal_handler(int sig)
+{
+    // Only async-signal-safe functions can be called here, so the trace file is exported by a
+    // separate thread
+    const unsigned char s = sig;
+    if (write(exit_signal_pipe[1], &s, 1) != 1) {
+        _exit(128 + sig);
+    }
+}
+
+static void exit_signal_thread()
+{
+    unsigned char sig = 0;
+    ssize_t n = 0;
+    do {
+        n = read(exit_signal_pipe[0], &sig, 1);
+    } while (n < 0 && errno == EINTR);
+    if (n == 1) {
+        export_trace_file();
+        _exit(128 + sig); // Conventional status of a process terminated by a signal
+    }
+}
+
+void setTraceFile(const char* path)
+{
+    const bool first = trace_file.empty();
+    trace_file = path ? path : "";
+    if (first && !trace_file.empty()) {
+        atexit(export_trace_file);
+        if (pipe(exit_signal_pipe) == 0) {
+            std::thread(exit_signal_thread).detach();
+            signal(SIGINT, exit_signal_handler);
+            signal(SIGTERM, exit_signal_handler);
+        }
+    }
+}
+
 void log_message_callback(const char *msg, int level, const char *category, const LogAttributes *attr, void *reserved)
 {
     if (level < log_level) {
@@ -101,7 +166,13 @@ void log_message_callback(const char *msg, int level, const char *category, cons
         strm.seekp(-2, std::ios_base::end); // Overwrite trailing comma
         strm << "] ";
     }
-    std::cout << strm.str() << std::endl;
+    if (log_file.isOpen()) {
+        strm << '\n';
+        const std::string s = strm.str();
+        log_file.write(s.data(), s.size());
+    } else {
+        std::cout << strm.str() << std::endl;
+    }
 }
 
 void log_write_callback(const char *data, size_t size, int level, const char *category, void *reserved)
@@ -109,7 +180,11 @@ void log_write_callback(const char *data, size_t size, int level, const char *ca
     if (level < log_level) {
         return;
     }
-    std::cout.write(data, size);
+    if (log_file.isOpen()) {
+        log_file.write(data, size);
+    } else {
+        std::cout.write(data, size);
+    }
 }
 
 int log_enabled_callback(int level, const char *category, void *reserved)
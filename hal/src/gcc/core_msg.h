@@ -26,6 +26,18 @@ extern "C" {
 
 void setLoggerLevel(LoggerOutputLevel level);
 
+/**
+ * Redirects the logging output to a size-capped, memory-mapped ring file (see log_file.h).
+ * An empty path restores the output to stdout. Returns false if the file cannot be opened.
+ */
+bool setLoggerFile(const char* path, size_t size);
+
+/**
+ * Sets the file where the events recorded by the tracer are written in the Chrome trace event
+ * format when the device exits (see trace_export.h).
+ */
+void setTraceFile(const char* path);
+
 extern void core_log(const char* msg, ...);
 
 #define MSG(...) core_log(__VA_ARGS__)
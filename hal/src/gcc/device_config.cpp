@@ -19,6 +19,7 @@
 #include "device_config.h"
 #include "core_msg.h"
 #include "filesystem.h"
+#include "log_file.h"
 #include <cstdlib>
 #include <fstream>
 #include <istream>
@@ -95,6 +96,9 @@ public:
             ("server_key,sk", po::value<string>(&config.server_key)->default_value("server_key.der"), "the filename containing the server public key")
             ("state,s", po::value<string>(&config.periph_directory)->default_value("state"), "the directory where device state and peripherals is stored")
 			("protocol,p", po::value<ProtocolFactory>(&config.protocol)->default_value(PROTOCOL_LIGHTSSL), "the cloud communication protocol to use")
+			("log_file", po::value<string>(&config.log_file), "the file where logging output is written instead of stdout (ring buffer)")
+			("log_file_size", po::value<size_t>(&config.log_file_size)->default_value(LogFile::DEFAULT_SIZE), "the maximum size of the log file in bytes")
+			("trace_file", po::value<string>(&config.trace_file), "the file where trace events are written on exit (Chrome trace format)")
 			;
 
         command_line_options.add(program_options).add(device_options);
@@ -201,6 +205,12 @@ void DeviceConfig::read(Configuration& configuration)
 #endif
 
     setLoggerLevel(LoggerOutputLevel(NO_LOG_LEVEL-configuration.log_level));
+    if (!configuration.log_file.empty() && !setLoggerFile(configuration.log_file.c_str(), configuration.log_file_size)) {
+        throw std::invalid_argument(std::string("unable to open log file '") + configuration.log_file + "'");
+    }
+    if (!configuration.trace_file.empty()) {
+        setTraceFile(configuration.trace_file.c_str());
+    }
 
     this->protocol = configuration.protocol;
 }
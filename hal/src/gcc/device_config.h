@@ -52,6 +52,9 @@ struct Configuration
     std::string server_key;
     std::string periph_directory;
     uint16_t log_level = 0;
+    std::string log_file;
+    size_t log_file_size = 0;
+    std::string trace_file;
     ProtocolFactory protocol = PROTOCOL_LIGHTSSL;
 };
 
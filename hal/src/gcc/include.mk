@@ -3,10 +3,12 @@
 #       based on the root of the project
 HAL_SRC_GCC_PATH = $(TARGET_HAL_PATH)/src/gcc
 
-# if we are being compiled with platform as a dependency, then also include
-# implementation headers.
+# if we are being compiled with platform as a dependency, or the concurrent HAL
+# is used, then also include implementation headers.
 ifneq (,$(findstring platform,$(DEPENDENCIES)))
 INCLUDE_DIRS += $(HAL_SRC_GCC_PATH)
+else ifeq ("$(PLATFORM_THREADING)","1")
+INCLUDE_DIRS += $(HAL_SRC_GCC_PATH)
 endif
 
 ifneq (,$(findstring hal,$(MAKE_DEPENDENCIES)))
@@ -20,7 +22,7 @@ LIBS += boost_system-mgw48-mt-1_57 ws2_32 wsock32
 else
 LIBS += boost_system
 endif
-LIBS += boost_program_options boost_random boost_thread
+LIBS += boost_program_options boost_random boost_thread pthread
 
 LIB_DIRS += $(BOOST_ROOT)/stage/lib
 
@@ -0,0 +1,188 @@
+/**
+  Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "log_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t LOG_FILE_MAGIC = 0x474f4c56; // "VLOG"
+const uint32_t LOG_FILE_VERSION = 1;
+
+uint64_t now()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+const size_t LogFile::DEFAULT_SIZE;
+const unsigned LogFile::DEFAULT_SYNC_INTERVAL;
+
+struct LogFile::Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    uint64_t written;
+};
+
+LogFile::LogFile() :
+        map_(nullptr),
+        mapSize_(0),
+        size_(0),
+        lastSync_(0),
+        syncInterval_(DEFAULT_SYNC_INTERVAL),
+        fd_(-1)
+{
+}
+
+LogFile::~LogFile()
+{
+    close();
+}
+
+bool LogFile::open(const char* path, size_t size, unsigned syncInterval)
+{
+    close();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size == 0) {
+        return false;
+    }
+    const int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const size_t mapSize = sizeof(Header) + size;
+    // Check if the existing file can be appended to
+    bool reset = true;
+    struct stat st = {};
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == mapSize) {
+        Header h = {};
+        if (pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && h.magic == LOG_FILE_MAGIC &&
+                h.version == LOG_FILE_VERSION && h.size == size) {
+            reset = false;
+        }
+    }
+    if (reset && (ftruncate(fd, 0) != 0 || ftruncate(fd, mapSize) != 0)) {
+        ::close(fd);
+        return false;
+    }
+    void* const map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    map_ = (char*)map;
+    mapSize_ = mapSize;
+    size_ = size;
+    syncInterval_ = syncInterval;
+    lastSync_ = now();
+    if (reset) {
+        Header* const h = header();
+        h->magic = LOG_FILE_MAGIC;
+        h->version = LOG_FILE_VERSION;
+        h->size = size;
+        h->written = 0;
+    }
+    return true;
+}
+
+void LogFile::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!map_) {
+        return;
+    }
+    msync(map_, mapSize_, MS_SYNC);
+    munmap(map_, mapSize_);
+    ::close(fd_);
+    map_ = nullptr;
+    mapSize_ = 0;
+    size_ = 0;
+    fd_ = -1;
+}
+
+bool LogFile::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return map_;
+}
+
+void LogFile::write(const char* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!map_ || size == 0) {
+        return;
+    }
+    Header* const h = header();
+    const uint64_t written = h->written + size;
+    if (size > size_) {
+        // Only the tail of the data fits into the file
+        data += size - size_;
+        size = size_;
+    }
+    const size_t pos = (written - size) % size_;
+    const size_t n = std::min(size, size_ - pos);
+    memcpy(buffer() + pos, data, n);
+    memcpy(buffer(), data + n, size - n);
+    // Make sure a concurrent reader doesn't see the updated position before the data
+    __atomic_store_n(&h->written, written, __ATOMIC_RELEASE);
+    if (syncInterval_ > 0) {
+        const uint64_t t = now();
+        if (t - lastSync_ >= syncInterval_) {
+            msync(map_, mapSize_, MS_ASYNC);
+            lastSync_ = t;
+        }
+    }
+}
+
+void LogFile::sync()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (map_) {
+        msync(map_, mapSize_, MS_SYNC);
+        lastSync_ = now();
+    }
+}
+
+uint64_t LogFile::written() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return map_ ? header()->written : 0;
+}
+
+LogFile::Header* LogFile::header() const
+{
+    return (Header*)map_;
+}
+
+char* LogFile::buffer() const
+{
+    return map_ + sizeof(Header);
+}
@@ -0,0 +1,82 @@
+/**
+  Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#pragma once
+
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Size-capped log file used by the virtual device. The file is memory-mapped and used as a ring
+ * buffer, so writing a log message costs a memcpy() rather than a system call. When the file is
+ * full, the oldest data is overwritten. Modified pages are flushed to disk periodically.
+ *
+ * The file starts with a header, followed by the data area:
+ *
+ * | Offset | Size | Description                                                |
+ * | ------ | ---- | ---------------------------------------------------------- |
+ * | 0      | 4    | Magic number ("VLOG")                                      |
+ * | 4      | 4    | Format version                                             |
+ * | 8      | 8    | Size of the data area                                      |
+ * | 16     | 8    | Total number of bytes written since the file was created   |
+ *
+ * All fields are little endian. The current write position is the total number of written bytes
+ * modulo the size of the data area. Use build/log_file_read.py to read the file.
+ */
+class LogFile
+{
+public:
+    static const size_t DEFAULT_SIZE = 16 * 1024 * 1024;
+    static const unsigned DEFAULT_SYNC_INTERVAL = 1000; // Milliseconds
+
+    LogFile();
+    ~LogFile();
+
+    /**
+     * Opens the file. An existing file in the same format and of the same size is appended to,
+     * otherwise the file is recreated.
+     *
+     * @param path File path.
+     * @param size Size of the data area.
+     * @param syncInterval Interval at which the modified pages are flushed, in milliseconds.
+     * @return `true` on success.
+     */
+    bool open(const char* path, size_t size = DEFAULT_SIZE, unsigned syncInterval = DEFAULT_SYNC_INTERVAL);
+    void close();
+    bool isOpen() const;
+
+    void write(const char* data, size_t size);
+    void sync();
+
+    uint64_t written() const;
+
+private:
+    struct Header;
+
+    mutable std::mutex mutex_;
+    char* map_;
+    size_t mapSize_;
+    size_t size_;
+    uint64_t lastSync_;
+    unsigned syncInterval_;
+    int fd_;
+
+    Header* header() const;
+    char* buffer() const;
+};
@@ -0,0 +1,154 @@
+/**
+  Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "heap_profiler.h"
+
+#if HEAP_PROFILER_ENABLED
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+/**
+ * Allocation wrappers recording the call sites of the allocations (see heap_profiler.h). This is
+ * the virtual device's counterpart of hal/src/stm32/newlib.cpp: the executable is linked with
+ * --wrap for the C allocation functions, and the C++ allocation operators are replaced. Memory
+ * allocated inside the host's C and C++ libraries is not profiled.
+ */
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+} // extern "C"
+
+namespace {
+
+std::mutex g_mutex;
+
+void* profiledMalloc(size_t size, const void* caller) {
+    if (size > SIZE_MAX - HEAP_PROFILER_HEADER_SIZE) {
+        return nullptr;
+    }
+    return heap_profiler_alloc(__real_malloc(size + HEAP_PROFILER_HEADER_SIZE), size, caller);
+}
+
+void profiledFree(void* ptr) {
+    void* const block = heap_profiler_block(ptr);
+    if (block) {
+        heap_profiler_free(block);
+        __real_free(block);
+    } else {
+        __real_free(ptr); // Allocated by a function that bypasses the wrappers
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+void heap_profiler_lock(void) {
+    g_mutex.lock();
+}
+
+void heap_profiler_unlock(void) {
+    g_mutex.unlock();
+}
+
+void* __wrap_malloc(size_t size) {
+    return profiledMalloc(size, __builtin_return_address(0));
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return nullptr;
+    }
+    void* const ptr = profiledMalloc(count * size, __builtin_return_address(0));
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return profiledMalloc(size, __builtin_return_address(0));
+    }
+    void* const block = heap_profiler_block(ptr);
+    if (!block) {
+        return __real_realloc(ptr, size);
+    }
+    if (size > SIZE_MAX - HEAP_PROFILER_HEADER_SIZE) {
+        return nullptr;
+    }
+    heap_profiler_realloc_begin(block);
+    return heap_profiler_realloc(block, __real_realloc(block, size + HEAP_PROFILER_HEADER_SIZE), size,
+            __builtin_return_address(0));
+}
+
+void __wrap_free(void* ptr) {
+    profiledFree(ptr);
+}
+
+char* __wrap_strdup(const char* str) {
+    const size_t size = strlen(str) + 1;
+    const auto s = (char*)profiledMalloc(size, __builtin_return_address(0));
+    if (s) {
+        memcpy(s, str, size);
+    }
+    return s;
+}
+
+} // extern "C"
+
+void* operator new(size_t size) {
+    void* const ptr = profiledMalloc(size, __builtin_return_address(0));
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    void* const ptr = profiledMalloc(size, __builtin_return_address(0));
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return profiledMalloc(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return profiledMalloc(size, __builtin_return_address(0));
+}
+
+void operator delete(void* ptr) noexcept {
+    profiledFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    profiledFree(ptr);
+}
+
+#endif // HEAP_PROFILER_ENABLED
@@ -0,0 +1,100 @@
+/**
+  Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "trace_export.h"
+
+#include "trace.h"
+
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+int collectEvent(const trace_event* event, void* data)
+{
+    static_cast<std::vector<trace_event>*>(data)->push_back(*event);
+    return 0;
+}
+
+const char* phase(uint8_t type)
+{
+    switch (type) {
+    case TRACE_EVENT_BEGIN:
+        return "B";
+    case TRACE_EVENT_END:
+        return "E";
+    default:
+        return "i";
+    }
+}
+
+void writeString(std::ostream& strm, const char* str)
+{
+    strm << '"';
+    for (; *str; ++str) {
+        const char c = *str;
+        if (c == '"' || c == '\\') {
+            strm << '\\' << c;
+        } else if ((unsigned char)c >= 0x20) {
+            strm << c;
+        }
+    }
+    strm << '"';
+}
+
+} // namespace
+
+bool exportChromeTrace(std::ostream& strm)
+{
+    std::vector<trace_event> events;
+    trace_enum_events(collectEvent, &events, nullptr);
+    // Timestamps wrap around, so they're converted relative to the oldest event
+    int32_t minOffset = 0;
+    const uint32_t ref = events.empty() ? 0 : events.front().time;
+    for (const trace_event& e: events) {
+        minOffset = std::min(minOffset, (int32_t)(e.time - ref));
+    }
+    strm << "{\"traceEvents\":[";
+    bool first = true;
+    for (const trace_event& e: events) {
+        if (!first) {
+            strm << ',';
+        }
+        first = false;
+        strm << "\n{\"name\":";
+        writeString(strm, e.name);
+        strm << ",\"ph\":\"" << phase(e.type) << "\",\"ts\":" << ((int64_t)(int32_t)(e.time - ref) - minOffset) <<
+                ",\"pid\":0,\"tid\":" << (unsigned)e.thread;
+        if (e.type == TRACE_EVENT_INSTANT) {
+            strm << ",\"s\":\"t\"";
+        }
+        if (e.data) {
+            strm << ",\"args\":{\"data\":" << e.data << '}';
+        }
+        strm << '}';
+    }
+    strm << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":" << trace_dropped_events(nullptr) << "}}\n";
+    return strm.good();
+}
+
+bool exportChromeTrace(const char* path)
+{
+    std::ofstream strm(path, std::ios::out | std::ios::trunc);
+    return strm && exportChromeTrace(strm);
+}
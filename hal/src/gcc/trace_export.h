@@ -0,0 +1,34 @@
+/**
+  Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#pragma once
+
+#include <ostream>
+
+/**
+ * Writes the events recorded by the tracer (see services/inc/trace.h) in the Chrome trace event
+ * format, which can be loaded into chrome://tracing or https://ui.perfetto.dev.
+ *
+ * The 32-bit timestamps of the events are converted to microseconds since the oldest event.
+ */
+bool exportChromeTrace(std::ostream& strm);
+
+/**
+ * Writes the recorded events to a file in the Chrome trace event format.
+ */
+bool exportChromeTrace(const char* path);
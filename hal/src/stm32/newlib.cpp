@@ -1,5 +1,7 @@
 #include "service_debug.h"
+#include "heap_profiler.h"
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * Shared newlib implementation for stm32 devices. (This is probably suitable for all embedded devices on gcc.)
@@ -7,6 +9,125 @@
 
 extern "C" {
 
+#if HEAP_PROFILER_ENABLED
+
+/*
+ * Allocation wrappers recording the call sites of the allocations (see heap_profiler.h). The image
+ * is linked with --wrap for these functions, so that the calls to them end up here
+ */
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void __malloc_lock(struct _reent* r);
+void __malloc_unlock(struct _reent* r);
+
+void heap_profiler_lock(void)
+{
+	__malloc_lock(nullptr);
+}
+
+void heap_profiler_unlock(void)
+{
+	__malloc_unlock(nullptr);
+}
+
+static void* profiled_malloc(size_t size, const void* caller)
+{
+	if (size > SIZE_MAX - HEAP_PROFILER_HEADER_SIZE) {
+		return nullptr;
+	}
+	return heap_profiler_alloc(__real_malloc(size + HEAP_PROFILER_HEADER_SIZE), size, caller);
+}
+
+static void profiled_free(void* ptr)
+{
+	void* const block = heap_profiler_block(ptr);
+	if (block) {
+		heap_profiler_free(block);
+		__real_free(block);
+	} else {
+		__real_free(ptr); // Allocated by a function that bypasses the wrappers
+	}
+}
+
+void* __wrap_malloc(size_t size)
+{
+	return profiled_malloc(size, __builtin_return_address(0));
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	if (size && count > SIZE_MAX / size) {
+		return nullptr;
+	}
+	void* const ptr = profiled_malloc(count * size, __builtin_return_address(0));
+	if (ptr) {
+		memset(ptr, 0, count * size);
+	}
+	return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	if (!ptr) {
+		return profiled_malloc(size, __builtin_return_address(0));
+	}
+	void* const block = heap_profiler_block(ptr);
+	if (!block) {
+		return __real_realloc(ptr, size);
+	}
+	if (size > SIZE_MAX - HEAP_PROFILER_HEADER_SIZE) {
+		return nullptr;
+	}
+	heap_profiler_realloc_begin(block);
+	return heap_profiler_realloc(block, __real_realloc(block, size + HEAP_PROFILER_HEADER_SIZE), size,
+			__builtin_return_address(0));
+}
+
+void __wrap_free(void* ptr)
+{
+	profiled_free(ptr);
+}
+
+char* __wrap_strdup(const char* str)
+{
+	const size_t size = strlen(str) + 1;
+	char* const s = (char*)profiled_malloc(size, __builtin_return_address(0));
+	if (s) {
+		memcpy(s, str, size);
+	}
+	return s;
+}
+
+/*
+ * Implement C++ new/delete operators using the heap
+ */
+
+void *operator new(size_t size)
+{
+	return profiled_malloc(size, __builtin_return_address(0));
+}
+
+void *operator new[](size_t size)
+{
+	return profiled_malloc(size, __builtin_return_address(0));
+}
+
+void operator delete(void *p)
+{
+	profiled_free(p);
+}
+
+void operator delete[](void *p)
+{
+	profiled_free(p);
+}
+
+#else // !HEAP_PROFILER_ENABLED
+
 /*
  * Implement C++ new/delete operators using the heap
  */
@@ -31,6 +152,8 @@ void operator delete[](void *p)
 	free(p);
 }
 
+#endif // !HEAP_PROFILER_ENABLED
+
 
 int _kill(int pid, int sig) __attribute((weak));
 
@@ -42,6 +42,10 @@
 #include "atomic_flag_mutex.h"
 #include "static_recursive_mutex.h"
 #include "service_debug.h"
+#include "trace.h"
+#include "system_error.h"
+#include <cstdlib>
+#include <cstring>
 
 #if PLATFORM_ID == 6 || PLATFORM_ID == 8
 # include "wwd_rtos_interface.h"
@@ -154,6 +158,8 @@ os_result_t os_thread_join(os_thread_t thread)
  */
 os_result_t os_thread_exit(os_thread_t thread)
 {
+    // FreeRTOS has no thread-local storage to release the trace buffer of the thread on exit
+    trace_thread_exit(thread, nullptr);
     vTaskDelete(thread);
     return 0;
 }
@@ -190,6 +196,48 @@ os_result_t os_thread_delay_until(system_tick_t *previousWakeTime, system_tick_t
     return 0;
 }
 
+os_thread_t os_thread_current(void* reserved)
+{
+    return xTaskGetCurrentTaskHandle();
+}
+
+int os_thread_enum_stats(os_thread_enum_stats_callback_t callback, void* data, void* reserved)
+{
+    // Leave some room for the threads created while the array is being allocated
+    const UBaseType_t maxCount = uxTaskGetNumberOfTasks() + 2;
+    const auto tasks = (TaskStatus_t*)malloc(maxCount * sizeof(TaskStatus_t));
+    if (!tasks) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    const UBaseType_t count = uxTaskGetSystemState(tasks, maxCount, nullptr);
+    int ret = 0;
+    for (UBaseType_t i = 0; i < count; ++i) {
+        const TaskStatus_t& t = tasks[i];
+        os_thread_stats_t stats = {};
+        stats.size = sizeof(stats);
+        stats.flags = OS_THREAD_STATS_FLAG_STACK_FREE;
+        stats.thread = t.xHandle;
+        stats.name = t.pcTaskName;
+        stats.stack_free = t.usStackHighWaterMark * sizeof(StackType_t);
+#if configGENERATE_RUN_TIME_STATS
+        // The run time counter is incremented every configRUN_TIME_COUNTER_PERIOD_US microseconds
+        stats.flags |= OS_THREAD_STATS_FLAG_CPU_TIME;
+        stats.cpu_time = (uint64_t)t.ulRunTimeCounter * configRUN_TIME_COUNTER_PERIOD_US / 1000;
+#endif
+        if (strcmp(t.pcTaskName, "IDLE") == 0) {
+            stats.type = OS_THREAD_TYPE_IDLE;
+        } else if (strcmp(t.pcTaskName, "Tmr Svc") == 0) {
+            stats.type = OS_THREAD_TYPE_TIMER;
+        }
+        ret = callback(&stats, data);
+        if (ret != 0) {
+            break;
+        }
+    }
+    free(tasks);
+    return ret;
+}
+
 /**
  * Map gthread handles to FreeRTOS task handles.
  */
@@ -28,4 +28,11 @@ constexpr uintptr_t EEPROM_SectorBase2 = 0x08010000;
 constexpr size_t EEPROM_SectorSize1 = 16*1024;
 constexpr size_t EEPROM_SectorSize2 = 64*1024;
 
-using FlashEEPROM = EEPROMEmulation<InternalFlashStore, EEPROM_SectorBase1, EEPROM_SectorSize1, EEPROM_SectorBase2, EEPROM_SectorSize2>;
+// Reads are served from a RAM copy of the EEPROM contents, which uses
+// FlashEEPROM::capacity() bytes of RAM (2KB on the Photon and Electron). Build with
+// EEPROM_RAM_CACHE=n to walk the page on each read instead
+#ifndef EEPROM_EMULATION_RAM_CACHE
+#define EEPROM_EMULATION_RAM_CACHE 1
+#endif
+
+using FlashEEPROM = EEPROMEmulation<InternalFlashStore, EEPROM_SectorBase1, EEPROM_SectorSize1, EEPROM_SectorBase2, EEPROM_SectorSize2, EEPROM_EMULATION_RAM_CACHE>;
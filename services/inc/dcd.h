@@ -19,6 +19,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 /**
  * Emulates rewritable storage using two flash blocks.
@@ -74,9 +75,25 @@
  *
  * After the write operation, the sector is validated. If it is not valid, the write is reattempted up to 3 times.
  * If the write continues to fail a failure code is returned.
+ *
+ * Journal:
+ *
+ * When journalSize is not 0, the last journalSize bytes before the footer are used as a journal, and the logical size
+ * of the data is reduced accordingly. Writes of up to journalMaxData bytes are appended to the journal of the current
+ * sector as records comprising the offset and length of the data (2 bytes each), the data padded to a multiple of 4 bytes
+ * and a CRC of the record. This avoids erasing and rewriting the alternate sector for each small write. When the
+ * journal is full, or for larger writes, the sector is rewritten as usual, merging the journal into the data.
+ *
+ * Reads overlay the valid records of the journal on the data of the sector, in the order they were appended. An
+ * interrupted append leaves a record with an invalid CRC, which ends the journal; such a write is discarded and the next
+ * write rewrites the sector. Since the journal is appended to after the sector CRC has been written, the CRC covers
+ * the CRC of the data and the CRC of the footer, excluding the journal.
+ *
+ * Code that reads the sector directly (such as the v1 implementation) doesn't see the journal, so it must be enabled
+ * only when all the code that accesses the DCD uses the same configuration.
  */
 
-template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len)>
+template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len), unsigned journalSize=0>
 class DCD
 {
 public:
@@ -90,6 +107,7 @@ public:
         DCD_SUCCESS,
         DCD_INVALID_OFFSET,
         DCD_INVALID_LENGTH,
+        DCD_JOURNAL_FULL,
     };
 
     Store store;
@@ -212,15 +230,49 @@ public:
         }
 	};
 
+    /**
+     * The header of a record in the journal. It is followed by the data, padded to a multiple of 4 bytes,
+     * and the CRC of the header, data and padding.
+     */
+    struct __attribute__((packed)) JournalRecord
+    {
+        uint16_t offset;
+        uint16_t length;
+
+        bool isEmpty() const {
+            return offset==0xFFFF && length==0xFFFF;
+        }
+
+        /**
+         * Return the size of a record containing the given amount of data.
+         */
+        static constexpr size_t sizeFor(size_t length) {
+            return sizeof(JournalRecord)+((length+3) & ~size_t(3))+sizeof(uint32_t);
+        }
+    };
+
+    /**
+     * The largest write that is appended to the journal. Larger writes rewrite the sector.
+     */
+    static const size_t journalMaxData = 64;
+
+    static_assert(journalSize%4==0, "journalSize should be a multiple of 4");
+    static_assert(!journalSize || sectorSize<=0x10000, "The offsets in the journal are 16-bit");
+
     /**
      * The offset in each sector where the footer is written.
      */
     const size_t footerOffset = sectorSize-sizeof(Footer);
 
+    /**
+     * The offset in each sector where the journal begins.
+     */
+    const size_t journalOffset = footerOffset-journalSize;
+
     /**
      * The logical size of the data that can be stored.
      */
-    const Address Length = sectorSize-sizeof(Header)-sizeof(Footer);
+    const Address Length = sectorSize-sizeof(Header)-sizeof(Footer)-journalSize;
 
     static const Sector Sector_0 = 0;
     static const Sector Sector_1 = 1;
@@ -239,10 +291,10 @@ protected:
      * Determine if the sector at the address contains any cleared bits
      * that requires erasing.
      */
-    bool requiresErase(Address offset)
+    bool requiresErase(Address offset, size_t size=sectorSize)
     {
         const uint8_t* test = store.dataAt(offset);
-        const uint8_t* end = test+sectorSize;
+        const uint8_t* end = test+size;
 
         while (test!=end)
         {
@@ -410,6 +462,119 @@ protected:
 		return sector0;	// both are equally valid - could do a 50/50 random choice here
     }
 
+    Address journalAddress(Sector sector)
+    {
+        return addressOf(sector)+journalOffset;
+    }
+
+    /**
+     * Determine if the journal of a sector has not been written to since the sector was written.
+     */
+    bool isJournalEmpty(Sector sector)
+    {
+        return !journalSize || !requiresErase(journalAddress(sector), sizeof(JournalRecord));
+    }
+
+    /**
+     * Determine if the journal record at the given address is complete and fits before the end address.
+     */
+    bool isJournalRecordValid(Address address, Address end)
+    {
+        const JournalRecord& record = *reinterpret_cast<const JournalRecord*>(store.dataAt(address));
+        const size_t size = JournalRecord::sizeFor(record.length);
+        if (record.isEmpty() || record.length>journalMaxData || record.offset+record.length>Length || address+size>end)
+            return false;
+        uint32_t crc;
+        memcpy(&crc, store.dataAt(address+size-sizeof(crc)), sizeof(crc));
+        return calculateCRC(store.dataAt(address), size-sizeof(crc))==crc;
+    }
+
+    /**
+     * Iterate over the valid records in the journal of a sector in the order they were appended, up to the first
+     * empty or invalid record.
+     * @param sector	The sector
+     * @param f	Called with the offset, data and length of each record
+     * @param verified	When not 0, the address returned by a previous call. The records are not checked again.
+     * @return The address following the last valid record.
+     */
+    template <typename F>
+    Address forEachJournalRecord(Sector sector, F f, Address verified=0)
+    {
+        Address address = journalAddress(sector);
+        const Address end = verified ? verified : address+journalSize;
+        while (address+sizeof(JournalRecord)<=end) {
+            if (!verified && !isJournalRecordValid(address, end))
+                break;
+            const JournalRecord& record = *reinterpret_cast<const JournalRecord*>(store.dataAt(address));
+            f(record.offset, store.dataAt(address+sizeof(JournalRecord)), record.length);
+            address += JournalRecord::sizeFor(record.length);
+        }
+        return address;
+    }
+
+    /**
+     * Copy the part of a block of data that overlaps the destination range.
+     * @param dest	The destination buffer, which holds the logical range [offset, offset+length)
+     * @param srcOffset	The logical offset of the source data
+     */
+    static void overlay(uint8_t* dest, Address offset, size_t length, Address srcOffset, const uint8_t* src, size_t srcLength)
+    {
+        const Address begin = offset>srcOffset ? offset : srcOffset;
+        const Address end = (offset+length)<(srcOffset+srcLength) ? (offset+length) : (srcOffset+srcLength);
+        if (begin<end) {
+            memcpy(dest+(begin-offset), src+(begin-srcOffset), end-begin);
+        }
+    }
+
+    /**
+     * Append a write to the journal of a sector.
+     * @return DCD_JOURNAL_FULL if there is no room for the record or the journal is damaged.
+     */
+    Result appendJournal(Sector sector, const Address offset, const void* data, size_t length)
+    {
+        const Address address = forEachJournalRecord(sector, [](Address, const uint8_t*, size_t) {});
+        const size_t size = JournalRecord::sizeFor(length);
+        if (address+size>journalAddress(sector)+journalSize || requiresErase(address, size))
+            return DCD_JOURNAL_FULL;
+
+        uint8_t buf[JournalRecord::sizeFor(journalMaxData)];
+        JournalRecord record;
+        record.offset = offset;
+        record.length = length;
+        memcpy(buf, &record, sizeof(record));
+        memset(buf+sizeof(record), 0xFF, size-sizeof(record));
+        memcpy(buf+sizeof(record), data, length);
+        const uint32_t crc = calculateCRC(buf, size-sizeof(crc));
+        memcpy(buf+size-sizeof(crc), &crc, sizeof(crc));
+        return store.write(address, buf, size);
+    }
+
+    /**
+     * Determine if the journal of a sector has writes at or after the given offset.
+     */
+    bool journalOverlaps(Sector sector, const Address offset)
+    {
+        bool overlaps = false;
+        if (!isJournalEmpty(sector)) {
+            forEachJournalRecord(sector, [&](Address recordOffset, const uint8_t*, size_t recordLength) {
+                if (recordOffset+recordLength>offset)
+                    overlaps = true;
+            });
+        }
+        return overlaps;
+    }
+
+    /**
+     * Copy data from a sector, including the writes in its journal.
+     */
+    void readSector(Sector sector, const Address offset, uint8_t* data, size_t length)
+    {
+        memcpy(data, store.dataAt(addressOf(sector)+sizeof(Header)+offset), length);
+        forEachJournalRecord(sector, [&](Address recordOffset, const uint8_t* recordData, size_t recordLength) {
+            overlay(data, offset, length, recordOffset, recordData, recordLength);
+        });
+    }
+
 public:
     DCD() = default;
 
@@ -431,6 +596,13 @@ public:
     }
 
     uint32_t computeCRC(const uint8_t* sectorStart) {
+        if (journalSize) {
+            const uint32_t crc[2] = {
+                calculateCRC(sectorStart+sizeof(Header), Length),
+                calculateCRC(sectorStart+footerOffset, sizeof(Footer)-sizeof(typename Footer::crc_type))
+            };
+            return calculateCRC(crc, sizeof(crc));
+        }
     		return calculateCRC(sectorStart+sizeof(Header), sectorSize-sizeof(Header)-sizeof(typename Footer::crc_type));
     }
 
@@ -468,17 +640,42 @@ public:
 
     /**
      * Retrieve a pointer to the data in the DCD.
+     * When the journal has writes at or after the offset, the sector is first rewritten so that the data
+     * includes them, which costs a sector erase. Prefer the copying read(), which doesn't rewrite the sector.
      * @param offset
-     * @return
+     * @return A pointer to the data, or nullptr if the journal couldn't be merged into the sector.
      */
     const uint8_t* read(const Address offset)
     {
         Sector current = currentValidSector();
+        if (journalOverlaps(current, offset)) {
+            if (_compactSector(current, 0, nullptr, 0))
+                return nullptr;
+            current = currentValidSector();
+        }
         const Header& header = sectorHeader(current);
         Address location = addressOf(current)+header.size()+offset;
         return store.dataAt(location);
     }
 
+    /**
+     * Copy data from the DCD.
+     * @param offset    The logical offset in the DCD region to read from.
+     * @param data      The buffer to copy the data to
+     * @param length    The number of bytes of data to read.
+     * @return	DCD_SUCCESS if the data was read.
+     */
+    Result read(const Address offset, void* data, size_t length)
+    {
+        if (offset >= Length)
+            return DCD_INVALID_OFFSET;
+        if (offset+length > Length)
+            return DCD_INVALID_LENGTH;
+
+        readSector(currentValidSector(), offset, static_cast<uint8_t*>(data), length);
+        return DCD_SUCCESS;
+    }
+
     /**
      * Write data to the DCD.
      * @param data      The data to write
@@ -497,6 +694,12 @@ public:
             return DCD_SUCCESS;
 
         Sector current = currentValidSector();
+        if (journalSize) {
+            if (length<=journalMaxData && appendJournal(current, offset, data, length)==DCD_SUCCESS)
+                return DCD_SUCCESS;
+            return _compactSector(current, offset, data, length);
+        }
+
         Sector newSector = alternateSectorTo(current);
         const uint8_t* existing = store.dataAt(addressOf(current));
         	Result error = this->_writeSector(offset, data, length, existing, newSector);
@@ -523,7 +726,6 @@ public:
         if (error) return error;
 
         const Header& existingHeader = *(reinterpret_cast<const Header*>(existing));
-        	const Footer& existingFooter = *(reinterpret_cast<const Footer*>(existing+footerOffset));
 
 		Address destination = addressOf(newSector);
         Address writeOffset = sizeof(Header);
@@ -545,18 +747,69 @@ public:
         }
 
         if (existing) {
-            error = store.write(destination+writeOffset, existing+readOffset, sectorSize-writeOffset-sizeof(Footer));
+            error = store.write(destination+writeOffset, existing+readOffset, sizeof(Header)+Length-writeOffset);
             if (error) return error;
         }
 
+        return _sealSector(newSector, existing);
+    }
+
+    /**
+     * Rewrite the current sector to the alternate sector, merging the journal into the data.
+     *
+     * @param current	The current sector
+     * @param offset	The logical offset of the data being written (0-based)
+     * @param data	The data to write
+     * @param length	The amount of data to write
+     */
+    Result _compactSector(Sector current, const Address offset, const void* data, size_t length)
+    {
+        const Sector newSector = alternateSectorTo(current);
+        Result error = erase(newSector);
+        if (error) return error;
+
+        // The data is written in chunks that combine the existing data, the journal and the new data
+        const Address journalEnd = forEachJournalRecord(current, [](Address, const uint8_t*, size_t) {});
+        const uint8_t* existing = store.dataAt(addressOf(current));
+        const Address destination = addressOf(newSector)+sizeof(Header);
+        uint8_t chunk[64];
+        for (Address pos = 0; pos<Length; pos += sizeof(chunk)) {
+            const size_t n = (Length-pos)<sizeof(chunk) ? (Length-pos) : sizeof(chunk);
+            memcpy(chunk, existing+sizeof(Header)+pos, n);
+            forEachJournalRecord(current, [&](Address recordOffset, const uint8_t* recordData, size_t recordLength) {
+                overlay(chunk, pos, n, recordOffset, recordData, recordLength);
+            }, journalEnd);
+            overlay(chunk, pos, n, offset, static_cast<const uint8_t*>(data), length);
+            error = store.write(destination+pos, chunk, n);
+            if (error) return error;
+        }
+
+        error = _sealSector(newSector, existing);
+        if (error) return error;
+
+        Header header;
+        header.makeInvalid();
+        return write(current, header);
+    }
+
+    /**
+     * Write the footer, the CRC and the header of a sector whose data has been written.
+     *
+     * @param newSector	The sector
+     * @param existing	A pointer to the sector the data was copied from, or nullptr
+     */
+    Result _sealSector(Sector newSector, const uint8_t* existing)
+    {
+        const Footer& existingFooter = *(reinterpret_cast<const Footer*>(existing+footerOffset));
+        Address destination = addressOf(newSector);
         uint8_t counter = 0;
         if (existing && existingFooter.isValid()) {
             counter = uint8_t((existingFooter.counter() + 1) & 3);
         }
-        error = _write_v2_footer(newSector, (existing && existingFooter.isValid()) ? &existingFooter : nullptr, counter);
+        Result error = _write_v2_footer(newSector, (existing && existingFooter.isValid()) ? &existingFooter : nullptr, counter);
         if (error) return error;
         typename Footer::crc_type crc = computeSectorCRC(newSector);
-        writeOffset = sectorSize-sizeof(typename Footer::crc_type);
+        Address writeOffset = sectorSize-sizeof(typename Footer::crc_type);
         error = store.write(destination+writeOffset, &crc, sizeof(crc));
         if (error) return error;
 		Header header;
@@ -584,12 +837,12 @@ public:
 
 };
 
-template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len)>
-const typename DCD<Store, sectorSize, DCD1, DCD2, calculateCRC>::Sector DCD<Store, sectorSize, DCD1, DCD2, calculateCRC>::Sector_0;
+template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len), unsigned journalSize>
+const typename DCD<Store, sectorSize, DCD1, DCD2, calculateCRC, journalSize>::Sector DCD<Store, sectorSize, DCD1, DCD2, calculateCRC, journalSize>::Sector_0;
 
-template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len)>
-const typename DCD<Store, sectorSize, DCD1, DCD2, calculateCRC>::Sector DCD<Store, sectorSize, DCD1, DCD2, calculateCRC>::Sector_1;
+template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len), unsigned journalSize>
+const typename DCD<Store, sectorSize, DCD1, DCD2, calculateCRC, journalSize>::Sector DCD<Store, sectorSize, DCD1, DCD2, calculateCRC, journalSize>::Sector_1;
 
-template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len)>
-const typename DCD<Store, sectorSize, DCD1, DCD2, calculateCRC>::Sector DCD<Store, sectorSize, DCD1, DCD2, calculateCRC>::Sector_Unknown;
+template <typename Store, unsigned sectorSize, unsigned DCD1, unsigned DCD2, uint32_t(*calculateCRC)(const void* data, size_t len), unsigned journalSize>
+const typename DCD<Store, sectorSize, DCD1, DCD2, calculateCRC, journalSize>::Sector DCD<Store, sectorSize, DCD1, DCD2, calculateCRC, journalSize>::Sector_Unknown;
 
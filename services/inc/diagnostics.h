@@ -54,6 +54,24 @@
 #define DIAG_NAME_CLOUD_RATE_LIMITED_EVENTS "pub:limit"
 #define DIAG_NAME_SYSTEM_TOTAL_RAM "sys:tram"
 #define DIAG_NAME_SYSTEM_USED_RAM "sys:uram"
+#define DIAG_NAME_LOG_SUPPRESSED_MESSAGES "log:supp"
+#define DIAG_NAME_CLOUD_ROUND_TRIP_TIME "coap:rtt"
+#define DIAG_NAME_CLOUD_PUBLISH_ACK_LATENCY "pub:acklat"
+#define DIAG_NAME_CLOUD_HANDSHAKE_DURATION "cloud:hsdur"
+#define DIAG_NAME_SYSTEM_QUEUE_WAIT_TIME "sys:qwait"
+#define DIAG_NAME_SYSTEM_THREAD_CPU_TIME "thr:sys:cpu"
+#define DIAG_NAME_SYSTEM_THREAD_STACK_FREE "thr:sys:stkfree"
+#define DIAG_NAME_APPLICATION_THREAD_CPU_TIME "thr:app:cpu"
+#define DIAG_NAME_APPLICATION_THREAD_STACK_FREE "thr:app:stkfree"
+#define DIAG_NAME_TIMER_THREAD_CPU_TIME "thr:tmr:cpu"
+#define DIAG_NAME_TIMER_THREAD_STACK_FREE "thr:tmr:stkfree"
+#define DIAG_NAME_OTHER_THREADS_CPU_TIME "thr:oth:cpu"
+#define DIAG_NAME_OTHER_THREADS_STACK_FREE "thr:oth:stkfree"
+#define DIAG_NAME_CLOUD_SMOOTHED_ROUND_TRIP_TIME "coap:srtt"
+#define DIAG_NAME_CLOUD_ROUND_TRIP_TIME_VARIATION "coap:rttvar"
+#define DIAG_NAME_CLOUD_ACK_TIMEOUT "coap:acktout"
+#define DIAG_NAME_CLOUD_LOSS_RATE "coap:loss"
+#define DIAG_NAME_CLOUD_THROUGHPUT "coap:tput"
 
 #ifdef __cplusplus
 extern "C" {
@@ -95,17 +113,37 @@ typedef enum diag_id {
     DIAG_ID_CLOUD_RATE_LIMITED_EVENTS = 20, // pub:throttle
     DIAG_ID_SYSTEM_TOTAL_RAM = 25, // sys:tram
     DIAG_ID_SYSTEM_USED_RAM = 26, // sys:uram
+    DIAG_ID_LOG_SUPPRESSED_MESSAGES = 38, // log:supp
+    DIAG_ID_CLOUD_ROUND_TRIP_TIME = 39, // coap:rtt
+    DIAG_ID_CLOUD_PUBLISH_ACK_LATENCY = 40, // pub:acklat
+    DIAG_ID_CLOUD_HANDSHAKE_DURATION = 41, // cloud:hsdur
+    DIAG_ID_SYSTEM_QUEUE_WAIT_TIME = 42, // sys:qwait
+    DIAG_ID_SYSTEM_THREAD_CPU_TIME = 43, // thr:sys:cpu
+    DIAG_ID_SYSTEM_THREAD_STACK_FREE = 44, // thr:sys:stkfree
+    DIAG_ID_APPLICATION_THREAD_CPU_TIME = 45, // thr:app:cpu
+    DIAG_ID_APPLICATION_THREAD_STACK_FREE = 46, // thr:app:stkfree
+    DIAG_ID_TIMER_THREAD_CPU_TIME = 47, // thr:tmr:cpu
+    DIAG_ID_TIMER_THREAD_STACK_FREE = 48, // thr:tmr:stkfree
+    DIAG_ID_OTHER_THREADS_CPU_TIME = 49, // thr:oth:cpu
+    DIAG_ID_OTHER_THREADS_STACK_FREE = 50, // thr:oth:stkfree
+    DIAG_ID_CLOUD_SMOOTHED_ROUND_TRIP_TIME = 51, // coap:srtt
+    DIAG_ID_CLOUD_ROUND_TRIP_TIME_VARIATION = 52, // coap:rttvar
+    DIAG_ID_CLOUD_ACK_TIMEOUT = 53, // coap:acktout
+    DIAG_ID_CLOUD_LOSS_RATE = 54, // coap:loss
+    DIAG_ID_CLOUD_THROUGHPUT = 55, // coap:tput
     DIAG_ID_USER = 32768 // Base value for application-specific source IDs
 } diag_id;
 
 // Data types
 typedef enum diag_type {
-    DIAG_TYPE_INT = 1 // 32-bit integer
+    DIAG_TYPE_INT = 1, // 32-bit integer
+    DIAG_TYPE_HISTOGRAM = 2 // Histogram of 32-bit unsigned values (see diag_histogram)
 } diag_type;
 
 // Data source commands
 typedef enum diag_source_cmd {
-    DIAG_SOURCE_CMD_GET = 1 // Get current data
+    DIAG_SOURCE_CMD_GET = 1, // Get current data
+    DIAG_SOURCE_CMD_GET_VALUE_PTR = 2 // Get a pointer to the current value of an integer source (optional)
 } diag_source_cmd;
 
 // Service commands
@@ -114,6 +152,11 @@ typedef enum diag_service_cmd {
     DIAG_SERVICE_CMD_START = 2 // Start the service
 } diag_service_cmd;
 
+// Snapshot entry flags
+typedef enum diag_snapshot_entry_flag {
+    DIAG_SNAPSHOT_ENTRY_FLAG_ERROR = 0x01 // Entry contains an error code returned by the source
+} diag_snapshot_entry_flag;
+
 typedef struct diag_source diag_source;
 
 typedef int(*diag_source_cmd_callback)(const diag_source* src, int cmd, void* data);
@@ -129,6 +172,19 @@ struct diag_source {
     diag_source_cmd_callback callback; // Source callback
 };
 
+// Histogram data. Values are counted in log-linear buckets: values below `2^sub_bucket_bits` have a
+// bucket each, and every following power of two range is split into `2^sub_bucket_bits` equally
+// sized buckets. This structure is followed by `bucket_count` 32-bit bucket counters
+typedef struct diag_histogram {
+    uint16_t size; // Size of this structure
+    uint8_t sub_bucket_bits; // Number of bits of a value that determine its bucket within a power of two range
+    uint8_t bucket_count; // Number of buckets. The last bucket also counts all values exceeding its range
+    uint32_t count; // Number of recorded values
+    uint32_t sum; // Sum of recorded values (wraps around on overflow)
+    uint32_t min; // Minimum recorded value
+    uint32_t max; // Maximum recorded value
+} diag_histogram;
+
 typedef struct diag_source_get_cmd_data {
     uint16_t size; // Size of this structure
     uint16_t reserved; // Reserved (should be set to 0)
@@ -136,6 +192,13 @@ typedef struct diag_source_get_cmd_data {
     size_t data_size; // Buffer size
 } diag_source_get_cmd_data;
 
+// Value of an integer data source (see diag_snapshot())
+typedef struct diag_snapshot_entry {
+    uint16_t id; // Source ID
+    uint16_t flags; // Entry flags (see diag_snapshot_entry_flag)
+    int32_t value; // Value of the source, or an error code if DIAG_SNAPSHOT_ENTRY_FLAG_ERROR is set
+} diag_snapshot_entry;
+
 // Registers a new data source. Note that in order for the data source to be registered, the service
 // needs to be in its initial stopped state
 int diag_register_source(const diag_source* src, void* reserved);
@@ -151,6 +214,14 @@ int diag_get_source(uint16_t id, const diag_source** src, void* reserved);
 // Issues a service command
 int diag_command(int cmd, void* data, void* reserved);
 
+// Copies the values of all integer data sources to `entries` in one pass. The entries are sorted by
+// source ID. On input, `count` is the size of the array, on output it's set to the number of integer
+// sources. If `entries` is NULL, only the number of sources is returned. Sources that provide
+// a pointer to their value via DIAG_SOURCE_CMD_GET_VALUE_PTR are read directly. This function never
+// blocks: a caller running concurrently with another snapshot takes the values collected by that
+// snapshot. This function returns an error if the service is not started
+int diag_snapshot(diag_snapshot_entry* entries, size_t* count, void* reserved);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
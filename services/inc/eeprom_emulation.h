@@ -20,10 +20,9 @@
  ******************************************************************************
  */
 
+#include <algorithm>
 #include <cstring>
 #include <memory>
-#include <vector>
-#include <limits>
 
 /* EEPROM Emulation using Flash memory
  *
@@ -71,6 +70,10 @@
  * - If any of the writes failed or there was not enough room for all
  *   records, do a page swap
  *
+ * Writes to several blocks can be made atomic as a whole by staging
+ * them in a Transaction (see beginTransaction()). The records of all
+ * the blocks are then written as a single atomic write.
+ *
  * It is possible for a write to fail verification (reading back the
  * value). This is because of previous marginal writes or marginal
  * erases (reset during writing or erase that leaves Flash cells reading
@@ -89,9 +92,16 @@
  * not call performPendingErase() before the next page swap, the
  * alternate page will be erased just before the page swap.
  *
+ * Optionally (RamCache template parameter), a copy of the logical EEPROM
+ * contents is kept in RAM. It is built by a single pass through the
+ * active page on init(), kept up to date by writes and page swaps, and
+ * serves reads without walking the page. If a write fails, the copy is
+ * rebuilt from the records in Flash on the next read. The copy uses
+ * capacity() bytes of RAM.
+ *
  */
 
-template <typename Store, uintptr_t PageBase1, size_t PageSize1, uintptr_t PageBase2, size_t PageSize2>
+template <typename Store, uintptr_t PageBase1, size_t PageSize1, uintptr_t PageBase2, size_t PageSize2, bool RamCache = false>
 class EEPROMEmulation
 {
 public:
@@ -167,6 +177,66 @@ public:
         }
     };
 
+    // A block of new values written as part of a transaction
+    struct Range
+    {
+        Index index;
+        const Data *data;
+        uint16_t length;
+    };
+
+    // Collects writes to several blocks of EEPROM and commits them
+    // atomically: either all the new values will be read back or none
+    // of them, even in the presence of power failure/controller reset.
+    //
+    // The values are not copied when staged, so they must remain valid
+    // until commit() is called. No memory is allocated
+    template <size_t MaxRanges = 8>
+    class Transaction
+    {
+    public:
+        explicit Transaction(EEPROMEmulation &eeprom)
+            : eeprom(eeprom),
+              count(0),
+              valid(true)
+        {
+        }
+
+        // Stages new values for a block of EEPROM. Values staged later
+        // take precedence over the earlier ones
+        //
+        // Returns false if the block is out of range or too many blocks
+        // were staged, in which case the transaction will not be committed
+        bool put(Index index, const void *data, uint16_t length)
+        {
+            if(count == MaxRanges || index + (size_t)length > capacity())
+            {
+                valid = false;
+                return false;
+            }
+
+            ranges[count++] = { index, (const Data *)data, length };
+            return true;
+        }
+
+        // Writes all the staged values and starts a new transaction
+        //
+        // Returns false if nothing was written
+        bool commit()
+        {
+            bool success = valid && eeprom.writeRanges(ranges, count);
+            count = 0;
+            valid = true;
+            return success;
+        }
+
+    private:
+        EEPROMEmulation &eeprom;
+        Range ranges[MaxRanges];
+        size_t count;
+        bool valid;
+    };
+
     /* Public API */
 
     // Initialize the EEPROM pages
@@ -179,6 +249,11 @@ public:
         {
             clear();
         }
+
+        if(RamCache && !cacheValid)
+        {
+            rebuildCache();
+        }
     }
 
     // Read the latest value of a byte of EEPROM in data or 0xFF if the
@@ -214,6 +289,15 @@ public:
         writeRange(index, (Data *)data, length);
     }
 
+    // Starts a transaction to write several blocks of EEPROM atomically.
+    // Compared to a put() of each block, the page is scanned once, the
+    // blocks don't need temporary buffers, and a page swap, if needed,
+    // happens at most once
+    Transaction<> beginTransaction()
+    {
+        return Transaction<>(*this);
+    }
+
     // Destroys all the data 💣
     void clear()
     {
@@ -222,6 +306,12 @@ public:
         writePageStatus(LogicalPage::Page1, PageHeader::ACTIVE);
 
         updateActivePage();
+
+        if(RamCache && getActivePage() != LogicalPage::NoPage)
+        {
+            std::memset(cache, FLASH_ERASED, sizeof(cache));
+            cacheValid = true;
+        }
     }
 
     // Returns number of bytes that can be stored in EEPROM
@@ -285,8 +375,12 @@ public:
 
     // Figure out which page should currently be read from/written to
     // and which one should be used as the target of the page swap
+    //
+    // The RAM cache is invalidated since the active page may have changed
     void updateActivePage()
     {
+        cacheValid = false;
+
         uint32_t status1 = readPageStatus(LogicalPage::Page1);
         uint32_t status2 = readPageStatus(LogicalPage::Page2);
 
@@ -339,6 +433,21 @@ public:
     {
         std::memset(data, FLASH_ERASED, length);
 
+        if(RamCache && getActivePage() != LogicalPage::NoPage)
+        {
+            if(!cacheValid)
+            {
+                rebuildCache();
+            }
+
+            if(indexBegin < capacity())
+            {
+                size_t count = std::min<size_t>(length, capacity() - indexBegin);
+                std::memcpy(data, cache + indexBegin, count);
+            }
+            return;
+        }
+
         Index indexEnd = indexBegin + length;
         forEachValidRecord(getActivePage(), [=](Address address, const Record &record)
         {
@@ -359,6 +468,14 @@ public:
             return;
         }
 
+        // The existing values are in the RAM cache, no need for a buffer
+        if(RamCache)
+        {
+            Range range = { indexBegin, data, length };
+            writeRanges(&range, 1);
+            return;
+        }
+
         // Read existing values for range
         std::unique_ptr<Data[]> existingData(new Data[length]);
         // don't write anything if memory is full
@@ -384,6 +501,132 @@ public:
         {
             swapPagesAndWrite(indexBegin, data, length);
         }
+        else
+        {
+            updateCache(indexBegin, data, length);
+        }
+    }
+
+    // Write each value of several ranges if it has changed, in an
+    // atomic fashion. Values replaced by a later range are not written
+    //
+    // The existing values are taken from the RAM cache. When it is
+    // disabled, all the values are written
+    //
+    // Returns false if a range is out of range or the page swap failed
+    bool writeRanges(const Range *ranges, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            if(ranges[i].index + (size_t)ranges[i].length > capacity())
+            {
+                return false;
+            }
+        }
+
+        bool useCache = RamCache && getActivePage() != LogicalPage::NoPage;
+        if(useCache && !cacheValid)
+        {
+            rebuildCache();
+        }
+
+        // Without the cache, the staged values that are the same as the
+        // latest ones are found in the pass through the page that finds
+        // where to write, and kept as a bit per address
+        uint8_t unchanged[RamCache ? 1 : (capacity() + 7) / 8];
+
+        // Make sure there are no previous invalid records before
+        // starting to write
+        Address writeAddressBegin;
+        bool success = RamCache ?
+                findEmptyRecord(getActivePage(), writeAddressBegin) :
+                findUnchangedAndEmpty(getActivePage(), ranges, count, unchanged, writeAddressBegin);
+
+        auto changed = [&](Index index, Data data) -> bool
+        {
+            if(RamCache)
+            {
+                return !useCache || cache[index] != data;
+            }
+            return !(unchanged[index / 8] & (1 << (index % 8)));
+        };
+
+        size_t changedCount = 0;
+        forEachStagedValue(ranges, count, [&](Index index, Data data) -> bool
+        {
+            if(changed(index, data))
+            {
+                changedCount++;
+            }
+            return true;
+        });
+
+        // Write all changed values, backwards from the end, as in
+        // writeRangeChanged()
+        if(success && changedCount > 0)
+        {
+            Address writeAddress = writeAddressBegin + changedCount * sizeof(Record);
+            Address endAddress = getPageEnd(getActivePage());
+
+            if(writeAddress < endAddress)
+            {
+                Record separatorRecord;
+                store.read(writeAddress, &separatorRecord, sizeof(separatorRecord));
+
+                success = separatorRecord.empty();
+            }
+
+            forEachStagedValue(ranges, count, [&](Index index, Data data) -> bool
+            {
+                if(success && changed(index, data))
+                {
+                    writeAddress -= sizeof(Record);
+                    success = writeRecord(writeAddress, endAddress, Record(index, data));
+                }
+                return success;
+            });
+        }
+
+        // If any writes failed because the page was full or a marginal
+        // write error occured, do a page swap then write all the
+        // records
+        if(!success)
+        {
+            return swapPagesAndWrite(ranges, count);
+        }
+
+        updateCache(ranges, count);
+        return true;
+    }
+
+    // Find the address where to write new records
+    //
+    // Return false if there are invalid records, true if page can be
+    // written to
+    bool findEmptyRecord(LogicalPage page, Address &emptyAddress)
+    {
+        bool hasInvalidRecords = false;
+        emptyAddress = getPageEnd(page);
+
+        forEachRecord(page, [&](Address address, const Record &record) -> bool
+        {
+            if(record.empty())
+            {
+                emptyAddress = address;
+                return true;
+            }
+            else if(record.valid())
+            {
+                return false;
+            }
+            else
+            {
+                hasInvalidRecords = true;
+                return true;
+            }
+        });
+
+        return !hasInvalidRecords;
     }
 
     // Read values and find the address where to write new records
@@ -424,6 +667,64 @@ public:
         return !hasInvalidRecords;
     }
 
+    // Find which staged values are the same as the latest values of a
+    // page, as a bit per address of capacity() bits, and the address
+    // where to write new records
+    //
+    // Return false if there are invalid records, true if page can be
+    // written to
+    bool findUnchangedAndEmpty(LogicalPage page, const Range *ranges, size_t count,
+            uint8_t *unchanged, Address &emptyAddress)
+    {
+        bool hasInvalidRecords = false;
+
+        auto setUnchanged = [=](Index index, bool value)
+        {
+            if(value)
+            {
+                unchanged[index / 8] |= (1 << (index % 8));
+            }
+            else
+            {
+                unchanged[index / 8] &= ~(1 << (index % 8));
+            }
+        };
+
+        // Addresses that were never written read as 0xFF
+        std::memset(unchanged, 0, (capacity() + 7) / 8);
+        forEachStagedValue(ranges, count, [&](Index index, Data data) -> bool
+        {
+            setUnchanged(index, data == FLASH_ERASED);
+            return true;
+        });
+
+        emptyAddress = getPageEnd(page);
+
+        forEachRecord(page, [&](Address address, const Record &record) -> bool
+        {
+            if(record.empty())
+            {
+                emptyAddress = address;
+                return true;
+            }
+            else if(record.valid())
+            {
+                Data data;
+                if(record.index < capacity() && findStagedValue(ranges, count, record.index, data))
+                {
+                    setUnchanged(record.index, record.data == data);
+                }
+                return false;
+            }
+            else
+            {
+                hasInvalidRecords = true;
+                return true;
+            }
+        });
+
+        return !hasInvalidRecords;
+    }
 
     // Write new records backwards in Flash. This ensures data
     // consistency if writeRange is interrupted by a reset since reads
@@ -539,78 +840,6 @@ public:
         });
     }
 
-    // Iterate through a page and yield each valid record once, with the
-    // latest value
-    template <typename Func>
-    void forEachUniqueValidRecord(LogicalPage page, Func f)
-    {
-        // Find latest address of each record in several passes through the page, batching
-        // the finds to reduce the number of linear searches through the page.
-
-        // To save heap space, only address offsets are used instead of the full
-        // addresses, so make sure offsets fit in the chosen AddressOffset data type
-        using AddressOffset = uint16_t;
-        static_assert(
-            PageSize1 <= std::numeric_limits<AddressOffset>::max() + 1 &&
-            PageSize2 <= std::numeric_limits<AddressOffset>::max() + 1,
-            "PageSize1 or PageSize2 doesn't fit in AddressOffset. "
-            "Make pages smaller or AddressOffset a larger data type"
-        );
-
-        // The recordAddresses vector will use up to BatchSize * sizeof(AddressOffset)
-        // bytes on the heap.
-        std::vector<AddressOffset> recordAddresses;
-        const Index BatchSize = 128;
-
-        Address baseAddress = getPageBegin(page);
-
-        Index firstIndex = 0;
-        Index lastIndex = BatchSize;
-        bool hasMoreRecords = true;
-
-        while(hasMoreRecords) {
-            hasMoreRecords = false;
-
-            forEachValidRecord(page, [&](Address address, const Record &record)
-            {
-                // Save records in this batch
-                if(record.index >= firstIndex && record.index < lastIndex) {
-                    Index indexOffset = record.index - firstIndex;
-                    AddressOffset addressOffset = address - baseAddress;
-
-                    if(indexOffset >= recordAddresses.size())
-                    {
-                        recordAddresses.resize(indexOffset + 1);
-                    }
-
-                    recordAddresses[indexOffset] = addressOffset;
-                }
-
-                // More records in a later batch
-                if(record.index >= lastIndex) {
-                    hasMoreRecords = true;
-                }
-            });
-
-            // Yield the records in this batch that have a value
-            for(auto addressOffset: recordAddresses)
-            {
-                if(addressOffset != 0) {
-                    Address address = baseAddress + addressOffset;
-                    const Record &record = *(const Record *) store.dataAt(address);
-
-                    // Yield record
-                    f(address, record);
-                }
-            }
-
-            // Get ready for a new batch
-            recordAddresses.clear();
-            firstIndex += BatchSize;
-            lastIndex += BatchSize;
-        }
-    }
-
     // Verify that the entire page is erased to protect against resets
     // during page erase
     bool verifyPage(LogicalPage page)
@@ -639,6 +868,13 @@ public:
     // Then write the new record to the alternate page.
     // Then erase the old active page
     bool swapPagesAndWrite(Index indexBegin, const Data *data, uint16_t length)
+    {
+        Range range = { indexBegin, data, length };
+        return swapPagesAndWrite(&range, 1);
+    }
+
+    // Same as above, with the new values of several ranges
+    bool swapPagesAndWrite(const Range *ranges, size_t count)
     {
         LogicalPage sourcePage = getActivePage();
         LogicalPage destinationPage = getAlternatePage();
@@ -665,17 +901,14 @@ public:
             success = success && copyAllRecordsToPageExcept(sourcePage,
                                                             destinationPage,
                                                             writeAddress,
-                                                            indexBegin,
-                                                            indexBegin + length);
-
-            Address endAddress = getPageEnd(destinationPage);
+                                                            ranges,
+                                                            count);
 
             // Write new records to destination directly
-            success = success && writeRangeDirect(writeAddress,
-                                                  getPageEnd(destinationPage),
-                                                  indexBegin,
-                                                  data,
-                                                  length);
+            success = success && writeRangesDirect(writeAddress,
+                                                   getPageEnd(destinationPage),
+                                                   ranges,
+                                                   count);
 
             // Mark new page as active
             success = success && writePageStatus(destinationPage, PageHeader::ACTIVE);
@@ -683,62 +916,225 @@ public:
 
             if(success)
             {
+                // The new page contains the contents of the old page,
+                // except for the written ranges
+                bool wasCacheValid = cacheValid;
                 updateActivePage();
+                cacheValid = wasCacheValid;
+                updateCache(ranges, count);
                 return true;
             }
         }
 
+        // The state of the pages is unknown, so read the contents back
+        // from Flash
+        cacheValid = false;
         return false;
     }
 
     // Perform the actual copy of records during page swap
+    //
+    // The latest value of each address is taken from the RAM cache and
+    // written in ascending index order. When the cache is disabled, the
+    // valid records of the source page are walked backwards, so that the
+    // first record found for an address holds its latest value, and are
+    // written most recent first. A bit per address (capacity() / 8 bytes
+    // on the stack) marks the addresses already seen
     bool copyAllRecordsToPageExcept(LogicalPage sourcePage,
             LogicalPage destinationPage,
             Address &writeAddress,
-            Index exceptIndexBegin,
-            Index exceptIndexEnd)
+            const Range *exceptRanges,
+            size_t exceptCount)
     {
-        bool success = true;
         Address endAddress = getPageEnd(destinationPage);
-        forEachUniqueValidRecord(sourcePage, [&](Address address, const Record &record)
+        if(RamCache && sourcePage == getActivePage())
+        {
+            if(!cacheValid)
+            {
+                rebuildCache();
+            }
+            return copyValuesExcept(cache, 0, capacity(), writeAddress, endAddress,
+                    exceptRanges, exceptCount);
+        }
+
+        // Only the records before the first invalid one are valid, so
+        // find the end of those first. This only reads the record headers
+        Address beginAddress = getPageBegin(sourcePage) + sizeof(PageHeader);
+        Address validEndAddress = beginAddress;
+        forEachValidRecord(sourcePage, [&](Address address, const Record &record)
+        {
+            validEndAddress = address + sizeof(Record);
+        });
+
+        uint8_t seen[(capacity() + 7) / 8];
+        std::memset(seen, 0, sizeof(seen));
+
+        bool success = true;
+        for(Address address = validEndAddress; address > beginAddress && success;)
         {
+            address -= sizeof(Record);
+            const Record &record = *(const Record *) store.dataAt(address);
+            Index index = record.index;
+            if(index >= capacity() || (seen[index / 8] & (1 << (index % 8))))
+            {
+                continue;
+            }
+            seen[index / 8] |= (1 << (index % 8));
+
             // Don't copy the records that are being replaced or records that are 0xFF
-            if(!(record.index >= exceptIndexBegin && record.index < exceptIndexEnd) &&
+            if(!isInRanges(index, exceptRanges, exceptCount) &&
                 record.data != FLASH_ERASED)
             {
-                success = success && writeRecord(writeAddress, endAddress, Record(record.index, record.data));
+                success = writeRecord(writeAddress, endAddress, Record(index, record.data));
                 writeAddress += sizeof(Record);
             }
-        });
+        }
 
         return success;
     }
 
-    // Write a range of valid records starting a specified address
-    bool writeRangeDirect(Address writeAddress,
+    // Write the values of count addresses starting at firstIndex, except
+    // the addresses that are being replaced and the values that are 0xFF
+    bool copyValuesExcept(const Data *values,
+            Index firstIndex,
+            size_t count,
+            Address &writeAddress,
             Address endAddress,
-            Index indexBegin,
-            const Data *data,
-            uint16_t length)
+            const Range *exceptRanges,
+            size_t exceptCount)
     {
         bool success = true;
+        for(size_t i = 0; i < count && success; i++)
+        {
+            Index index = firstIndex + i;
+            if(!isInRanges(index, exceptRanges, exceptCount) &&
+                values[i] != FLASH_ERASED)
+            {
+                success = writeRecord(writeAddress, endAddress, Record(index, values[i]));
+                writeAddress += sizeof(Record);
+            }
+        }
 
-        // Write new records to destination directly
-        for(uint16_t i = 0; i < length && success; i++)
+        return success;
+    }
+
+    // Write the valid records of several ranges starting a specified
+    // address
+    bool writeRangesDirect(Address &writeAddress,
+            Address endAddress,
+            const Range *ranges,
+            size_t count)
+    {
+        bool success = true;
+        forEachStagedValue(ranges, count, [&](Index index, Data data) -> bool
         {
             // Don't bother writing records that are 0xFF
-            if(data[i] != FLASH_ERASED)
+            if(data != FLASH_ERASED)
             {
-                Index index = indexBegin + i;
-                success = success && writeRecord(
-                        writeAddress, endAddress, Record(index, data[i]));
+                success = writeRecord(writeAddress, endAddress, Record(index, data));
                 writeAddress += sizeof(Record);
             }
-        }
+            return success;
+        });
 
         return success;
     }
 
+    // Check if an index belongs to any of the ranges
+    static bool isInRanges(Index index, const Range *ranges, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            if(index >= ranges[i].index && index < ranges[i].index + (size_t)ranges[i].length)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Find the new value of an address in a set of ranges, where a later
+    // range takes precedence over the earlier ones
+    static bool findStagedValue(const Range *ranges, size_t count, Index index, Data &data)
+    {
+        for(size_t r = count; r > 0; r--)
+        {
+            const Range &range = ranges[r - 1];
+            if(index >= range.index && index < range.index + (size_t)range.length)
+            {
+                data = range.data[index - range.index];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Yield the index and the new value of each address written by a
+    // set of ranges, skipping the values replaced by a later range.
+    // Stops early if f returns false
+    template <typename Func>
+    static void forEachStagedValue(const Range *ranges, size_t count, Func f)
+    {
+        for(size_t r = 0; r < count; r++)
+        {
+            for(uint16_t i = 0; i < ranges[r].length; i++)
+            {
+                Index index = ranges[r].index + i;
+                if(!isInRanges(index, ranges + r + 1, count - r - 1) &&
+                    !f(index, ranges[r].data[i]))
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Copy the latest value of each address of the active page to the
+    // RAM cache in a single pass through the page
+    void rebuildCache()
+    {
+        if(!RamCache)
+        {
+            return;
+        }
+
+        std::memset(cache, FLASH_ERASED, sizeof(cache));
+        forEachValidRecord(getActivePage(), [this](Address address, const Record &record)
+        {
+            if(record.index < capacity())
+            {
+                cache[record.index] = record.data;
+            }
+        });
+        cacheValid = true;
+    }
+
+    // Update the RAM cache after a successful write
+    void updateCache(Index indexBegin, const Data *data, uint16_t length)
+    {
+        if(!RamCache || !cacheValid || length == 0)
+        {
+            return;
+        }
+
+        if(indexBegin + (size_t)length > capacity())
+        {
+            // Not written by writeRange(), read the contents back from Flash
+            cacheValid = false;
+            return;
+        }
+
+        std::memcpy(cache + indexBegin, data, length);
+    }
+
+    void updateCache(const Range *ranges, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            updateCache(ranges[i].index, ranges[i].data, ranges[i].length);
+        }
+    }
+
     // Which page needs to be erased after a page swap.
     LogicalPage getPendingErasePage()
     {
@@ -758,4 +1154,12 @@ public:
 protected:
     LogicalPage activePage;
     LogicalPage alternatePage;
+
+    // Latest value of each address, if RamCache is enabled. The size of
+    // the array is capacity(), which can't be used here since the class
+    // is incomplete
+    Data cache[RamCache ? SmallestPageSize / sizeof(Record) / 2 : 1];
+    // There is no constructor so that a global instance is zero-initialized
+    // without a runtime initializer. updateActivePage() resets the flag
+    bool cacheValid;
 };
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The heap profiler is disabled by default. Build with HEAP_PROFILER=y to enable it
+#ifndef HEAP_PROFILER_ENABLED
+#define HEAP_PROFILER_ENABLED 0
+#endif
+
+// Maximum number of tracked call sites. Allocations made by other call sites are attributed to
+// a catch-all site with a null caller address
+#ifndef HEAP_PROFILER_MAX_SITES
+#define HEAP_PROFILER_MAX_SITES 64
+#endif
+
+// Size of the header that the allocator wrappers prepend to each profiled block. The header keeps
+// the alignment of the blocks returned by the underlying allocator
+#define HEAP_PROFILER_HEADER_SIZE 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct heap_profiler_site {
+    uint16_t size; // Size of this structure
+    uint16_t reserved; // Reserved (should be set to 0)
+    uintptr_t caller; // Return address of the allocation call
+    uint32_t count; // Number of allocations
+    uint32_t bytes; // Total number of allocated bytes
+    uint32_t live_count; // Number of allocations that haven't been freed yet
+    uint32_t live_bytes; // Number of allocated bytes that haven't been freed yet
+} heap_profiler_site;
+
+typedef int(*heap_profiler_enum_sites_callback)(const heap_profiler_site* site, void* data);
+
+// The functions below are used by the allocator wrappers of the platform (see hal/src/stm32/newlib.cpp)
+
+// Records an allocation. `block` is the block returned by the underlying allocator, which should
+// be `size + HEAP_PROFILER_HEADER_SIZE` bytes long. Returns the pointer that should be returned to
+// the application, or NULL if `block` is NULL
+void* heap_profiler_alloc(void* block, size_t size, const void* caller);
+
+// Prepares a profiled block for resizing. Should be called before the block is passed to the
+// underlying allocator, since the header is invalidated so that the original memory isn't taken for
+// a profiled block if the block is moved
+void heap_profiler_realloc_begin(void* block);
+
+// Records the resizing of a profiled block. `block` is the original block, and `new_block` is the
+// block returned by the underlying allocator, which contains the header of the original allocation.
+// If `new_block` is NULL, the original block is recorded as allocated again and NULL is returned
+void* heap_profiler_realloc(void* block, void* new_block, size_t size, const void* caller);
+
+// Records the deallocation of a profiled block
+void heap_profiler_free(void* block);
+
+// Returns the underlying block of a pointer returned by heap_profiler_alloc(), or NULL if the
+// pointer doesn't belong to a profiled allocation, e.g. because it was allocated by a function that
+// bypasses the wrappers
+void* heap_profiler_block(void* ptr);
+
+// Enumerates the call sites. If the callback returns an error, the enumeration stops and the error
+// is returned to the caller. Returns SYSTEM_ERROR_NOT_SUPPORTED if the profiler is disabled
+int heap_profiler_enum_sites(heap_profiler_enum_sites_callback callback, void* data, void* reserved);
+
+// Resets the cumulative allocation counters. The live counters are kept
+void heap_profiler_reset(void* reserved);
+
+// Serializes the access to the profiler's state. The default implementations do nothing, platforms
+// override them to acquire their allocator lock. The profiler never calls other functions while
+// holding the lock, so the lock doesn't need to be recursive
+void heap_profiler_lock(void);
+void heap_profiler_unlock(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
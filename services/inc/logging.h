@@ -57,6 +57,14 @@
         extern struct Foo foo;
         LOG_DUMP(TRACE, &foo, sizeof(foo));
 
+    LOG_BINARY(level, format, ...) - generates binary log record. Unlike LOG(), this macro doesn't
+    format the message on the calling thread: the address of the format string and the raw argument
+    values are forwarded to backend logger, which may either format the message later or write the
+    record as is, so that it can be decoded on the host (see build/log_decode.py). Format strings
+    passed to this macro must be string literals.
+
+        LOG_BINARY(TRACE, "rx: %u bytes, rssi: %d", size, rssi);
+
     LOG_ENABLED(level) - checks whether specified logging level is enabled at run time.
 
         if (LOG_ENABLED(TRACE)) {
@@ -112,6 +120,21 @@
     LOG_COMPILE_TIME_LEVEL - allows to strip any logging output that is below of certain logging level
     at compile time. Default value is LOG_LEVEL_ALL meaning that no compile-time filtering is applied.
 
+    LOG_COMPILE_TIME_CATEGORY_LEVELS - overrides LOG_COMPILE_TIME_LEVEL for specific categories (C++
+    only). The level is chosen according to the current category (see LOG_SOURCE_CATEGORY() and
+    LOG_CATEGORY()), using the most specific matching entry, and applies to all logging macros used
+    in the scope of that category. Messages below the level are removed by the compiler, including
+    their format strings and argument expressions. This macro is typically defined via the
+    LOG_CATEGORY_LEVELS make variable:
+
+        LOG_CATEGORY_LEVELS = comm.protocol:WARN comm.dtls:ERROR
+
+    which expands to:
+
+        #define LOG_COMPILE_TIME_CATEGORY_LEVELS \
+                LOG_CATEGORY_LEVEL("comm.protocol", WARN) \
+                LOG_CATEGORY_LEVEL("comm.dtls", ERROR)
+
     LOG_MAX_STRING_LENGTH - specifies maximum number of characters allowed for formatted strings.
     This parameter affects log_message() and some other functions along with their wrapper macros.
 
@@ -193,6 +216,31 @@ typedef void (*log_write_callback_type)(const char *data, size_t size, int level
 // Callback invoked to check whether logging is enabled for particular level and category (used by log_enabled())
 typedef int (*log_enabled_callback_type)(int level, const char *category, void *reserved);
 
+// Flags of a binary log record
+typedef enum LogBinaryRecordFlag {
+    LOG_BINARY_RECORD_TRUNCATED = 0x01 // Some of the arguments didn't fit into the record
+} LogBinaryRecordFlag;
+
+// Binary log record generated by log_binary(). The record contains the address of the format string
+// and the raw values of the arguments, so that the message can be formatted later, possibly on the host.
+// Arguments are stored in the order of the conversion specifications in the format string:
+//   - integers and characters: 4 bytes, or 8 bytes if the argument type is 64-bit;
+//   - pointers: sizeof(void*) bytes;
+//   - floating point numbers: 8 bytes (double);
+//   - strings: null-terminated string padded to a multiple of 4 bytes.
+// Values are stored in the native byte order and are aligned at 4-byte boundaries.
+typedef struct LogBinaryRecord {
+    const char *fmt; // Format string
+    uint32_t time; // Timestamp
+    uint16_t size; // Size of the argument data
+    uint16_t flags; // Record flags (see LogBinaryRecordFlag)
+    char args[0]; // Argument data
+} LogBinaryRecord;
+
+// Callback for binary logging (used by log_binary()). `size` is the size of the entire record
+typedef void (*log_binary_callback_type)(const LogBinaryRecord *record, size_t size, int level, const char *category,
+        void *reserved);
+
 // Generates log message
 void log_message(int level, const char *category, LogAttributes *attr, void *reserved, const char *fmt, ...);
 
@@ -222,6 +270,19 @@ const char* log_level_name(int level, void *reserved);
 void log_set_callbacks(log_message_callback_type log_msg, log_write_callback_type log_write,
         log_enabled_callback_type log_enabled, void *reserved);
 
+// Generates binary log record. The arguments are copied to the record without formatting them. If binary
+// logging callback is not set, this function falls back to log_message()
+void log_binary(int level, const char *category, void *reserved, const char *fmt, ...);
+
+// Variant of the log_binary() function taking variable arguments via va_list
+void log_binary_v(int level, const char *category, void *reserved, const char *fmt, va_list args);
+
+// Formats binary log record. Returns the length of the formatted string as snprintf() does
+int log_binary_format(const LogBinaryRecord *record, size_t size, char *buf, size_t buf_size, void *reserved);
+
+// Sets binary logging callback
+void log_set_binary_callback(log_binary_callback_type callback, void *reserved);
+
 extern void HAL_Delay_Microseconds(uint32_t delay);
 
 #ifdef __cplusplus
@@ -232,6 +293,10 @@ extern void HAL_Delay_Microseconds(uint32_t delay);
 #define LOG_COMPILE_TIME_LEVEL LOG_LEVEL_ALL
 #endif
 
+#ifndef LOG_COMPILE_TIME_CATEGORY_LEVELS
+#define LOG_COMPILE_TIME_CATEGORY_LEVELS
+#endif
+
 #ifndef LOG_MAX_STRING_LENGTH
 #define LOG_MAX_STRING_LENGTH 160
 #endif
@@ -256,12 +321,49 @@ extern void HAL_Delay_Microseconds(uint32_t delay);
 
 #ifdef __cplusplus
 
+// Compile-time category levels
+struct _LogCategoryLevel {
+    const char* name;
+    int level;
+};
+
+#define LOG_CATEGORY_LEVEL(_name, _level) \
+        { _name, LOG_LEVEL_##_level },
+
+static constexpr _LogCategoryLevel _LOG_CATEGORY_LEVELS[] = {
+    LOG_COMPILE_TIME_CATEGORY_LEVELS
+    { NULL, 0 }
+};
+
+// Returns the length of a category prefix if it matches the category name, or -1 otherwise
+static constexpr int _logCategoryMatch(const char* name, const char* prefix, int i = 0) {
+    return !prefix[i] ? ((!name[i] || name[i] == '.') ? i : -1) :
+            (name[i] == prefix[i]) ? _logCategoryMatch(name, prefix, i + 1) : -1;
+}
+
+// Returns the compile-time level of a category, using the longest matching category prefix
+static constexpr int _logCompileTimeLevel(const char* name, int i = 0, int len = -1, int level = LOG_COMPILE_TIME_LEVEL) {
+    return (!name || !_LOG_CATEGORY_LEVELS[i].name) ? level :
+            (_logCategoryMatch(name, _LOG_CATEGORY_LEVELS[i].name) > len) ?
+                    _logCompileTimeLevel(name, i + 1, _logCategoryMatch(name, _LOG_CATEGORY_LEVELS[i].name), _LOG_CATEGORY_LEVELS[i].level) :
+                    _logCompileTimeLevel(name, i + 1, len, level);
+}
+
+// Ensures the compile-time level is evaluated at compile time regardless of the optimization level
+template<int level>
+struct _LogCompileTimeLevel {
+    static const int value = level;
+};
+
 // Module category
 template<typename T>
 struct _LogCategoryWrapper {
     static const char* name() {
         return LOG_MODULE_CATEGORY;
     }
+    static constexpr int compileTimeLevel() {
+        return _logCompileTimeLevel(LOG_MODULE_CATEGORY);
+    }
 };
 
 struct _LogGlobalCategory;
@@ -274,6 +376,9 @@ typedef _LogCategoryWrapper<_LogGlobalCategory> _LogCategory;
             static const char* name() { \
                 return _name; \
             } \
+            static constexpr int compileTimeLevel() { \
+                return _logCompileTimeLevel(_name); \
+            } \
         };
 
 // Scoped category
@@ -282,11 +387,17 @@ typedef _LogCategoryWrapper<_LogGlobalCategory> _LogCategory;
             static const char* name() { \
                 return _name; \
             } \
+            static constexpr int compileTimeLevel() { \
+                return _logCompileTimeLevel(_name); \
+            } \
         }
 
 // Expands to current category name
 #define LOG_THIS_CATEGORY() _LogCategory::name()
 
+// Expands to compile-time level of current category
+#define _LOG_COMPILE_TIME_LEVEL _LogCompileTimeLevel<_LogCategory::compileTimeLevel()>::value
+
 #else // !defined(__cplusplus)
 
 // weakref allows to have different implementations of the same function in different translation
@@ -310,6 +421,9 @@ static const char* const _log_category = NULL;
 #define LOG_THIS_CATEGORY() \
         (_log_category ? _log_category : (_log_source_category ? _log_source_category() : LOG_MODULE_CATEGORY))
 
+// Category levels are not supported in C code
+#define _LOG_COMPILE_TIME_LEVEL LOG_COMPILE_TIME_LEVEL
+
 #endif // !defined(__cplusplus)
 
 #if LOG_INCLUDE_SOURCE_INFO
@@ -335,7 +449,7 @@ static const char* const _log_category = NULL;
 // Primary logging macros
 #define LOG_C(_level, _category, _fmt, ...) \
         do { \
-            if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
+            if (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL) { \
                 _LOG_ATTR_INIT(_attr); \
                 log_message(LOG_LEVEL_##_level, _category, &_attr, NULL, _fmt, ##__VA_ARGS__); \
             } \
@@ -343,7 +457,7 @@ static const char* const _log_category = NULL;
 
 #define LOG_ATTR_C(_level, _category, _attrs, _fmt, ...) \
         do { \
-            if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
+            if (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL) { \
                 _LOG_ATTR_INIT(_attr); \
                 PP_FOR_EACH(_LOG_ATTR_SET, _attr, PP_ARGS(_attrs)); \
                 log_message(LOG_LEVEL_##_level, _category, &_attr, NULL, _fmt, ##__VA_ARGS__); \
@@ -352,14 +466,14 @@ static const char* const _log_category = NULL;
 
 #define LOG_WRITE_C(_level, _category, _data, _size) \
         do { \
-            if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
+            if (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL) { \
                 log_write(LOG_LEVEL_##_level, _category, _data, _size, NULL); \
             } \
         } while (0)
 
 #define LOG_PRINT_C(_level, _category, _str) \
         do { \
-            if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
+            if (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL) { \
                 const char* const _s = _str; \
                 log_write(LOG_LEVEL_##_level, _category, _s, strlen(_s), NULL); \
             } \
@@ -367,20 +481,27 @@ static const char* const _log_category = NULL;
 
 #define LOG_PRINTF_C(_level, _category, _fmt, ...) \
         do { \
-            if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
+            if (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL) { \
                 log_printf(LOG_LEVEL_##_level, _category, NULL, _fmt, ##__VA_ARGS__); \
             } \
         } while (0)
 
 #define LOG_DUMP_C(_level, _category, _data, _size) \
         do { \
-            if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
+            if (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL) { \
                 log_dump(LOG_LEVEL_##_level, _category, _data, _size, 0, NULL); \
             } \
         } while (0)
 
 #define LOG_ENABLED_C(_level, _category) \
-        (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL && log_enabled(LOG_LEVEL_##_level, _category, NULL))
+        (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL && log_enabled(LOG_LEVEL_##_level, _category, NULL))
+
+#define LOG_BINARY_C(_level, _category, _fmt, ...) \
+        do { \
+            if (LOG_LEVEL_##_level >= _LOG_COMPILE_TIME_LEVEL) { \
+                log_binary(LOG_LEVEL_##_level, _category, NULL, _fmt, ##__VA_ARGS__); \
+            } \
+        } while (0)
 
 #else // LOG_DISABLE
 
@@ -395,6 +516,7 @@ static const char* const _log_category = NULL;
 #define LOG_PRINTF_C(_level, _category, _fmt, ...)
 #define LOG_DUMP_C(_level, _category, _data, _size)
 #define LOG_ENABLED_C(_level, _category) (0)
+#define LOG_BINARY_C(_level, _category, _fmt, ...)
 
 #endif
 
@@ -422,6 +544,7 @@ static const char* const _log_category = NULL;
 #define LOG_PRINTF(_level, _fmt, ...) LOG_PRINTF_C(_level, LOG_THIS_CATEGORY(), _fmt, ##__VA_ARGS__)
 #define LOG_DUMP(_level, _data, _size) LOG_DUMP_C(_level, LOG_THIS_CATEGORY(), _data, _size)
 #define LOG_ENABLED(_level) LOG_ENABLED_C(_level, LOG_THIS_CATEGORY())
+#define LOG_BINARY(_level, _fmt, ...) LOG_BINARY_C(_level, LOG_THIS_CATEGORY(), _fmt, ##__VA_ARGS__)
 
 #define LOG_DEBUG(_level, _fmt, ...) LOG_DEBUG_C(_level, LOG_THIS_CATEGORY(), _fmt, ##__VA_ARGS__)
 #define LOG_DEBUG_ATTR(_level, _attrs, _fmt, ...) LOG_DEBUG_ATTR_C(_level, LOG_THIS_CATEGORY(), _attrs, _fmt, ##__VA_ARGS__)
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERVICES_MPSC_QUEUE_H
+#define SERVICES_MPSC_QUEUE_H
+
+#include "system_error.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+// Bounded lock-free queue supporting multiple producers and a single consumer. Elements are stored
+// in preallocated slots and are filled and consumed in place, so pushing an element never allocates
+// memory or blocks. When the queue is full, new elements are dropped and counted.
+//
+// The implementation is based on Dmitry Vyukov's bounded MPMC queue: each slot has a sequence number
+// that tells the producers and the consumer whether the slot is free or contains a complete element.
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() :
+            mask_(0),
+            head_(0),
+            tail_(0),
+            dropped_(0) {
+    }
+
+    // Allocates the queue's storage. The capacity is rounded up to a power of two. Returns 0 on
+    // success, or a negative error code otherwise. This method is not thread-safe
+    int init(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        std::unique_ptr<Slot[]> slots(new(std::nothrow) Slot[n]);
+        if (!slots) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+        slots_ = std::move(slots);
+        mask_ = n - 1;
+        head_ = 0;
+        tail_.store(0, std::memory_order_relaxed);
+        dropped_.store(0, std::memory_order_relaxed);
+        return SYSTEM_ERROR_NONE;
+    }
+
+    // Reserves a free slot and invokes `fill(T&)` to initialize the element in place. Returns
+    // `false` if the queue is full or not initialized. This method can be called concurrently
+    // from any number of threads
+    template<typename F>
+    bool push(F fill) {
+        if (!slots_) {
+            return false;
+        }
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            const size_t seq = slot->seq.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        fill(slot->value);
+        // Publish the element
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Invokes `consume(T&)` for the oldest element and frees its slot. Returns `false` if the queue
+    // is empty. Only one thread is allowed to consume elements at a time
+    template<typename F>
+    bool pop(F consume) {
+        if (!slots_) {
+            return false;
+        }
+        Slot* const slot = &slots_[head_ & mask_];
+        const size_t seq = slot->seq.load(std::memory_order_acquire);
+        if (seq != head_ + 1) {
+            return false; // The queue is empty or the next element is still being written
+        }
+        consume(slot->value);
+        slot->seq.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    size_t capacity() const {
+        return slots_ ? mask_ + 1 : 0;
+    }
+
+    // Returns the number of elements dropped since the last call to this method
+    unsigned takeDroppedCount() {
+        return dropped_.exchange(0, std::memory_order_relaxed);
+    }
+
+    // This class is non-copyable
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    size_t head_; // Accessed only by the consumer
+    std::atomic<size_t> tail_;
+    std::atomic<unsigned> dropped_;
+};
+
+} // namespace particle
+
+#endif // SERVICES_MPSC_QUEUE_H
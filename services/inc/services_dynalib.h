@@ -110,6 +110,17 @@ DYNALIB_FN(55, services, pb_encode_varint, bool(pb_ostream_t*, pb_uint64_t))
 # define BASE_IDX 40
 #endif
 
+DYNALIB_FN(BASE_IDX + 0, services, log_binary, void(int, const char*, void*, const char*, ...))
+DYNALIB_FN(BASE_IDX + 1, services, log_binary_v, void(int, const char*, void*, const char*, va_list))
+DYNALIB_FN(BASE_IDX + 2, services, log_binary_format, int(const LogBinaryRecord*, size_t, char*, size_t, void*))
+DYNALIB_FN(BASE_IDX + 3, services, log_set_binary_callback, void(log_binary_callback_type, void*))
+DYNALIB_FN(BASE_IDX + 4, services, trace_record, void(int, const char*, uint32_t, void*))
+DYNALIB_FN(BASE_IDX + 5, services, trace_enum_events, int(trace_enum_events_callback, void*, void*))
+DYNALIB_FN(BASE_IDX + 6, services, trace_dropped_events, uint32_t(void*))
+DYNALIB_FN(BASE_IDX + 7, services, trace_clear, void(void*))
+DYNALIB_FN(BASE_IDX + 8, services, diag_snapshot, int(diag_snapshot_entry*, size_t*, void*))
+DYNALIB_FN(BASE_IDX + 9, services, trace_thread_exit, void(void*, void*))
+
 DYNALIB_END(services)
 
 #endif	/* SERVICES_DYNALIB_H */
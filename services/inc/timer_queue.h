@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERVICES_TIMER_QUEUE_H
+#define SERVICES_TIMER_QUEUE_H
+
+#include "spark_wiring_vector.h"
+#include "system_tick_hal.h"
+
+#include <limits>
+
+namespace particle {
+
+class TimerQueue;
+
+// Timer managed by a TimerQueue. Timers are allocated by their owners, the queue only keeps pointers
+// to the active timers. A timer is stopped automatically when it's destroyed
+class SoftTimer {
+public:
+    typedef void (*Callback)(SoftTimer* timer, void* data);
+
+    explicit SoftTimer(Callback callback = nullptr, void* data = nullptr) :
+            callback_(callback),
+            data_(data),
+            queue_(nullptr),
+            deadline_(0),
+            period_(0),
+            slack_(0),
+            index_(0) {
+    }
+
+    ~SoftTimer();
+
+    void setCallback(Callback callback, void* data = nullptr) {
+        callback_ = callback;
+        data_ = data;
+    }
+
+    void* data() const {
+        return data_;
+    }
+
+    bool isActive() const {
+        return queue_;
+    }
+
+    system_tick_t deadline() const {
+        return deadline_;
+    }
+
+    system_tick_t period() const {
+        return period_;
+    }
+
+    // This class is non-copyable
+    SoftTimer(const SoftTimer&) = delete;
+    SoftTimer& operator=(const SoftTimer&) = delete;
+
+private:
+    Callback callback_;
+    void* data_;
+    TimerQueue* queue_;
+    system_tick_t deadline_;
+    system_tick_t period_;
+    system_tick_t slack_;
+    int index_; // Position in the queue's heap
+
+    friend class TimerQueue;
+};
+
+// Priority queue of software timers based on a binary min-heap. Starting and stopping a timer takes
+// O(log n) time, which allows the queue to manage thousands of timers cheaply.
+//
+// A timer may be started with some slack, in which case it expires anywhere between its deadline and
+// its deadline plus the slack. The queue is ordered by the latest expiration time of the timers, and
+// when the earliest of those is reached, other timers whose deadlines have passed are expired as well,
+// so that their wakeups are coalesced.
+//
+// This class is not thread-safe: the owning thread is expected to call process() or takeExpired()
+// periodically, or after waiting for nextTimeout() milliseconds, and timer callbacks are invoked in
+// that thread's context.
+class TimerQueue {
+public:
+    static const system_tick_t MAX_TIMEOUT = std::numeric_limits<system_tick_t>::max();
+
+    TimerQueue() :
+            now_(0),
+            processing_(false) {
+    }
+
+    ~TimerQueue() {
+        clear();
+    }
+
+    // Starts or restarts `timer` so that it expires at `deadline`. If `period` is not 0, the timer is
+    // restarted automatically every `period` milliseconds after it expires. Returns 0 on success,
+    // or a negative error code otherwise
+    int start(SoftTimer* timer, system_tick_t deadline, system_tick_t period = 0, system_tick_t slack = 0);
+
+    void stop(SoftTimer* timer);
+
+    // Stops all timers
+    void clear();
+
+    // Removes an expired timer from the queue, or returns nullptr if no timers have expired. Periodic
+    // timers are restarted before they are returned. This method doesn't invoke the timer callback
+    SoftTimer* takeExpired(system_tick_t now);
+
+    // Invokes the callbacks of all expired timers and returns the number of expired timers. A timer
+    // restarted from a callback never expires during the same call, even if its deadline has passed
+    int process(system_tick_t now);
+
+    // Returns the number of milliseconds after which at least one of the timers needs to be expired,
+    // or MAX_TIMEOUT if there are no active timers
+    system_tick_t nextTimeout(system_tick_t now) const;
+
+    int size() const {
+        return heap_.size();
+    }
+
+    bool isEmpty() const {
+        return heap_.isEmpty();
+    }
+
+    // This class is non-copyable
+    TimerQueue(const TimerQueue&) = delete;
+    TimerQueue& operator=(const TimerQueue&) = delete;
+
+private:
+    spark::Vector<SoftTimer*> heap_;
+    system_tick_t now_; // Time passed to the current process() call
+    bool processing_;
+
+    void remove(int index);
+    void siftUp(int index);
+    void siftDown(int index);
+
+    void place(SoftTimer* timer, int index) {
+        heap_[index] = timer;
+        timer->index_ = index;
+    }
+
+    static bool before(const SoftTimer* t1, const SoftTimer* t2) {
+        return (int32_t)((t1->deadline_ + t1->slack_) - (t2->deadline_ + t2->slack_)) < 0;
+    }
+};
+
+inline SoftTimer::~SoftTimer() {
+    if (queue_) {
+        queue_->stop(this);
+    }
+}
+
+} // namespace particle
+
+#endif // SERVICES_TIMER_QUEUE_H
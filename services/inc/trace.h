@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "preprocessor.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Tracing is disabled by default. Build with TRACE=y to enable it
+#ifndef PARTICLE_TRACE_ENABLED
+#define PARTICLE_TRACE_ENABLED 0
+#endif
+
+// Maximum number of concurrently running threads that can record events. Events recorded by other
+// threads are dropped. The buffer of a thread is reused by other threads after it exits
+#ifndef PARTICLE_TRACE_MAX_THREADS
+#define PARTICLE_TRACE_MAX_THREADS 8
+#endif
+
+// Size of the ring buffer of each thread, in events (needs to be a power of two). The buffer keeps
+// `PARTICLE_TRACE_THREAD_EVENTS - 1` most recent events of the thread
+#ifndef PARTICLE_TRACE_THREAD_EVENTS
+#define PARTICLE_TRACE_THREAD_EVENTS 64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Event types
+typedef enum trace_event_type {
+    TRACE_EVENT_BEGIN = 1, // Beginning of a duration
+    TRACE_EVENT_END = 2, // End of a duration
+    TRACE_EVENT_INSTANT = 3 // Instant event
+} trace_event_type;
+
+typedef struct trace_event {
+    uint32_t time; // Timestamp in microseconds (wraps around)
+    const char* name; // Event name. Only string literals can be used as event names
+    uint32_t data; // Event payload
+    uint8_t type; // Event type (see trace_event_type)
+    uint8_t thread; // Index of the thread that recorded the event
+} trace_event;
+
+typedef int(*trace_enum_events_callback)(const trace_event* event, void* data);
+
+// Records an event. Each thread records events into its own ring buffer, so that the recording is
+// lock-free. Events recorded in an ISR are dropped
+void trace_record(int type, const char* name, uint32_t data, void* reserved);
+
+// Enumerates the recorded events. The events of each thread are enumerated in chronological order,
+// events that are overwritten during the enumeration are skipped. If the callback returns an error,
+// the enumeration stops and the error is returned to the caller
+int trace_enum_events(trace_enum_events_callback callback, void* data, void* reserved);
+
+// Returns the number of events that were dropped since the last call to trace_clear()
+uint32_t trace_dropped_events(void* reserved);
+
+// Discards the recorded events. Events recorded concurrently with this call may be lost
+void trace_clear(void* reserved);
+
+// Releases the ring buffer of a thread that is about to exit, so that it can be reused by other
+// threads. `thread` is the thread handle (os_thread_t), or NULL for the calling thread
+void trace_thread_exit(void* thread, void* reserved);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#if PARTICLE_TRACE_ENABLED
+
+#define TRACE_BEGIN(_name) \
+        trace_record(TRACE_EVENT_BEGIN, _name, 0, NULL)
+
+#define TRACE_END(_name) \
+        trace_record(TRACE_EVENT_END, _name, 0, NULL)
+
+#define TRACE_INSTANT(_name, _data) \
+        trace_record(TRACE_EVENT_INSTANT, _name, _data, NULL)
+
+#ifdef __cplusplus
+
+// Records the duration of the enclosing scope
+#define TRACE_SCOPE(_name) \
+        const ::particle::TraceScope PP_CAT(_traceScope, __LINE__)(_name)
+
+namespace particle {
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) :
+            name_(name) {
+        trace_record(TRACE_EVENT_BEGIN, name_, 0, nullptr);
+    }
+
+    ~TraceScope() {
+        trace_record(TRACE_EVENT_END, name_, 0, nullptr);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+};
+
+} // namespace particle
+
+#endif // defined(__cplusplus)
+
+#else // !PARTICLE_TRACE_ENABLED
+
+#define TRACE_BEGIN(_name)
+#define TRACE_END(_name)
+#define TRACE_INSTANT(_name, _data)
+#define TRACE_SCOPE(_name)
+
+#endif // !PARTICLE_TRACE_ENABLED
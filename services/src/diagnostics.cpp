@@ -21,12 +21,21 @@
 
 #include "system_error.h"
 
+#if PLATFORM_THREADING
+#include "concurrent_hal.h"
+#endif
+
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace {
 
 using namespace spark;
 
+// Maximum number of attempts to read a snapshot taken by another thread
+const unsigned MAX_SNAPSHOT_READ_ATTEMPTS = 100;
+
 class Diagnostics {
 public:
     int registerSource(const diag_source* src) {
@@ -75,15 +84,69 @@ public:
         return SYSTEM_ERROR_NONE;
     }
 
+    int snapshot(diag_snapshot_entry* entries, size_t* count) {
+        if (!started_) {
+            return SYSTEM_ERROR_INVALID_STATE;
+        }
+        const size_t n = intSrcs_.size();
+        if (!entries) {
+            *count = n;
+            return SYSTEM_ERROR_NONE;
+        }
+        if (*count < n) {
+            return SYSTEM_ERROR_TOO_LARGE;
+        }
+        *count = n;
+        // The cached snapshot is protected with a sequence lock: the sequence number is odd while
+        // the snapshot is being taken. Whoever changes it from even to odd becomes the writer, and
+        // other threads copy the writer's values once it's done instead of waiting for a lock
+        const uint32_t start = seq_.load(std::memory_order_acquire);
+        for (unsigned i = 0; i < MAX_SNAPSHOT_READ_ATTEMPTS; ++i) {
+            if (i > 0) {
+                yield(); // Let the writer finish
+            }
+            uint32_t seq = seq_.load(std::memory_order_acquire);
+            if (seq & 1) {
+                continue; // Snapshot is being taken
+            }
+            if (seq == start) {
+                if (!seq_.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire)) {
+                    continue;
+                }
+                readValues(cache_.data());
+                memcpy(entries, cache_.data(), n * sizeof(diag_snapshot_entry));
+                seq_.store(seq + 2, std::memory_order_release);
+                return SYSTEM_ERROR_NONE;
+            }
+            // Another thread has taken a snapshot after this function was called
+            memcpy(entries, cache_.data(), n * sizeof(diag_snapshot_entry));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == seq) {
+                return SYSTEM_ERROR_NONE;
+            }
+        }
+        // The writer doesn't make progress, e.g. because it was preempted by this thread
+        readValues(entries);
+        return SYSTEM_ERROR_NONE;
+    }
+
     int command(int cmd, void* data) {
         switch (cmd) {
 #if PLATFORM_ID == 3
         case DIAG_SERVICE_CMD_RESET:
             srcs_.clear();
+            intSrcs_.clear();
+            cache_.clear();
             started_ = 0;
             break;
 #endif
         case DIAG_SERVICE_CMD_START:
+            if (!started_) {
+                const int ret = initSnapshot();
+                if (ret != SYSTEM_ERROR_NONE) {
+                    return ret;
+                }
+            }
             started_ = 1;
             break;
         default:
@@ -98,14 +161,70 @@ public:
     }
 
 private:
+    struct IntSource {
+        const diag_source* src;
+        const volatile int32_t* value; // Pointer to the source's value (optional)
+    };
+
     Vector<const diag_source*> srcs_;
+    Vector<IntSource> intSrcs_;
+    Vector<diag_snapshot_entry> cache_; // Last snapshot of the integer sources
+    std::atomic<uint32_t> seq_;
     volatile uint8_t started_;
 
     Diagnostics() :
+            seq_(0),
             started_(0) { // The service is stopped initially
         srcs_.reserve(32);
     }
 
+    int initSnapshot() {
+        intSrcs_.clear();
+        for (const diag_source* src: srcs_) {
+            if (src->type != DIAG_TYPE_INT) {
+                continue;
+            }
+            const volatile void* ptr = nullptr;
+            if (src->callback(src, DIAG_SOURCE_CMD_GET_VALUE_PTR, &ptr) != SYSTEM_ERROR_NONE) {
+                ptr = nullptr;
+            }
+            if (!intSrcs_.append({ src, static_cast<const volatile int32_t*>(ptr) })) {
+                return SYSTEM_ERROR_NO_MEMORY;
+            }
+        }
+        if (!cache_.resize(intSrcs_.size())) {
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        return SYSTEM_ERROR_NONE;
+    }
+
+    static void yield() {
+#if PLATFORM_THREADING
+        os_thread_yield();
+#endif
+    }
+
+    void readValues(diag_snapshot_entry* entries) const {
+        for (const IntSource& s: intSrcs_) {
+            diag_snapshot_entry& e = *entries++;
+            e.id = s.src->id;
+            e.flags = 0;
+            if (s.value) {
+                e.value = *s.value;
+                continue;
+            }
+            int32_t val = 0;
+            diag_source_get_cmd_data d = { sizeof(diag_source_get_cmd_data), 0 /* reserved */, &val, sizeof(val) };
+            const int ret = s.src->callback(s.src, DIAG_SOURCE_CMD_GET, &d);
+            if (ret == SYSTEM_ERROR_NONE) {
+                e.value = val;
+            } else {
+                e.flags = DIAG_SNAPSHOT_ENTRY_FLAG_ERROR;
+                e.value = ret;
+            }
+        }
+    }
+
     int indexForId(uint16_t id) const {
         return std::distance(srcs_.begin(), std::lower_bound(srcs_.begin(), srcs_.end(), id,
                 [](const diag_source* src, uint16_t id) {
@@ -131,3 +250,7 @@ int diag_get_source(uint16_t id, const diag_source** src, void* reserved) {
 int diag_command(int cmd, void* data, void* reserved) {
     return Diagnostics::instance()->command(cmd, data);
 }
+
+int diag_snapshot(diag_snapshot_entry* entries, size_t* count, void* reserved) {
+    return Diagnostics::instance()->snapshot(entries, count);
+}
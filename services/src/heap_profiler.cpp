@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "heap_profiler.h"
+
+#include "system_error.h"
+
+#if HEAP_PROFILER_ENABLED
+
+namespace {
+
+const size_t MAX_SITES = HEAP_PROFILER_MAX_SITES;
+// Maximum number of slots checked when looking up a call site
+const size_t MAX_PROBES = 8;
+// Index of the catch-all site
+const uint16_t OTHER_SITE = MAX_SITES;
+
+const uint32_t HEADER_MAGIC = 0x48505246; // "HPRF"
+
+static_assert(MAX_SITES > 0 && MAX_SITES < 0xffff, "Invalid number of call sites");
+
+struct Site {
+    uintptr_t caller;
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t liveCount;
+    uint32_t liveBytes;
+    bool used;
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t size;
+    uint16_t site;
+    uint16_t reserved;
+    uint32_t check;
+};
+
+static_assert(sizeof(Header) == HEAP_PROFILER_HEADER_SIZE, "Invalid header size");
+
+Site g_sites[MAX_SITES + 1];
+
+// Allows to detect pointers that were not allocated via the wrappers
+inline uint32_t headerCheck(const Header* h) {
+    return h->magic ^ h->size ^ h->site ^ (uint32_t)(uintptr_t)h;
+}
+
+uint16_t findSite(uintptr_t caller) {
+    size_t index = (caller >> 1) % MAX_SITES; // Return addresses are at least 2-byte aligned
+    for (size_t i = 0; i < MAX_PROBES && i < MAX_SITES; ++i) {
+        Site& s = g_sites[index];
+        if (!s.used) {
+            s.used = true;
+            s.caller = caller;
+            return index;
+        }
+        if (s.caller == caller) {
+            return index;
+        }
+        index = (index + 1) % MAX_SITES;
+    }
+    return OTHER_SITE;
+}
+
+void* recordAlloc(void* block, size_t size, uintptr_t caller) {
+    const auto h = static_cast<Header*>(block);
+    heap_profiler_lock();
+    const uint16_t index = findSite(caller);
+    Site& s = g_sites[index];
+    ++s.count;
+    s.bytes += size;
+    ++s.liveCount;
+    s.liveBytes += size;
+    heap_profiler_unlock();
+    h->magic = HEADER_MAGIC;
+    h->size = size;
+    h->site = index;
+    h->reserved = 0;
+    h->check = headerCheck(h);
+    return h + 1;
+}
+
+void recordFree(const Header* h) {
+    heap_profiler_lock();
+    Site& s = g_sites[h->site];
+    --s.liveCount;
+    s.liveBytes -= h->size;
+    heap_profiler_unlock();
+}
+
+} // namespace
+
+void* heap_profiler_alloc(void* block, size_t size, const void* caller) {
+    if (!block) {
+        return nullptr;
+    }
+    return recordAlloc(block, size, (uintptr_t)caller);
+}
+
+void heap_profiler_realloc_begin(void* block) {
+    const auto h = static_cast<Header*>(block);
+    recordFree(h);
+    h->magic = 0; // Invalidate the header
+}
+
+void* heap_profiler_realloc(void* block, void* new_block, size_t size, const void* caller) {
+    if (!new_block) {
+        // The original block is left intact by the allocator
+        const auto h = static_cast<Header*>(block);
+        heap_profiler_lock();
+        Site& s = g_sites[h->site];
+        ++s.liveCount;
+        s.liveBytes += h->size;
+        heap_profiler_unlock();
+        h->magic = HEADER_MAGIC;
+        return nullptr;
+    }
+    return recordAlloc(new_block, size, (uintptr_t)caller);
+}
+
+void heap_profiler_free(void* block) {
+    const auto h = static_cast<Header*>(block);
+    recordFree(h);
+    h->magic = 0; // Invalidate the header
+}
+
+void* heap_profiler_block(void* ptr) {
+    if (!ptr) {
+        return nullptr;
+    }
+    const auto h = static_cast<Header*>(ptr) - 1;
+    if (h->magic != HEADER_MAGIC || h->check != headerCheck(h) || h->site > OTHER_SITE) {
+        return nullptr;
+    }
+    return h;
+}
+
+int heap_profiler_enum_sites(heap_profiler_enum_sites_callback callback, void* data, void* reserved) {
+    for (const Site& s: g_sites) {
+        // Take a copy of the site, so that the callback is free to allocate memory
+        heap_profiler_lock();
+        const Site site = s;
+        heap_profiler_unlock();
+        if (!site.used && (&s - g_sites) != OTHER_SITE) {
+            continue;
+        }
+        heap_profiler_site d = {};
+        d.size = sizeof(d);
+        d.caller = site.caller;
+        d.count = site.count;
+        d.bytes = site.bytes;
+        d.live_count = site.liveCount;
+        d.live_bytes = site.liveBytes;
+        const int ret = callback(&d, data);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+void heap_profiler_reset(void* reserved) {
+    heap_profiler_lock();
+    for (Site& s: g_sites) {
+        s.count = 0;
+        s.bytes = 0;
+    }
+    heap_profiler_unlock();
+}
+
+__attribute__((weak)) void heap_profiler_lock(void) {
+}
+
+__attribute__((weak)) void heap_profiler_unlock(void) {
+}
+
+#else // !HEAP_PROFILER_ENABLED
+
+void* heap_profiler_alloc(void* block, size_t size, const void* caller) {
+    return nullptr;
+}
+
+void heap_profiler_realloc_begin(void* block) {
+}
+
+void* heap_profiler_realloc(void* block, void* new_block, size_t size, const void* caller) {
+    return nullptr;
+}
+
+void heap_profiler_free(void* block) {
+}
+
+void* heap_profiler_block(void* ptr) {
+    return nullptr;
+}
+
+int heap_profiler_enum_sites(heap_profiler_enum_sites_callback callback, void* data, void* reserved) {
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+void heap_profiler_reset(void* reserved) {
+}
+
+void heap_profiler_lock(void) {
+}
+
+void heap_profiler_unlock(void) {
+}
+
+#endif // !HEAP_PROFILER_ENABLED
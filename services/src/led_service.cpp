@@ -272,22 +272,26 @@ private:
     }
 };
 
-LEDService ledService;
+// Constructed on first use, as global constructors in other modules update the LED state
+LEDService& ledService() {
+    static LEDService service;
+    return service;
+}
 
 } // namespace
 
 void led_set_status_active(LEDStatusData* status, int active, void* reserved) {
-    ledService.setStatusActive(status, active);
+    ledService().setStatusActive(status, active);
 }
 
 void led_set_update_enabled(int enabled, void* reserved) {
-    ledService.setUpdateEnabled(enabled);
+    ledService().setUpdateEnabled(enabled);
 }
 
 int led_update_enabled(void* reserved) {
-    return (ledService.isUpdateEnabled() ? 1 : 0);
+    return (ledService().isUpdateEnabled() ? 1 : 0);
 }
 
 void led_update(system_tick_t ticks, LEDStatusData* status, void* reserved) {
-    ledService.update(ticks);
+    ledService().update(ticks);
 }
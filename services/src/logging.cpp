@@ -18,6 +18,7 @@
 #include "logging.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdio>
 #include "timer_hal.h"
 #include "service_debug.h"
@@ -64,9 +65,339 @@ STATIC_ASSERT_FIELD_ORDER(LogAttributes, details, end);
 
 namespace {
 
+// Maximum size of the argument data of a binary log record
+const size_t MAX_BINARY_ARGS_SIZE = LOG_MAX_STRING_LENGTH / 4 * 4;
+
+enum ArgType {
+    ARG_NONE, // No argument or invalid specification
+    ARG_INT32,
+    ARG_INT64,
+    ARG_POINTER,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_COUNT // %n
+};
+
+// Conversion specification of a format string: %[flags][width][.precision][length]conversion
+struct FormatSpec {
+    const char *start; // Position of the '%' character
+    const char *width; // Start of the width field
+    const char *prec; // Start of the precision field (including the '.' character)
+    const char *length; // Start of the length modifier
+    const char *end; // Position following the specification
+    char lengthMod; // Length modifier: 'H' for "hh", 'L' for "ll", 'D' for "L", or the modifier character
+    char conv; // Conversion character
+    bool widthArg; // Width is passed as an argument
+    bool precArg; // Precision is passed as an argument
+    ArgType type;
+};
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline size_t alignSize(size_t size) {
+    return (size + 3) & ~(size_t)3;
+}
+
+// Finds next conversion specification in a format string. Returns false if there are no more
+// specifications
+bool nextFormatSpec(const char *fmt, FormatSpec *spec) {
+    const char *p = strchr(fmt, '%');
+    if (!p) {
+        return false;
+    }
+    spec->start = p++;
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        ++p;
+    }
+    spec->width = p;
+    spec->widthArg = (*p == '*');
+    if (spec->widthArg) {
+        ++p;
+    } else {
+        while (isDigit(*p)) {
+            ++p;
+        }
+    }
+    spec->prec = p;
+    spec->precArg = false;
+    if (*p == '.') {
+        ++p;
+        spec->precArg = (*p == '*');
+        if (spec->precArg) {
+            ++p;
+        } else {
+            while (isDigit(*p)) {
+                ++p;
+            }
+        }
+    }
+    spec->length = p;
+    spec->lengthMod = 0;
+    switch (*p) {
+    case 'h':
+    case 'l':
+        spec->lengthMod = *p++;
+        if (*p == spec->lengthMod) {
+            spec->lengthMod = (*p++ == 'h') ? 'H' : 'L';
+        }
+        break;
+    case 'j':
+    case 'z':
+    case 't':
+        spec->lengthMod = *p++;
+        break;
+    case 'L':
+        spec->lengthMod = 'D';
+        ++p;
+        break;
+    default:
+        break;
+    }
+    spec->conv = *p;
+    if (*p) {
+        ++p;
+    }
+    spec->end = p;
+    switch (spec->conv) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c': {
+        size_t size = sizeof(int);
+        switch (spec->lengthMod) {
+        case 'L':
+        case 'j':
+            size = sizeof(long long);
+            break;
+        case 'l':
+            size = sizeof(long);
+            break;
+        case 'z':
+            size = sizeof(size_t);
+            break;
+        case 't':
+            size = sizeof(ptrdiff_t);
+            break;
+        default:
+            break;
+        }
+        spec->type = (size > 4) ? ARG_INT64 : ARG_INT32;
+        break;
+    }
+    case 'p':
+        spec->type = ARG_POINTER;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->type = ARG_DOUBLE;
+        break;
+    case 's':
+        spec->type = ARG_STRING;
+        break;
+    case 'n':
+        spec->type = ARG_COUNT;
+        break;
+    default: // "%%" or invalid specification
+        spec->type = ARG_NONE;
+        break;
+    }
+    return true;
+}
+
+// Helper class for log_binary_format()
+class BinaryRecordFormatter {
+public:
+    BinaryRecordFormatter(const LogBinaryRecord *record, size_t size, char *buf, size_t bufSize) :
+            args_(record->args),
+            argsSize_(std::min<size_t>(record->size, size - std::min(size, sizeof(LogBinaryRecord)))),
+            argsOffs_(0),
+            buf_(buf),
+            bufSize_(bufSize),
+            len_(0) {
+    }
+
+    int format(const char *fmt, bool truncated) {
+        FormatSpec spec;
+        while (nextFormatSpec(fmt, &spec)) {
+            append(fmt, spec.start - fmt);
+            fmt = spec.end;
+            if (spec.type == ARG_NONE) {
+                if (spec.conv == '%') {
+                    append("%", 1);
+                } else {
+                    append(spec.start, spec.end - spec.start);
+                }
+            } else if (!formatArg(spec)) {
+                // Arguments that didn't fit into the record end the message
+                truncated = true;
+                fmt = "";
+                break;
+            }
+        }
+        append(fmt, strlen(fmt));
+        if (truncated) {
+            append("~", 1);
+        }
+        if (bufSize_ > 0) {
+            buf_[std::min(len_, bufSize_ - 1)] = '\0';
+        }
+        return len_;
+    }
+
+private:
+    const char *args_;
+    size_t argsSize_;
+    size_t argsOffs_;
+    char *buf_;
+    size_t bufSize_;
+    size_t len_;
+
+    bool formatArg(const FormatSpec &spec) {
+        // Rebuild the specification substituting the width and precision arguments and normalizing
+        // the length modifier for the stored argument type
+        char s[48];
+        size_t n = spec.width - spec.start;
+        const size_t widthLen = spec.prec - spec.width;
+        const size_t precLen = spec.length - spec.prec;
+        if (n + widthLen + precLen + 16 > sizeof(s)) {
+            return false;
+        }
+        memcpy(s, spec.start, n);
+        if (spec.widthArg) {
+            int32_t width = 0;
+            if (!read(&width, sizeof(width))) {
+                return false;
+            }
+            n += snprintf(s + n, sizeof(s) - n, "%d", (int)width);
+        } else {
+            memcpy(s + n, spec.width, widthLen);
+            n += widthLen;
+        }
+        if (spec.precArg) {
+            int32_t prec = 0;
+            if (!read(&prec, sizeof(prec))) {
+                return false;
+            }
+            n += snprintf(s + n, sizeof(s) - n, ".%d", (int)prec);
+        } else {
+            memcpy(s + n, spec.prec, precLen);
+            n += precLen;
+        }
+        switch (spec.type) {
+        case ARG_INT32: {
+            if (spec.lengthMod == 'h' || spec.lengthMod == 'H') {
+                const size_t len = spec.end - spec.length - 1;
+                memcpy(s + n, spec.length, len);
+                n += len;
+            }
+            s[n++] = spec.conv;
+            s[n] = '\0';
+            int32_t val = 0;
+            if (!read(&val, sizeof(val))) {
+                return false;
+            }
+            appendFormatted(s, (int)val);
+            break;
+        }
+        case ARG_INT64: {
+            s[n++] = 'l';
+            s[n++] = 'l';
+            s[n++] = spec.conv;
+            s[n] = '\0';
+            int64_t val = 0;
+            if (!read(&val, sizeof(val))) {
+                return false;
+            }
+            appendFormatted(s, (long long)val);
+            break;
+        }
+        case ARG_POINTER: {
+            s[n++] = spec.conv;
+            s[n] = '\0';
+            uintptr_t val = 0;
+            if (!read(&val, sizeof(val))) {
+                return false;
+            }
+            appendFormatted(s, (void*)val);
+            break;
+        }
+        case ARG_DOUBLE: {
+            s[n++] = spec.conv;
+            s[n] = '\0';
+            double val = 0;
+            if (!read(&val, sizeof(val))) {
+                return false;
+            }
+            appendFormatted(s, val);
+            break;
+        }
+        case ARG_STRING: {
+            s[n++] = spec.conv;
+            s[n] = '\0';
+            const char* const str = args_ + argsOffs_;
+            const size_t maxLen = argsSize_ - argsOffs_;
+            const size_t len = strnlen(str, maxLen);
+            if (len == maxLen) {
+                return false;
+            }
+            argsOffs_ += alignSize(len + 1);
+            appendFormatted(s, str);
+            break;
+        }
+        default: // ARG_COUNT
+            break;
+        }
+        return true;
+    }
+
+    bool read(void *val, size_t size) {
+        if (argsSize_ - argsOffs_ < size) {
+            return false;
+        }
+        memcpy(val, args_ + argsOffs_, size);
+        argsOffs_ += alignSize(size);
+        return true;
+    }
+
+    template<typename T>
+    void appendFormatted(const char *fmt, T val) {
+        const bool hasSpace = (len_ < bufSize_);
+        const int n = snprintf(hasSpace ? buf_ + len_ : nullptr, hasSpace ? bufSize_ - len_ : 0, fmt, val);
+        if (n > 0) {
+            len_ += n;
+        }
+    }
+
+    void append(const char *str, size_t size) {
+        if (len_ < bufSize_) {
+            memcpy(buf_ + len_, str, std::min(size, bufSize_ - len_));
+        }
+        len_ += size;
+    }
+};
+
 volatile log_message_callback_type log_msg_callback = 0;
 volatile log_write_callback_type log_write_callback = 0;
 volatile log_enabled_callback_type log_enabled_callback = 0;
+volatile log_binary_callback_type log_binary_callback = 0;
+
+// Checks whether the backend logger accepts messages with specified level and category. This allows
+// to skip formatting of the messages that would be discarded anyway
+inline bool isLevelEnabled(int level, const char *category) {
+    const log_enabled_callback_type enabled_callback = log_enabled_callback;
+    return !enabled_callback || enabled_callback(level, category, 0);
+}
 
 } // namespace
 
@@ -82,6 +413,9 @@ void log_message_v(int level, const char *category, LogAttributes *attr, void *r
     if (!msg_callback && (!log_compat_callback || level < log_compat_level)) {
         return;
     }
+    if (msg_callback && !isLevelEnabled(level, category)) {
+        return;
+    }
     // Set default attributes
     if (!attr->has_time) {
         LOG_ATTR_SET(*attr, time, HAL_Timer_Get_Milli_Seconds());
@@ -158,6 +492,9 @@ void log_printf_v(int level, const char *category, void *reserved, const char *f
     if (!write_callback && (!log_compat_callback || level < log_compat_level)) {
         return;
     }
+    if (write_callback && !isLevelEnabled(level, category)) {
+        return;
+    }
     char buf[LOG_MAX_STRING_LENGTH];
     int n = vsnprintf(buf, sizeof(buf), fmt, args);
     if (n > (int)sizeof(buf) - 1) {
@@ -183,6 +520,9 @@ void log_dump(int level, const char *category, const void *data, size_t size, in
     if (!size || (!write_callback && (!log_compat_callback || level < log_compat_level))) {
         return;
     }
+    if (write_callback && !isLevelEnabled(level, category)) {
+        return;
+    }
     static const char hex[] = "0123456789abcdef";
     char buf[LOG_MAX_STRING_LENGTH / 2 * 2 + 1]; // Hex data is flushed in chunks
     buf[sizeof(buf) - 1] = 0; // Compatibility callback expects null-terminated strings
@@ -234,3 +574,144 @@ const char* log_level_name(int level, void *reserved) {
     const int i = std::max(0, std::min<int>(level / 10, sizeof(names) / sizeof(names[0]) - 1));
     return names[i];
 }
+
+void log_binary_v(int level, const char *category, void *reserved, const char *fmt, va_list args) {
+    const log_binary_callback_type binary_callback = log_binary_callback;
+    if (!binary_callback) {
+        LogAttributes attr;
+        attr.size = sizeof(LogAttributes);
+        attr.flags = 0;
+        log_message_v(level, category, &attr, reserved, fmt, args);
+        return;
+    }
+    if (!isLevelEnabled(level, category)) {
+        return;
+    }
+    union {
+        LogBinaryRecord record;
+        char buf[sizeof(LogBinaryRecord) + MAX_BINARY_ARGS_SIZE];
+    } r;
+    r.record.fmt = fmt;
+    r.record.time = HAL_Timer_Get_Milli_Seconds();
+    r.record.flags = 0;
+    // The argument data is written via the buffer, as the size of the `args` array is zero
+    char* const data = r.buf + offsetof(LogBinaryRecord, args);
+    size_t offs = 0;
+    FormatSpec spec;
+    while (nextFormatSpec(fmt, &spec)) {
+        fmt = spec.end;
+        if (spec.type == ARG_NONE) {
+            continue;
+        }
+        const size_t intArgsSize = (spec.widthArg ? 4 : 0) + (spec.precArg ? 4 : 0);
+        if (MAX_BINARY_ARGS_SIZE - offs < intArgsSize) {
+            r.record.flags |= LOG_BINARY_RECORD_TRUNCATED;
+            break;
+        }
+        if (spec.widthArg) {
+            const int32_t width = va_arg(args, int);
+            memcpy(data + offs, &width, 4);
+            offs += 4;
+        }
+        if (spec.precArg) {
+            const int32_t prec = va_arg(args, int);
+            memcpy(data + offs, &prec, 4);
+            offs += 4;
+        }
+        union {
+            int32_t i32;
+            int64_t i64;
+            uintptr_t ptr;
+            double dbl;
+        } val;
+        const char *str = nullptr;
+        size_t size = 0;
+        switch (spec.type) {
+        case ARG_INT32:
+        case ARG_INT64: {
+            long long v = 0;
+            switch (spec.lengthMod) {
+            case 'L':
+                v = va_arg(args, long long);
+                break;
+            case 'j':
+                v = va_arg(args, intmax_t);
+                break;
+            case 'l':
+                v = va_arg(args, long);
+                break;
+            case 'z':
+                v = va_arg(args, size_t);
+                break;
+            case 't':
+                v = va_arg(args, ptrdiff_t);
+                break;
+            default:
+                v = va_arg(args, int);
+                break;
+            }
+            if (spec.type == ARG_INT32) {
+                val.i32 = v;
+                size = sizeof(val.i32);
+            } else {
+                val.i64 = v;
+                size = sizeof(val.i64);
+            }
+            break;
+        }
+        case ARG_POINTER:
+            val.ptr = (uintptr_t)va_arg(args, void*);
+            size = sizeof(val.ptr);
+            break;
+        case ARG_DOUBLE:
+            if (spec.lengthMod == 'D') {
+                val.dbl = va_arg(args, long double);
+            } else {
+                val.dbl = va_arg(args, double);
+            }
+            size = sizeof(val.dbl);
+            break;
+        case ARG_STRING:
+            str = va_arg(args, const char*);
+            if (!str) {
+                str = "(null)";
+            }
+            size = strlen(str) + 1;
+            break;
+        default: // ARG_COUNT
+            va_arg(args, void*);
+            continue;
+        }
+        if (MAX_BINARY_ARGS_SIZE - offs < alignSize(size)) {
+            // A string argument is truncated, any other argument is dropped
+            if (str && MAX_BINARY_ARGS_SIZE - offs >= 4) {
+                size = MAX_BINARY_ARGS_SIZE - offs;
+                memcpy(data + offs, str, size - 1);
+                data[offs + size - 1] = '\0';
+                offs += size;
+            }
+            r.record.flags |= LOG_BINARY_RECORD_TRUNCATED;
+            break;
+        }
+        memcpy(data + offs, str ? (const void*)str : (const void*)&val, size);
+        offs += alignSize(size);
+    }
+    r.record.size = offs;
+    binary_callback(&r.record, sizeof(LogBinaryRecord) + offs, level, category, 0);
+}
+
+void log_binary(int level, const char *category, void *reserved, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_binary_v(level, category, reserved, fmt, args);
+    va_end(args);
+}
+
+int log_binary_format(const LogBinaryRecord *record, size_t size, char *buf, size_t buf_size, void *reserved) {
+    BinaryRecordFormatter formatter(record, size, buf, buf_size);
+    return formatter.format(record->fmt, record->flags & LOG_BINARY_RECORD_TRUNCATED);
+}
+
+void log_set_binary_callback(log_binary_callback_type callback, void *reserved) {
+    log_binary_callback = callback;
+}
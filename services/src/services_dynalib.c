@@ -29,5 +29,6 @@
 #include "system_error.h"
 #include "led_service.h"
 #include "diagnostics.h"
+#include "trace.h"
 #include "printf_export.h"
 #include "services_dynalib.h"
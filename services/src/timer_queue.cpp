@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "timer_queue.h"
+
+#include "system_error.h"
+
+const system_tick_t particle::TimerQueue::MAX_TIMEOUT;
+
+int particle::TimerQueue::start(SoftTimer* timer, system_tick_t deadline, system_tick_t period, system_tick_t slack) {
+    if (timer->queue_ && timer->queue_ != this) {
+        timer->queue_->stop(timer);
+    }
+    if (processing_ && (int32_t)(deadline - now_) <= 0) {
+        // Make sure a callback restarting its own timer can't stall the processing loop
+        deadline = now_ + 1;
+    }
+    timer->deadline_ = deadline;
+    timer->period_ = period;
+    timer->slack_ = slack;
+    if (timer->queue_) {
+        // Restore the heap property after the timer's expiration time has changed
+        siftUp(timer->index_);
+        siftDown(timer->index_);
+        return SYSTEM_ERROR_NONE;
+    }
+    if (!heap_.append(timer)) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    timer->queue_ = this;
+    timer->index_ = heap_.size() - 1;
+    siftUp(timer->index_);
+    return SYSTEM_ERROR_NONE;
+}
+
+void particle::TimerQueue::stop(SoftTimer* timer) {
+    if (timer->queue_ == this) {
+        remove(timer->index_);
+    }
+}
+
+void particle::TimerQueue::clear() {
+    for (SoftTimer* t: heap_) {
+        t->queue_ = nullptr;
+    }
+    heap_.clear();
+}
+
+particle::SoftTimer* particle::TimerQueue::takeExpired(system_tick_t now) {
+    if (heap_.isEmpty()) {
+        return nullptr;
+    }
+    SoftTimer* const t = heap_.first();
+    if ((int32_t)(now - t->deadline_) < 0) {
+        // As in the Linux kernel, the first timer whose deadline hasn't passed yet ends the batch of
+        // coalesced timers, even though some of the later timers could have expired too
+        return nullptr;
+    }
+    if (t->period_ > 0) {
+        t->deadline_ += t->period_;
+        if ((int32_t)(t->deadline_ - now) <= 0) {
+            // Skip the missed periods instead of expiring the timer several times in a row
+            t->deadline_ = now + t->period_;
+        }
+        siftDown(0);
+    } else {
+        remove(0);
+    }
+    return t;
+}
+
+int particle::TimerQueue::process(system_tick_t now) {
+    const bool processing = processing_; // process() may be called recursively from a callback
+    processing_ = true;
+    now_ = now;
+    int count = 0;
+    SoftTimer* t = nullptr;
+    while ((t = takeExpired(now))) {
+        if (t->callback_) {
+            t->callback_(t, t->data_);
+        }
+        ++count;
+    }
+    processing_ = processing;
+    return count;
+}
+
+system_tick_t particle::TimerQueue::nextTimeout(system_tick_t now) const {
+    if (heap_.isEmpty()) {
+        return MAX_TIMEOUT;
+    }
+    const SoftTimer* const t = heap_.first();
+    const int32_t dt = (t->deadline_ + t->slack_) - now;
+    return (dt > 0) ? dt : 0;
+}
+
+void particle::TimerQueue::remove(int index) {
+    SoftTimer* const t = heap_[index];
+    t->queue_ = nullptr;
+    SoftTimer* const last = heap_.takeLast();
+    if (index < heap_.size()) {
+        place(last, index);
+        siftUp(index);
+        siftDown(last->index_);
+    }
+}
+
+void particle::TimerQueue::siftUp(int index) {
+    SoftTimer* const t = heap_[index];
+    while (index > 0) {
+        const int parent = (index - 1) / 2;
+        if (!before(t, heap_[parent])) {
+            break;
+        }
+        place(heap_[parent], index);
+        index = parent;
+    }
+    place(t, index);
+}
+
+void particle::TimerQueue::siftDown(int index) {
+    SoftTimer* const t = heap_[index];
+    const int size = heap_.size();
+    for (;;) {
+        int child = index * 2 + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && before(heap_[child + 1], heap_[child])) {
+            ++child;
+        }
+        if (!before(heap_[child], t)) {
+            break;
+        }
+        place(heap_[child], index);
+        index = child;
+    }
+    place(t, index);
+}
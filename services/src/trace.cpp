@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#if PARTICLE_TRACE_ENABLED
+
+#include "timer_hal.h"
+#define INTERRUPTS_HAL_EXCLUDE_PLATFORM_HEADERS
+#include "interrupts_hal.h"
+#if PLATFORM_THREADING
+#include "concurrent_hal.h"
+#endif
+
+#include <atomic>
+
+namespace {
+
+const size_t THREAD_EVENTS = PARTICLE_TRACE_THREAD_EVENTS;
+const size_t MAX_THREADS = PARTICLE_TRACE_MAX_THREADS;
+
+static_assert(MAX_THREADS > 0 && MAX_THREADS <= 255, "Invalid number of threads");
+static_assert(THREAD_EVENTS > 0 && (THREAD_EVENTS & (THREAD_EVENTS - 1)) == 0, "Number of events should be a power of two");
+
+// Ring buffer written by a single thread
+struct Ring {
+    trace_event events[THREAD_EVENTS];
+    std::atomic<uint32_t> head; // Total number of recorded events
+#if PLATFORM_THREADING
+    std::atomic<os_thread_t> thread; // Owner thread, or OS_THREAD_INVALID_HANDLE if the ring is free
+#endif
+};
+
+Ring g_rings[MAX_THREADS];
+std::atomic<uint32_t> g_dropped(0);
+
+#if PLATFORM_THREADING
+
+// Releases the rings owned by a thread. The recorded events are kept until they are overwritten by
+// the next owner of the ring
+void releaseRings(os_thread_t thread) {
+    for (Ring& r: g_rings) {
+        os_thread_t owner = thread;
+        r.thread.compare_exchange_strong(owner, OS_THREAD_INVALID_HANDLE, std::memory_order_release);
+    }
+}
+
+#if PLATFORM_ID == 3
+
+// The virtual device runs on pthreads, which release the ring of a thread when it exits. FreeRTOS
+// has no thread-local storage, so os_thread_exit() releases the ring there
+struct RingOwner {
+    os_thread_t thread = OS_THREAD_INVALID_HANDLE;
+
+    ~RingOwner() {
+        if (thread) {
+            releaseRings(thread);
+        }
+    }
+};
+
+thread_local RingOwner g_owner;
+
+#endif // PLATFORM_ID == 3
+
+#endif // PLATFORM_THREADING
+
+Ring* currentRing() {
+#if PLATFORM_THREADING
+    const os_thread_t thread = os_thread_current(nullptr);
+    for (Ring& r: g_rings) {
+        if (r.thread.load(std::memory_order_acquire) == thread) {
+            return &r;
+        }
+    }
+    // Claim a free ring for the calling thread
+    for (Ring& r: g_rings) {
+        os_thread_t owner = OS_THREAD_INVALID_HANDLE;
+        if (r.thread.compare_exchange_strong(owner, thread, std::memory_order_acquire)) {
+#if PLATFORM_ID == 3
+            g_owner.thread = thread;
+#endif
+            return &r;
+        }
+    }
+    return nullptr;
+#else
+    return &g_rings[0];
+#endif
+}
+
+} // namespace
+
+void trace_record(int type, const char* name, uint32_t data, void* reserved) {
+    if (HAL_IsISR()) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Ring* const r = currentRing();
+    if (!r) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const uint32_t head = r->head.load(std::memory_order_relaxed);
+    trace_event& e = r->events[head % THREAD_EVENTS];
+    e.time = HAL_Timer_Get_Micro_Seconds();
+    e.name = name;
+    e.data = data;
+    e.type = type;
+    e.thread = r - g_rings;
+    // Make sure a concurrent reader doesn't see the updated position before the event
+    r->head.store(head + 1, std::memory_order_release);
+}
+
+int trace_enum_events(trace_enum_events_callback callback, void* data, void* reserved) {
+    for (Ring& r: g_rings) {
+        // The oldest entry can't be read safely, since it's the one that is written next
+        const uint32_t head = r.head.load(std::memory_order_acquire);
+        for (uint32_t i = (head >= THREAD_EVENTS) ? head - THREAD_EVENTS + 1 : 0; i < head; ++i) {
+            const trace_event e = r.events[i % THREAD_EVENTS];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (r.head.load(std::memory_order_relaxed) - i >= THREAD_EVENTS) {
+                continue; // The event has been overwritten while it was being copied
+            }
+            const int ret = callback(&e, data);
+            if (ret != 0) {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+uint32_t trace_dropped_events(void* reserved) {
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+void trace_clear(void* reserved) {
+    for (Ring& r: g_rings) {
+        r.head.store(0, std::memory_order_relaxed);
+    }
+    g_dropped.store(0, std::memory_order_relaxed);
+}
+
+void trace_thread_exit(void* thread, void* reserved) {
+#if PLATFORM_THREADING
+    releaseRings(thread ? static_cast<os_thread_t>(thread) : os_thread_current(nullptr));
+#endif
+}
+
+#else // !PARTICLE_TRACE_ENABLED
+
+void trace_record(int type, const char* name, uint32_t data, void* reserved) {
+}
+
+int trace_enum_events(trace_enum_events_callback callback, void* data, void* reserved) {
+    return 0;
+}
+
+uint32_t trace_dropped_events(void* reserved) {
+    return 0;
+}
+
+void trace_clear(void* reserved) {
+}
+
+void trace_thread_exit(void* thread, void* reserved) {
+}
+
+#endif // !PARTICLE_TRACE_ENABLED
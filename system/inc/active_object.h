@@ -30,6 +30,7 @@
 
 #include "channel.h"
 #include "concurrent_hal.h"
+#include "timer_hal.h"
 
 /**
  * Configuratino data for an active object.
@@ -41,6 +42,11 @@ struct ActiveObjectConfiguration
      */
     typedef std::function<void(void)> background_task_t;
 
+    /**
+     * Function to call with the time a message spent in the queue, in milliseconds.
+     */
+    typedef void(*queue_wait_t)(system_tick_t);
+
     /**
      * The function to run when there is nothing else to do.
      */
@@ -63,11 +69,16 @@ struct ActiveObjectConfiguration
      */
     uint16_t queue_size;
 
+    /**
+     * Optional function to call when a message is taken from the queue.
+     */
+    queue_wait_t queue_wait;
+
 public:
     ActiveObjectConfiguration(background_task_t task, unsigned take_wait_, unsigned put_wait_,
     			uint16_t queue_size_,
-            size_t stack_size_ =0) : background_task(task), stack_size(stack_size_),
-            take_wait(take_wait_), put_wait(put_wait_), queue_size(queue_size_) {}
+            size_t stack_size_ =0, queue_wait_t queue_wait_ =nullptr) : background_task(task), stack_size(stack_size_),
+            take_wait(take_wait_), put_wait(put_wait_), queue_size(queue_size_), queue_wait(queue_wait_) {}
 
 };
 
@@ -76,11 +87,17 @@ public:
  */
 class Message
 {
+    /**
+     * The time when this message was created, which is right before it is put into the queue.
+     */
+    system_tick_t created;
 
 public:
-    Message() {}
+    Message() : created(HAL_Timer_Get_Milli_Seconds()) {}
     virtual void operator()()=0;
     virtual ~Message() {}
+
+    system_tick_t created_time() const { return created; }
 };
 
 /**
@@ -249,6 +266,11 @@ protected:
 
     std::thread::id _thread_id;
 
+    /**
+     * HAL handle of the thread that runs this active object.
+     */
+    os_thread_t _os_thread;
+
     std::mutex _start;
 
     volatile bool started;
@@ -281,7 +303,7 @@ protected:
 
 public:
 
-    ActiveObjectBase(const ActiveObjectConfiguration& config) : configuration(config), started(false) {}
+    ActiveObjectBase(const ActiveObjectConfiguration& config) : configuration(config), _os_thread(OS_THREAD_INVALID_HANDLE), started(false) {}
 
     bool process();
 
@@ -291,12 +313,17 @@ public:
 
     void setCurrentThread() {
         _thread_id = std::this_thread::get_id();
+        _os_thread = os_thread_current(nullptr);
     }
 
     bool isStarted() {
         return started;
     }
 
+    os_thread_t threadHandle() const {
+        return _os_thread;
+    }
+
     template<typename R> void invoke_async(const std::function<R(void)>& work)
     {
         auto task = new AsyncTask<R>(work);
@@ -51,6 +51,9 @@ typedef enum ctrl_request_type {
     CTRL_REQUEST_START_LISTENING = 70,
     CTRL_REQUEST_STOP_LISTENING = 71,
     CTRL_REQUEST_LOG_CONFIG = 80,
+    CTRL_REQUEST_GET_RETAINED_LOG = 81,
+    CTRL_REQUEST_GET_TRACE_EVENTS = 82,
+    CTRL_REQUEST_GET_HEAP_PROFILE = 83,
     CTRL_REQUEST_MODULE_INFO = 90,
     CTRL_REQUEST_DIAGNOSTIC_INFO = 100,
     CTRL_REQUEST_WIFI_SET_ANTENNA = 110,
@@ -70,10 +70,16 @@ extern volatile system_tick_t spark_loop_total_millis;
 
 void system_delay_ms(unsigned long ms, bool no_background_loop);
 
+/**
+ * Maximum backoff period between connection attempts, in milliseconds.
+ */
+const unsigned MAX_BACKOFF_PERIOD = 128000;
+
 /**
  * Determines the backoff period after a number of failed connections.
+ * @param base_period The period after the first failed connections, in milliseconds.
  */
-unsigned backoff_period(unsigned connection_attempts);
+unsigned backoff_period(unsigned connection_attempts, unsigned base_period);
 
 /**
  * This is for internal testing. Do not call this function since it is not
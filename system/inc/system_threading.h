@@ -30,7 +30,8 @@ extern ISRTaskQueue SystemISRTaskQueue;
 #include <mutex>
 #include <future>
 
-#ifndef PARTICLE_GTHREAD_INCLUDED
+// The virtual device uses the host's native gthreads implementation
+#if !defined(PARTICLE_GTHREAD_INCLUDED) && PLATFORM_ID != 3
 #error "GTHREAD header not included. This is required for correct mutex implementation on embedded platforms."
 #endif
 
@@ -145,12 +145,30 @@ void system_pending_shutdown();
 int system_set_flag(system_flag_t flag, uint8_t value, void* reserved);
 int system_get_flag(system_flag_t flag, uint8_t* value,void* reserved);
 
+/**
+ * Flags for system_format_diag_data().
+ */
+typedef enum system_format_diag_flag {
+    SYSTEM_FORMAT_DIAG_FLAG_BINARY = 0x01, // Binary format (JSON is used by default)
+    SYSTEM_FORMAT_DIAG_FLAG_DELTA = 0x02, // Incremental binary format (see system_diag_snapshot.h)
+    SYSTEM_FORMAT_DIAG_FLAG_FULL = 0x04, // Forces a full snapshot in the incremental format
+    SYSTEM_FORMAT_DIAG_FLAG_HISTOGRAMS = 0x08, // Includes histograms in the binary format
+    SYSTEM_FORMAT_DIAG_FLAG_COMMIT = 0x10, // Marks the last incremental report as sent (nothing is formatted)
+    SYSTEM_FORMAT_DIAG_FLAG_RESET = 0x20 // Discards the values of the previous incremental reports (nothing is formatted)
+} system_format_diag_flag;
+
 /**
  * Formats the diagnostic data using an appender function.
  *
+ * In the incremental format, only the data sources that changed since the last successfully
+ * sent report are included. Once a report has been sent, the caller needs to call this function
+ * with the `SYSTEM_FORMAT_DIAG_FLAG_COMMIT` flag, and with the `SYSTEM_FORMAT_DIAG_FLAG_RESET` flag
+ * when the receiver may have lost the previous reports. This format needs to be used by a single
+ * consumer and only from the system thread.
+ *
  * @param id Array of data source IDs. This argument can be set to NULL to format all registered data sources.
  * @param count Number of data source IDs in the array.
- * @param flags Formatting flags.
+ * @param flags Formatting flags (see `system_format_diag_flag`).
  * @param append Appender function.
  * @param append_data Opaque data passed to the appender function.
  * @param reserved Reserved argument (should be set to NULL).
@@ -21,6 +21,7 @@
 
 #include "spark_wiring_interrupts.h"
 #include "debug.h"
+#include "trace.h"
 
 #if PLATFORM_THREADING
 
@@ -44,6 +45,7 @@ void ActiveObjectBase::run()
     /* XXX: We shouldn't constantly hold a mutex. This breaks priority inhertiance mechanisms in FreeRTOS. */
     /* It's not even used anywhere */
     // std::lock_guard<std::mutex> lck (_start);
+    _os_thread = os_thread_current(nullptr);
     started = true;
 
     uint32_t last_background_run = 0;
@@ -68,7 +70,12 @@ bool ActiveObjectBase::process()
     Item item = nullptr;
     if (take(item) && item)
     {
+        TRACE_SCOPE("ActiveObjectBase::process");
         Message& msg = *item;
+        if (configuration.queue_wait)
+        {
+            configuration.queue_wait(HAL_Timer_Get_Milli_Seconds() - msg.created_time());
+        }
         msg();
         result = true;
     }
@@ -23,6 +23,9 @@
 #include "system_update.h"
 #include "spark_wiring_system.h"
 #include "appender.h"
+#include "timer_hal.h"
+#include "trace.h"
+#include "heap_profiler.h"
 #include "debug.h"
 
 #include "control/network.h"
@@ -141,6 +144,59 @@ void particle::SystemControl::processRequest(ctrl_request* req, ControlRequestCh
         }
         break;
     }
+    case CTRL_REQUEST_GET_TRACE_EVENTS: {
+        // The reply data starts with the current time in microseconds and the number of dropped
+        // events, followed by the recorded events. Each event is encoded as the time, the payload,
+        // the event type, the thread index, the length of the event name and the name itself.
+        // All integers are little endian
+        struct Formatter {
+            static int callback(Appender* appender, void* data) {
+                const uint32_t header[] = { HAL_Timer_Get_Micro_Seconds(), trace_dropped_events(nullptr) };
+                appender->append((const uint8_t*)header, sizeof(header));
+                return trace_enum_events(formatEvent, appender, nullptr);
+            }
+
+            static int formatEvent(const trace_event* event, void* data) {
+                const auto appender = static_cast<Appender*>(data);
+                const size_t nameLen = std::min(strlen(event->name), (size_t)255);
+                const uint32_t fields[] = { event->time, event->data };
+                const uint8_t attrs[] = { event->type, event->thread, (uint8_t)nameLen };
+                appender->append((const uint8_t*)fields, sizeof(fields));
+                appender->append(attrs, sizeof(attrs));
+                appender->append((const uint8_t*)event->name, nameLen);
+                return 0;
+            }
+        };
+        const int ret = formatReplyData(req, Formatter::callback);
+        setResult(req, ret);
+        break;
+    }
+    case CTRL_REQUEST_GET_HEAP_PROFILE: {
+        // The reply data contains the allocation statistics of each call site, encoded as the
+        // caller address, the number of allocations, the number of allocated bytes, the number of
+        // live allocations and the number of live bytes. All integers are 32-bit little endian.
+        // If the first byte of the request data is non-zero, the cumulative counters are reset
+        // after formatting the reply
+        struct Formatter {
+            static int callback(Appender* appender, void* data) {
+                return heap_profiler_enum_sites(formatSite, appender, nullptr);
+            }
+
+            static int formatSite(const heap_profiler_site* site, void* data) {
+                const auto appender = static_cast<Appender*>(data);
+                const uint32_t fields[] = { (uint32_t)site->caller, site->count, site->bytes, site->live_count,
+                        site->live_bytes };
+                appender->append((const uint8_t*)fields, sizeof(fields));
+                return 0;
+            }
+        };
+        const int ret = formatReplyData(req, Formatter::callback);
+        if (ret == 0 && req->request_size > 0 && req->request_data[0] != 0) {
+            heap_profiler_reset(nullptr);
+        }
+        setResult(req, ret);
+        break;
+    }
 #if Wiring_WiFi == 1
     /* wifi requests */
     case CTRL_REQUEST_WIFI_GET_ANTENNA: {
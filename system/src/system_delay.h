@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+#include "timer_hal.h"
+#include "delay_hal.h"
+#include "core_hal.h"
+
+namespace particle {
+
+namespace system {
+
+// Maximum time the delay engine sleeps without notifying the watchdog
+const system_tick_t DELAY_MAX_SLEEP_MILLIS = 100;
+
+// Remaining time (in microseconds) above which the delay is considered to be already overdue
+const system_tick_t DELAY_OVERDUE_MICROS = 100000;
+
+/**
+ * Blocks the calling thread for `ms` milliseconds, periodically invoking `process` to run
+ * background work.
+ *
+ * Instead of waking up every millisecond, the engine computes the deadline of the next background
+ * iteration and sleeps until that deadline or the end of the delay, whichever comes first. The
+ * last millisecond of the delay is resolved using the microsecond timer.
+ *
+ * The `process` callable is invoked with no arguments and should return `true` if more background
+ * work is pending and should be processed without waiting for the next `interval`.
+ *
+ * @param ms Delay duration in milliseconds.
+ * @param interval Interval between background iterations in milliseconds.
+ * @param pending `true` if background work is already overdue.
+ * @param process Background processing callable. Not invoked if `interval` is 0.
+ */
+template<typename ProcessFn>
+inline void delay_pump(system_tick_t ms, system_tick_t interval, bool pending, ProcessFn process) {
+    if (ms == 0) {
+        return;
+    }
+    const system_tick_t startMillis = HAL_Timer_Get_Milli_Seconds();
+    // This value may overflow, which is fine since all comparisons are done on differences
+    const system_tick_t endMicros = HAL_Timer_Get_Micro_Seconds() + ms * 1000;
+    system_tick_t nextProcess = pending ? 0 : interval; // Relative to startMillis
+    for (;;) {
+        HAL_Notify_WDT();
+        const system_tick_t elapsed = HAL_Timer_Get_Milli_Seconds() - startMillis;
+        if (elapsed >= ms - 1) {
+            // On the last millisecond, resolve using the microsecond timer since we don't know
+            // how far in that millisecond we have come
+            const system_tick_t remaining = endMicros - HAL_Timer_Get_Micro_Seconds();
+            if (remaining > 0 && remaining < DELAY_OVERDUE_MICROS) {
+                HAL_Delay_Microseconds(remaining);
+            }
+            return;
+        }
+        if (interval > 0 && elapsed >= nextProcess) {
+            if (process()) {
+                nextProcess = elapsed + 1;
+            } else {
+                // Keep background iterations aligned to the interval unless we've fallen behind
+                nextProcess += interval;
+                if (nextProcess <= elapsed) {
+                    nextProcess = elapsed + interval;
+                }
+            }
+            continue;
+        }
+        system_tick_t wakeup = ms - 1;
+        if (interval > 0 && nextProcess < wakeup) {
+            wakeup = nextProcess;
+        }
+        system_tick_t sleep = wakeup - elapsed;
+        if (sleep > DELAY_MAX_SLEEP_MILLIS) {
+            sleep = DELAY_MAX_SLEEP_MILLIS;
+        }
+        HAL_Delay_Milliseconds(sleep);
+    }
+}
+
+} // namespace system
+
+} // namespace particle
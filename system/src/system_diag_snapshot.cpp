@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system_diag_snapshot.h"
+
+namespace {
+
+enum EntryFlag {
+    VALID = 0x01, // Entry contains a reported value
+    PENDING = 0x02, // Value of the source was encoded in the current report
+    SEEN = 0x04 // Source was encoded in the current report
+};
+
+inline size_t encodeVarint(char* buf, uint32_t val) {
+    size_t n = 0;
+    while (val >= 0x80) {
+        buf[n++] = (val & 0x7f) | 0x80;
+        val >>= 7;
+    }
+    buf[n++] = val;
+    return n;
+}
+
+inline uint32_t zigzag(int32_t val) {
+    return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+}
+
+} // namespace
+
+const size_t particle::DiagnosticsSnapshot::MAX_SOURCES;
+const unsigned particle::DiagnosticsSnapshot::FULL_SNAPSHOT_INTERVAL;
+const size_t particle::DiagnosticsSnapshot::HEADER_SIZE;
+const size_t particle::DiagnosticsSnapshot::MAX_ENTRY_SIZE;
+
+particle::DiagnosticsSnapshot::DiagnosticsSnapshot() :
+        entries_(),
+        count_(0),
+        next_(0),
+        reports_(0),
+        seq_(0),
+        full_(false) {
+}
+
+particle::DiagnosticsSnapshot::ReportType particle::DiagnosticsSnapshot::begin(char* buf, bool full) {
+    full_ = (full || count_ == 0 || reports_ >= FULL_SNAPSHOT_INTERVAL);
+    for (size_t i = 0; i < count_; ++i) {
+        entries_[i].flags &= ~(PENDING | SEEN);
+    }
+    next_ = 0;
+    const ReportType type = full_ ? FULL_SNAPSHOT : DELTA;
+    buf[0] = 0;
+    buf[1] = 0;
+    buf[2] = type;
+    buf[3] = seq_;
+    return type;
+}
+
+size_t particle::DiagnosticsSnapshot::encodeValue(uint16_t id, int32_t value, char* buf) {
+    Entry* const e = entry(id);
+    if (!e) {
+        // The value can't be stored, so it's reported as is
+        return encodeEntry(buf, id, VALUE_ENTRY, value);
+    }
+    e->pending = value;
+    e->flags |= PENDING | SEEN;
+    if (full_ || !(e->flags & VALID)) {
+        return encodeEntry(buf, id, VALUE_ENTRY, value);
+    }
+    if (value == e->value) {
+        return 0;
+    }
+    return encodeEntry(buf, id, DELTA_ENTRY, (int32_t)((uint32_t)value - (uint32_t)e->value));
+}
+
+size_t particle::DiagnosticsSnapshot::encodeError(uint16_t id, int error, char* buf) {
+    Entry* const e = entry(id);
+    if (e) {
+        e->flags |= SEEN;
+        e->flags &= ~VALID; // The next value will be reported as is
+    }
+    return encodeEntry(buf, id, ERROR_ENTRY, error);
+}
+
+void particle::DiagnosticsSnapshot::commit() {
+    size_t n = 0;
+    for (size_t i = 0; i < count_; ++i) {
+        Entry& e = entries_[i];
+        if (full_ && !(e.flags & SEEN)) {
+            continue; // The source is no longer registered
+        }
+        if (e.flags & PENDING) {
+            e.value = e.pending;
+            e.flags |= VALID;
+        }
+        entries_[n++] = e;
+    }
+    count_ = n;
+    reports_ = full_ ? 1 : reports_ + 1;
+    ++seq_;
+}
+
+void particle::DiagnosticsSnapshot::reset() {
+    count_ = 0;
+    next_ = 0;
+    reports_ = 0;
+}
+
+particle::DiagnosticsSnapshot::Entry* particle::DiagnosticsSnapshot::entry(uint16_t id) {
+    // Sources are normally enumerated in the same order
+    for (size_t i = 0; i < count_; ++i) {
+        const size_t index = (next_ + i) % count_;
+        if (entries_[index].id == id) {
+            next_ = index + 1;
+            return &entries_[index];
+        }
+    }
+    if (count_ == MAX_SOURCES) {
+        return nullptr;
+    }
+    Entry& e = entries_[count_++];
+    e.id = id;
+    e.value = 0;
+    e.flags = 0;
+    next_ = count_;
+    return &e;
+}
+
+size_t particle::DiagnosticsSnapshot::encodeEntry(char* buf, uint16_t id, EntryType type, int32_t value) {
+    size_t n = encodeVarint(buf, ((uint32_t)id << 2) | type);
+    n += encodeVarint(buf + n, zigzag(value));
+    return n;
+}
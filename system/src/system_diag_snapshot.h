@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Keeps the last reported values of the diagnostic data sources and encodes incremental reports.
+ *
+ * A report starts with the following header:
+ *
+ * | Size | Description                                                                       |
+ * | ---- | --------------------------------------------------------------------------------- |
+ * | 2    | Always 0, distinguishes the report from a report in the non-incremental format   |
+ * | 1    | Report type: 1 - full snapshot, 2 - changes since the previous report             |
+ * | 1    | Sequence number of the report                                                     |
+ *
+ * The header is followed by a sequence of entries. Each entry consists of a varint-encoded key,
+ * `(source ID << 2) | entry type`, and a zigzag varint-encoded value:
+ *
+ * - 0: difference between the current and the previously reported value of the source.
+ * - 1: current value of the source.
+ * - 2: error code returned by the source.
+ *
+ * Sources that haven't changed since the previous report are omitted from incremental reports.
+ * A receiver that misses a report (i.e. sees a gap in the sequence numbers) needs to wait for
+ * the next full snapshot, which is generated every `FULL_SNAPSHOT_INTERVAL` reports.
+ *
+ * This class is not thread-safe.
+ */
+class DiagnosticsSnapshot {
+public:
+    enum ReportType {
+        FULL_SNAPSHOT = 1,
+        DELTA = 2
+    };
+
+    enum EntryType {
+        DELTA_ENTRY = 0,
+        VALUE_ENTRY = 1,
+        ERROR_ENTRY = 2
+    };
+
+    static const size_t MAX_SOURCES = 48;
+    static const unsigned FULL_SNAPSHOT_INTERVAL = 10;
+    static const size_t HEADER_SIZE = 4;
+    static const size_t MAX_ENTRY_SIZE = 8; // 3-byte key and 5-byte value
+
+    DiagnosticsSnapshot();
+
+    /**
+     * Starts a new report and encodes its header. The header is `HEADER_SIZE` bytes long.
+     *
+     * @param buf Output buffer.
+     * @param full Set to `true` to force a full snapshot.
+     * @return Report type.
+     */
+    ReportType begin(char* buf, bool full = false);
+    /**
+     * Encodes the value of a source. Returns the size of the encoded entry, or 0 if the entry
+     * can be omitted.
+     */
+    size_t encodeValue(uint16_t id, int32_t value, char* buf);
+    /**
+     * Encodes an error returned by a source.
+     */
+    size_t encodeError(uint16_t id, int error, char* buf);
+    /**
+     * Stores the values encoded in the current report. This method needs to be called only if
+     * the report was successfully sent.
+     */
+    void commit();
+    /**
+     * Discards all stored values, so that the next report is a full snapshot.
+     */
+    void reset();
+
+private:
+    struct Entry {
+        int32_t value; // Last reported value
+        int32_t pending; // Value encoded in the current report
+        uint16_t id;
+        uint8_t flags;
+    };
+
+    Entry entries_[MAX_SOURCES];
+    size_t count_;
+    size_t next_; // Index of the entry that is likely to be looked up next
+    unsigned reports_; // Number of reports since the last full snapshot
+    uint8_t seq_;
+    bool full_;
+
+    Entry* entry(uint16_t id);
+
+    static size_t encodeEntry(char* buf, uint16_t id, EntryType type, int32_t value);
+};
+
+} // namespace particle
@@ -39,6 +39,7 @@
 #include "cellular_hal.h"
 #include "system_power.h"
 #include "simple_pool_allocator.h"
+#include "system_delay.h"
 
 #include "spark_wiring_network.h"
 #include "spark_wiring_constants.h"
@@ -46,10 +47,15 @@
 #include "system_threading.h"
 #include "spark_wiring_interrupts.h"
 #include "spark_wiring_led.h"
+#include "spark_wiring_diagnostics.h"
+#include "trace.h"
+
+#include <algorithm>
 
 using spark::Network;
 using particle::LEDStatus;
 using particle::CloudDiagnostics;
+using particle::AbstractIntegerDiagnosticData;
 
 volatile system_tick_t spark_loop_total_millis = 0;
 
@@ -109,6 +115,7 @@ void manage_serial_flasher()
  */
 void manage_network_connection()
 {
+    TRACE_SCOPE("manage_network_connection");
     if (SPARK_WLAN_RESET || SPARK_WLAN_SLEEP || WLAN_WD_TO())
     {
         if (SPARK_WLAN_STARTED)
@@ -225,9 +232,28 @@ void cloud_connection_failed()
     cloud_backoff_start = HAL_Timer_Get_Milli_Seconds();
 }
 
+/**
+ * Returns the base period of the cloud reconnection backoff. On a slow link, a connection attempt
+ * made too soon after a failure is likely to fail as well, so the period is scaled to the CoAP ACK
+ * timeout once the round trip time has been estimated. backoff_period() still caps the later steps at
+ * MAX_BACKOFF_PERIOD.
+ */
+static unsigned cloud_backoff_base_period()
+{
+    const unsigned MIN_PERIOD = 1000;
+    const unsigned MAX_PERIOD = 8000;
+    AbstractIntegerDiagnosticData::IntType srtt = 0, ackTimeout = 0;
+    if (AbstractIntegerDiagnosticData::get(DIAG_ID_CLOUD_SMOOTHED_ROUND_TRIP_TIME, srtt) != 0 || srtt <= 0 ||
+            AbstractIntegerDiagnosticData::get(DIAG_ID_CLOUD_ACK_TIMEOUT, ackTimeout) != 0) {
+        return MIN_PERIOD;
+    }
+    return std::min(MAX_PERIOD, std::max(MIN_PERIOD, (unsigned)ackTimeout));
+}
+
 inline uint8_t in_cloud_backoff_period()
 {
-    return (HAL_Timer_Get_Milli_Seconds()-cloud_backoff_start)<backoff_period(cloud_failed_connection_attempts);
+    return (HAL_Timer_Get_Milli_Seconds()-cloud_backoff_start)<backoff_period(cloud_failed_connection_attempts,
+            cloud_backoff_base_period());
 }
 
 void handle_cloud_errors()
@@ -416,6 +442,7 @@ void handle_cloud_connection(bool force_events)
 
 void manage_cloud_connection(bool force_events)
 {
+    TRACE_SCOPE("manage_cloud_connection");
     if (spark_cloud_flag_auto_connect() == 0)
     {
         cloud_disconnect_graceful(true, CLOUD_DISCONNECT_REASON_USER);
@@ -440,6 +467,7 @@ extern void system_handle_button_clicks(bool isIsr);
 
 void Spark_Idle_Events(bool force_events/*=false*/)
 {
+    TRACE_SCOPE("Spark_Idle_Events");
     HAL_Notify_WDT();
 
     ON_EVENT_DELTA();
@@ -476,56 +504,21 @@ void system_delay_pump(unsigned long ms, bool force_no_background_loop=false)
 {
     if (ms==0) return;
 
-    system_tick_t spark_loop_elapsed_millis = SPARK_LOOP_DELAY_MILLIS;
     spark_loop_total_millis += ms;
 
-    system_tick_t start_millis = HAL_Timer_Get_Milli_Seconds();
-    system_tick_t end_micros = HAL_Timer_Get_Micro_Seconds() + (1000*ms);
-
-    while (1)
-    {
-        HAL_Notify_WDT();
-
-        system_tick_t elapsed_millis = HAL_Timer_Get_Milli_Seconds() - start_millis;
-
-        if (elapsed_millis > ms)
-        {
-            break;
-        }
-        else if (elapsed_millis >= (ms-1)) {
-            // on the last millisecond, resolve using millis - we don't know how far in that millisecond had come
-            // have to be careful with wrap around since start_micros can be greater than end_micros.
-
-            for (;;)
-            {
-                system_tick_t delay = end_micros-HAL_Timer_Get_Micro_Seconds();
-                if (delay>100000)
-                    return;
-                HAL_Delay_Microseconds(min(delay/2, 1u));
-            }
-        }
-        else
+    const bool background = !(SPARK_WLAN_SLEEP || force_no_background_loop);
+    const bool pending = (spark_loop_total_millis >= SPARK_LOOP_DELAY_MILLIS);
+    particle::system::delay_pump(ms, background ? SPARK_LOOP_DELAY_MILLIS : 0, pending, []() {
+        bool threading = system_thread_get_state(nullptr);
+        //spark_loop_total_millis is reset to 0 in Spark_Idle()
+        do
         {
-            HAL_Delay_Milliseconds(1);
+            //Run once if the above condition passes
+            spark_process();
         }
-
-        if (SPARK_WLAN_SLEEP || force_no_background_loop)
-        {
-            //Do not yield for Spark_Idle()
-        }
-        else if ((elapsed_millis >= spark_loop_elapsed_millis) || (spark_loop_total_millis >= SPARK_LOOP_DELAY_MILLIS))
-        {
-        		bool threading = system_thread_get_state(nullptr);
-            spark_loop_elapsed_millis = elapsed_millis + SPARK_LOOP_DELAY_MILLIS;
-            //spark_loop_total_millis is reset to 0 in Spark_Idle()
-            do
-            {
-                //Run once if the above condition passes
-                spark_process();
-            }
-            while (!threading && SPARK_FLASH_UPDATE); //loop during OTA update
-        }
-    }
+        while (!threading && SPARK_FLASH_UPDATE); //loop during OTA update
+        return (spark_loop_total_millis >= SPARK_LOOP_DELAY_MILLIS);
+    });
 }
 
 /**
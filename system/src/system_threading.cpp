@@ -1,5 +1,7 @@
 #include "system_threading.h"
 #include "system_task.h"
+#include "spark_wiring_diagnostics.h"
+#include "system_error.h"
 #include <time.h>
 #include <string.h>
 
@@ -7,6 +9,117 @@
 
 #define THREAD_STACK_SIZE (5 * 1024)
 
+namespace {
+
+particle::SimpleHistogramDiagnosticData g_queueWaitTime(DIAG_ID_SYSTEM_QUEUE_WAIT_TIME, DIAG_NAME_SYSTEM_QUEUE_WAIT_TIME);
+
+void system_thread_queue_wait(system_tick_t wait)
+{
+    g_queueWaitTime.record(wait);
+}
+
+// Threads are grouped by their role. User threads are reported together with the remaining threads
+// created by the system and networking stack, since sources can't be registered at runtime
+enum class ThreadGroup {
+    SYSTEM,
+    APPLICATION,
+    TIMER,
+    OTHER
+};
+
+class ThreadStatsDiagnosticData: public particle::AbstractIntegerDiagnosticData {
+public:
+    enum Field {
+        CPU_TIME, // Cumulative CPU time in milliseconds, summed over the threads of the group
+        STACK_FREE // Minimum free stack space in bytes among the threads of the group
+    };
+
+    ThreadStatsDiagnosticData(uint16_t id, const char* name, ThreadGroup group, Field field) :
+            AbstractIntegerDiagnosticData(id, name),
+            group_(group),
+            field_(field) {
+    }
+
+    virtual int get(IntType& val) override {
+        Query q = { this, 0, false, false };
+        const int ret = os_thread_enum_stats(processStats, &q, nullptr);
+        if (ret != 0) {
+            return ret;
+        }
+        if (!q.found) {
+            return SYSTEM_ERROR_NOT_FOUND;
+        }
+        if (!q.supported) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+        val = q.value;
+        return 0;
+    }
+
+private:
+    struct Query {
+        const ThreadStatsDiagnosticData* self;
+        uint32_t value;
+        bool supported;
+        bool found;
+    };
+
+    ThreadGroup group_;
+    Field field_;
+
+    static int processStats(const os_thread_stats_t* stats, void* data) {
+        const auto q = static_cast<Query*>(data);
+        if (stats->type == OS_THREAD_TYPE_IDLE || threadGroup(stats) != q->self->group_) {
+            return 0;
+        }
+        if (q->self->field_ == CPU_TIME) {
+            if (stats->flags & OS_THREAD_STATS_FLAG_CPU_TIME) {
+                q->value += stats->cpu_time;
+                q->supported = true;
+            }
+        } else if (stats->flags & OS_THREAD_STATS_FLAG_STACK_FREE) {
+            if (!q->supported || stats->stack_free < q->value) {
+                q->value = stats->stack_free;
+            }
+            q->supported = true;
+        }
+        q->found = true;
+        return 0;
+    }
+
+    static ThreadGroup threadGroup(const os_thread_stats_t* stats) {
+        if (stats->thread == SystemThread.threadHandle()) {
+            return ThreadGroup::SYSTEM;
+        }
+        if (stats->thread == ApplicationThread.threadHandle()) {
+            return ThreadGroup::APPLICATION;
+        }
+        if (stats->type == OS_THREAD_TYPE_TIMER) {
+            return ThreadGroup::TIMER;
+        }
+        return ThreadGroup::OTHER;
+    }
+};
+
+ThreadStatsDiagnosticData g_systemThreadCpuTime(DIAG_ID_SYSTEM_THREAD_CPU_TIME, DIAG_NAME_SYSTEM_THREAD_CPU_TIME,
+        ThreadGroup::SYSTEM, ThreadStatsDiagnosticData::CPU_TIME);
+ThreadStatsDiagnosticData g_systemThreadStackFree(DIAG_ID_SYSTEM_THREAD_STACK_FREE, DIAG_NAME_SYSTEM_THREAD_STACK_FREE,
+        ThreadGroup::SYSTEM, ThreadStatsDiagnosticData::STACK_FREE);
+ThreadStatsDiagnosticData g_appThreadCpuTime(DIAG_ID_APPLICATION_THREAD_CPU_TIME, DIAG_NAME_APPLICATION_THREAD_CPU_TIME,
+        ThreadGroup::APPLICATION, ThreadStatsDiagnosticData::CPU_TIME);
+ThreadStatsDiagnosticData g_appThreadStackFree(DIAG_ID_APPLICATION_THREAD_STACK_FREE, DIAG_NAME_APPLICATION_THREAD_STACK_FREE,
+        ThreadGroup::APPLICATION, ThreadStatsDiagnosticData::STACK_FREE);
+ThreadStatsDiagnosticData g_timerThreadCpuTime(DIAG_ID_TIMER_THREAD_CPU_TIME, DIAG_NAME_TIMER_THREAD_CPU_TIME,
+        ThreadGroup::TIMER, ThreadStatsDiagnosticData::CPU_TIME);
+ThreadStatsDiagnosticData g_timerThreadStackFree(DIAG_ID_TIMER_THREAD_STACK_FREE, DIAG_NAME_TIMER_THREAD_STACK_FREE,
+        ThreadGroup::TIMER, ThreadStatsDiagnosticData::STACK_FREE);
+ThreadStatsDiagnosticData g_otherThreadsCpuTime(DIAG_ID_OTHER_THREADS_CPU_TIME, DIAG_NAME_OTHER_THREADS_CPU_TIME,
+        ThreadGroup::OTHER, ThreadStatsDiagnosticData::CPU_TIME);
+ThreadStatsDiagnosticData g_otherThreadsStackFree(DIAG_ID_OTHER_THREADS_STACK_FREE, DIAG_NAME_OTHER_THREADS_STACK_FREE,
+        ThreadGroup::OTHER, ThreadStatsDiagnosticData::STACK_FREE);
+
+} // namespace
+
 void system_thread_idle()
 {
     Spark_Idle_Events(true);
@@ -16,7 +129,10 @@ ActiveObjectThreadQueue SystemThread(ActiveObjectConfiguration(system_thread_idl
 			100, /* take timeout */
 			0x7FFFFFFF, /* put timeout - wait forever */
 			50, /* queue size */
-			THREAD_STACK_SIZE /* stack size */)); // TODO: Use this value for threads spawned by ActiveObjectBase
+			THREAD_STACK_SIZE, /* stack size */ // TODO: Use this value for threads spawned by ActiveObjectBase
+			system_thread_queue_wait));
+
+#if PLATFORM_ID != 3 // The virtual device uses the host's native gthreads implementation
 
 /**
  * Implementation to support gthread's concurrency primitives.
@@ -114,6 +230,8 @@ namespace std {
     }
 }
 
+#endif // PLATFORM_ID != 3
+
 static os_mutex_recursive_t usb_serial_mutex;
 
 os_mutex_recursive_t mutex_usb_serial()
@@ -42,6 +42,10 @@
 #include "spark_macros.h"
 #include "system_network_internal.h"
 #include "bytes2hexbuf.h"
+#include "system_diag_snapshot.h"
+
+#include <memory>
+#include <new>
 
 #ifdef START_DFU_FLASHER_SERIAL_SPEED
 static uint32_t start_dfu_flasher_serial_speed = START_DFU_FLASHER_SERIAL_SPEED;
@@ -373,6 +377,10 @@ protected:
 		return fn(data, (const uint8_t*)&value, sizeof(value));
 	}
 
+    inline bool writeData(const void* buf, size_t size) {
+		return fn(data, (const uint8_t*)buf, size);
+	}
+
 public:
 
     AppendBase(appender_fn fn, void* data) {
@@ -405,6 +413,18 @@ public:
     		return writeDirect(value);
     }
 
+    bool write(uint32_t value) {
+    		return writeDirect(value);
+    }
+
+    bool write(uint8_t value) {
+    		return writeDirect(value);
+    }
+
+    bool write(const char* buf, size_t size) {
+    		return writeData(buf, size);
+    }
+
 };
 
 
@@ -450,6 +470,11 @@ public:
         return write(itoa(value, buf, 10));
     }
 
+    bool write_unsigned(unsigned long value) {
+        char buf[12];
+        return write(ultoa(value, buf, 10));
+    }
+
     inline bool write(char c) {
     		return super::write(c);
     }
@@ -605,6 +630,36 @@ using namespace particle;
 template <typename T>
 class AbstractDiagnosticsFormatter {
 
+	// Values of the integer sources, taken in one pass before formatting
+	std::unique_ptr<diag_snapshot_entry[]> snapshot;
+	size_t snapshotSize = 0;
+
+	// If the snapshot can't be taken, e.g. because the diagnostics service is not started yet,
+	// the integer sources are queried directly
+	void takeSnapshot() {
+		snapshotSize = 0;
+		size_t count = 0;
+		if (Diagnostics::snapshot(nullptr, count) != 0) {
+			return;
+		}
+		snapshot.reset(new(std::nothrow) diag_snapshot_entry[count]);
+		if (!snapshot || Diagnostics::snapshot(snapshot.get(), count) != 0) {
+			return;
+		}
+		snapshotSize = count;
+	}
+
+	int getInt(const diag_source* src, AbstractIntegerDiagnosticData::IntType& val) const {
+		const auto e = Diagnostics::find(snapshot.get(), snapshotSize, src->id);
+		if (!e) {
+			return AbstractIntegerDiagnosticData::get(src, val);
+		}
+		if (e->flags & DIAG_SNAPSHOT_ENTRY_FLAG_ERROR) {
+			return e->value;
+		}
+		val = e->value;
+		return 0;
+	}
 
 protected:
 
@@ -628,12 +683,27 @@ protected:
 	    switch (src->type) {
 	    case DIAG_TYPE_INT: {
 	        AbstractIntegerDiagnosticData::IntType val = 0;
-	        const int ret = AbstractIntegerDiagnosticData::get(src, val);
+	        const int ret = getInt(src, val);
 	        if ((ret == 0 && !fmt.formatSourceInt(src, val)) || (ret != 0 && !fmt.formatSourceError(src, ret))) {
 	            return SYSTEM_ERROR_TOO_LARGE;
 	        }
 	        break;
 	    }
+	    case DIAG_TYPE_HISTOGRAM: {
+	        // Keep the buffer aligned for the bucket counters
+	        uint32_t buf[AbstractHistogramDiagnosticData::MAX_DATA_SIZE / sizeof(uint32_t)];
+	        size_t size = sizeof(buf);
+	        int ret = AbstractDiagnosticData::get(src, buf, size);
+	        const auto hist = (const diag_histogram*)buf;
+	        if (ret == 0 && (size < sizeof(diag_histogram) ||
+	                size < hist->size + hist->bucket_count * sizeof(uint32_t))) {
+	            ret = SYSTEM_ERROR_BAD_DATA;
+	        }
+	        if ((ret == 0 && !fmt.formatSourceHistogram(src, hist)) || (ret != 0 && !fmt.formatSourceError(src, ret))) {
+	            return SYSTEM_ERROR_TOO_LARGE;
+	        }
+	        break;
+	    }
 	    default:
 	        return SYSTEM_ERROR_NOT_SUPPORTED;
 	    }
@@ -641,6 +711,7 @@ protected:
 	}
 
 	static int formatSources(T& formatter, const uint16_t* id, size_t count, unsigned flags) {
+		formatter.takeSnapshot();
 	    if (!formatter.openDocument()) {
 			return SYSTEM_ERROR_TOO_LARGE;
 	    }
@@ -709,18 +780,48 @@ public:
 	inline bool formatSourceInt(const diag_source* src, AbstractIntegerDiagnosticData::IntType val) {
 		return json.write_value(src->name, val);
 	}
+
+	/**
+	 * Histograms are formatted as an object with the summary values and a list of
+	 * `[lower bound, count]` pairs for the non-empty buckets.
+	 */
+	bool formatSourceHistogram(const diag_source* src, const diag_histogram* hist) {
+		bool result = json.write_attribute(src->name) &&
+				json.write('{') &&
+				json.write_attribute("cnt") && json.write_unsigned(hist->count) && json.write(',') &&
+				json.write_attribute("sum") && json.write_unsigned(hist->sum) && json.write(',') &&
+				json.write_attribute("min") && json.write_unsigned(hist->min) && json.write(',') &&
+				json.write_attribute("max") && json.write_unsigned(hist->max) && json.write(',') &&
+				json.write_attribute("bkt") && json.write('[');
+		const uint32_t* buckets = AbstractHistogramDiagnosticData::buckets(hist);
+		bool first = true;
+		for (unsigned i = 0; result && i < hist->bucket_count; ++i) {
+			if (!buckets[i]) {
+				continue;
+			}
+			result = (first || json.write(',')) &&
+					json.write('[') &&
+					json.write_unsigned(AbstractHistogramDiagnosticData::bucketLowerBound(i, hist->sub_bucket_bits)) &&
+					json.write(',') &&
+					json.write_unsigned(buckets[i]) &&
+					json.write(']');
+			first = false;
+		}
+		return result && json.write("]}") && json.next();
+	}
 };
 
 
 class BinaryDiagnosticsFormatter : public AbstractDiagnosticsFormatter<BinaryDiagnosticsFormatter> {
 
 	AppendData& data;
+	bool histograms;
 
 	using value = AbstractIntegerDiagnosticData::IntType;
 	using id = typeof(diag_source::id);
 
 public:
-	BinaryDiagnosticsFormatter(AppendData& appender_) : data(appender_) {}
+	BinaryDiagnosticsFormatter(AppendData& appender_, bool histograms_) : data(appender_), histograms(histograms_) {}
 
 
 	inline bool openDocument() {
@@ -747,18 +848,106 @@ public:
 		return data.write(src->id) && data.write(val);
 	}
 
+	/**
+	 * Histograms are only included if requested via SYSTEM_FORMAT_DIAG_FLAG_HISTOGRAMS, since
+	 * their entries have a different layout: the ID with bit 14 set, the size of the entry data,
+	 * the count, sum, minimum and maximum of the values, the number of sub-bucket bits, the number
+	 * of non-empty buckets, and an index and a counter for each non-empty bucket.
+	 */
+	bool formatSourceHistogram(const diag_source* src, const diag_histogram* hist) {
+		if (!histograms) {
+			return true;
+		}
+		const uint32_t* buckets = AbstractHistogramDiagnosticData::buckets(hist);
+		uint8_t nonEmpty = 0;
+		for (unsigned i = 0; i < hist->bucket_count; ++i) {
+			if (buckets[i]) {
+				++nonEmpty;
+			}
+		}
+		const uint16_t size = sizeof(uint32_t) * 4 + 2 + nonEmpty * (1 + sizeof(uint32_t));
+		bool result = data.write(decltype(src->id)(src->id | 1<<14)) && data.write(size) &&
+				data.write(hist->count) && data.write(hist->sum) && data.write(hist->min) && data.write(hist->max) &&
+				data.write(hist->sub_bucket_bits) && data.write(nonEmpty);
+		for (unsigned i = 0; result && i < hist->bucket_count; ++i) {
+			if (buckets[i]) {
+				result = data.write(uint8_t(i)) && data.write(buckets[i]);
+			}
+		}
+		return result;
+	}
+
 };
 
 
+
+class DeltaDiagnosticsFormatter : public AbstractDiagnosticsFormatter<DeltaDiagnosticsFormatter> {
+
+	AppendData& data;
+	DiagnosticsSnapshot& snapshot;
+	bool full;
+
+public:
+	DeltaDiagnosticsFormatter(AppendData& appender_, DiagnosticsSnapshot& snapshot_, bool full_) :
+			data(appender_), snapshot(snapshot_), full(full_) {}
+
+	inline bool openDocument() {
+		char buf[DiagnosticsSnapshot::HEADER_SIZE];
+		snapshot.begin(buf, full);
+		return data.write(buf, sizeof(buf));
+	}
+
+	inline bool closeDocument() {
+		return true; // The snapshot is committed once the report has been sent
+	}
+
+	bool formatSourceError(const diag_source* src, int error) {
+		char buf[DiagnosticsSnapshot::MAX_ENTRY_SIZE];
+		const size_t n = snapshot.encodeError(src->id, error, buf);
+		return data.write(buf, n);
+	}
+
+	inline bool isSourceOk(const diag_source* src) {
+	    return true;
+	}
+
+	inline bool formatSourceInt(const diag_source* src, AbstractIntegerDiagnosticData::IntType val) {
+		char buf[DiagnosticsSnapshot::MAX_ENTRY_SIZE];
+		const size_t n = snapshot.encodeValue(src->id, val, buf);
+		return n == 0 || data.write(buf, n);
+	}
+
+	inline bool formatSourceHistogram(const diag_source* src, const diag_histogram* hist) {
+		return true; // Not supported by the incremental format
+	}
+
+};
+
+// Last reported values of the data sources
+DiagnosticsSnapshot diagSnapshot;
+
 } // namespace
 
 
 
 int system_format_diag_data(const uint16_t* id, size_t count, unsigned flags, appender_fn append, void* append_data,
         void* reserved) {
-	if (flags & 1) {
+	if (flags & SYSTEM_FORMAT_DIAG_FLAG_DELTA) {
+		if (flags & SYSTEM_FORMAT_DIAG_FLAG_RESET) {
+			diagSnapshot.reset();
+			return 0;
+		}
+		if (flags & SYSTEM_FORMAT_DIAG_FLAG_COMMIT) {
+			diagSnapshot.commit();
+			return 0;
+		}
+		AppendData data(append, append_data);
+		DeltaDiagnosticsFormatter fmt(data, diagSnapshot, flags & SYSTEM_FORMAT_DIAG_FLAG_FULL);
+		return fmt.format(id, count, flags);
+	}
+	else if (flags & SYSTEM_FORMAT_DIAG_FLAG_BINARY) {
 		AppendData data(append, append_data);
-		BinaryDiagnosticsFormatter fmt(data);
+		BinaryDiagnosticsFormatter fmt(data, flags & SYSTEM_FORMAT_DIAG_FLAG_HISTOGRAMS);
 	    return fmt.format(id, count, flags);
 	}
 	else {
@@ -29,16 +29,19 @@
 using std::min;
 
 /**
- * Series 1s (5 times), 2s (5 times), 4s (5 times)...64s (5 times) then to 128s thereafter.
+ * Series 1x (5 times), 2x (5 times), 4x (5 times)...64x (5 times) then to 128x the base period thereafter.
+ * The period never exceeds MAX_BACKOFF_PERIOD, so a base period scaled to a slow link only lengthens
+ * the early steps.
  * @param connection_attempts
+ * @param base_period
  * @return The number of milliseconds to backoff.
  */
-unsigned backoff_period(unsigned connection_attempts)
+unsigned backoff_period(unsigned connection_attempts, unsigned base_period)
 {
     if (!connection_attempts)
         return 0;
     unsigned exponent = min(7u, (connection_attempts-1)/5);
-    return 1000*(1<<exponent);
+    return min(base_period*(1<<exponent), MAX_BACKOFF_PERIOD);
 }
 
 STATIC_ASSERT(system_version_info_size, sizeof(SystemVersionInfo)==28);
@@ -70,12 +70,14 @@
 #include "spark_wiring_json.h"
 #include "spark_wiring_vector.h"
 #include "spark_wiring_async.h"
+#include "spark_wiring_worker_pool.h"
 #include "spark_wiring_error.h"
 #include "spark_wiring_led.h"
 #include "spark_wiring_diagnostics.h"
 #include "fast_pin.h"
 #include "string_convert.h"
 #include "debug_output_handler.h"
+#include "spark_wiring_retained_log_handler.h"
 
 // this was being implicitly pulled in by some of the other headers
 // adding here for backwards compatibility.
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "heap_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace particle::bench;
+
+struct BenchmarkInfo {
+    const char* name;
+    BenchmarkFunction func;
+};
+
+struct Options {
+    std::vector<std::string> filters;
+    uint64_t minNanos = 200 * 1000000ull;
+    unsigned repetitions = 3;
+    bool list = false;
+};
+
+const size_t MAX_ITERATIONS = 1000000000;
+
+// Registered benchmarks. Initialized on first use, since the registrations are static objects
+// defined in other translation units
+std::vector<BenchmarkInfo>& benchmarks() {
+    static std::vector<BenchmarkInfo> b;
+    return b;
+}
+
+uint64_t nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Returns the total number of allocations and allocated bytes recorded by the heap profiler
+void allocStats(uint64_t* count, uint64_t* bytes) {
+    struct Stats {
+        uint64_t count;
+        uint64_t bytes;
+    };
+    Stats stats = {};
+    heap_profiler_enum_sites([](const heap_profiler_site* site, void* data) {
+        const auto stats = static_cast<Stats*>(data);
+        stats->count += site->count;
+        stats->bytes += site->bytes;
+        return 0;
+    }, &stats, nullptr);
+    *count = stats.count;
+    *bytes = stats.bytes;
+}
+
+bool matches(const BenchmarkInfo& b, const Options& opts) {
+    if (opts.filters.empty()) {
+        return true;
+    }
+    for (const auto& f: opts.filters) {
+        if (strstr(b.name, f.c_str())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs a benchmark function with the given number of iterations
+bool runOnce(const BenchmarkInfo& info, size_t iterations, Benchmark* result, std::string* error) {
+    Benchmark b(iterations);
+    heap_profiler_reset(nullptr);
+    info.func(b);
+    if (b.failed()) {
+        *error = b.error();
+        return false;
+    }
+    if (b.next()) {
+        *error = "Benchmark loop did not complete";
+        return false;
+    }
+    *result = b;
+    return true;
+}
+
+// Finds the number of iterations needed for the loop to run at least the requested time, in the
+// same way as the Go benchmarks do
+bool calibrate(const BenchmarkInfo& info, const Options& opts, size_t* iterations, std::string* error) {
+    size_t n = 1;
+    for (;;) {
+        Benchmark b(n);
+        if (!runOnce(info, n, &b, error)) {
+            return false;
+        }
+        if (b.nanoseconds() >= opts.minNanos || n >= MAX_ITERATIONS) {
+            break;
+        }
+        const uint64_t perOp = std::max<uint64_t>(b.nanoseconds() / n, 1);
+        uint64_t next = opts.minNanos / perOp;
+        next += next / 5; // Overshoot by 20%
+        next = std::min<uint64_t>(next, (uint64_t)n * 100);
+        next = std::max<uint64_t>(next, n + 1);
+        n = std::min<uint64_t>(next, MAX_ITERATIONS);
+    }
+    *iterations = n;
+    return true;
+}
+
+void printString(const char* str) {
+    putchar('"');
+    for (const char* s = str; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+            putchar(*s);
+        } else if ((unsigned char)*s < 0x20) {
+            printf("\\u%04x", (unsigned)*s);
+        } else {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+// Runs a benchmark and prints its results as a single line of JSON
+bool run(const BenchmarkInfo& info, const Options& opts) {
+    std::string error;
+    size_t iterations = 0;
+    std::vector<double> nsPerOp;
+    Benchmark result(0);
+    bool ok = calibrate(info, opts, &iterations, &error);
+    for (unsigned i = 0; ok && i < opts.repetitions; ++i) {
+        ok = runOnce(info, iterations, &result, &error);
+        if (ok) {
+            nsPerOp.push_back((double)result.nanoseconds() / iterations);
+        }
+    }
+    printf("{\"name\":");
+    printString(info.name);
+    if (ok) {
+        // The median of the repetitions is reported, since it's less sensitive to the noise
+        // caused by other processes
+        std::sort(nsPerOp.begin(), nsPerOp.end());
+        printf(",\"iterations\":%lu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%.2f}\n",
+                (unsigned long)iterations, nsPerOp[nsPerOp.size() / 2],
+                (double)result.allocations() / iterations, (double)result.allocatedBytes() / iterations);
+    } else {
+        printf(",\"error\":");
+        printString(error.empty() ? "Benchmark failed" : error.c_str());
+        printf("}\n");
+    }
+    fflush(stdout);
+    return ok;
+}
+
+void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [options] [filter...]\n"
+            "Runs the benchmarks whose names contain any of the filter strings.\n"
+            "\n"
+            "Options:\n"
+            "  -t, --min-time <ms>     Minimum duration of a measured loop (default: 200)\n"
+            "  -r, --repetitions <n>   Number of measurements per benchmark (default: 3)\n"
+            "  -l, --list              List the benchmarks\n",
+            name);
+}
+
+bool parseArgs(int argc, char** argv, Options* opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "-t") || !strcmp(arg, "--min-time")) {
+            if (++i == argc) {
+                return false;
+            }
+            opts->minNanos = strtoull(argv[i], nullptr, 10) * 1000000ull;
+        } else if (!strcmp(arg, "-r") || !strcmp(arg, "--repetitions")) {
+            if (++i == argc) {
+                return false;
+            }
+            opts->repetitions = std::max(atoi(argv[i]), 1);
+        } else if (!strcmp(arg, "-l") || !strcmp(arg, "--list")) {
+            opts->list = true;
+        } else if (arg[0] == '-') {
+            return false;
+        } else {
+            opts->filters.push_back(arg);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+particle::bench::Benchmark::Benchmark(size_t iterations) :
+        iterations_(iterations),
+        n_(0),
+        startNanos_(0),
+        nanos_(0),
+        startAllocs_(0),
+        startAllocBytes_(0),
+        allocs_(0),
+        allocBytes_(0),
+        error_(nullptr),
+        started_(false) {
+}
+
+void particle::bench::Benchmark::pause() {
+    const uint64_t t = nanos();
+    nanos_ += t - startNanos_;
+    uint64_t count = 0, bytes = 0;
+    allocStats(&count, &bytes);
+    allocs_ += count - startAllocs_;
+    allocBytes_ += bytes - startAllocBytes_;
+}
+
+void particle::bench::Benchmark::resume() {
+    allocStats(&startAllocs_, &startAllocBytes_);
+    startNanos_ = nanos();
+}
+
+void particle::bench::Benchmark::fail(const char* msg) {
+    if (!error_) {
+        error_ = msg;
+    }
+    n_ = 0;
+    started_ = true;
+}
+
+bool particle::bench::Benchmark::nextSlow() {
+    if (!started_) {
+        started_ = true;
+        if (!iterations_) {
+            return false;
+        }
+        n_ = iterations_;
+        resume();
+        return true;
+    }
+    if (n_) {
+        n_ = 0;
+        pause(); // The loop has completed
+    }
+    return false;
+}
+
+particle::bench::Registration::Registration(const char* name, BenchmarkFunction func) {
+    benchmarks().push_back({ name, func });
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, &opts)) {
+        usage(argv[0]);
+        return 2;
+    }
+    auto& all = benchmarks();
+    std::sort(all.begin(), all.end(), [](const BenchmarkInfo& b1, const BenchmarkInfo& b2) {
+        return strcmp(b1.name, b2.name) < 0;
+    });
+    int failed = 0;
+    for (const auto& b: all) {
+        if (!matches(b, opts)) {
+            continue;
+        }
+        if (opts.list) {
+            printf("%s\n", b.name);
+            continue;
+        }
+        if (!run(b, opts)) {
+            ++failed;
+        }
+    }
+    return failed ? 1 : 0;
+}
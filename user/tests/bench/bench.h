@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+namespace bench {
+
+/**
+ * State of a running benchmark.
+ *
+ * A benchmark function performs its setup, and then runs the measured operation in a loop until
+ * `next()` returns false. Only the loop is measured:
+ *
+ * ```
+ * BENCHMARK(string_concat) {
+ *     String s;
+ *     while (b.next()) {
+ *         ...
+ *     }
+ * }
+ * ```
+ *
+ * The runner calls the function several times with an increasing number of iterations, until the
+ * loop takes long enough to be measured reliably.
+ */
+class Benchmark {
+public:
+    explicit Benchmark(size_t iterations);
+
+    bool next() {
+        if (n_ > 1) {
+            --n_;
+            return true;
+        }
+        return nextSlow();
+    }
+
+    // Excludes the code executed within the loop from the measurement, e.g. to restore the state
+    // modified by the measured operation
+    void pause();
+    void resume();
+
+    size_t iterations() const {
+        return iterations_;
+    }
+
+    // Results
+    uint64_t nanoseconds() const {
+        return nanos_;
+    }
+
+    uint64_t allocations() const {
+        return allocs_;
+    }
+
+    uint64_t allocatedBytes() const {
+        return allocBytes_;
+    }
+
+    bool failed() const {
+        return error_ != nullptr;
+    }
+
+    const char* error() const {
+        return error_;
+    }
+
+    // Marks the benchmark as failed, e.g. if the measured operation returned an unexpected result.
+    // The message should be a string literal
+    void fail(const char* msg);
+
+private:
+    size_t iterations_, n_;
+    uint64_t startNanos_, nanos_;
+    uint64_t startAllocs_, startAllocBytes_, allocs_, allocBytes_;
+    const char* error_;
+    bool started_;
+
+    bool nextSlow();
+};
+
+typedef void(*BenchmarkFunction)(Benchmark& b);
+
+// Registers a benchmark function. Benchmarks are run in the order of their names
+struct Registration {
+    Registration(const char* name, BenchmarkFunction func);
+};
+
+// Prevents the compiler from optimizing out the computation of a value
+template<typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+} // namespace bench
+
+} // namespace particle
+
+#define BENCHMARK_FUNC_(_name) \
+        bench_##_name
+
+#define BENCHMARK(_name) \
+        static void BENCHMARK_FUNC_(_name)(::particle::bench::Benchmark& b); \
+        static const ::particle::bench::Registration bench_registration_##_name(#_name, BENCHMARK_FUNC_(_name)); \
+        static void BENCHMARK_FUNC_(_name)(::particle::bench::Benchmark& b)
+
+// Checks a condition within a benchmark function
+#define BENCH_CHECK(_cond) \
+        do { \
+            if (!(_cond)) { \
+                b.fail(#_cond); \
+                return; \
+            } \
+        } while (false)
@@ -0,0 +1,137 @@
+#include "bench.h"
+
+#include "coap_channel.h"
+#include "messages.h"
+#include "subscriptions.h"
+
+#include <cstring>
+
+using namespace particle::bench;
+using namespace particle::protocol;
+
+namespace {
+
+// A message channel that discards all outgoing messages
+class NullMessageChannel: public MessageChannel {
+public:
+    bool is_unreliable() override {
+        return false;
+    }
+
+    ProtocolError establish(uint32_t& flags, uint32_t app_state_crc) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError create(Message& msg, size_t size) override {
+        msg.set_buffer(buf_, sizeof(buf_));
+        return NO_ERROR;
+    }
+
+    ProtocolError response(Message& original, Message& response, size_t required) override {
+        return create(response, required);
+    }
+
+    ProtocolError notify_established() override {
+        return NO_ERROR;
+    }
+
+    ProtocolError send(Message& msg) override {
+        return NO_ERROR;
+    }
+
+    ProtocolError receive(Message& msg) override {
+        msg.set_length(0);
+        return NO_ERROR;
+    }
+
+    ProtocolError command(Command cmd, void* arg) override {
+        return NO_ERROR;
+    }
+
+private:
+    uint8_t buf_[PROTOCOL_BUFFER_SIZE];
+};
+
+const char EVENT_NAME[] = "sensor/temperature";
+const char EVENT_DATA[] = "{\"temp\":21.5,\"humidity\":48,\"battery\":3.92}";
+
+size_t g_eventCount = 0;
+
+void handleEvent(const char* name, const char* data) {
+    ++g_eventCount;
+}
+
+// Fills a message store with confirmable messages that are waiting for acknowledgement
+bool sendConfirmable(CoAPMessageStore& store, message_id_t id, system_tick_t time) {
+    uint8_t buf[128];
+    const size_t size = Messages::event(buf, id, EVENT_NAME, EVENT_DATA, 60, EventType::PRIVATE, true);
+    Message msg(buf, sizeof(buf), size);
+    msg.set_id(id);
+    return store.send(msg, time) == NO_ERROR;
+}
+
+} // namespace
+
+BENCHMARK(messages_event) {
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    message_id_t id = 0;
+    while (b.next()) {
+        const size_t size = Messages::event(buf, ++id, EVENT_NAME, EVENT_DATA, 60, EventType::PRIVATE, true);
+        BENCH_CHECK(size > sizeof(EVENT_DATA));
+        doNotOptimize(buf);
+    }
+}
+
+// Dispatches an incoming event to the matching subscription handler. The handler parses the
+// message in place, so the message is restored on every iteration
+BENCHMARK(subscriptions_handle_event) {
+    NullMessageChannel channel;
+    Subscriptions subs;
+    subs.add_event_handler("device/", handleEvent, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+    subs.add_event_handler("system/", handleEvent, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+    subs.add_event_handler("sensor/", handleEvent, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+    uint8_t src[PROTOCOL_BUFFER_SIZE];
+    const size_t size = Messages::event(src, 1, EVENT_NAME, EVENT_DATA, 60, EventType::PRIVATE, false);
+    uint8_t buf[PROTOCOL_BUFFER_SIZE];
+    g_eventCount = 0;
+    while (b.next()) {
+        memcpy(buf, src, size);
+        Message msg(buf, sizeof(buf), size);
+        BENCH_CHECK(subs.handle_event(msg, nullptr, channel) == NO_ERROR);
+    }
+    BENCH_CHECK(g_eventCount == b.iterations());
+}
+
+// Processes a message store in which no message is due for retransmission, which is what happens
+// on most iterations of the system loop
+BENCHMARK(coap_store_process_idle) {
+    NullMessageChannel channel;
+    CoAPMessageStore store;
+    for (message_id_t id = 1; id <= 8; ++id) {
+        BENCH_CHECK(sendConfirmable(store, id, 0));
+    }
+    system_tick_t time = 0;
+    while (b.next()) {
+        store.process(time++ % CoAPMessage::ACK_TIMEOUT, channel);
+    }
+    BENCH_CHECK(store.has_unacknowledged_requests());
+}
+
+// Sends a confirmable message and receives its acknowledgement
+BENCHMARK(coap_store_send_ack) {
+    NullMessageChannel channel;
+    CoAPMessageStore store;
+    uint8_t ackBuf[16];
+    message_id_t id = 0;
+    system_tick_t time = 0;
+    while (b.next()) {
+        ++id;
+        BENCH_CHECK(sendConfirmable(store, id, time));
+        time += 100;
+        const size_t size = Messages::empty_ack(ackBuf, id >> 8, id & 0xff);
+        Message ack(ackBuf, sizeof(ackBuf), size);
+        BENCH_CHECK(store.receive(ack, channel, time) == NO_ERROR);
+        store.process(time, channel);
+    }
+    BENCH_CHECK(!store.has_messages());
+}
@@ -0,0 +1,20 @@
+// HAL functions used by the benchmarked code. The virtual device's implementations depend on
+// Boost, which the benchmarks don't need otherwise
+
+#include "timer_hal.h"
+
+#include <chrono>
+
+namespace {
+
+const auto g_start = std::chrono::steady_clock::now();
+
+} // namespace
+
+system_tick_t HAL_Timer_Get_Micro_Seconds(void) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_start).count();
+}
+
+system_tick_t HAL_Timer_Get_Milli_Seconds(void) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - g_start).count();
+}
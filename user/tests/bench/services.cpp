@@ -0,0 +1,260 @@
+#include "bench.h"
+
+#include "dcd.h"
+#include "eeprom_emulation.h"
+#include "flash_storage.h"
+#include "simple_pool_allocator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+using namespace particle::bench;
+
+namespace {
+
+// The EEPROM emulation configuration used on the Photon and Electron: a 16 KB and a 64 KB sector,
+// with reads served from the RAM cache
+const uintptr_t EepromBase = 0x0800C000;
+const uintptr_t EepromPageBase1 = EepromBase;
+const size_t EepromPageSize1 = 16 * 1024;
+const uintptr_t EepromPageBase2 = EepromBase + EepromPageSize1;
+const size_t EepromPageSize2 = 64 * 1024;
+
+using EepromStore = RAMFlashStorage<EepromBase, 5, 16 * 1024>;
+using Eeprom = EEPROMEmulation<EepromStore, EepromPageBase1, EepromPageSize1, EepromPageBase2, EepromPageSize2, true>;
+using UncachedEeprom = EEPROMEmulation<EepromStore, EepromPageBase1, EepromPageSize1, EepromPageBase2, EepromPageSize2>;
+
+struct Config {
+    uint32_t version;
+    uint8_t flags;
+    char name[27];
+    uint32_t counter;
+};
+
+const Eeprom::Index ConfigIndex = 0;
+const Eeprom::Index CounterIndex = offsetof(Config, counter);
+
+// Creates an EEPROM with a stored configuration whose counter was updated a number of times, so
+// that the active page contains a realistic mix of valid and obsolete records
+std::unique_ptr<Eeprom> makeEeprom(unsigned counterUpdates) {
+    srand(1);
+    std::unique_ptr<Eeprom> eeprom(new Eeprom);
+    eeprom->clear();
+    eeprom->init();
+    Config c = {};
+    c.version = 3;
+    c.flags = 0x5a;
+    strcpy(c.name, "sensor-node");
+    eeprom->put(ConfigIndex, &c, sizeof(c));
+    for (uint32_t i = 0; i < counterUpdates; ++i) {
+        eeprom->put(CounterIndex, &i, sizeof(i));
+    }
+    return eeprom;
+}
+
+// Measures the page swap time for an EEPROM in which the given percentage of the capacity was
+// written. The erase of the old page is not measured, since the application can schedule it
+template<typename EepromT>
+void benchmarkPageSwap(Benchmark& b, unsigned fillPercent) {
+    srand(1);
+    std::unique_ptr<EepromT> eeprom(new EepromT);
+    eeprom->clear();
+    eeprom->init();
+    const size_t count = EepromT::capacity() * fillPercent / 100;
+    std::unique_ptr<uint8_t[]> data(new uint8_t[count]);
+    for (size_t i = 0; i < count; ++i) {
+        data[i] = i % 0xfe;
+    }
+    eeprom->put(0, data.get(), count);
+    while (b.next()) {
+        b.pause();
+        eeprom->performPendingErase();
+        b.resume();
+        BENCH_CHECK(eeprom->swapPagesAndWrite(0, nullptr, 0));
+    }
+}
+
+// Table-driven CRC-32, which is closer to the cost of the hardware CRC unit used on the device
+uint32_t crc32(const void* data, size_t size) {
+    static uint32_t table[256] = {};
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int j = 0; j < 8; ++j) {
+                c = (c >> 1) ^ (0xedb88320 & -(c & 1));
+            }
+            table[i] = c;
+        }
+    }
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t crc = 0xffffffff;
+    while (size-- > 0) {
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// The DCT configuration used on the Electron: two 16 KB sectors
+const unsigned DcdSectorSize = 16 * 1024;
+const unsigned DcdBase = 0x08004000;
+
+using DcdStore = RAMFlashStorage<DcdBase, 2, DcdSectorSize>;
+using Dcd = DCD<DcdStore, DcdSectorSize, DcdBase, DcdBase + DcdSectorSize, crc32>;
+using JournalDcd = DCD<DcdStore, DcdSectorSize, DcdBase, DcdBase + DcdSectorSize, crc32, 1024>;
+
+// Updates a flag byte, as done when changing a setting. This includes the cost of the sector
+// rewrites, which happen on every write or when the journal becomes full
+template<typename DcdT>
+void benchmarkDcdWriteFlag(Benchmark& b) {
+    std::unique_ptr<DcdT> dcd(new DcdT);
+    dcd->erase();
+    uint8_t flag = 0;
+    while (b.next()) {
+        ++flag;
+        BENCH_CHECK(dcd->write(100, &flag, sizeof(flag)) == DcdT::DCD_SUCCESS);
+    }
+}
+
+uint32_t nextRandom(uint32_t& state) {
+    state = state * 1664525 + 1013904223;
+    return state >> 16;
+}
+
+} // namespace
+
+BENCHMARK(eeprom_read_byte) {
+    const auto eeprom = makeEeprom(1000);
+    while (b.next()) {
+        uint8_t flags = 0;
+        eeprom->get(offsetof(Config, flags), flags);
+        BENCH_CHECK(flags == 0x5a);
+    }
+}
+
+BENCHMARK(eeprom_read_struct) {
+    const auto eeprom = makeEeprom(1000);
+    while (b.next()) {
+        Config c;
+        eeprom->get(ConfigIndex, &c, sizeof(c));
+        BENCH_CHECK(c.counter == 999);
+    }
+}
+
+// Updates a counter. This includes the cost of the page swaps, which happen whenever the active
+// page becomes full
+BENCHMARK(eeprom_write_counter) {
+    const auto eeprom = makeEeprom(0);
+    uint32_t counter = 0;
+    while (b.next()) {
+        ++counter;
+        eeprom->put(CounterIndex, &counter, sizeof(counter));
+    }
+}
+
+// Saves a checkpoint of the application state made of the configuration and a counter, which
+// are updated atomically as a whole in the transaction variant
+BENCHMARK(eeprom_checkpoint_put) {
+    const auto eeprom = makeEeprom(0);
+    Config c;
+    eeprom->get(ConfigIndex, &c, sizeof(c));
+    uint32_t counter = 0;
+    while (b.next()) {
+        ++counter;
+        c.flags = counter & 0x0f;
+        eeprom->put(ConfigIndex, &c, sizeof(c));
+        eeprom->put(sizeof(Config), &counter, sizeof(counter));
+    }
+}
+
+BENCHMARK(eeprom_checkpoint_transaction) {
+    const auto eeprom = makeEeprom(0);
+    Config c;
+    eeprom->get(ConfigIndex, &c, sizeof(c));
+    uint32_t counter = 0;
+    while (b.next()) {
+        ++counter;
+        c.flags = counter & 0x0f;
+        auto tx = eeprom->beginTransaction();
+        tx.put(ConfigIndex, &c, sizeof(c));
+        tx.put(sizeof(Config), &counter, sizeof(counter));
+        BENCH_CHECK(tx.commit());
+    }
+}
+
+BENCHMARK(eeprom_page_swap_fill_0) {
+    benchmarkPageSwap<Eeprom>(b, 0);
+}
+
+BENCHMARK(eeprom_page_swap_fill_25) {
+    benchmarkPageSwap<Eeprom>(b, 25);
+}
+
+BENCHMARK(eeprom_page_swap_fill_50) {
+    benchmarkPageSwap<Eeprom>(b, 50);
+}
+
+BENCHMARK(eeprom_page_swap_fill_100) {
+    benchmarkPageSwap<Eeprom>(b, 100);
+}
+
+BENCHMARK(eeprom_page_swap_uncached_fill_0) {
+    benchmarkPageSwap<UncachedEeprom>(b, 0);
+}
+
+BENCHMARK(eeprom_page_swap_uncached_fill_25) {
+    benchmarkPageSwap<UncachedEeprom>(b, 25);
+}
+
+BENCHMARK(eeprom_page_swap_uncached_fill_50) {
+    benchmarkPageSwap<UncachedEeprom>(b, 50);
+}
+
+BENCHMARK(eeprom_page_swap_uncached_fill_100) {
+    benchmarkPageSwap<UncachedEeprom>(b, 100);
+}
+
+BENCHMARK(dcd_write_flag) {
+    benchmarkDcdWriteFlag<Dcd>(b);
+}
+
+BENCHMARK(dcd_write_flag_journal) {
+    benchmarkDcdWriteFlag<JournalDcd>(b);
+}
+
+// Allocates a number of blocks and frees them in the reverse order
+BENCHMARK(pool_alloc_free_lifo) {
+    alignas(uintptr_t) uint8_t buf[4096];
+    SimpleStaticPool pool(buf, sizeof(buf));
+    void* ptrs[16];
+    while (b.next()) {
+        for (size_t i = 0; i < 16; ++i) {
+            ptrs[i] = pool.allocate(16 + i * 8);
+            BENCH_CHECK(ptrs[i]);
+        }
+        for (size_t i = 16; i > 0; --i) {
+            pool.deallocate(ptrs[i - 1]);
+        }
+    }
+}
+
+// Replaces a random block in a set of live blocks of different sizes with a block of the same size.
+// The pool doesn't merge adjacent free blocks, so the sizes are kept to avoid exhausting it
+BENCHMARK(pool_alloc_free_random) {
+    alignas(uintptr_t) uint8_t buf[4096];
+    SimpleStaticPool pool(buf, sizeof(buf));
+    void* ptrs[16];
+    size_t sizes[16];
+    uint32_t rnd = 1;
+    for (size_t i = 0; i < 16; ++i) {
+        sizes[i] = 8 + nextRandom(rnd) % 120;
+        ptrs[i] = pool.allocate(sizes[i]);
+        BENCH_CHECK(ptrs[i]);
+    }
+    while (b.next()) {
+        const size_t i = nextRandom(rnd) % 16;
+        pool.deallocate(ptrs[i]);
+        ptrs[i] = pool.allocate(sizes[i]);
+        BENCH_CHECK(ptrs[i]);
+    }
+}
@@ -0,0 +1,120 @@
+#include "bench.h"
+
+#include "spark_wiring_string.h"
+#include "spark_wiring_vector.h"
+#include "spark_wiring_json.h"
+#include "spark_wiring_logging.h"
+
+#include <cstring>
+
+using namespace particle::bench;
+using namespace spark;
+
+namespace {
+
+const char JSON_DOC[] = "{\"id\":\"3c002a000547343138333038\",\"name\":\"sensor\",\"connected\":true,"
+        "\"variables\":{\"temp\":\"double\",\"humidity\":\"int32\"},\"functions\":[\"led\",\"reset\"],"
+        "\"last_heard\":1514764800,\"firmware_version\":6,\"rssi\":-61.5}";
+
+} // namespace
+
+// Builds a short string from several parts, as done when formatting event names and data
+BENCHMARK(string_concat) {
+    while (b.next()) {
+        String s("device/");
+        s += "3c002a000547343138333038";
+        s += '/';
+        s += 12345;
+        s += "/status=";
+        s += String(3.14159, 2);
+        doNotOptimize(s.c_str());
+    }
+}
+
+BENCHMARK(string_concat_reserved) {
+    while (b.next()) {
+        String s;
+        s.reserve(64);
+        s += "device/";
+        s += "3c002a000547343138333038";
+        s += '/';
+        s += 12345;
+        s += "/status=";
+        s += String(3.14159, 2);
+        doNotOptimize(s.c_str());
+    }
+}
+
+// Appends 64 elements to an empty vector, one at a time
+BENCHMARK(vector_append_64) {
+    while (b.next()) {
+        Vector<int> v;
+        for (int i = 0; i < 64; ++i) {
+            v.append(i);
+        }
+        doNotOptimize(v.data());
+    }
+}
+
+BENCHMARK(vector_insert_front_64) {
+    while (b.next()) {
+        Vector<int> v;
+        for (int i = 0; i < 64; ++i) {
+            v.prepend(i);
+        }
+        doNotOptimize(v.data());
+    }
+}
+
+// Parses a document and iterates over its top-level members. JSONValue::parse() modifies the
+// source data, so the document is copied to a scratch buffer on every iteration
+BENCHMARK(json_parse) {
+    char buf[sizeof(JSON_DOC)];
+    while (b.next()) {
+        memcpy(buf, JSON_DOC, sizeof(JSON_DOC));
+        const JSONValue v = JSONValue::parse(buf, sizeof(JSON_DOC) - 1);
+        JSONObjectIterator it(v);
+        int n = 0;
+        while (it.next()) {
+            ++n;
+        }
+        BENCH_CHECK(n == 8);
+    }
+}
+
+BENCHMARK(json_buffer_writer) {
+    char buf[256];
+    while (b.next()) {
+        JSONBufferWriter w(buf, sizeof(buf));
+        w.beginObject();
+        w.name("id").value("3c002a000547343138333038");
+        w.name("connected").value(true);
+        w.name("variables").beginObject();
+        w.name("temp").value(21.5);
+        w.name("humidity").value(48);
+        w.endObject();
+        w.name("functions").beginArray().value("led").value("reset").endArray();
+        w.name("last_heard").value(1514764800u);
+        w.endObject();
+        BENCH_CHECK(w.dataSize() < sizeof(buf));
+        doNotOptimize(buf);
+    }
+}
+
+// Looks up the level of a nested category among several category filters
+BENCHMARK(log_filter_level) {
+    const detail::LogFilter f(LOG_LEVEL_WARN, {
+        { "app", LOG_LEVEL_ALL },
+        { "app.network", LOG_LEVEL_INFO },
+        { "comm", LOG_LEVEL_INFO },
+        { "comm.coap", LOG_LEVEL_TRACE },
+        { "comm.protocol", LOG_LEVEL_WARN },
+        { "system", LOG_LEVEL_INFO },
+        { "system.ota", LOG_LEVEL_TRACE },
+        { "wiring.spi", LOG_LEVEL_ERROR }
+    });
+    while (b.next()) {
+        BENCH_CHECK(f.level("comm.coap.retransmit") == LOG_LEVEL_TRACE);
+        BENCH_CHECK(f.level("hal.usb") == LOG_LEVEL_WARN);
+    }
+}
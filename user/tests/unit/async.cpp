@@ -8,6 +8,7 @@
 
 #include <thread>
 #include <deque>
+#include <string>
 
 namespace {
 
@@ -52,11 +53,12 @@ public:
     }
 
     static bool isApplicationThreadCurrent() {
-        return true; // TODO
+        return std::this_thread::get_id() == instance()->threadId_;
     }
 
 private:
     std::deque<Event> events_;
+    std::thread::id threadId_ = std::this_thread::get_id(); // Thread running the test cases
 };
 
 template<typename ResultT>
@@ -411,6 +413,153 @@ TEST_CASE("AdaptedFuture<int>") {
     }
 }
 
+TEST_CASE("Future::then()") {
+    resetContext();
+
+    SECTION("continuation is invoked with the result of succeeded future") {
+        ::Promise<int> p;
+        ::Future<int> f1 = p.future();
+        ::Future<int> f2 = f1.then([](int r) {
+            return r + 1;
+        });
+        CHECK(f2.isDone() == false);
+        p.setResult(1);
+        CHECK(f2.isSucceeded() == true);
+        CHECK(f2.result() == 2);
+    }
+
+    SECTION("continuation is invoked immediately for already completed future") {
+        ::Future<int> f1(1);
+        bool called = false;
+        ::Future<void> f2 = f1.then([&called](int r) {
+            called = true;
+        });
+        CHECK(called == true);
+        CHECK(f2.isSucceeded() == true);
+    }
+
+    SECTION("continuations can be chained") {
+        ::Promise<void> p;
+        ::Future<std::string> f = p.future().then([]() {
+            return 1;
+        }).then([](int r) {
+            return std::to_string(r + 1);
+        });
+        p.setResult();
+        CHECK(f.result() == "2");
+    }
+
+    SECTION("future returned by continuation is unwrapped") {
+        ::Promise<int> p1, p2;
+        ::Future<int> f = p1.future().then([&p2](int r) {
+            return p2.future();
+        });
+        p1.setResult(1);
+        CHECK(f.isDone() == false);
+        p2.setResult(2);
+        CHECK(f.result() == 2);
+    }
+
+    SECTION("error is propagated without invoking continuation") {
+        ::Promise<int> p;
+        bool called = false;
+        ::Future<int> f = p.future().then([&called](int r) {
+            called = true;
+            return r;
+        });
+        p.setError(Error::TIMEOUT);
+        CHECK(called == false);
+        CHECK(f.error() == Error::TIMEOUT);
+    }
+
+    SECTION("cancellation is propagated as an error") {
+        ::Promise<int> p;
+        ::Future<int> f1 = p.future();
+        ::Future<void> f2 = f1.then([](int r) {
+        });
+        f1.cancel();
+        CHECK(f2.error() == Error::CANCELLED);
+    }
+
+    SECTION("multiple continuations are invoked in order") {
+        ::Promise<int> p;
+        ::Future<int> f = p.future();
+        std::string s;
+        f.then([&s](int r) {
+            s += 'a';
+        });
+        f.then([&s](int r) {
+            s += 'b';
+        });
+        p.setResult(1);
+        CHECK(s == "ab");
+    }
+
+    SECTION("continuation is invoked in the application context") {
+        ::Promise<int> p;
+        ::Future<int> f = p.future().then([](int r) {
+            return r + 1;
+        });
+        std::thread t([&p]() {
+            p.setResult(1);
+        });
+        t.join();
+        CHECK(f.isDone() == false); // Continuation is pending in the event queue
+        CHECK(f.result() == 2);
+    }
+}
+
+TEST_CASE("whenAll()") {
+    resetContext();
+
+    SECTION("succeeds when all futures succeed") {
+        ::Promise<int> p1, p2;
+        ::Future<void> f = whenAll({ p1.future(), p2.future() });
+        p1.setResult(1);
+        CHECK(f.isDone() == false);
+        p2.setResult(2);
+        CHECK(f.isSucceeded() == true);
+    }
+
+    SECTION("fails with the error of the first failed future") {
+        ::Promise<int> p1, p2, p3;
+        ::Future<void> f = whenAll({ p1.future(), p2.future(), p3.future() });
+        p2.setError(Error::TIMEOUT);
+        CHECK(f.error() == Error::TIMEOUT);
+        p1.setError(Error::UNKNOWN);
+        p3.setResult(3);
+        CHECK(f.error() == Error::TIMEOUT);
+    }
+
+    SECTION("succeeds for an empty set of futures") {
+        ::Future<void> f = whenAll<int, Context>(nullptr, 0);
+        CHECK(f.isSucceeded() == true);
+    }
+}
+
+TEST_CASE("whenAny()") {
+    resetContext();
+
+    SECTION("succeeds with the index of the first succeeded future") {
+        ::Promise<int> p1, p2, p3;
+        ::Future<size_t> f = whenAny({ p1.future(), p2.future(), p3.future() });
+        p1.setError(Error::UNKNOWN);
+        CHECK(f.isDone() == false);
+        p3.setResult(3);
+        CHECK(f.result() == 2);
+        p2.setResult(2);
+        CHECK(f.result() == 2);
+    }
+
+    SECTION("fails if all futures fail") {
+        ::Promise<void> p1, p2;
+        ::Future<size_t> f = whenAny({ p1.future(), p2.future() });
+        p1.setError(Error::UNKNOWN);
+        p2.setError(Error::TIMEOUT);
+        CHECK(f.error() == Error::TIMEOUT);
+    }
+}
+
 TEST_CASE("CompletionHandler") {
     SECTION("using default-constructed handler") {
         CHECK((bool)CompletionHandler() == false);
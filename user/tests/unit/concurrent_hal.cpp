@@ -0,0 +1,267 @@
+#include "concurrent_hal.h"
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+struct ThreadData {
+    std::atomic<int> count;
+    std::atomic<os_thread_t> self;
+    bool current;
+};
+
+void incrementCount(void* data) {
+    const auto d = static_cast<ThreadData*>(data);
+    ++d->count;
+}
+
+struct TimerData {
+    std::atomic<int> count;
+    os_timer_t timer;
+};
+
+void timerCallback(os_timer_t timer) {
+    void* id = nullptr;
+    os_timer_get_id(timer, &id);
+    ++static_cast<TimerData*>(id)->count;
+}
+
+template<typename PredicateT>
+bool waitUntil(PredicateT pred, unsigned timeout = 1000) {
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() >= end) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("gcc concurrent HAL") {
+    SECTION("threads") {
+        ThreadData d = {};
+        os_thread_t t = OS_THREAD_INVALID_HANDLE;
+        REQUIRE(os_thread_create(&t, "test", OS_THREAD_PRIORITY_DEFAULT, [](void* data) {
+            const auto d = static_cast<ThreadData*>(data);
+            // Wait until the handle is known to the test
+            while (!d->self) {
+                os_thread_yield();
+            }
+            d->current = os_thread_is_current(d->self);
+            os_thread_exit(nullptr);
+        }, &d, OS_THREAD_STACK_SIZE_DEFAULT) == 0);
+        REQUIRE(t != OS_THREAD_INVALID_HANDLE);
+        CHECK(!os_thread_is_current(t));
+        d.self = t;
+        REQUIRE(os_thread_join(t) == 0);
+        CHECK(d.current);
+        CHECK(os_thread_cleanup(t) == 0);
+    }
+
+    SECTION("queues") {
+        os_queue_t q = nullptr;
+        REQUIRE(os_queue_create(&q, sizeof(int), 2, nullptr) == 0);
+        int v = 1;
+        CHECK(os_queue_put(q, &v, 0, nullptr) == 0);
+        v = 2;
+        CHECK(os_queue_put(q, &v, 0, nullptr) == 0);
+        v = 3;
+        CHECK(os_queue_put(q, &v, 10, nullptr) != 0); // Queue is full
+        CHECK(os_queue_take(q, &v, 0, nullptr) == 0);
+        CHECK(v == 1);
+        CHECK(os_queue_take(q, &v, 0, nullptr) == 0);
+        CHECK(v == 2);
+        CHECK(os_queue_take(q, &v, 10, nullptr) != 0); // Queue is empty
+        // Blocking take
+        std::thread producer([q]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            int v = 4;
+            os_queue_put(q, &v, CONCURRENT_WAIT_FOREVER, nullptr);
+        });
+        CHECK(os_queue_take(q, &v, CONCURRENT_WAIT_FOREVER, nullptr) == 0);
+        CHECK(v == 4);
+        producer.join();
+        CHECK(os_queue_destroy(q, nullptr) == 0);
+    }
+
+    SECTION("mutexes") {
+        os_mutex_t m = nullptr;
+        REQUIRE(os_mutex_create(&m) == 0);
+        CHECK(os_mutex_lock(m) == 0);
+        std::thread([m]() {
+            CHECK(os_mutex_trylock(m) != 0);
+        }).join();
+        CHECK(os_mutex_unlock(m) == 0);
+        CHECK(os_mutex_trylock(m) == 0);
+        CHECK(os_mutex_unlock(m) == 0);
+        CHECK(os_mutex_destroy(m) == 0);
+
+        os_mutex_recursive_t r = nullptr;
+        REQUIRE(os_mutex_recursive_create(&r) == 0);
+        CHECK(os_mutex_recursive_lock(r) == 0);
+        CHECK(os_mutex_recursive_trylock(r) == 0);
+        std::thread([r]() {
+            CHECK(os_mutex_recursive_trylock(r) != 0);
+        }).join();
+        CHECK(os_mutex_recursive_unlock(r) == 0);
+        CHECK(os_mutex_recursive_unlock(r) == 0);
+        CHECK(os_mutex_recursive_destroy(r) == 0);
+    }
+
+    SECTION("semaphores") {
+        os_semaphore_t s = nullptr;
+        REQUIRE(os_semaphore_create(&s, 2, 1) == 0);
+        CHECK(os_semaphore_take(s, 0, false) == 0);
+        CHECK(os_semaphore_take(s, 10, false) != 0);
+        CHECK(os_semaphore_give(s, false) == 0);
+        CHECK(os_semaphore_give(s, false) == 0);
+        CHECK(os_semaphore_give(s, false) != 0); // Maximum count reached
+        CHECK(os_semaphore_take(s, 0, false) == 0);
+        CHECK(os_semaphore_take(s, 0, false) == 0);
+        CHECK(os_semaphore_destroy(s) == 0);
+    }
+
+    SECTION("multiple threads") {
+        const int N = 4;
+        ThreadData d = {};
+        os_thread_t threads[N] = {};
+        for (int i = 0; i < N; ++i) {
+            REQUIRE(os_thread_create(&threads[i], "test", OS_THREAD_PRIORITY_DEFAULT, incrementCount, &d,
+                    OS_THREAD_STACK_SIZE_DEFAULT) == 0);
+        }
+        for (int i = 0; i < N; ++i) {
+            CHECK(os_thread_join(threads[i]) == 0);
+            CHECK(os_thread_cleanup(threads[i]) == 0);
+        }
+        CHECK(d.count == N);
+    }
+
+    SECTION("thread statistics") {
+        struct Stats {
+            os_thread_t thread;
+            std::atomic<bool> done;
+            bool current;
+            bool found;
+            uint32_t cpuTime;
+        };
+        Stats d = {};
+        os_thread_t t = OS_THREAD_INVALID_HANDLE;
+        REQUIRE(os_thread_create(&t, "stats", OS_THREAD_PRIORITY_DEFAULT, [](void* data) {
+            const auto d = static_cast<Stats*>(data);
+            // Keep the CPU busy for a while
+            const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+            while (std::chrono::steady_clock::now() < end) {
+            }
+            d->current = (os_thread_current(nullptr) != OS_THREAD_INVALID_HANDLE);
+            while (!d->done) {
+                os_thread_yield();
+            }
+        }, &d, OS_THREAD_STACK_SIZE_DEFAULT) == 0);
+        d.thread = t;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(os_thread_enum_stats([](const os_thread_stats_t* stats, void* data) {
+            const auto d = static_cast<Stats*>(data);
+            if (stats->thread == d->thread) {
+                d->found = (strcmp(stats->name, "stats") == 0 && stats->type == OS_THREAD_TYPE_OTHER &&
+                        (stats->flags & OS_THREAD_STATS_FLAG_CPU_TIME));
+                d->cpuTime = stats->cpu_time;
+            }
+            return 0;
+        }, &d, nullptr) == 0);
+        d.done = true;
+        REQUIRE(os_thread_join(t) == 0);
+        CHECK(d.found);
+        CHECK(d.current);
+        CHECK(d.cpuTime >= 10);
+        CHECK(os_thread_cleanup(t) == 0);
+        // The thread is no longer reported
+        CHECK(os_thread_enum_stats([](const os_thread_stats_t* stats, void* data) {
+            return (stats->thread == data) ? 1 : 0;
+        }, t, nullptr) == 0);
+    }
+
+    SECTION("statistics of threads not created via the HAL") {
+        struct Stats {
+            std::atomic<os_thread_t> thread;
+            std::atomic<bool> done;
+            bool found;
+        };
+        Stats d = {};
+        std::thread t([&d]() {
+            d.thread = os_thread_current(nullptr); // Adopts the thread
+            while (!d.done) {
+                os_thread_yield();
+            }
+        });
+        REQUIRE(waitUntil([&d]() { return d.thread != OS_THREAD_INVALID_HANDLE; }));
+        REQUIRE(os_thread_enum_stats([](const os_thread_stats_t* stats, void* data) {
+            const auto d = static_cast<Stats*>(data);
+            if (stats->thread == d->thread) {
+                d->found = (stats->type == OS_THREAD_TYPE_OTHER && (stats->flags & OS_THREAD_STATS_FLAG_CPU_TIME));
+            }
+            return 0;
+        }, &d, nullptr) == 0);
+        CHECK(d.found);
+        CHECK(os_thread_join(d.thread) != 0); // Not joinable via the HAL
+        d.done = true;
+        t.join();
+        // The thread is no longer reported after it exits
+        os_thread_t thread = d.thread;
+        CHECK(os_thread_enum_stats([](const os_thread_stats_t* stats, void* data) {
+            return (stats->thread == data) ? 1 : 0;
+        }, thread, nullptr) == 0);
+    }
+
+    SECTION("one-shot timers") {
+        TimerData d = {};
+        REQUIRE(os_timer_create(&d.timer, 10, timerCallback, &d, true, nullptr) == 0);
+        CHECK(!os_timer_is_active(d.timer, nullptr));
+        CHECK(os_timer_change(d.timer, OS_TIMER_CHANGE_START, false, 0, 0, nullptr) == 0);
+        CHECK(os_timer_is_active(d.timer, nullptr));
+        CHECK(waitUntil([&d]() { return d.count == 1; }));
+        CHECK(waitUntil([&d]() { return !os_timer_is_active(d.timer, nullptr); }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(d.count == 1);
+        CHECK(os_timer_destroy(d.timer, nullptr) == 0);
+    }
+
+    SECTION("periodic timers") {
+        TimerData d = {};
+        REQUIRE(os_timer_create(&d.timer, 5, timerCallback, &d, false, nullptr) == 0);
+        CHECK(os_timer_change(d.timer, OS_TIMER_CHANGE_START, false, 0, 0, nullptr) == 0);
+        CHECK(waitUntil([&d]() { return d.count >= 3; }));
+        CHECK(os_timer_change(d.timer, OS_TIMER_CHANGE_STOP, false, 0, 0, nullptr) == 0);
+        CHECK(!os_timer_is_active(d.timer, nullptr));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20)); // Let a running callback finish
+        const int count = d.count;
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(d.count == count);
+        // Changing the period restarts the timer
+        CHECK(os_timer_change(d.timer, OS_TIMER_CHANGE_PERIOD, false, 10, 0, nullptr) == 0);
+        CHECK(os_timer_is_active(d.timer, nullptr));
+        CHECK(waitUntil([&d, count]() { return d.count > count; }));
+        CHECK(os_timer_destroy(d.timer, nullptr) == 0);
+    }
+
+    SECTION("timers destroyed from their callback") {
+        TimerData d = {};
+        REQUIRE(os_timer_create(&d.timer, 1, [](os_timer_t timer) {
+            void* id = nullptr;
+            os_timer_get_id(timer, &id);
+            ++static_cast<TimerData*>(id)->count;
+            os_timer_destroy(timer, nullptr);
+        }, &d, false, nullptr) == 0);
+        CHECK(os_timer_change(d.timer, OS_TIMER_CHANGE_START, false, 0, 0, nullptr) == 0);
+        CHECK(waitUntil([&d]() { return d.count == 1; }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(d.count == 1);
+    }
+}
@@ -0,0 +1,128 @@
+#include "connection_quality.h"
+
+#include "catch.hpp"
+
+using particle::protocol::ConnectionQuality;
+
+TEST_CASE("ConnectionQuality") {
+    ConnectionQuality q;
+
+    SECTION("uses the default timeouts until the round trip time is sampled") {
+        CHECK_FALSE(q.has_samples());
+        CHECK(q.srtt() == 0);
+        CHECK(q.ack_timeout() == ConnectionQuality::DEFAULT_ACK_TIMEOUT);
+        CHECK(q.ping_timeout(30000) == 30000);
+        // Retransmitted messages are not sampled
+        q.message_acknowledged(5000, 2, 10, 5000);
+        CHECK_FALSE(q.has_samples());
+        CHECK(q.ack_timeout() == ConnectionQuality::DEFAULT_ACK_TIMEOUT);
+    }
+
+    SECTION("estimates the round trip time as described in RFC 6298") {
+        q.message_acknowledged(1000, 1, 10, 1000);
+        CHECK(q.has_samples());
+        CHECK(q.srtt() == 1000);
+        CHECK(q.rttvar() == 500);
+        CHECK(q.ack_timeout() == 3000); // SRTT + 4 * RTTVAR
+        q.message_acknowledged(2000, 1, 10, 3000);
+        CHECK(q.srtt() == 1125); // 7/8 * 1000 + 1/8 * 2000
+        CHECK(q.rttvar() == 625); // 3/4 * 500 + 1/4 * 1000
+        CHECK(q.ack_timeout() == 1125 + 4 * 625);
+    }
+
+    SECTION("converges to a stable round trip time") {
+        for (int i = 0; i < 100; ++i) {
+            q.message_acknowledged(3000, 1, 10, i * 3000);
+        }
+        CHECK(q.srtt() == 3000);
+        CHECK(q.rttvar() < 10);
+        CHECK(q.ack_timeout() == 3000 + ConnectionQuality::MIN_RTT_VARIATION);
+        CHECK(q.ping_timeout(30000) == (3000 + ConnectionQuality::MIN_RTT_VARIATION) * ConnectionQuality::PING_TIMEOUT_FACTOR);
+    }
+
+    SECTION("clamps the timeouts") {
+        for (int i = 0; i < 100; ++i) {
+            q.message_acknowledged(20, 1, 10, i * 20);
+        }
+        CHECK(q.srtt() == 20);
+        CHECK(q.ack_timeout() == ConnectionQuality::MIN_ACK_TIMEOUT);
+        CHECK(q.ping_timeout(30000) == ConnectionQuality::MIN_PING_TIMEOUT);
+        for (int i = 0; i < 100; ++i) {
+            q.message_acknowledged(30000, 1, 10, i * 30000);
+        }
+        CHECK(q.ack_timeout() == ConnectionQuality::MAX_ACK_TIMEOUT);
+        CHECK(q.ping_timeout(30000) == ConnectionQuality::MAX_PING_TIMEOUT);
+    }
+
+    SECTION("scales the timeouts that depend on retransmission timing") {
+        CHECK(q.scaled_timeout(45000) == 45000);
+        for (int i = 0; i < 100; ++i) {
+            q.message_acknowledged(20, 1, 10, i * 20);
+        }
+        CHECK(q.scaled_timeout(45000) == 45000);
+        for (int i = 0; i < 100; ++i) {
+            q.message_acknowledged(30000, 1, 10, i * 30000);
+        }
+        CHECK(q.scaled_timeout(45000) == 45000 * ConnectionQuality::MAX_ACK_TIMEOUT / ConnectionQuality::DEFAULT_ACK_TIMEOUT);
+    }
+
+    SECTION("backs off the ACK timeout until the next sample") {
+        for (int i = 0; i < 100; ++i) {
+            q.message_acknowledged(20, 1, 10, i * 20);
+        }
+        CHECK(q.ack_timeout() == ConnectionQuality::MIN_ACK_TIMEOUT);
+        // Retransmitted messages are not sampled, but the timeout still grows
+        q.retransmission_timeout();
+        CHECK(q.ack_timeout() == ConnectionQuality::MIN_ACK_TIMEOUT * 2);
+        q.message_acknowledged(3000, 2, 10, 10000);
+        CHECK(q.ack_timeout() == ConnectionQuality::MIN_ACK_TIMEOUT * 2);
+        for (int i = 0; i < 10; ++i) {
+            q.retransmission_timeout();
+        }
+        CHECK(q.ack_timeout() == ConnectionQuality::MAX_ACK_TIMEOUT);
+        // A new sample replaces the backed off value
+        q.message_acknowledged(20, 1, 10, 20000);
+        CHECK(q.ack_timeout() == ConnectionQuality::MIN_ACK_TIMEOUT);
+    }
+
+    SECTION("discards the estimates on reset") {
+        q.message_acknowledged(3000, 1, 10, 3000);
+        q.message_timeout(2);
+        q.reset();
+        CHECK_FALSE(q.has_samples());
+        CHECK(q.srtt() == 0);
+        CHECK(q.ack_timeout() == ConnectionQuality::DEFAULT_ACK_TIMEOUT);
+        CHECK(q.loss_rate() == 0);
+    }
+
+    SECTION("estimates the loss rate") {
+        CHECK(q.loss_rate() == 0);
+        q.message_timeout(4);
+        const int lossAfterTimeout = q.loss_rate();
+        CHECK(lossAfterTimeout > 0);
+        // Acknowledgements after a retransmission count the lost transmission
+        q.message_acknowledged(100, 2, 10, 100);
+        CHECK(q.loss_rate() > 0);
+        for (int i = 0; i < 200; ++i) {
+            q.message_acknowledged(100, 1, 10, i * 100);
+        }
+        CHECK(q.loss_rate() < lossAfterTimeout / 10);
+        // Every other transmission is lost
+        for (int i = 0; i < 500; ++i) {
+            q.message_acknowledged(100, 2, 10, i * 100);
+        }
+        CHECK(q.loss_rate() >= 450);
+        CHECK(q.loss_rate() <= 550);
+    }
+
+    SECTION("estimates the throughput") {
+        CHECK(q.throughput() == 0);
+        system_tick_t t = 1000;
+        for (int i = 0; i < 20; ++i) {
+            t += 1000;
+            q.message_acknowledged(100, 1, 500, t); // 500 bytes per second
+        }
+        CHECK(q.throughput() >= 450);
+        CHECK(q.throughput() <= 550);
+    }
+}
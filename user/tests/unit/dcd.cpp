@@ -443,3 +443,124 @@ SCENARIO_METHOD(TestDCD, "secondary (invalid_v2) sector is selected as valid if
     // Validate data
     assertMemoryEqual(read(0), temp, sizeof(temp));
 }
+
+const unsigned TestJournalSize = 1024;
+
+class TestJournalDCD : public DCD<TestStore, TestSectorSize, TestBase, TestBase+TestSectorSize, calcCrc, TestJournalSize> {
+};
+
+SCENARIO_METHOD(TestJournalDCD, "DCD journal reduces the length by the journal size", "[dcd]") {
+    REQUIRE(Length == TestSectorSize-8-32-TestJournalSize);
+}
+
+SCENARIO_METHOD(TestJournalDCD, "DCD journal appends small writes without erasing", "[dcd]") {
+    REQUIRE_FALSE(write(23, "abcdef", 6));
+    const Sector current = currentSector();
+    store.resetEraseCount();
+
+    REQUIRE_FALSE(write(23, "batman", 6));
+    REQUIRE_FALSE(write(24, "batman", 6));
+
+    REQUIRE(store.getEraseCount() == 0);
+    REQUIRE(currentSector() == current);
+    REQUIRE(isCRCValid(current));
+
+    uint8_t data[10];
+    REQUIRE_FALSE(read(22, data, sizeof(data)));
+    assertMemoryEqual(data, (const uint8_t*)"\xFF" "bbatman\xFF\xFF", sizeof(data));
+}
+
+SCENARIO_METHOD(TestJournalDCD, "DCD journal is merged into the sector when full", "[dcd]") {
+    uint8_t expected[64];
+    memset(expected, 0xFF, sizeof(expected));
+    REQUIRE_FALSE(write(0, "initial", 7));
+    const Sector current = currentSector();
+
+    // the first write takes 16 bytes of the journal and each 4-byte write 12 bytes,
+    // so the last write doesn't fit
+    for (uint32_t i=0; i<(TestJournalSize-16)/12+1; i++) {
+        REQUIRE_FALSE(write((i%16)*4, &i, sizeof(i)));
+        memcpy(expected+(i%16)*4, &i, sizeof(i));
+    }
+
+    REQUIRE(currentSector() == alternateSectorTo(current));
+    REQUIRE(isCRCValid(currentSector()));
+    REQUIRE(isJournalEmpty(currentSector()));
+    uint8_t data[sizeof(expected)];
+    REQUIRE_FALSE(read(0, data, sizeof(data)));
+    assertMemoryEqual(data, expected, sizeof(expected));
+    assertMemoryEqual(read(0), expected, sizeof(expected));
+}
+
+SCENARIO_METHOD(TestJournalDCD, "DCD journal is not used for large writes", "[dcd]") {
+    REQUIRE_FALSE(write(23, "batman", 6));
+    const Sector current = currentSector();
+
+    uint8_t expected[journalMaxData+1];
+    for (unsigned i=0; i<sizeof(expected); i++)
+        expected[i] = rand();
+    REQUIRE_FALSE(write(100, expected, sizeof(expected)));
+
+    REQUIRE(currentSector() == alternateSectorTo(current));
+    REQUIRE(isJournalEmpty(currentSector()));
+    assertMemoryEqual(read(23), (const uint8_t*)"batman", 6);
+    assertMemoryEqual(read(100), expected, sizeof(expected));
+}
+
+SCENARIO_METHOD(TestJournalDCD, "DCD journal append is atomic if partial failure", "[dcd]") {
+    for (int write_count=0; write_count<int(JournalRecord::sizeFor(6)); write_count++)
+    {
+        store.eraseSector(TestBase);
+        store.eraseSector(TestBase+TestSectorSize);
+        REQUIRE_FALSE(write(23, "batman", 6));
+
+        // mock a power failure after a certain number of writes
+        store.setWriteCount(write_count);
+        CAPTURE(write_count);
+        REQUIRE(write(23, "7890-!", 6));
+        store.setWriteCount(INT_MAX);
+
+        uint8_t data[6];
+        REQUIRE_FALSE(read(23, data, sizeof(data)));
+        assertMemoryEqual(data, (const uint8_t*)"batman", 6);
+
+        // the next write rewrites the sector if the journal was damaged
+        REQUIRE_FALSE(write(24, "robin", 5));
+        REQUIRE_FALSE(read(23, data, sizeof(data)));
+        assertMemoryEqual(data, (const uint8_t*)"brobin", 6);
+    }
+}
+
+SCENARIO_METHOD(TestJournalDCD, "DCD journal is merged into the sector when a pointer is read", "[dcd]") {
+    REQUIRE_FALSE(write(23, "batman", 6));
+    REQUIRE_FALSE(isJournalEmpty(currentSector()));
+
+    assertMemoryEqual(read(23), (const uint8_t*)"batman", 6);
+    REQUIRE(isJournalEmpty(currentSector()));
+    REQUIRE(isCRCValid(currentSector()));
+}
+
+SCENARIO_METHOD(TestJournalDCD, "DCD journal is not merged for a pointer before the journaled writes", "[dcd]") {
+    REQUIRE_FALSE(write(23, "batman", 6));
+    const Sector current = currentSector();
+    store.resetEraseCount();
+
+    REQUIRE_FALSE(read(29) == nullptr);
+    REQUIRE(store.getEraseCount() == 0);
+    REQUIRE(currentSector() == current);
+    REQUIRE_FALSE(isJournalEmpty(current));
+}
+
+SCENARIO_METHOD(TestJournalDCD, "DCD pointer read fails if the journal can't be merged", "[dcd]") {
+    REQUIRE_FALSE(write(23, "batman", 6));
+    const Sector current = currentSector();
+
+    store.setWriteCount(0);
+    REQUIRE(read(23) == nullptr);
+    store.setWriteCount(INT_MAX);
+
+    uint8_t data[6];
+    REQUIRE_FALSE(read(23, data, sizeof(data)));
+    assertMemoryEqual(data, (const uint8_t*)"batman", 6);
+    REQUIRE(currentSector() == current);
+}
@@ -0,0 +1,173 @@
+#include "system_diag_snapshot.h"
+
+#include "catch.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace {
+
+using namespace particle;
+
+struct Entry {
+    uint16_t id;
+    int type;
+    int32_t value;
+
+    bool operator==(const Entry& e) const {
+        return id == e.id && type == e.type && value == e.value;
+    }
+};
+
+uint32_t decodeVarint(const char*& p) {
+    uint32_t val = 0;
+    unsigned shift = 0;
+    uint8_t b = 0;
+    do {
+        b = *p++;
+        val |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return val;
+}
+
+class Report {
+public:
+    explicit Report(DiagnosticsSnapshot& snapshot, bool full = false) :
+            snapshot_(snapshot),
+            buf_(DiagnosticsSnapshot::HEADER_SIZE) {
+        snapshot_.begin(buf_.data(), full);
+    }
+
+    Report& value(uint16_t id, int32_t value) {
+        append(snapshot_.encodeValue(id, value, buf()));
+        return *this;
+    }
+
+    Report& error(uint16_t id, int error) {
+        append(snapshot_.encodeError(id, error, buf()));
+        return *this;
+    }
+
+    Report& commit() {
+        snapshot_.commit();
+        return *this;
+    }
+
+    int type() const {
+        return buf_[2];
+    }
+
+    int seq() const {
+        return (uint8_t)buf_[3];
+    }
+
+    std::vector<Entry> entries() const {
+        std::vector<Entry> entries;
+        const char* p = buf_.data() + DiagnosticsSnapshot::HEADER_SIZE;
+        while (p < buf_.data() + buf_.size()) {
+            const uint32_t key = decodeVarint(p);
+            const uint32_t v = decodeVarint(p);
+            entries.push_back(Entry{ (uint16_t)(key >> 2), (int)(key & 3), (int32_t)((v >> 1) ^ -(int32_t)(v & 1)) });
+        }
+        return entries;
+    }
+
+private:
+    DiagnosticsSnapshot& snapshot_;
+    std::vector<char> buf_;
+
+    char* buf() {
+        buf_.resize(buf_.size() + DiagnosticsSnapshot::MAX_ENTRY_SIZE);
+        return buf_.data() + buf_.size() - DiagnosticsSnapshot::MAX_ENTRY_SIZE;
+    }
+
+    void append(size_t n) {
+        REQUIRE(n <= DiagnosticsSnapshot::MAX_ENTRY_SIZE);
+        buf_.resize(buf_.size() - DiagnosticsSnapshot::MAX_ENTRY_SIZE + n);
+    }
+};
+
+const int DELTA = DiagnosticsSnapshot::DELTA_ENTRY;
+const int VALUE = DiagnosticsSnapshot::VALUE_ENTRY;
+const int ERROR = DiagnosticsSnapshot::ERROR_ENTRY;
+
+} // namespace
+
+TEST_CASE("DiagnosticsSnapshot") {
+    DiagnosticsSnapshot snapshot;
+
+    SECTION("first report is a full snapshot") {
+        Report r(snapshot);
+        r.value(1, 100).value(2, -5).value(300, 0).error(4, -120).commit();
+        CHECK(r.type() == DiagnosticsSnapshot::FULL_SNAPSHOT);
+        CHECK(r.seq() == 0);
+        CHECK(r.entries() == std::vector<Entry>({ { 1, VALUE, 100 }, { 2, VALUE, -5 }, { 300, VALUE, 0 }, { 4, ERROR, -120 } }));
+    }
+
+    SECTION("only changed values are reported") {
+        Report(snapshot).value(1, 100).value(2, 200).value(3, 300).commit();
+        Report r(snapshot);
+        r.value(1, 100).value(2, 150).value(3, 0x7fffffff).commit();
+        CHECK(r.type() == DiagnosticsSnapshot::DELTA);
+        CHECK(r.seq() == 1);
+        CHECK(r.entries() == std::vector<Entry>({ { 2, DELTA, -50 }, { 3, DELTA, 0x7fffffff - 300 } }));
+        Report r2(snapshot);
+        r2.value(1, 100).value(2, 150).value(3, 0x7fffffff).value(4, 1).commit();
+        CHECK(r2.entries() == std::vector<Entry>({ { 4, VALUE, 1 } })); // New source
+    }
+
+    SECTION("values of uncommitted reports are not stored") {
+        Report(snapshot).value(1, 100).commit();
+        Report(snapshot).value(1, 110); // Not committed
+        Report r(snapshot);
+        r.value(1, 120).commit();
+        CHECK(r.seq() == 1);
+        CHECK(r.entries() == std::vector<Entry>({ { 1, DELTA, 20 } }));
+    }
+
+    SECTION("value following an error is reported as is") {
+        Report(snapshot).value(1, 100).commit();
+        Report(snapshot).error(1, -1).commit();
+        Report r(snapshot);
+        r.value(1, 100).commit();
+        CHECK(r.entries() == std::vector<Entry>({ { 1, VALUE, 100 } }));
+    }
+
+    SECTION("full snapshot is generated periodically") {
+        Report(snapshot).value(1, 100).commit();
+        for (unsigned i = 1; i < DiagnosticsSnapshot::FULL_SNAPSHOT_INTERVAL; ++i) {
+            Report r(snapshot);
+            r.value(1, 100).commit();
+            CHECK(r.type() == DiagnosticsSnapshot::DELTA);
+            CHECK(r.entries().empty());
+        }
+        Report r(snapshot);
+        r.value(1, 100).commit();
+        CHECK(r.type() == DiagnosticsSnapshot::FULL_SNAPSHOT);
+        CHECK(r.entries() == std::vector<Entry>({ { 1, VALUE, 100 } }));
+    }
+
+    SECTION("full snapshot can be forced") {
+        Report(snapshot).value(1, 100).commit();
+        Report r(snapshot, true /* full */);
+        r.value(1, 100).commit();
+        CHECK(r.type() == DiagnosticsSnapshot::FULL_SNAPSHOT);
+        CHECK(r.entries() == std::vector<Entry>({ { 1, VALUE, 100 } }));
+    }
+
+    SECTION("sources exceeding the capacity are reported as is") {
+        const uint16_t n = DiagnosticsSnapshot::MAX_SOURCES + 1;
+        Report r1(snapshot);
+        for (uint16_t id = 0; id < n; ++id) {
+            r1.value(id, id);
+        }
+        r1.commit();
+        Report r2(snapshot);
+        for (uint16_t id = 0; id < n; ++id) {
+            r2.value(id, id);
+        }
+        r2.commit();
+        CHECK(r2.entries() == std::vector<Entry>({ { (uint16_t)(n - 1), VALUE, n - 1 } }));
+    }
+}
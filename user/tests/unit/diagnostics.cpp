@@ -3,8 +3,12 @@
 #include "tools/catch.h"
 
 #include <functional>
+#include <thread>
+#include <atomic>
+#include <vector>
 #include <unordered_set>
 #include <cassert>
+#include <cstring>
 
 namespace {
 
@@ -524,6 +528,49 @@ TEST_CASE("Service API") {
         }
     }
 
+    SECTION("diag_snapshot()") {
+        auto d1 = DiagSource(1).type(DIAG_TYPE_INT).get([](GetData d) {
+            return d.setInt(123);
+        }).add();
+        auto d2 = DiagSource(2).type(DIAG_TYPE_HISTOGRAM).add();
+        auto d3 = DiagSource(3).type(DIAG_TYPE_INT).get([](GetData d) {
+            return SYSTEM_ERROR_UNKNOWN;
+        }).add();
+
+        SECTION("fails if the service is not started") {
+            size_t count = 0;
+            CHECK(diag_snapshot(nullptr, &count, nullptr) == SYSTEM_ERROR_INVALID_STATE);
+        }
+
+        SECTION("returns the number of integer data sources") {
+            diag.start();
+            size_t count = 0;
+            CHECK(diag_snapshot(nullptr, &count, nullptr) == 0);
+            CHECK(count == 2);
+        }
+
+        SECTION("copies the values of the integer data sources") {
+            diag.start();
+            diag_snapshot_entry e[3] = {};
+            size_t count = 3;
+            CHECK(diag_snapshot(e, &count, nullptr) == 0);
+            REQUIRE(count == 2);
+            CHECK(e[0].id == 1);
+            CHECK(e[0].flags == 0);
+            CHECK(e[0].value == 123);
+            CHECK(e[1].id == 3);
+            CHECK(e[1].flags == DIAG_SNAPSHOT_ENTRY_FLAG_ERROR);
+            CHECK(e[1].value == SYSTEM_ERROR_UNKNOWN);
+        }
+
+        SECTION("fails if the buffer is too small") {
+            diag.start();
+            diag_snapshot_entry e[1] = {};
+            size_t count = 1;
+            CHECK(diag_snapshot(e, &count, nullptr) == SYSTEM_ERROR_TOO_LARGE);
+        }
+    }
+
     SECTION("diag_command()") {
         SECTION("can be used to start the diagnostics service") {
             CHECK(diag_command(DIAG_SERVICE_CMD_START, nullptr, nullptr) == 0);
@@ -624,4 +671,188 @@ TEST_CASE("Wiring API") {
         testPersistentEnumDiagnosticData<PersistentEnumDiagnosticData, NoConcurrency>(diag);
         // testPersistentEnumDiagnosticData<PersistentEnumDiagnosticData, AtomicConcurrency>(diag);
     }
+
+    SECTION("Diagnostics") {
+        AtomicIntegerDiagnosticData d1(1);
+        SimpleIntegerDiagnosticData d2(2);
+        AtomicEnumDiagnosticData<int> d3(3, 0);
+        SimpleHistogramDiagnosticData d4(4);
+        diag.start();
+
+        SECTION("snapshot() copies the values of the integer data sources") {
+            d1 = 1;
+            d2 = -2;
+            d3 = 3;
+            const size_t n = Diagnostics::snapshotSize();
+            REQUIRE(n == 3);
+            std::vector<Diagnostics::Entry> e(n);
+            size_t count = e.size();
+            CHECK(Diagnostics::snapshot(e.data(), count) == 0);
+            REQUIRE(count == 3);
+            CHECK(e[0].value == 1);
+            CHECK(e[1].value == -2);
+            CHECK(e[2].value == 3);
+            // Values are read directly, so the snapshot reflects the current values
+            d1 += 10;
+            ++d2;
+            CHECK(Diagnostics::snapshot(e.data(), count) == 0);
+            CHECK(e[0].value == 11);
+            CHECK(e[1].value == -1);
+        }
+
+        SECTION("find() looks up an entry by source ID") {
+            d2 = 5;
+            Diagnostics::Entry e[3] = {};
+            size_t count = 3;
+            REQUIRE(Diagnostics::snapshot(e, count) == 0);
+            const auto entry = Diagnostics::find(e, count, 2);
+            REQUIRE(entry != nullptr);
+            CHECK(entry->value == 5);
+            CHECK(Diagnostics::find(e, count, 4) == nullptr);
+        }
+
+        SECTION("snapshot() can be called concurrently") {
+            d2 = 2;
+            std::atomic<bool> done(false);
+            std::atomic<int> errors(0);
+            std::thread writer([&]() {
+                while (!done) {
+                    ++d1;
+                }
+            });
+            std::vector<std::thread> readers;
+            for (int i = 0; i < 4; ++i) {
+                readers.emplace_back([&]() {
+                    for (int j = 0; j < 10000; ++j) {
+                        Diagnostics::Entry e[3] = {};
+                        size_t count = 3;
+                        if (Diagnostics::snapshot(e, count) != 0 || count != 3 || e[0].id != 1 || e[0].value < 0 ||
+                                e[1].id != 2 || e[1].value != 2 || e[2].id != 3) {
+                            ++errors;
+                        }
+                    }
+                });
+            }
+            for (auto& t: readers) {
+                t.join();
+            }
+            done = true;
+            writer.join();
+            CHECK(errors == 0);
+        }
+    }
+
+    SECTION("AbstractHistogramDiagnosticData") {
+        SECTION("bucketIndex()") {
+            // Values below 2^subBucketBits have a bucket each
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(0, 2, 64) == 0);
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(3, 2, 64) == 3);
+            // Each following power of two range is split into 2^subBucketBits buckets
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(4, 2, 64) == 4);
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(7, 2, 64) == 7);
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(8, 2, 64) == 8);
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(9, 2, 64) == 8);
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(10, 2, 64) == 9);
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(15, 2, 64) == 11);
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(1000, 2, 64) == 35);
+            // Values exceeding the range of the last bucket are counted in the last bucket
+            CHECK(AbstractHistogramDiagnosticData::bucketIndex(0xffffffff, 2, 64) == 63);
+        }
+
+        SECTION("bucketLowerBound()") {
+            CHECK(AbstractHistogramDiagnosticData::bucketLowerBound(3, 2) == 3);
+            CHECK(AbstractHistogramDiagnosticData::bucketLowerBound(8, 2) == 8);
+            CHECK(AbstractHistogramDiagnosticData::bucketLowerBound(9, 2) == 10);
+            CHECK(AbstractHistogramDiagnosticData::bucketLowerBound(35, 2) == 896);
+            CHECK(AbstractHistogramDiagnosticData::bucketLowerBound(63, 2) == 114688);
+            for (uint32_t val = 0; val < 100000; val += 7) {
+                const unsigned i = AbstractHistogramDiagnosticData::bucketIndex(val, 2, 64);
+                CHECK(AbstractHistogramDiagnosticData::bucketLowerBound(i, 2) <= val);
+                CHECK(AbstractHistogramDiagnosticData::bucketLowerBound(i + 1, 2) > val);
+            }
+        }
+    }
+
+    SECTION("HistogramDiagnosticData") {
+        HistogramDiagnosticData<2, 16> d(1, "hist");
+        diag.start();
+
+        uint32_t buf[AbstractHistogramDiagnosticData::MAX_DATA_SIZE / sizeof(uint32_t)] = {};
+        const auto hist = (const diag_histogram*)buf;
+        size_t size = sizeof(buf);
+
+        SECTION("is registered with the histogram type") {
+            const diag_source* src = nullptr;
+            REQUIRE(diag_get_source(1, &src, nullptr) == 0);
+            CHECK(src->type == DIAG_TYPE_HISTOGRAM);
+            CHECK(strcmp(src->name, "hist") == 0);
+        }
+
+        SECTION("reports an empty histogram initially") {
+            REQUIRE(AbstractDiagnosticData::get(1, buf, size) == 0);
+            CHECK(size == sizeof(diag_histogram) + 16 * sizeof(uint32_t));
+            CHECK(hist->size == sizeof(diag_histogram));
+            CHECK(hist->sub_bucket_bits == 2);
+            CHECK(hist->bucket_count == 16);
+            CHECK(hist->count == 0);
+            CHECK(hist->sum == 0);
+            CHECK(hist->min == 0);
+            CHECK(hist->max == 0);
+        }
+
+        SECTION("record()") {
+            d.record(1);
+            d.record(9);
+            d.record(10);
+            d.record(100000);
+            CHECK(d.count() == 4);
+            REQUIRE(AbstractDiagnosticData::get(1, buf, size) == 0);
+            CHECK(hist->count == 4);
+            CHECK(hist->sum == 100020);
+            CHECK(hist->min == 1);
+            CHECK(hist->max == 100000);
+            const uint32_t* b = AbstractHistogramDiagnosticData::buckets(hist);
+            CHECK(b[1] == 1);
+            CHECK(b[8] == 1);
+            CHECK(b[9] == 1);
+            CHECK(b[15] == 1);
+        }
+
+        SECTION("reset()") {
+            d.record(5);
+            d.reset();
+            CHECK(d.count() == 0);
+            REQUIRE(AbstractDiagnosticData::get(1, buf, size) == 0);
+            CHECK(hist->count == 0);
+            CHECK(hist->sum == 0);
+        }
+
+        SECTION("get() fails if the buffer is too small") {
+            size = sizeof(diag_histogram);
+            CHECK(AbstractDiagnosticData::get(1, buf, size) == SYSTEM_ERROR_TOO_LARGE);
+        }
+
+        SECTION("accepts NULL as the data argument") {
+            size = 0;
+            CHECK(AbstractDiagnosticData::get(1, nullptr, size) == 0);
+            CHECK(size == sizeof(diag_histogram) + 16 * sizeof(uint32_t));
+        }
+    }
+
+    SECTION("TimerDiagnosticData") {
+        TimerDiagnosticData<> d(1);
+        diag.start();
+
+        CHECK_FALSE(d.isRunning());
+        CHECK_FALSE(d.stop());
+        d.start();
+        CHECK(d.isRunning());
+        CHECK(d.stop());
+        CHECK_FALSE(d.isRunning());
+        CHECK(d.count() == 1);
+        d.start();
+        d.cancel();
+        CHECK_FALSE(d.stop());
+        CHECK(d.count() == 1);
+    }
 }
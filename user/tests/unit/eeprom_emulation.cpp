@@ -4,6 +4,7 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include "eeprom_emulation.h"
 #include "flash_storage.h"
 
@@ -876,17 +877,38 @@ TEST_CASE("Copy records during page swap", "[eeprom]")
 
         performSwap();
 
-        THEN("The records are copied from small ids to large ids")
+        THEN("The records are copied from the most recent to the oldest")
         {
             tester.requireContents(toAddress, PAGE_ACTIVE, {
+                Record(2, 0xCC),
                 Record(0, 0xAA),
                 Record(1, 0xBB),
-                Record(2, 0xCC),
                 Record(3, 0xDD)
             });
         }
     }
 
+    SECTION("Records far apart")
+    {
+        eeprom.put(300, 0xDD);
+        eeprom.put(1, 0xBB);
+        eeprom.put(eeprom.capacity() - 1, 0xEE);
+        eeprom.put(130, 0xCC);
+        eeprom.put(300, 0xD0);
+
+        performSwap();
+
+        THEN("The latest record of each id is copied, from the most recent to the oldest")
+        {
+            tester.requireContents(toAddress, PAGE_ACTIVE, {
+                Record(300, 0xD0),
+                Record(130, 0xCC),
+                Record(eeprom.capacity() - 1, 0xEE),
+                Record(1, 0xBB)
+            });
+        }
+    }
+
     SECTION("Except specified records")
     {
         eeprom.put(3, 0xDD);
@@ -927,9 +949,9 @@ TEST_CASE("Copy records during page swap", "[eeprom]")
         THEN("Records up to the invalid record are copied")
         {
             tester.requireContents(toAddress, PAGE_ACTIVE, {
+                Record(2, 0xCC),
                 Record(0, 0xAA),
                 Record(1, 0xBB),
-                Record(2, 0xCC),
                 Record(3, 0xDD)
             });
         }
@@ -1338,3 +1360,312 @@ TEST_CASE("Page swap with data in multiple batches", "[eeprom]")
         REQUIRE(dataRead == data);
     }
 }
+
+TEST_CASE("RAM cache", "[eeprom]")
+{
+    using CachedTestEEPROM = EEPROMEmulation<TestStore, PageBase1, PageSize1, PageBase2, PageSize2, true>;
+    CachedTestEEPROM eeprom;
+
+    // Reads the values of all indexes from the records in Flash
+    auto readFromFlash = [&]()
+    {
+        std::vector<uint8_t> values(eeprom.capacity(), 0xFF);
+        eeprom.forEachValidRecord(eeprom.getActivePage(), [&](uintptr_t address, const CachedTestEEPROM::Record &record)
+        {
+            if(record.index < values.size())
+            {
+                values[record.index] = record.data;
+            }
+        });
+        return values;
+    };
+
+    auto readAll = [&]()
+    {
+        std::vector<uint8_t> values(eeprom.capacity());
+        eeprom.get(0, values.data(), values.size());
+        return values;
+    };
+
+    SECTION("The cache is built from the records of the active page")
+    {
+        CachedTestEEPROM::Record records[] = {
+            CachedTestEEPROM::Record(0, 1),
+            CachedTestEEPROM::Record(1, 2),
+            CachedTestEEPROM::Record(0, 3)
+        };
+        uint32_t status = PAGE_ACTIVE;
+        eeprom.store.eraseSector(PageBase1);
+        eeprom.store.eraseSector(PageBase2);
+        eeprom.store.write(PageBase2, &status, sizeof(status));
+        eeprom.store.write(PageBase2 + sizeof(status), records, sizeof(records));
+
+        eeprom.init();
+
+        uint8_t values[3];
+        eeprom.get(0, values, sizeof(values));
+        REQUIRE(values[0] == 3);
+        REQUIRE(values[1] == 2);
+        REQUIRE(values[2] == 0xFF);
+
+        THEN("reads don't access the Flash")
+        {
+            eeprom.store.eraseSector(PageBase2);
+            eeprom.get(0, values, sizeof(values));
+            REQUIRE(values[0] == 3);
+        }
+    }
+
+    SECTION("Writes and page swaps keep the cache consistent with Flash")
+    {
+        eeprom.init();
+
+        // Write ranges of random values until the pages have been swapped several times
+        std::vector<uint8_t> expected(eeprom.capacity(), 0xFF);
+        unsigned seed = 1;
+        for(int i = 0; i < 3000; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            uint16_t length = 1 + (seed >> 16) % 16;
+            uint16_t index = (seed >> 8) % (eeprom.capacity() - length);
+            uint8_t data[16];
+            for(uint16_t j = 0; j < length; j++)
+            {
+                data[j] = (seed >> j) & 0x0F; // Repeating values, so that some records are unchanged
+            }
+            eeprom.put(index, data, length);
+            std::memcpy(&expected[index], data, length);
+        }
+        REQUIRE(eeprom.store.getEraseCount() > 2);
+
+        REQUIRE(readAll() == expected);
+        REQUIRE(readFromFlash() == expected);
+    }
+
+    SECTION("An interrupted write is not visible")
+    {
+        eeprom.init();
+        eeprom.put(10, 0xAA);
+
+        uint8_t values[] = { 1, 2, 3 };
+        eeprom.store.discardWritesAfter(6, [&] {
+            eeprom.put(10, values, sizeof(values));
+        });
+
+        uint8_t value;
+        eeprom.get(10, value);
+        REQUIRE(value == 0xAA);
+        REQUIRE(readAll() == readFromFlash());
+    }
+
+    SECTION("Clear resets the cache")
+    {
+        eeprom.init();
+        eeprom.put(0, 0xAA);
+        eeprom.clear();
+
+        uint8_t value;
+        eeprom.get(0, value);
+        REQUIRE(value == 0xFF);
+    }
+
+    SECTION("Out of range reads return erased values")
+    {
+        eeprom.init();
+        eeprom.put(eeprom.capacity() - 1, 0xAA);
+
+        uint8_t values[2];
+        eeprom.get(eeprom.capacity() - 1, values, sizeof(values));
+        REQUIRE(values[0] == 0xAA);
+        REQUIRE(values[1] == 0xFF);
+    }
+}
+
+TEST_CASE("Transactions", "[eeprom]")
+{
+    using CachedTestEEPROM = EEPROMEmulation<TestStore, PageBase1, PageSize1, PageBase2, PageSize2, true>;
+    CachedTestEEPROM eeprom;
+    eeprom.init();
+
+    auto countValidRecords = [&]()
+    {
+        size_t count = 0;
+        eeprom.forEachValidRecord(eeprom.getActivePage(), [&](uintptr_t address, const CachedTestEEPROM::Record &record)
+        {
+            count++;
+        });
+        return count;
+    };
+
+    auto readFromFlash = [&](uint16_t index)
+    {
+        uint8_t value = 0xFF;
+        eeprom.forEachValidRecord(eeprom.getActivePage(), [&](uintptr_t address, const CachedTestEEPROM::Record &record)
+        {
+            if(record.index == index)
+            {
+                value = record.data;
+            }
+        });
+        return value;
+    };
+
+    uint8_t config[] = { 1, 2, 3, 4 };
+    uint8_t counter[] = { 0x10, 0x20 };
+
+    SECTION("All the staged ranges are written")
+    {
+        auto tx = eeprom.beginTransaction();
+        REQUIRE(tx.put(0, config, sizeof(config)));
+        REQUIRE(tx.put(100, counter, sizeof(counter)));
+        REQUIRE(tx.commit());
+
+        uint8_t values[4];
+        eeprom.get(0, values, sizeof(values));
+        REQUIRE(std::memcmp(values, config, sizeof(config)) == 0);
+        eeprom.get(100, values, sizeof(counter));
+        REQUIRE(std::memcmp(values, counter, sizeof(counter)) == 0);
+        REQUIRE(countValidRecords() == 6);
+        REQUIRE(readFromFlash(3) == 4);
+        REQUIRE(readFromFlash(101) == 0x20);
+    }
+
+    SECTION("Unchanged values are not written")
+    {
+        eeprom.put(0, config, sizeof(config));
+        config[2] = 0x33;
+
+        auto tx = eeprom.beginTransaction();
+        tx.put(0, config, sizeof(config));
+        tx.put(100, counter, sizeof(counter));
+        REQUIRE(tx.commit());
+
+        REQUIRE(countValidRecords() == 4 + 1 + 2);
+        REQUIRE(readFromFlash(2) == 0x33);
+    }
+
+    SECTION("Later ranges take precedence")
+    {
+        uint8_t flag = 0xAA;
+        auto tx = eeprom.beginTransaction();
+        tx.put(0, config, sizeof(config));
+        tx.put(1, &flag, sizeof(flag));
+        REQUIRE(tx.commit());
+
+        uint8_t value;
+        eeprom.get(1, value);
+        REQUIRE(value == 0xAA);
+        REQUIRE(countValidRecords() == 4);
+        REQUIRE(readFromFlash(1) == 0xAA);
+    }
+
+    SECTION("An interrupted commit is not visible")
+    {
+        eeprom.put(0, 0xBB);
+
+        auto tx = eeprom.beginTransaction();
+        tx.put(0, config, sizeof(config));
+        tx.put(100, counter, sizeof(counter));
+        eeprom.store.discardWritesAfter(5, [&] {
+            tx.commit();
+        });
+
+        eeprom.init();
+        uint8_t value;
+        eeprom.get(0, value);
+        REQUIRE(value == 0xBB);
+        eeprom.get(100, value);
+        REQUIRE(value == 0xFF);
+    }
+
+    SECTION("A full page is swapped once for all the ranges")
+    {
+        // Fill the active page up to the last record
+        const size_t recordCount = (PageSize1 - sizeof(uint32_t)) / sizeof(Record) - 1;
+        for(size_t i = 0; i < recordCount; i++)
+        {
+            eeprom.put(200, (uint8_t)i);
+        }
+        REQUIRE(eeprom.getActivePage() == CachedTestEEPROM::LogicalPage::Page1);
+        eeprom.store.resetEraseCount();
+
+        auto tx = eeprom.beginTransaction();
+        tx.put(0, config, sizeof(config));
+        tx.put(100, counter, sizeof(counter));
+        REQUIRE(tx.commit());
+
+        REQUIRE(eeprom.getActivePage() == CachedTestEEPROM::LogicalPage::Page2);
+        REQUIRE(eeprom.store.getEraseCount() == 0);
+        REQUIRE(countValidRecords() == 7);
+        REQUIRE(readFromFlash(0) == 1);
+        REQUIRE(readFromFlash(101) == 0x20);
+        REQUIRE(readFromFlash(200) == (uint8_t)(recordCount - 1));
+    }
+
+    SECTION("Out of range blocks cancel the transaction")
+    {
+        auto tx = eeprom.beginTransaction();
+        REQUIRE(tx.put(0, config, sizeof(config)));
+        REQUIRE_FALSE(tx.put(eeprom.capacity() - 1, counter, sizeof(counter)));
+        REQUIRE_FALSE(tx.commit());
+
+        REQUIRE(countValidRecords() == 0);
+    }
+
+    SECTION("Too many blocks cancel the transaction")
+    {
+        CachedTestEEPROM::Transaction<2> tx(eeprom);
+        REQUIRE(tx.put(0, config, 1));
+        REQUIRE(tx.put(1, config, 1));
+        REQUIRE_FALSE(tx.put(2, config, 1));
+        REQUIRE_FALSE(tx.commit());
+
+        REQUIRE(countValidRecords() == 0);
+    }
+
+    SECTION("Without the RAM cache, unchanged values are not written either")
+    {
+        TestEEPROM uncached;
+        uncached.init();
+        uncached.put(0, config, sizeof(config));
+        uncached.put(1, 0x22);
+        uncached.put(100, 0xCC);
+
+        auto countUncachedRecords = [&]()
+        {
+            size_t count = 0;
+            uncached.forEachValidRecord(uncached.getActivePage(), [&](uintptr_t address, const Record &record)
+            {
+                count++;
+            });
+            return count;
+        };
+        REQUIRE(countUncachedRecords() == 6);
+
+        // Only the latest record of an address is compared, and a later
+        // range takes precedence over the earlier ones
+        uint8_t flag = 0x22;
+        config[2] = 0x33;
+        auto tx = uncached.beginTransaction();
+        tx.put(0, config, sizeof(config));
+        tx.put(1, &flag, sizeof(flag));
+        tx.put(100, counter, sizeof(counter));
+        REQUIRE(tx.commit());
+
+        REQUIRE(countUncachedRecords() == 6 + 1 + 2);
+
+        uint8_t values[4];
+        uncached.get(0, values, sizeof(values));
+        REQUIRE(values[1] == 0x22);
+        REQUIRE(values[2] == 0x33);
+        uncached.get(100, values, sizeof(counter));
+        REQUIRE(std::memcmp(values, counter, sizeof(counter)) == 0);
+
+        // Nothing is written when all the values are the same
+        auto same = uncached.beginTransaction();
+        same.put(100, counter, sizeof(counter));
+        same.put(200, "\xFF", 1);
+        REQUIRE(same.commit());
+        REQUIRE(countUncachedRecords() == 6 + 1 + 2);
+    }
+}
@@ -0,0 +1,150 @@
+#include "heap_profiler.h"
+
+#include "catch.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+void* profiledMalloc(size_t size, uintptr_t caller) {
+    return heap_profiler_alloc(malloc(size + HEAP_PROFILER_HEADER_SIZE), size, (const void*)caller);
+}
+
+void* profiledRealloc(void* ptr, size_t size, uintptr_t caller) {
+    void* const block = heap_profiler_block(ptr);
+    REQUIRE(block);
+    heap_profiler_realloc_begin(block);
+    return heap_profiler_realloc(block, realloc(block, size + HEAP_PROFILER_HEADER_SIZE), size, (const void*)caller);
+}
+
+void profiledFree(void* ptr) {
+    void* const block = heap_profiler_block(ptr);
+    REQUIRE(block);
+    heap_profiler_free(block);
+    free(block);
+}
+
+std::vector<heap_profiler_site> sites() {
+    std::vector<heap_profiler_site> sites;
+    REQUIRE(heap_profiler_enum_sites([](const heap_profiler_site* site, void* data) {
+        static_cast<std::vector<heap_profiler_site>*>(data)->push_back(*site);
+        return 0;
+    }, &sites, nullptr) == 0);
+    return sites;
+}
+
+heap_profiler_site site(uintptr_t caller) {
+    for (const auto& s: sites()) {
+        if (s.caller == caller) {
+            return s;
+        }
+    }
+    FAIL("Call site not found");
+    return heap_profiler_site();
+}
+
+} // namespace
+
+TEST_CASE("Heap profiler") {
+    SECTION("attributes allocations to their call sites") {
+        void* p1 = profiledMalloc(10, 0x1000);
+        void* p2 = profiledMalloc(20, 0x1000);
+        void* p3 = profiledMalloc(30, 0x2000);
+        REQUIRE((p1 && p2 && p3));
+        profiledFree(p2);
+        auto s = site(0x1000);
+        CHECK(s.count == 2);
+        CHECK(s.bytes == 30);
+        CHECK(s.live_count == 1);
+        CHECK(s.live_bytes == 10);
+        s = site(0x2000);
+        CHECK(s.count == 1);
+        CHECK(s.bytes == 30);
+        CHECK(s.live_bytes == 30);
+        profiledFree(p1);
+        profiledFree(p3);
+        CHECK(site(0x1000).live_bytes == 0);
+        CHECK(site(0x2000).live_count == 0);
+    }
+
+    SECTION("preserves the data and alignment of the blocks") {
+        const auto p = (char*)profiledMalloc(5, 0x3000);
+        REQUIRE(p);
+        CHECK(((uintptr_t)p % alignof(std::max_align_t)) == 0);
+        memcpy(p, "abcd", 5);
+        const auto p2 = (char*)profiledRealloc(p, 1000, 0x3002);
+        REQUIRE(p2);
+        CHECK(strcmp(p2, "abcd") == 0);
+        // The block is attributed to the last call site that resized it
+        auto s = site(0x3000);
+        CHECK(s.live_count == 0);
+        CHECK(s.live_bytes == 0);
+        s = site(0x3002);
+        CHECK(s.count == 1);
+        CHECK(s.bytes == 1000);
+        CHECK(s.live_bytes == 1000);
+        profiledFree(p2);
+        CHECK(site(0x3002).live_bytes == 0);
+    }
+
+    SECTION("detects blocks that were not allocated via the profiler") {
+        const auto p = (char*)malloc(64);
+        memset(p, 0, 64);
+        CHECK(heap_profiler_block(p + HEAP_PROFILER_HEADER_SIZE) == nullptr);
+        CHECK(heap_profiler_block(nullptr) == nullptr);
+        free(p);
+        // A freed block is no longer recognized
+        void* const p2 = profiledMalloc(8, 0x4000);
+        void* const block = heap_profiler_block(p2);
+        REQUIRE(block);
+        heap_profiler_free(block);
+        CHECK(heap_profiler_block(p2) == nullptr);
+        free(block);
+    }
+
+    SECTION("the header of a resized block is invalidated") {
+        char* const p = (char*)profiledMalloc(16, 0x6000);
+        REQUIRE(p);
+        void* const block = heap_profiler_block(p);
+        heap_profiler_realloc_begin(block);
+        // The original block is no longer recognized while it's being resized
+        CHECK(heap_profiler_block(p) == nullptr);
+        // A failed reallocation leaves the original block intact
+        CHECK(heap_profiler_realloc(block, nullptr, 1024, (const void*)0x6002) == nullptr);
+        CHECK(heap_profiler_block(p) == block);
+        auto s = site(0x6000);
+        CHECK(s.live_count == 1);
+        CHECK(s.live_bytes == 16);
+        profiledFree(p);
+        CHECK(site(0x6000).live_count == 0);
+    }
+
+    SECTION("heap_profiler_reset() keeps the live counters") {
+        void* const p = profiledMalloc(100, 0x5000);
+        heap_profiler_reset(nullptr);
+        const auto s = site(0x5000);
+        CHECK(s.count == 0);
+        CHECK(s.bytes == 0);
+        CHECK(s.live_count == 1);
+        CHECK(s.live_bytes == 100);
+        profiledFree(p);
+    }
+
+    // This section fills the table of call sites, so it should go last
+    SECTION("attributes allocations to a catch-all site when the table is full") {
+        std::vector<void*> ptrs;
+        for (uintptr_t i = 0; i < HEAP_PROFILER_MAX_SITES * 2; ++i) {
+            ptrs.push_back(profiledMalloc(1, 0x10000 + i * 2));
+        }
+        const auto other = site(0);
+        CHECK(other.count >= HEAP_PROFILER_MAX_SITES);
+        CHECK(other.live_count >= HEAP_PROFILER_MAX_SITES);
+        for (void* p: ptrs) {
+            profiledFree(p);
+        }
+        CHECK(site(0).live_count == 0);
+    }
+}
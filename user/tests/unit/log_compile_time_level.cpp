@@ -0,0 +1,90 @@
+#define LOG_COMPILE_TIME_CATEGORY_LEVELS \
+        LOG_CATEGORY_LEVEL("a", WARN) \
+        LOG_CATEGORY_LEVEL("a.b", INFO) \
+        LOG_CATEGORY_LEVEL("a.b.c", NONE)
+
+#include "spark_wiring_logging.h"
+
+#include "catch.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace spark;
+
+class TestLogHandler: public LogHandler {
+public:
+    TestLogHandler() :
+            LogHandler(LOG_LEVEL_ALL) {
+        LogManager::instance()->addHandler(this);
+    }
+
+    ~TestLogHandler() {
+        LogManager::instance()->removeHandler(this);
+    }
+
+    std::vector<std::string> msgs;
+
+protected:
+    virtual void logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) override {
+        msgs.push_back(msg);
+    }
+};
+
+// Incremented when an argument of a logging macro is evaluated
+int evalCount = 0;
+
+int eval() {
+    return ++evalCount;
+}
+
+} // namespace
+
+static_assert(_logCompileTimeLevel("a") == LOG_LEVEL_WARN, "");
+static_assert(_logCompileTimeLevel("a.x") == LOG_LEVEL_WARN, "");
+static_assert(_logCompileTimeLevel("ab") == LOG_COMPILE_TIME_LEVEL, "");
+static_assert(_logCompileTimeLevel("a.b") == LOG_LEVEL_INFO, "");
+static_assert(_logCompileTimeLevel("a.b.x") == LOG_LEVEL_INFO, "");
+static_assert(_logCompileTimeLevel("a.b.c") == LOG_LEVEL_NONE, "");
+static_assert(_logCompileTimeLevel("x") == LOG_COMPILE_TIME_LEVEL, "");
+static_assert(_logCompileTimeLevel(nullptr) == LOG_COMPILE_TIME_LEVEL, "");
+
+TEST_CASE("Compile-time category levels") {
+    TestLogHandler log;
+    evalCount = 0;
+
+    SECTION("messages below the category level are stripped") {
+        LOG_CATEGORY("a.x");
+        static_assert(_LogCategory::compileTimeLevel() == LOG_LEVEL_WARN, "");
+        LOG(INFO, "info %d", eval());
+        LOG(WARN, "warn %d", eval());
+        CHECK(!LOG_ENABLED(INFO));
+        REQUIRE(log.msgs.size() == 1);
+        CHECK(log.msgs[0] == "warn 1");
+        CHECK(evalCount == 1);
+    }
+
+    SECTION("most specific category level is used") {
+        LOG_CATEGORY("a.b");
+        LOG(TRACE, "trace %d", eval());
+        LOG(INFO, "info %d", eval());
+        REQUIRE(log.msgs.size() == 1);
+        CHECK(log.msgs[0] == "info 1");
+    }
+
+    SECTION("category level can disable logging entirely") {
+        LOG_CATEGORY("a.b.c");
+        LOG(ERROR, "error %d", eval());
+        LOG_PRINTF(ERROR, "error %d", eval());
+        CHECK(log.msgs.empty());
+        CHECK(evalCount == 0);
+    }
+
+    SECTION("other categories are not affected") {
+        LOG_CATEGORY("x");
+        LOG(TRACE, "trace");
+        REQUIRE(log.msgs.size() == 1);
+    }
+}
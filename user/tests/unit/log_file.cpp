@@ -0,0 +1,109 @@
+#include "log_file.h"
+
+#include "catch.hpp"
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace {
+
+const size_t HEADER_SIZE = 24;
+
+class TempFile {
+public:
+    TempFile() {
+        char path[] = "/tmp/log_file_XXXXXX";
+        const int fd = mkstemp(path);
+        REQUIRE(fd >= 0);
+        close(fd);
+        path_ = path;
+    }
+
+    ~TempFile() {
+        unlink(path_.c_str());
+    }
+
+    std::string data() const {
+        std::ifstream f(path_, std::ios::binary);
+        std::ostringstream s;
+        s << f.rdbuf();
+        return s.str();
+    }
+
+    const char* path() const {
+        return path_.c_str();
+    }
+
+private:
+    std::string path_;
+};
+
+void write(LogFile& log, const std::string& str) {
+    log.write(str.data(), str.size());
+}
+
+} // namespace
+
+TEST_CASE("LogFile") {
+    TempFile file;
+
+    SECTION("data is written to the file") {
+        LogFile log;
+        REQUIRE(log.open(file.path(), 16));
+        CHECK(log.isOpen());
+        write(log, "abc");
+        write(log, "def");
+        CHECK(log.written() == 6);
+        log.close();
+        CHECK(!log.isOpen());
+        const std::string d = file.data();
+        REQUIRE(d.size() == HEADER_SIZE + 16);
+        CHECK(d.substr(HEADER_SIZE, 6) == "abcdef");
+    }
+
+    SECTION("oldest data is overwritten when the file is full") {
+        LogFile log;
+        REQUIRE(log.open(file.path(), 8));
+        write(log, "0123456");
+        write(log, "789");
+        CHECK(log.written() == 10);
+        write(log, "abcdefghijklmnop"); // Larger than the file
+        CHECK(log.written() == 26);
+        log.close();
+        const std::string d = file.data();
+        REQUIRE(d.size() == HEADER_SIZE + 8);
+        CHECK(d.substr(HEADER_SIZE) == "opijklmn"); // Write position is at offset 2
+    }
+
+    SECTION("existing file is appended to") {
+        {
+            LogFile log;
+            REQUIRE(log.open(file.path(), 16));
+            write(log, "abc");
+        }
+        LogFile log;
+        REQUIRE(log.open(file.path(), 16));
+        CHECK(log.written() == 3);
+        write(log, "def");
+        log.close();
+        CHECK(file.data().substr(HEADER_SIZE, 6) == "abcdef");
+    }
+
+    SECTION("file is recreated if its size doesn't match") {
+        {
+            LogFile log;
+            REQUIRE(log.open(file.path(), 16));
+            write(log, "abc");
+        }
+        LogFile log;
+        REQUIRE(log.open(file.path(), 32));
+        CHECK(log.written() == 0);
+        log.close();
+        CHECK(file.data().size() == HEADER_SIZE + 32);
+    }
+}
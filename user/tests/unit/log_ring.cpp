@@ -0,0 +1,166 @@
+#include "spark_wiring_log_ring.h"
+
+#include "catch.hpp"
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+namespace {
+
+using namespace particle;
+
+int append(LogRing& ring, const std::string& msg, const char* category = "app") {
+    LogRing::Record rec = {};
+    rec.type = LogRing::TEXT_MESSAGE;
+    rec.level = 30;
+    return ring.append(rec, category, msg.data(), msg.size());
+}
+
+std::string read(const LogRing& ring, uint32_t seq) {
+    char buf[256] = {};
+    LogRing::Record rec = {};
+    const int n = ring.read(seq, &rec, buf, sizeof(buf));
+    if (n < 0) {
+        return std::string();
+    }
+    const size_t catSize = strlen(buf) + 1;
+    return std::string(buf + catSize, n - catSize);
+}
+
+} // namespace
+
+TEST_CASE("LogRing") {
+    std::vector<char> mem(256 + 1); // Unaligned size
+    // Simulate uninitialized retained memory
+    for (size_t i = 0; i < mem.size(); ++i) {
+        mem[i] = (char)(i * 31 + 7);
+    }
+
+    SECTION("is reset if the memory doesn't contain a valid ring") {
+        LogRing ring;
+        REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+        CHECK(!ring.restored());
+        CHECK(ring.count() == 0);
+        CHECK(ring.firstSeq() == 0);
+        CHECK(ring.nextSeq() == 0);
+        CHECK(ring.read(0, nullptr, nullptr, 0) < 0);
+    }
+
+    SECTION("records are read back in order") {
+        LogRing ring;
+        REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+        REQUIRE(append(ring, "message 1") == 0);
+        REQUIRE(append(ring, "message 2", nullptr) == 0);
+        CHECK(ring.count() == 2);
+        CHECK(read(ring, 0) == "message 1");
+        CHECK(read(ring, 1) == "message 2");
+        CHECK(read(ring, 2) == "");
+        char buf[16] = {};
+        LogRing::Record rec = {};
+        CHECK(ring.read(0, &rec, buf, sizeof(buf)) == (int)(4 + 9)); // "app\0message 1"
+        CHECK(rec.type == LogRing::TEXT_MESSAGE);
+        CHECK(rec.level == 30);
+        CHECK(std::string(buf) == "app");
+    }
+
+    SECTION("oldest records are discarded when the ring is full") {
+        LogRing ring;
+        REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(append(ring, "message " + std::to_string(i)) == 0);
+            REQUIRE(ring.nextSeq() == (uint32_t)i + 1);
+            REQUIRE(read(ring, i) == "message " + std::to_string(i));
+        }
+        CHECK(ring.count() > 1);
+        CHECK(ring.count() < 100);
+        CHECK(ring.firstSeq() == 100 - ring.count());
+        for (uint32_t seq = ring.firstSeq(); seq < ring.nextSeq(); ++seq) {
+            CHECK(read(ring, seq) == "message " + std::to_string(seq));
+        }
+    }
+
+    SECTION("records can be read in any order") {
+        LogRing ring;
+        REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+        for (int i = 0; i < 30; ++i) {
+            REQUIRE(append(ring, "message " + std::to_string(i)) == 0);
+            if (i % 3 == 0) {
+                REQUIRE(read(ring, ring.firstSeq()) == "message " + std::to_string(ring.firstSeq()));
+            }
+        }
+        for (uint32_t seq = ring.nextSeq(); seq-- > ring.firstSeq();) {
+            CHECK(read(ring, seq) == "message " + std::to_string(seq));
+        }
+        for (uint32_t seq = ring.firstSeq(); seq < ring.nextSeq(); seq += 2) {
+            CHECK(read(ring, seq) == "message " + std::to_string(seq));
+        }
+    }
+
+    SECTION("records that don't fit into the ring are rejected") {
+        LogRing ring;
+        REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+        REQUIRE(append(ring, "message") == 0);
+        CHECK(append(ring, std::string(ring.maxDataSize(), 'a')) < 0);
+        CHECK(append(ring, std::string(ring.maxDataSize() - 4, 'a')) == 0); // Category name takes 4 bytes
+        CHECK(ring.count() == 1);
+        CHECK(ring.firstSeq() == 1);
+    }
+
+    SECTION("records are restored after a reset") {
+        {
+            LogRing ring;
+            REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+            for (int i = 0; i < 20; ++i) {
+                REQUIRE(append(ring, "message " + std::to_string(i)) == 0);
+            }
+            ring.tag(1234);
+        }
+        LogRing ring;
+        REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+        CHECK(ring.restored());
+        CHECK(ring.tag() == 1234);
+        CHECK(ring.nextSeq() == 20);
+        for (uint32_t seq = ring.firstSeq(); seq < ring.nextSeq(); ++seq) {
+            CHECK(read(ring, seq) == "message " + std::to_string(seq));
+        }
+        REQUIRE(append(ring, "message 20") == 0);
+        CHECK(read(ring, 20) == "message 20");
+    }
+
+    SECTION("last committed state is restored if the header is corrupted") {
+        uint32_t next = 0;
+        {
+            LogRing ring;
+            REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+            for (int i = 0; i < 20; ++i) {
+                REQUIRE(append(ring, "message " + std::to_string(i)) == 0);
+            }
+            next = ring.nextSeq();
+        }
+        // Corrupt one of the header copies, as if a reset occurred while it was being written
+        for (int i = 0; i < 2; ++i) {
+            std::vector<char> m(mem);
+            m[(i == 0) ? 12 : 52] ^= 0x55;
+            LogRing ring;
+            REQUIRE(ring.init(m.data(), m.size()) == 0);
+            CHECK(ring.restored());
+            CHECK(((ring.nextSeq() == next) || (ring.nextSeq() == next - 1)));
+            for (uint32_t seq = ring.firstSeq(); seq < ring.nextSeq(); ++seq) {
+                CHECK(read(ring, seq) == "message " + std::to_string(seq));
+            }
+        }
+    }
+
+    SECTION("clear() discards all records but keeps the sequence numbers") {
+        LogRing ring;
+        REQUIRE(ring.init(mem.data(), mem.size()) == 0);
+        REQUIRE(append(ring, "message 1") == 0);
+        REQUIRE(append(ring, "message 2") == 0);
+        ring.clear();
+        CHECK(ring.count() == 0);
+        CHECK(ring.firstSeq() == 2);
+        REQUIRE(append(ring, "message 3") == 0);
+        CHECK(read(ring, 2) == "message 3");
+    }
+}
@@ -17,7 +17,9 @@
 #include <boost/optional/optional_io.hpp>
 
 #include <queue>
+#include <thread>
 #include <map>
+#include <vector>
 
 #define CHECK_LOG_ATTR_FLAG(flag, value) \
         do { \
@@ -142,7 +144,8 @@ class TestLogHandler: public LogHandler {
 public:
     TestLogHandler(LogLevel level, LogCategoryFilters filters, Print *stream) :
             LogHandler(level, filters),
-            strm_(stream) {
+            strm_(stream),
+            time_(0) {
     }
 
     LogMessage checkNext() {
@@ -164,6 +167,10 @@ public:
         return strm_;
     }
 
+    void advanceTime(system_tick_t ms) {
+        time_ += ms;
+    }
+
 protected:
     // spark::LogHandler
     virtual void logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) override {
@@ -176,9 +183,14 @@ protected:
         }
     }
 
+    virtual system_tick_t currentTime() const override {
+        return time_;
+    }
+
 private:
     std::queue<LogMessage> msgs_;
     Print *strm_;
+    system_tick_t time_;
 };
 
 inline LogMessage LogMessage::checkNext() const {
@@ -267,6 +279,31 @@ private:
     }
 };
 
+// Output stream counting write operations
+class CountingOutputStream: public test::OutputStream {
+public:
+    CountingOutputStream() :
+            writeCount_(0) {
+    }
+
+    virtual size_t write(const uint8_t *data, size_t size) override {
+        ++writeCount_;
+        return test::OutputStream::write(data, size);
+    }
+
+    virtual size_t write(uint8_t byte) override {
+        ++writeCount_;
+        return test::OutputStream::write(byte);
+    }
+
+    size_t writeCount() const {
+        return writeCount_;
+    }
+
+private:
+    size_t writeCount_;
+};
+
 // Mixin class registering log handler automatically
 template<typename HandlerT>
 class ScopedLogHandler: public HandlerT {
@@ -643,6 +680,55 @@ TEST_CASE("Direct logging (compatibility callback)") {
     }
 }
 */
+TEST_CASE("Binary logging") {
+    SECTION("records are formatted by text handlers") {
+        DefaultLogHandler log(LOG_LEVEL_ALL);
+        LOG_BINARY(INFO, "%d %u %x %c %s %%", -1, 2u, 0xabu, 'c', "str");
+        log.checkNext().messageEquals("-1 2 ab c str %").levelEquals(LOG_LEVEL_INFO).categoryEquals(LOG_THIS_CATEGORY());
+        LOG_BINARY(WARN, "%5.2f|%-4s|%08lld|%hhx|%*d|%.*s|%zu", 3.14159, "ab", 123456789012LL, 0x1ff, 4, 7, 2, "abc", (size_t)10);
+        log.checkNext().messageEquals(" 3.14|ab  |123456789012|ff|   7|ab|10").levelEquals(LOG_LEVEL_WARN);
+        LOG_BINARY(ERROR, "%s", (const char*)nullptr);
+        log.checkNext().messageEquals("(null)");
+        void* const p = &log;
+        LOG_BINARY(TRACE, "%p", p);
+        char buf[32] = {};
+        snprintf(buf, sizeof(buf), "%p", p);
+        log.checkNext().messageEquals(buf);
+        log.checkAtEnd();
+    }
+    SECTION("arguments that don't fit into a record are truncated") {
+        DefaultLogHandler log(LOG_LEVEL_ALL);
+        std::string s = test::randomString(LOG_MAX_STRING_LENGTH * 3 / 2);
+        LOG_BINARY(INFO, "%s", s.c_str());
+        log.checkNext().messageEquals(s.substr(0, LOG_MAX_STRING_LENGTH - 2) + '~');
+        s = test::randomString(LOG_MAX_STRING_LENGTH - 8);
+        LOG_BINARY(INFO, "%s %d %d", s.c_str(), 1, 2);
+        log.checkNext().messageEquals(s + " 1 ~");
+    }
+    SECTION("binary stream handler") {
+        test::OutputStream stream;
+        ScopedLogHandler<BinaryStreamLogHandler> handler(stream);
+        const char* const fmt = "value: %d";
+        LOG_BINARY(WARN, fmt, 0x01020304);
+        const std::string cat = LOG_THIS_CATEGORY();
+        std::string s(stream);
+        REQUIRE(s.size() == 16 + cat.size() + 1 + 4);
+        CHECK(s.substr(0, 4) == std::string("\xb1\x0c\x01\x28", 4)); // Signature, type, level
+        CHECK((uint8_t)s[4] == cat.size() + 1 + 4); // Payload size
+        CHECK(s[5] == 0);
+        uint32_t addr = 0;
+        memcpy(&addr, s.data() + 12, 4);
+        CHECK(addr == (uint32_t)(uintptr_t)fmt);
+        CHECK(s.substr(16) == cat + std::string("\0\x04\x03\x02\x01", 5));
+        // Text messages use the same framing
+        LOG(INFO, "text");
+        s = std::string(stream).substr(s.size());
+        REQUIRE(s.size() == 16 + cat.size() + 1 + 4);
+        CHECK(s.substr(0, 4) == std::string("\xb1\x0c\x02\x1e", 4));
+        CHECK(s.substr(16) == cat + std::string("\0text", 5));
+    }
+}
+
 TEST_CASE("Basic filtering") {
     SECTION("warn") {
         DefaultLogHandler log(LOG_LEVEL_WARN); // TRACE and INFO should be filtered out
@@ -662,6 +748,20 @@ TEST_CASE("Basic filtering") {
         LOG_PRINT(TRACE, "a"); LOG_PRINT(INFO, "b"); LOG_PRINT(WARN, "c"); LOG_PRINT(ERROR, "d");
         check(log.stream()).isEmpty();
     }
+    SECTION("cached levels are updated when handlers change") {
+        DefaultLogHandler log1(LOG_LEVEL_WARN);
+        CHECK((!LOG_ENABLED(INFO) && LOG_ENABLED(WARN)));
+        CHECK(!LOG_ENABLED(INFO)); // Cached level
+        {
+            DefaultLogHandler log2(LOG_LEVEL_INFO);
+            CHECK((!LOG_ENABLED(TRACE) && LOG_ENABLED(INFO)));
+            LOG(INFO, "info");
+            log2.checkNext().messageEquals("info");
+        }
+        CHECK((!LOG_ENABLED(INFO) && LOG_ENABLED(WARN)));
+        LOG(INFO, "info");
+        CHECK(!log1.hasNext());
+    }
 }
 /*
 TEST_CASE("Basic filtering (compatibility callback)") {
@@ -826,6 +926,16 @@ TEST_CASE("Category filtering") {
         LOG_PRINT(TRACE, "a"); LOG_PRINT(INFO, "b"); LOG_PRINT(WARN, "c"); LOG_PRINT(ERROR, "d");
         check(log.stream()).equals("bcd");
     }
+    SECTION("same category name at different addresses") {
+        static const char cat1[] = "a.a.a";
+        static const char cat2[] = "a.a.a";
+        static const char cat3[] = "b.b";
+        CHECK(LOG_ENABLED_C(TRACE, cat1));
+        CHECK(LOG_ENABLED_C(TRACE, cat2));
+        CHECK(LOG_ENABLED_C(TRACE, cat1)); // Cached level
+        CHECK((!LOG_ENABLED_C(TRACE, cat3) && LOG_ENABLED_C(INFO, cat3)));
+        CHECK(LOG_ENABLED_C(TRACE, cat2));
+    }
 }
 
 TEST_CASE("Malformed category name") {
@@ -960,6 +1070,75 @@ TEST_CASE("Logger API") {
     }
 }
 
+TEST_CASE("Message limits") {
+    SECTION("rate limiting") {
+        DefaultLogHandler log(LOG_LEVEL_ALL, {
+            LogCategoryFilter("a", LOG_LEVEL_ALL).rateLimit(10, 2) // 10 messages per second, burst of 2 messages
+        });
+        for (int i = 0; i < 5; ++i) {
+            LOG_C(INFO, "a", "%d", i);
+        }
+        log.checkNext().messageEquals("0");
+        log.checkNext().messageEquals("1");
+        CHECK(!log.hasNext());
+        // Messages in other categories are not limited
+        for (int i = 0; i < 5; ++i) {
+            LOG_C(INFO, "b", "%d", i);
+        }
+        for (int i = 0; i < 5; ++i) {
+            log.checkNext().categoryEquals("b");
+        }
+        log.advanceTime(99);
+        LOG_C(INFO, "a", "5"); // Still limited
+        CHECK(!log.hasNext());
+        log.advanceTime(51); // 1.5 tokens have been added since the bucket was emptied
+        LOG_C(INFO, "a", "6");
+        log.checkNext().messageEquals("4 message(s) suppressed").levelEquals(LOG_LEVEL_WARN).categoryEquals("a");
+        log.checkNext().messageEquals("6");
+        CHECK(!log.hasNext());
+    }
+    SECTION("suppressed messages are reported when the category goes quiet") {
+        DefaultLogHandler log(LOG_LEVEL_ALL, {
+            LogCategoryFilter("a", LOG_LEVEL_ALL).rateLimit(10, 1) // 10 messages per second
+        });
+        LOG_C(INFO, "a.b", "0");
+        LOG_C(INFO, "a.b", "1");
+        LOG_C(INFO, "a.b", "2");
+        log.checkNext().messageEquals("0");
+        CHECK(!log.hasNext());
+        CHECK(LogManager::messagesSuppressed());
+        log.advanceTime(50);
+        LogManager::instance()->flushExpired(); // Still limited
+        CHECK(!log.hasNext());
+        CHECK(LogManager::messagesSuppressed());
+        log.advanceTime(50);
+        LogManager::instance()->flushExpired();
+        log.checkNext().messageEquals("2 message(s) suppressed").levelEquals(LOG_LEVEL_WARN).categoryEquals("a.b");
+        CHECK(!log.hasNext());
+        CHECK(!LogManager::messagesSuppressed());
+        LOG_C(INFO, "a.b", "3");
+        log.checkNext().messageEquals("3");
+        CHECK(!log.hasNext());
+    }
+    SECTION("deduplication") {
+        DefaultLogHandler log(LOG_LEVEL_ALL, {
+            LogCategoryFilter("a", LOG_LEVEL_ALL).deduplicate()
+        });
+        LOG_C(INFO, "a", "x"); LOG_C(INFO, "a", "x"); LOG_C(INFO, "a", "x");
+        LOG_C(WARN, "a", "y");
+        log.checkNext().messageEquals("x");
+        log.checkNext().messageEquals("Last message repeated 2 time(s)").levelEquals(LOG_LEVEL_INFO);
+        log.checkNext().messageEquals("y").levelEquals(LOG_LEVEL_WARN);
+        CHECK(!log.hasNext());
+        // Non-consecutive messages are not deduplicated
+        LOG_C(INFO, "a", "x"); LOG_C(INFO, "b", "x"); LOG_C(INFO, "a", "x");
+        log.checkNext().categoryEquals("a");
+        log.checkNext().categoryEquals("b");
+        log.checkNext().categoryEquals("a");
+        CHECK(!log.hasNext());
+    }
+}
+
 TEST_CASE("Message formatting") {
     SECTION("level names") {
         CHECK(LogHandler::levelName(LOG_LEVEL_TRACE) == std::string("TRACE"));
@@ -998,6 +1177,166 @@ TEST_CASE("Message formatting") {
     }
 }
 
+TEST_CASE("Buffered output") {
+    SECTION("each message is written with a single write operation") {
+        CountingOutputStream stream;
+        ScopedLogHandler<StreamLogHandler> handler(stream);
+        LOG_ATTR(INFO, (code = -1, details = "details"), "message 1");
+        CHECK(stream.writeCount() == 1);
+        LOG(WARN, "message 2");
+        CHECK(stream.writeCount() == 2);
+        check(stream).endsWith("WARN: message 2\r\n");
+    }
+
+    SECTION("JSON messages are written with a single write operation") {
+        CountingOutputStream stream;
+        ScopedLogHandler<JSONStreamLogHandler> handler(stream);
+        LOG_ATTR(INFO, (code = -1, details = "details"), "message");
+        CHECK(stream.writeCount() == 1);
+        check(stream).endsWith("}\r\n");
+    }
+
+    SECTION("messages are batched until the threshold is reached") {
+        CountingOutputStream stream;
+        ScopedLogHandler<StreamLogHandler> handler(stream);
+        handler.setBatching(1000, 60000);
+        LOG(INFO, "message 1");
+        LOG(INFO, "message 2");
+        CHECK(stream.writeCount() == 0);
+        for (int i = 0; i < 100 && stream.writeCount() == 0; ++i) {
+            LOG(INFO, "message %d", i + 3);
+        }
+        CHECK(stream.writeCount() == 1);
+        check(stream).contains("INFO: message 1\r\n");
+        check(stream).contains("INFO: message 2\r\n");
+    }
+
+    SECTION("batched messages are written on flush") {
+        CountingOutputStream stream;
+        ScopedLogHandler<StreamLogHandler> handler(stream);
+        handler.setBatching(1000, 60000);
+        LOG(INFO, "message 1");
+        LOG(INFO, "message 2");
+        CHECK(stream.size() == 0);
+        LogManager::instance()->flush();
+        CHECK(stream.writeCount() == 1);
+        check(stream).contains("INFO: message 1\r\n");
+        check(stream).endsWith("INFO: message 2\r\n");
+    }
+
+    SECTION("batched messages are written when the interval expires") {
+        CountingOutputStream stream;
+        ScopedLogHandler<StreamLogHandler> handler(stream);
+        handler.setBatching(1000, 60000);
+        LOG(INFO, "message 1");
+        LogManager::instance()->flushExpired();
+        CHECK(stream.writeCount() == 0);
+        handler.setBatching(1000, 0); // Writes the buffered message
+        CHECK(stream.writeCount() == 1);
+        LOG(INFO, "message 2");
+        CHECK(stream.writeCount() == 1);
+        LogManager::instance()->flushExpired();
+        CHECK(stream.writeCount() == 2);
+        check(stream).endsWith("INFO: message 2\r\n");
+        LogManager::instance()->flushExpired(); // Nothing to write
+        CHECK(stream.writeCount() == 2);
+    }
+
+    SECTION("log manager knows whether batching is enabled") {
+        CountingOutputStream stream;
+        CHECK(!LogManager::batchingEnabled());
+        {
+            ScopedLogHandler<StreamLogHandler> handler(stream);
+            CHECK(!LogManager::batchingEnabled());
+            handler.setBatching(1000, 60000);
+            CHECK(LogManager::batchingEnabled());
+            handler.setBatching(2000, 60000);
+            handler.setBatching(0);
+            CHECK(!LogManager::batchingEnabled());
+            handler.setBatching(1000, 60000);
+        }
+        CHECK(!LogManager::batchingEnabled()); // The handler has been destroyed
+    }
+
+    SECTION("direct logging writes batched messages first") {
+        CountingOutputStream stream;
+        ScopedLogHandler<StreamLogHandler> handler(stream);
+        handler.setBatching(1000, 60000);
+        LOG(INFO, "message");
+        Log.print("direct");
+        check(stream).endsWith("INFO: message\r\ndirect");
+    }
+
+    SECTION("messages exceeding the buffer size are not truncated") {
+        CountingOutputStream stream;
+        ScopedLogHandler<StreamLogHandler> handler(stream);
+        const std::string msg(detail::LogBuffer::DEFAULT_SIZE * 2, 'a');
+        handler.message(msg.c_str(), LOG_LEVEL_INFO, nullptr, LogAttributes());
+        check(stream).endsWith(msg + "\r\n");
+    }
+}
+
+#if PLATFORM_THREADING
+
+TEST_CASE("Asynchronous logging") {
+    const auto mgr = LogManager::instance();
+    // The queue is allocated once and shared by all sections
+    REQUIRE(mgr->enableAsyncMode(256));
+    REQUIRE(mgr->isAsyncMode());
+    DefaultLogHandler log(LOG_LEVEL_ALL);
+
+    SECTION("queued messages are delivered on flush") {
+        LOG(INFO, "message 1");
+        LOG_ATTR(WARN, (code = -1, details = "details"), "message 2");
+        mgr->flush();
+        log.checkNext().messageEquals("message 1").levelEquals(LOG_LEVEL_INFO).categoryEquals(LOG_THIS_CATEGORY());
+        log.checkNext().messageEquals("message 2").levelEquals(LOG_LEVEL_WARN).codeEquals(-1).detailsEquals("details");
+        log.checkAtEnd();
+    }
+
+    SECTION("pending messages are delivered when asynchronous mode is disabled") {
+        LOG(INFO, "message 1");
+        LOG(INFO, "message 2");
+        mgr->disableAsyncMode();
+        CHECK(!mgr->isAsyncMode());
+        log.checkNext().messageEquals("message 1");
+        log.checkNext().messageEquals("message 2");
+        log.checkAtEnd();
+        LOG(INFO, "message 3"); // Logged synchronously
+        log.checkNext().messageEquals("message 3");
+        log.checkAtEnd();
+    }
+
+    SECTION("messages logged while asynchronous mode is being disabled are not lost") {
+        const unsigned dropped = mgr->droppedMessageCount();
+        const int THREADS = 4;
+        const int MESSAGES = 50; // The queue can hold all messages
+        std::vector<std::thread> threads;
+        for (int i = 0; i < THREADS; ++i) {
+            threads.push_back(std::thread([]() {
+                for (int j = 0; j < MESSAGES; ++j) {
+                    LOG(INFO, "message");
+                }
+            }));
+        }
+        mgr->disableAsyncMode();
+        for (std::thread &t: threads) {
+            t.join();
+        }
+        int count = 0;
+        while (log.hasNext()) {
+            log.checkNext().messageEquals("message");
+            ++count;
+        }
+        CHECK(count == THREADS * MESSAGES);
+        CHECK(mgr->droppedMessageCount() == dropped);
+    }
+
+    mgr->disableAsyncMode();
+}
+
+#endif // PLATFORM_THREADING
+
 TEST_CASE("Configuration requests") {
     LogControl logControl;
     NamedOutputStreamFactory streamFactory;
@@ -0,0 +1,110 @@
+#include "mpsc_queue.h"
+
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace particle;
+
+template<typename T>
+bool push(MpscQueue<T>& q, T value) {
+    return q.push([value](T& v) {
+        v = value;
+    });
+}
+
+template<typename T>
+bool pop(MpscQueue<T>& q, T* value) {
+    return q.pop([value](const T& v) {
+        *value = v;
+    });
+}
+
+} // namespace
+
+TEST_CASE("MpscQueue") {
+    SECTION("rounds up the capacity to a power of two") {
+        MpscQueue<int> q;
+        CHECK(q.capacity() == 0);
+        CHECK(!push(q, 1)); // Not initialized
+        REQUIRE(q.init(5) == 0);
+        CHECK(q.capacity() == 8);
+    }
+
+    SECTION("elements are consumed in FIFO order") {
+        MpscQueue<int> q;
+        REQUIRE(q.init(4) == 0);
+        int v = 0;
+        CHECK(!pop(q, &v));
+        for (int i = 0; i < 10; ++i) {
+            CHECK(push(q, i));
+            CHECK(push(q, i + 100));
+            CHECK(pop(q, &v));
+            CHECK(v == i);
+            CHECK(pop(q, &v));
+            CHECK(v == i + 100);
+        }
+        CHECK(!pop(q, &v));
+    }
+
+    SECTION("drops and counts elements when full") {
+        MpscQueue<int> q;
+        REQUIRE(q.init(2) == 0);
+        CHECK(push(q, 1));
+        CHECK(push(q, 2));
+        CHECK(!push(q, 3));
+        CHECK(!push(q, 4));
+        CHECK(q.takeDroppedCount() == 2);
+        CHECK(q.takeDroppedCount() == 0);
+        int v = 0;
+        CHECK(pop(q, &v));
+        CHECK(v == 1);
+        CHECK(push(q, 5));
+        CHECK(pop(q, &v));
+        CHECK(v == 2);
+        CHECK(pop(q, &v));
+        CHECK(v == 5);
+    }
+
+    SECTION("supports concurrent producers") {
+        const int PRODUCERS = 4;
+        const int COUNT = 20000;
+        MpscQueue<int> q;
+        REQUIRE(q.init(64) == 0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < PRODUCERS; ++i) {
+            threads.emplace_back([&q, i]() {
+                for (int j = 0; j < COUNT; ++j) {
+                    while (!push(q, i * COUNT + j)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        // Elements of each producer must be received in order
+        std::vector<int> next(PRODUCERS, 0);
+        int received = 0;
+        bool ordered = true;
+        while (received < PRODUCERS * COUNT) {
+            int v = 0;
+            if (pop(q, &v)) {
+                const int p = v / COUNT;
+                if (v % COUNT != next[p]) {
+                    ordered = false;
+                }
+                next[p] = v % COUNT + 1;
+                ++received;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        for (auto& t: threads) {
+            t.join();
+        }
+        CHECK(ordered);
+        CHECK(!pop(q, &received));
+    }
+}
@@ -0,0 +1,75 @@
+#include "system_delay.h"
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+using namespace particle::system;
+
+// Tolerance for the host scheduler, in microseconds
+const system_tick_t MAX_JITTER_MICROS = 2000;
+
+system_tick_t measureDelay(system_tick_t ms, system_tick_t interval, unsigned* count = nullptr) {
+    unsigned n = 0;
+    const system_tick_t t = HAL_Timer_Get_Micro_Seconds();
+    delay_pump(ms, interval, false, [&n]() {
+        ++n;
+        return false;
+    });
+    const system_tick_t d = HAL_Timer_Get_Micro_Seconds() - t;
+    if (count) {
+        *count = n;
+    }
+    return d;
+}
+
+} // namespace
+
+TEST_CASE("delay_pump()") {
+    SECTION("returns immediately for zero delay") {
+        unsigned count = 0;
+        CHECK(measureDelay(0, 1, &count) < MAX_JITTER_MICROS);
+        CHECK(count == 0);
+    }
+
+    SECTION("completes the delay without early return") {
+        // The host scheduler may occasionally preempt the test, so the median jitter is checked
+        std::vector<system_tick_t> jitter;
+        for (system_tick_t ms = 1; ms <= 21; ++ms) {
+            const system_tick_t d = measureDelay(ms, 0);
+            REQUIRE(d >= ms * 1000);
+            jitter.push_back(d - ms * 1000);
+        }
+        std::sort(jitter.begin(), jitter.end());
+        const system_tick_t median = jitter.at(jitter.size() / 2);
+        INFO("median jitter: " << median << " us, max jitter: " << jitter.back() << " us");
+        CHECK(median < MAX_JITTER_MICROS);
+    }
+
+    SECTION("runs background processing once per interval") {
+        unsigned count = 0;
+        const system_tick_t d = measureDelay(110, 20, &count);
+        CHECK(d >= 110000);
+        CHECK(count == 5);
+    }
+
+    SECTION("runs overdue background processing immediately") {
+        unsigned count = 0;
+        delay_pump(10, 1000, true, [&count]() {
+            ++count;
+            return false;
+        });
+        CHECK(count == 1);
+    }
+
+    SECTION("keeps processing while background work is pending") {
+        unsigned count = 0;
+        delay_pump(20, 1000, true, [&count]() {
+            return ++count < 3;
+        });
+        CHECK(count == 3);
+    }
+}
@@ -36,7 +36,7 @@ using std::min;
 
 SCENARIO("Backoff period after 0 attempts should be 0", "[system_task]") {
 
-    REQUIRE(backoff_period(0)==0);
+    REQUIRE(backoff_period(0, 1000)==0);
 }
 
 SCENARIO("Backoff period should increase exponentially from 1s to 128s", "[system_task]") {
@@ -44,7 +44,7 @@ SCENARIO("Backoff period should increase exponentially from 1s to 128s", "[syste
     unsigned previous = 0;
     for (int i=0; i<1000; i++) {
         INFO("connection attempts " << i);
-        unsigned period = backoff_period(i);
+        unsigned period = backoff_period(i, 1000);
         REQUIRE(period >= previous);
         int exponent = min(7,  ((i-1)/5));
         unsigned expected = i==0 ? 0 : ((1<<exponent)*1000);
@@ -53,6 +53,18 @@ SCENARIO("Backoff period should increase exponentially from 1s to 128s", "[syste
     }
 }
 
+SCENARIO("Backoff period should not exceed 128s for a longer base period", "[system_task]") {
+
+    for (int i=1; i<1000; i++) {
+        INFO("connection attempts " << i);
+        unsigned period = backoff_period(i, 8000);
+        int exponent = min(7,  ((i-1)/5));
+        REQUIRE(period == min(MAX_BACKOFF_PERIOD, (1u<<exponent)*8000));
+    }
+    REQUIRE(backoff_period(1, 8000)==8000);
+    REQUIRE(backoff_period(1000, 8000)==MAX_BACKOFF_PERIOD);
+}
+
 SCENARIO("System version info is retrieved", "[system,version]") {
 
     SystemVersionInfo info;
@@ -0,0 +1,182 @@
+#include "timer_queue.h"
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace particle;
+
+class Timers {
+public:
+    explicit Timers(size_t count) :
+            timers_(new SoftTimer[count]) {
+        for (size_t i = 0; i < count; ++i) {
+            timers_[i].setCallback(expired, this);
+        }
+    }
+
+    SoftTimer* at(size_t index) {
+        return &timers_[index];
+    }
+
+    size_t indexOf(const SoftTimer* timer) const {
+        return timer - timers_.get();
+    }
+
+    std::vector<size_t>& expired() {
+        return expired_;
+    }
+
+private:
+    std::unique_ptr<SoftTimer[]> timers_;
+    std::vector<size_t> expired_;
+
+    static void expired(SoftTimer* timer, void* data) {
+        const auto self = static_cast<Timers*>(data);
+        self->expired_.push_back(self->indexOf(timer));
+    }
+};
+
+} // namespace
+
+TEST_CASE("TimerQueue") {
+    TimerQueue q;
+
+    SECTION("expires timers in the order of their deadlines") {
+        Timers t(3);
+        REQUIRE(q.start(t.at(0), 300) == 0);
+        REQUIRE(q.start(t.at(1), 100) == 0);
+        REQUIRE(q.start(t.at(2), 200) == 0);
+        CHECK(q.size() == 3);
+        CHECK(q.nextTimeout(0) == 100);
+        CHECK(q.process(99) == 0);
+        CHECK(q.process(250) == 2);
+        CHECK(t.expired() == std::vector<size_t>({ 1, 2 }));
+        CHECK(!t.at(1)->isActive());
+        CHECK(t.at(0)->isActive());
+        CHECK(q.nextTimeout(250) == 50);
+        CHECK(q.process(1000) == 1);
+        CHECK(q.isEmpty());
+        CHECK(q.nextTimeout(1000) == TimerQueue::MAX_TIMEOUT);
+    }
+
+    SECTION("stops and restarts timers") {
+        Timers t(3);
+        q.start(t.at(0), 100);
+        q.start(t.at(1), 200);
+        q.start(t.at(2), 300);
+        q.stop(t.at(0));
+        CHECK(!t.at(0)->isActive());
+        q.start(t.at(2), 50); // Restart an active timer
+        CHECK(q.size() == 2);
+        CHECK(q.nextTimeout(0) == 50);
+        q.process(1000);
+        CHECK(t.expired() == std::vector<size_t>({ 2, 1 }));
+    }
+
+    SECTION("stops a timer when it's destroyed") {
+        {
+            SoftTimer timer;
+            q.start(&timer, 100);
+            CHECK(q.size() == 1);
+        }
+        CHECK(q.isEmpty());
+    }
+
+    SECTION("restarts periodic timers") {
+        Timers t(1);
+        q.start(t.at(0), 10, 10);
+        CHECK(q.process(10) == 1);
+        CHECK(t.at(0)->isActive());
+        CHECK(t.at(0)->deadline() == 20);
+        // Missed periods are skipped
+        CHECK(q.process(55) == 1);
+        CHECK(t.at(0)->deadline() == 65);
+        CHECK(t.expired().size() == 2);
+    }
+
+    SECTION("coalesces timers with slack") {
+        Timers t(2);
+        q.start(t.at(0), 100, 0, 50);
+        q.start(t.at(1), 130);
+        CHECK(q.nextTimeout(0) == 130);
+        CHECK(q.process(130) == 2);
+        CHECK(t.expired() == std::vector<size_t>({ 1, 0 }));
+    }
+
+    SECTION("handles timer wraparound") {
+        Timers t(2);
+        const system_tick_t now = 0xfffffff0;
+        q.start(t.at(0), now + 0x20);
+        q.start(t.at(1), now + 0x10);
+        CHECK(q.nextTimeout(now) == 0x10);
+        CHECK(q.process(now + 0x10) == 1);
+        CHECK(q.process(now + 0x20) == 1);
+        CHECK(t.expired() == std::vector<size_t>({ 1, 0 }));
+    }
+
+    SECTION("timers restarted from a callback expire on the next call") {
+        SoftTimer timer;
+        struct Ctx {
+            TimerQueue* q;
+            int count;
+        } ctx = { &q, 0 };
+        timer.setCallback([](SoftTimer* timer, void* data) {
+            const auto ctx = static_cast<Ctx*>(data);
+            ++ctx->count;
+            ctx->q->start(timer, 0); // Deadline in the past
+        }, &ctx);
+        q.start(&timer, 10);
+        CHECK(q.process(10) == 1);
+        CHECK(ctx.count == 1);
+        CHECK(timer.deadline() == 11);
+        CHECK(q.process(11) == 1);
+        CHECK(ctx.count == 2);
+    }
+
+    SECTION("takeExpired() doesn't invoke callbacks") {
+        Timers t(2);
+        q.start(t.at(0), 10);
+        q.start(t.at(1), 20);
+        CHECK(q.takeExpired(15) == t.at(0));
+        CHECK(q.takeExpired(15) == nullptr);
+        CHECK(t.expired().empty());
+    }
+
+    SECTION("manages thousands of timers") {
+        const size_t N = 10000;
+        Timers t(N);
+        std::mt19937 gen(1);
+        std::uniform_int_distribution<system_tick_t> dist(1, 1000000);
+        std::vector<system_tick_t> deadlines;
+        for (size_t i = 0; i < N; ++i) {
+            const system_tick_t d = dist(gen);
+            deadlines.push_back(d);
+            REQUIRE(q.start(t.at(i), d) == 0);
+        }
+        // Stop every third timer
+        size_t stopped = 0;
+        for (size_t i = 0; i < N; i += 3) {
+            q.stop(t.at(i));
+            ++stopped;
+        }
+        CHECK(q.size() == (int)(N - stopped));
+        system_tick_t now = 0;
+        while (!q.isEmpty()) {
+            now += q.nextTimeout(now);
+            q.process(now);
+        }
+        REQUIRE(t.expired().size() == N - stopped);
+        for (size_t i = 1; i < t.expired().size(); ++i) {
+            REQUIRE(deadlines[t.expired()[i - 1]] <= deadlines[t.expired()[i]]);
+        }
+        for (size_t i: t.expired()) {
+            REQUIRE((i % 3) != 0);
+        }
+    }
+}
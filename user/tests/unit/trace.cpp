@@ -0,0 +1,115 @@
+#include "trace.h"
+#include "trace_export.h"
+
+#include "catch.hpp"
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+std::vector<trace_event> recordedEvents() {
+    std::vector<trace_event> events;
+    REQUIRE(trace_enum_events([](const trace_event* e, void* data) {
+        static_cast<std::vector<trace_event>*>(data)->push_back(*e);
+        return 0;
+    }, &events, nullptr) == 0);
+    return events;
+}
+
+void traceScope() {
+    TRACE_SCOPE("scope");
+    TRACE_INSTANT("instant", 123);
+}
+
+} // namespace
+
+TEST_CASE("Tracer") {
+    trace_clear(nullptr);
+
+    SECTION("records events in chronological order") {
+        TRACE_BEGIN("a");
+        TRACE_INSTANT("b", 1);
+        TRACE_END("a");
+        const auto events = recordedEvents();
+        REQUIRE(events.size() == 3);
+        CHECK(std::string(events[0].name) == "a");
+        CHECK(events[0].type == TRACE_EVENT_BEGIN);
+        CHECK(std::string(events[1].name) == "b");
+        CHECK(events[1].type == TRACE_EVENT_INSTANT);
+        CHECK(events[1].data == 1);
+        CHECK(events[2].type == TRACE_EVENT_END);
+        CHECK((int32_t)(events[2].time - events[0].time) >= 0);
+    }
+
+    SECTION("TRACE_SCOPE records the duration of the enclosing scope") {
+        traceScope();
+        const auto events = recordedEvents();
+        REQUIRE(events.size() == 3);
+        CHECK(events[0].type == TRACE_EVENT_BEGIN);
+        CHECK(std::string(events[1].name) == "instant");
+        CHECK(events[2].type == TRACE_EVENT_END);
+        CHECK(std::string(events[2].name) == "scope");
+    }
+
+    SECTION("keeps only the most recent events") {
+        for (unsigned i = 0; i < PARTICLE_TRACE_THREAD_EVENTS * 2 + 5; ++i) {
+            TRACE_INSTANT("event", i);
+        }
+        const auto events = recordedEvents();
+        REQUIRE(events.size() == PARTICLE_TRACE_THREAD_EVENTS - 1);
+        CHECK(events.front().data == PARTICLE_TRACE_THREAD_EVENTS + 6);
+        CHECK(events.back().data == PARTICLE_TRACE_THREAD_EVENTS * 2 + 4);
+    }
+
+    SECTION("rings of exited threads are reused") {
+        const uint32_t dropped = trace_dropped_events(nullptr);
+        for (unsigned i = 0; i < PARTICLE_TRACE_MAX_THREADS * 2; ++i) {
+            std::thread([i]() {
+                TRACE_INSTANT("thread", i);
+            }).join();
+        }
+        CHECK(trace_dropped_events(nullptr) == dropped);
+        unsigned count = 0;
+        for (const trace_event& e: recordedEvents()) {
+            if (std::string(e.name) == "thread") {
+                ++count;
+            }
+        }
+        CHECK(count == PARTICLE_TRACE_MAX_THREADS * 2);
+    }
+
+    SECTION("trace_enum_events() stops on callback errors") {
+        TRACE_INSTANT("a", 0);
+        TRACE_INSTANT("b", 0);
+        int count = 0;
+        CHECK(trace_enum_events([](const trace_event* e, void* data) {
+            ++*static_cast<int*>(data);
+            return -1;
+        }, &count, nullptr) == -1);
+        CHECK(count == 1);
+    }
+
+    SECTION("trace_clear() discards the recorded events") {
+        TRACE_INSTANT("a", 0);
+        trace_clear(nullptr);
+        CHECK(recordedEvents().empty());
+    }
+
+    SECTION("exportChromeTrace() writes events in the Chrome trace format") {
+        traceScope();
+        std::ostringstream strm;
+        REQUIRE(exportChromeTrace(strm));
+        const std::string s = strm.str();
+        CHECK(s.find("{\"traceEvents\":[") == 0);
+        CHECK(s.find("{\"name\":\"scope\",\"ph\":\"B\",\"ts\":0,\"pid\":0,\"tid\":0}") != std::string::npos);
+        CHECK(s.find("{\"name\":\"instant\",\"ph\":\"i\",\"ts\":") != std::string::npos);
+        CHECK(s.find("\"s\":\"t\",\"args\":{\"data\":123}}") != std::string::npos);
+        CHECK(s.find("{\"name\":\"scope\",\"ph\":\"E\",\"ts\":") != std::string::npos);
+        CHECK(s.find("\"otherData\":{\"dropped\":0}}") != std::string::npos);
+    }
+
+    trace_clear(nullptr);
+}
@@ -39,4 +39,14 @@ test(api_application_watchdog)
 }
 
 
+test(api_worker_pool)
+{
+	WorkerPool pool;
+	WorkerPool pool2(4, 1024, OS_THREAD_PRIORITY_DEFAULT + 1);
+	API_COMPILE(pool.submit([]() { return 1; }).onSuccess([](int) {}));
+	API_COMPILE(pool.submit([]() {}).wait());
+	API_COMPILE(pool.size());
+	API_COMPILE(pool.stop());
+}
+
 #endif
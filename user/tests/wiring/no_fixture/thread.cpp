@@ -124,4 +124,41 @@ test(APPLICATION_WATCHDOG_03_doesnt_leak_memory)
 	assertMoreOrEqual(System.freeMemory(), s_ram_free_before - 2048);
 }
 
+test(WORKER_POOL_01_runs_submitted_tasks)
+{
+	WorkerPool pool(3, 2048);
+	assertEqual(pool.size(), 3);
+	std::atomic<int> count(0);
+	Future<int> futures[10];
+	for (int i = 0; i < 10; ++i) {
+		futures[i] = pool.submit([&count, i]() {
+			++count;
+			return i * i;
+		});
+	}
+	for (int i = 0; i < 10; ++i) {
+		assertEqual(futures[i].result(), i * i);
+	}
+	pool.stop();
+	assertEqual(count.load(), 10);
+}
+
+test(WORKER_POOL_02_tasks_can_submit_tasks)
+{
+	WorkerPool pool(2, 2048);
+	std::atomic<int> count(0);
+	for (int i = 0; i < 4; ++i) {
+		pool.submit([&pool, &count]() {
+			for (int j = 0; j < 4; ++j) {
+				pool.submit([&count]() {
+					++count;
+				});
+			}
+		});
+	}
+	// Stopping the pool executes all pending tasks
+	pool.stop();
+	assertEqual(count.load(), 16);
+}
+
 #endif
@@ -25,8 +25,11 @@
 #include "system_task.h"
 
 #include <functional>
+#include <initializer_list>
+#include <type_traits>
 #include <memory>
 #include <atomic>
+#include <new>
 
 #if (ATOMIC_POINTER_LOCK_FREE != 2) || (ATOMIC_CHAR_LOCK_FREE != 2) || (ATOMIC_BOOL_LOCK_FREE != 2)
 #error "std::atomic is not always lock-free for required types"
@@ -53,6 +56,30 @@ struct FutureCallbackTypes<void> {
 // Helper function for FutureImplBase::invokeCallback()
 void futureCallbackWrapper(void* data);
 
+template<typename ResultT, typename ContextT>
+class FutureImpl;
+
+// Base class for a continuation attached to a future
+template<typename ResultT, typename ContextT>
+class FutureContinuation {
+public:
+    virtual ~FutureContinuation() = default;
+
+    // Invoked by the thread that completed the future
+    virtual void complete(const FutureImpl<ResultT, ContextT>& future) = 0;
+
+    // Invoked if the future is destroyed before it's completed
+    virtual void discard() {
+        delete this;
+    }
+
+private:
+    FutureContinuation* next_ = nullptr;
+
+    template<typename, typename>
+    friend class FutureImplBase;
+};
+
 // Internal future implementation. Base class for FutureImpl
 template<typename ResultT, typename ContextT>
 class FutureImplBase {
@@ -72,6 +99,14 @@ public:
     ~FutureImplBase() {
         delete onSuccess_.load(std::memory_order_relaxed);
         delete onError_.load(std::memory_order_relaxed);
+        auto c = continuations_.load(std::memory_order_relaxed);
+        if (c != completedMarker()) {
+            while (c) {
+                const auto next = c->next_;
+                c->discard();
+                c = next;
+            }
+        }
     }
 
     bool wait(int timeout = 0) const {
@@ -95,11 +130,25 @@ public:
     bool cancel() {
         if (changeState(State::CANCELLED)) {
             releaseDone();
+            completeContinuations();
             return true;
         }
         return false;
     }
 
+    // Attaches a continuation to this future. If the future is already completed, the continuation
+    // is invoked immediately
+    void addContinuation(FutureContinuation<ResultT, ContextT>* c) {
+        auto head = continuations_.load(std::memory_order_acquire);
+        do {
+            if (head == completedMarker()) {
+                c->complete(static_cast<const FutureImpl<ResultT, ContextT>&>(*this));
+                return;
+            }
+            c->next_ = head;
+        } while (!continuations_.compare_exchange_weak(head, c, std::memory_order_acq_rel, std::memory_order_acquire));
+    }
+
     bool isSucceeded() const {
         wait();
         return state() == State::SUCCEEDED;
@@ -123,12 +172,38 @@ protected:
     std::atomic<bool> done_; // Flag signaling that future is in a final state
     std::atomic<typename FutureCallbackTypes<ResultT>::OnSuccess*> onSuccess_; // User callback for succeeded operation
     std::atomic<typename FutureCallbackTypes<ResultT>::OnError*> onError_; // User callback for failed operation
+    std::atomic<FutureContinuation<ResultT, ContextT>*> continuations_; // Attached continuations
 
     explicit FutureImplBase(State state) :
             state_(state),
             done_(state != State::RUNNING),
             onSuccess_(nullptr),
-            onError_(nullptr) {
+            onError_(nullptr),
+            continuations_((state != State::RUNNING) ? completedMarker() : nullptr) {
+    }
+
+    // Invokes all attached continuations in the order in which they were attached
+    void completeContinuations() {
+        auto c = continuations_.exchange(completedMarker(), std::memory_order_acq_rel);
+        FutureContinuation<ResultT, ContextT>* prev = nullptr;
+        while (c) {
+            const auto next = c->next_;
+            c->next_ = prev;
+            prev = c;
+            c = next;
+        }
+        while (prev) {
+            const auto next = prev->next_;
+            prev->complete(static_cast<const FutureImpl<ResultT, ContextT>&>(*this));
+            prev = next;
+        }
+    }
+
+    // Marker value indicating that the future's continuations have been invoked. This pointer is
+    // never dereferenced
+    static FutureContinuation<ResultT, ContextT>* completedMarker() {
+        static char marker;
+        return reinterpret_cast<FutureContinuation<ResultT, ContextT>*>(&marker);
     }
 
     bool changeState(State state) {
@@ -219,6 +294,7 @@ public:
             new(&result_) ResultT(std::move(result));
             this->releaseDone();
             this->invokeCallback(this->onSuccess_, result_);
+            this->completeContinuations();
         }
     }
 
@@ -235,6 +311,7 @@ public:
             new(&error_) Error(std::move(error));
             this->releaseDone();
             this->invokeCallback(this->onError_, error_);
+            this->completeContinuations();
         }
     }
 
@@ -293,6 +370,7 @@ public:
         if (this->changeState(State::SUCCEEDED)) {
             this->releaseDone();
             this->invokeCallback(this->onSuccess_);
+            this->completeContinuations();
         }
     }
 
@@ -301,6 +379,7 @@ public:
             error_ = std::move(error);
             this->releaseDone();
             this->invokeCallback(this->onError_, error_);
+            this->completeContinuations();
         }
     }
 
@@ -360,6 +439,38 @@ class Future;
 template<typename ResultT, typename ContextT>
 class Promise;
 
+namespace detail {
+
+// Result type of a function passed to Future::then()
+template<typename ResultT, typename FunctionT>
+struct FutureFunctionResult {
+    typedef typename std::result_of<FunctionT(const ResultT&)>::type type;
+};
+
+template<typename FunctionT>
+struct FutureFunctionResult<void, FunctionT> {
+    typedef typename std::result_of<FunctionT()>::type type;
+};
+
+// Result type of a future returned by Future::then(). Functions returning a future are unwrapped
+template<typename T, typename ContextT>
+struct FutureUnwrap {
+    typedef T type;
+};
+
+template<typename T, typename ContextT>
+struct FutureUnwrap<Future<T, ContextT>, ContextT> {
+    typedef T type;
+};
+
+template<typename ResultT, typename ContextT, typename FunctionT, typename RetT>
+class ThenContinuation;
+
+// Helper class providing access to the internal future implementation
+struct FutureAccess;
+
+} // namespace particle::detail
+
 // Base class for Promise. Promise allows to store result of an asynchronous operation that later
 // can be acquired via Future
 template<typename ResultT, typename ContextT>
@@ -507,10 +618,29 @@ public:
         return *static_cast<Future<ResultT, ContextT>*>(this);
     }
 
+    // Returns a future that is completed with the result of a function invoked with the result of
+    // this future. If this future fails or gets cancelled, the function is not invoked and the
+    // returned future fails with the same error. The function is invoked in the application context
+    // and can return another future, in which case the returned future is completed when that
+    // future is completed
+    template<typename FunctionT, typename RetT = typename detail::FutureFunctionResult<ResultT, FunctionT>::type>
+    Future<typename detail::FutureUnwrap<RetT, ContextT>::type, ContextT> then(FunctionT func) const {
+        typedef typename detail::FutureUnwrap<RetT, ContextT>::type NextT;
+        Promise<NextT, ContextT> p;
+        const auto c = new(std::nothrow) detail::ThenContinuation<ResultT, ContextT, FunctionT, RetT>(std::move(func), p);
+        if (!c) {
+            return Future<NextT, ContextT>(Error::NO_MEMORY);
+        }
+        p_->addContinuation(c);
+        return p.future();
+    }
+
 protected:
     typedef typename detail::FutureImpl<ResultT, ContextT>::State State;
 
     detail::FutureImplPtr<ResultT, ContextT> p_;
+
+    friend struct detail::FutureAccess;
 };
 
 template<typename ResultT, typename ContextT = detail::FutureContext>
@@ -575,6 +705,308 @@ public:
     }
 };
 
+namespace detail {
+
+struct FutureAccess {
+    template<typename ResultT, typename ContextT>
+    static void addContinuation(const FutureBase<ResultT, ContextT>& future, FutureContinuation<ResultT, ContextT>* c) {
+        future.p_->addContinuation(c);
+    }
+};
+
+// Storage for a future's result
+template<typename ResultT>
+class FutureValue {
+public:
+    template<typename ContextT>
+    void set(const FutureImpl<ResultT, ContextT>& future) {
+        value_ = future.result();
+    }
+
+    template<typename FunctionT>
+    typename std::result_of<FunctionT(const ResultT&)>::type apply(FunctionT& func) const {
+        return func(value_);
+    }
+
+    template<typename ContextT>
+    void complete(Promise<ResultT, ContextT>& promise) {
+        promise.setResult(std::move(value_));
+    }
+
+private:
+    ResultT value_;
+};
+
+// Specialization for void result type
+template<>
+class FutureValue<void> {
+public:
+    template<typename ContextT>
+    void set(const FutureImpl<void, ContextT>& future) {
+    }
+
+    template<typename FunctionT>
+    typename std::result_of<FunctionT()>::type apply(FunctionT& func) const {
+        return func();
+    }
+
+    template<typename ContextT>
+    void complete(Promise<void, ContextT>& promise) {
+        promise.setResult();
+    }
+};
+
+// Returns the error of a completed future that didn't succeed
+template<typename ResultT, typename ContextT>
+inline Error futureError(const FutureImpl<ResultT, ContextT>& future) {
+    return future.isFailed() ? future.error() : Error(Error::CANCELLED);
+}
+
+// Continuation forwarding the result of a future to a promise
+template<typename ResultT, typename ContextT>
+class ForwardContinuation: public FutureContinuation<ResultT, ContextT> {
+public:
+    explicit ForwardContinuation(Promise<ResultT, ContextT> promise) :
+            promise_(std::move(promise)) {
+    }
+
+    void complete(const FutureImpl<ResultT, ContextT>& future) override {
+        if (future.isSucceeded()) {
+            FutureValue<ResultT> v;
+            v.set(future);
+            v.complete(promise_);
+        } else {
+            promise_.setError(futureError(future));
+        }
+        delete this;
+    }
+
+private:
+    Promise<ResultT, ContextT> promise_;
+};
+
+// Invokes a continuation function and completes a promise with the function's result
+template<typename RetT, typename ContextT>
+struct ThenInvoker {
+    template<typename ValueT, typename FunctionT>
+    static void invoke(Promise<RetT, ContextT>& promise, const ValueT& value, FunctionT& func) {
+        promise.setResult(value.apply(func));
+    }
+};
+
+template<typename ContextT>
+struct ThenInvoker<void, ContextT> {
+    template<typename ValueT, typename FunctionT>
+    static void invoke(Promise<void, ContextT>& promise, const ValueT& value, FunctionT& func) {
+        value.apply(func);
+        promise.setResult();
+    }
+};
+
+template<typename T, typename ContextT>
+struct ThenInvoker<Future<T, ContextT>, ContextT> {
+    template<typename ValueT, typename FunctionT>
+    static void invoke(Promise<T, ContextT>& promise, const ValueT& value, FunctionT& func) {
+        const Future<T, ContextT> f = value.apply(func);
+        const auto c = new(std::nothrow) ForwardContinuation<T, ContextT>(promise);
+        if (!c) {
+            promise.setError(Error::NO_MEMORY);
+            return;
+        }
+        FutureAccess::addContinuation(f, c);
+    }
+};
+
+// Continuation created by Future::then()
+template<typename ResultT, typename ContextT, typename FunctionT, typename RetT>
+class ThenContinuation: public FutureContinuation<ResultT, ContextT> {
+public:
+    typedef typename FutureUnwrap<RetT, ContextT>::type NextT;
+
+    ThenContinuation(FunctionT func, Promise<NextT, ContextT> promise) :
+            func_(std::move(func)),
+            promise_(std::move(promise)),
+            error_(Error::NONE) {
+    }
+
+    void complete(const FutureImpl<ResultT, ContextT>& future) override {
+        if (future.isSucceeded()) {
+            value_.set(future);
+        } else {
+            error_ = futureError(future);
+        }
+        if (ContextT::isApplicationThreadCurrent()) {
+            run(this); // Synchronous call
+        } else {
+            ContextT::invokeApplicationCallback(run, this);
+        }
+    }
+
+private:
+    FunctionT func_;
+    Promise<NextT, ContextT> promise_;
+    FutureValue<ResultT> value_;
+    Error error_;
+
+    static void run(void* data) {
+        const auto c = static_cast<ThenContinuation*>(data);
+        // The resulting future could have been cancelled
+        if (!c->promise_.isDone()) {
+            if (c->error_ != Error::NONE) {
+                c->promise_.setError(std::move(c->error_));
+            } else {
+                ThenInvoker<RetT, ContextT>::invoke(c->promise_, c->value_, c->func_);
+            }
+        }
+        delete c;
+    }
+};
+
+// Continuation attached to each of the futures passed to whenAll() or whenAny()
+template<typename GroupT, typename ResultT, typename ContextT>
+class FutureGroupItem: public FutureContinuation<ResultT, ContextT> {
+public:
+    void init(GroupT* group, size_t index) {
+        group_ = group;
+        index_ = index;
+    }
+
+    void complete(const FutureImpl<ResultT, ContextT>& future) override {
+        if (future.isSucceeded()) {
+            group_->succeeded(index_);
+        } else {
+            group_->failed(futureError(future));
+        }
+    }
+
+    void discard() override {
+        group_->failed(Error::CANCELLED);
+    }
+
+private:
+    GroupT* group_ = nullptr;
+    size_t index_ = 0;
+};
+
+// Base class for whenAll() and whenAny() state. All continuations are allocated in one block,
+// which is released when the last of the futures is completed
+template<typename GroupT, typename GroupResultT, typename ResultT, typename ContextT>
+class FutureGroup {
+public:
+    typedef FutureGroupItem<GroupT, ResultT, ContextT> Item;
+
+    static Future<GroupResultT, ContextT> attach(const Future<ResultT, ContextT>* futures, size_t count) {
+        std::unique_ptr<GroupT> g(new(std::nothrow) GroupT(count));
+        if (!g || !g->items_) {
+            return Future<GroupResultT, ContextT>(Error::NO_MEMORY);
+        }
+        const auto f = g->promise_.future();
+        const auto group = g.release();
+        for (size_t i = 0; i < count; ++i) {
+            FutureAccess::addContinuation(futures[i], &group->items_[i]);
+        }
+        return f;
+    }
+
+protected:
+    Promise<GroupResultT, ContextT> promise_;
+
+    explicit FutureGroup(size_t count) :
+            items_(new(std::nothrow) Item[count]),
+            pending_(count) {
+        if (items_) {
+            for (size_t i = 0; i < count; ++i) {
+                items_[i].init(static_cast<GroupT*>(this), i);
+            }
+        }
+    }
+
+    // Returns true if this was the last pending future
+    bool release() {
+        return (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1);
+    }
+
+private:
+    std::unique_ptr<Item[]> items_;
+    std::atomic<size_t> pending_;
+};
+
+template<typename ResultT, typename ContextT>
+class WhenAllGroup: public FutureGroup<WhenAllGroup<ResultT, ContextT>, void, ResultT, ContextT> {
+public:
+    explicit WhenAllGroup(size_t count) :
+            FutureGroup<WhenAllGroup<ResultT, ContextT>, void, ResultT, ContextT>(count) {
+    }
+
+    void succeeded(size_t index) {
+        if (this->release()) {
+            this->promise_.setResult(); // Ignored if one of the futures has failed
+            delete this;
+        }
+    }
+
+    void failed(const Error& error) {
+        this->promise_.setError(error); // Ignored if one of the futures has already failed
+        if (this->release()) {
+            delete this;
+        }
+    }
+};
+
+template<typename ResultT, typename ContextT>
+class WhenAnyGroup: public FutureGroup<WhenAnyGroup<ResultT, ContextT>, size_t, ResultT, ContextT> {
+public:
+    explicit WhenAnyGroup(size_t count) :
+            FutureGroup<WhenAnyGroup<ResultT, ContextT>, size_t, ResultT, ContextT>(count) {
+    }
+
+    void succeeded(size_t index) {
+        this->promise_.setResult(index); // Ignored if one of the futures has already succeeded
+        if (this->release()) {
+            delete this;
+        }
+    }
+
+    void failed(const Error& error) {
+        if (this->release()) {
+            this->promise_.setError(error); // Ignored if one of the futures has succeeded
+            delete this;
+        }
+    }
+};
+
+} // namespace particle::detail
+
+// Returns a future that succeeds when all of the specified futures succeed, or fails with the
+// error of the first failed future
+template<typename ResultT, typename ContextT>
+inline Future<void, ContextT> whenAll(const Future<ResultT, ContextT>* futures, size_t count) {
+    if (count == 0) {
+        return Future<void, ContextT>();
+    }
+    return detail::WhenAllGroup<ResultT, ContextT>::attach(futures, count);
+}
+
+template<typename ResultT, typename ContextT>
+inline Future<void, ContextT> whenAll(std::initializer_list<Future<ResultT, ContextT>> futures) {
+    return whenAll(futures.begin(), futures.size());
+}
+
+// Returns a future that is completed with the index of the first succeeded future among the
+// specified futures, or fails with the error of the last future if all of them fail
+template<typename ResultT, typename ContextT>
+inline Future<size_t, ContextT> whenAny(const Future<ResultT, ContextT>* futures, size_t count) {
+    if (count == 0) {
+        return Future<size_t, ContextT>(Error::INVALID_ARGUMENT);
+    }
+    return detail::WhenAnyGroup<ResultT, ContextT>::attach(futures, count);
+}
+
+template<typename ResultT, typename ContextT>
+inline Future<size_t, ContextT> whenAny(std::initializer_list<Future<ResultT, ContextT>> futures) {
+    return whenAny(futures.begin(), futures.size());
+}
+
 } // namespace particle
 
 #endif // SPARK_WIRING_ASYNC_H
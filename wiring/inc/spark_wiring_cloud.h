@@ -333,6 +333,17 @@ public:
     }
     static String deviceID(void) { return SystemClass::deviceID(); }
 
+    /**
+     * Enables incremental reporting of diagnostics: only the values that changed since the previous
+     * report are sent to the cloud, with a full snapshot sent periodically.
+     */
+    static void incrementalDiagnostics(bool enabled = true)
+    {
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::INCREMENTAL_METRICS,
+                                               enabled, nullptr, nullptr),
+                 (void)0);
+    }
+
 #if HAL_PLATFORM_CLOUD_UDP
     static void keepAlive(unsigned sec)
     {
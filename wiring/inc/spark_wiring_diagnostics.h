@@ -22,12 +22,15 @@
 #include "spark_wiring_global.h"
 
 #include "diagnostics.h"
+#include "timer_hal.h"
 #include "system_error.h"
 #include "combine_hash.h"
 #include "underlying_type.h"
 #include "debug.h"
 
+#include <algorithm>
 #include <atomic>
+#include <limits>
 
 #define PARTICLE_RETAINED_INTEGER_DIAGNOSTIC_DATA(_var, _id, _name, _val, ...) \
         PARTICLE_RETAINED ::particle::RetainedIntegerDiagnosticDataStorage _storage##_id; \
@@ -41,6 +44,8 @@ namespace particle {
 
 typedef decltype(diag_source::id) DiagnosticDataId;
 
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "Unexpected size of std::atomic<int32_t>");
+
 // Base abstract class for a diagnostic data source
 class AbstractDiagnosticData {
 public:
@@ -58,6 +63,10 @@ protected:
     AbstractDiagnosticData(DiagnosticDataId id, const char* name, diag_type type);
 
     virtual int get(void* data, size_t& size) = 0;
+    // Returns a pointer to the current value of the source if it can be read directly, without
+    // calling get(). The value should be a naturally aligned 32-bit word, so that it can be read
+    // atomically (see diag_snapshot())
+    virtual const volatile void* valuePtr() const;
 
 private:
     diag_source d_;
@@ -161,6 +170,10 @@ private:
         ConcurrencyT::unlock(lock);
         return SYSTEM_ERROR_NONE;
     }
+
+    virtual const volatile void* valuePtr() const override { // AbstractDiagnosticData
+        return &val_;
+    }
 };
 
 template<>
@@ -215,6 +228,10 @@ private:
         val = val_.load(std::memory_order_relaxed);
         return SYSTEM_ERROR_NONE;
     }
+
+    virtual const volatile void* valuePtr() const override { // AbstractDiagnosticData
+        return &val_;
+    }
 };
 
 template<typename StorageT, typename ConcurrencyT = NoConcurrency>
@@ -345,6 +362,10 @@ private:
         ConcurrencyT::unlock(lock);
         return SYSTEM_ERROR_NONE;
     }
+
+    virtual const volatile void* valuePtr() const override { // AbstractDiagnosticData
+        return &val_;
+    }
 };
 
 template<typename EnumT>
@@ -377,6 +398,10 @@ private:
         val = val_.load(std::memory_order_relaxed);
         return SYSTEM_ERROR_NONE;
     }
+
+    virtual const volatile void* valuePtr() const override { // AbstractDiagnosticData
+        return &val_;
+    }
 };
 
 template<typename EnumT, typename StorageT, typename ConcurrencyT = NoConcurrency>
@@ -423,6 +448,144 @@ private:
     }
 };
 
+// Base abstract class for a data source containing a histogram of values
+class AbstractHistogramDiagnosticData: public AbstractDiagnosticData {
+public:
+    // Maximum number of buckets supported by the system formatters
+    static const unsigned MAX_BUCKET_COUNT = 64;
+    // Maximum size of the histogram data
+    static const size_t MAX_DATA_SIZE = sizeof(diag_histogram) + MAX_BUCKET_COUNT * sizeof(uint32_t);
+
+    // Returns the index of the bucket counting a given value
+    static unsigned bucketIndex(uint32_t val, unsigned subBucketBits, unsigned bucketCount);
+    // Returns the smallest value counted by a given bucket
+    static uint32_t bucketLowerBound(unsigned index, unsigned subBucketBits);
+    // Returns the bucket counters that follow the histogram data
+    static const uint32_t* buckets(const diag_histogram* hist);
+
+protected:
+    explicit AbstractHistogramDiagnosticData(DiagnosticDataId id, const char* name = nullptr);
+};
+
+// Histogram with log-linear buckets. Values are recorded without locking, so that record() can be
+// called from any thread or an ISR. Note that the fields of a histogram retrieved while values are
+// being recorded may be slightly inconsistent with each other
+template<unsigned SubBucketBitsN = 2, unsigned BucketCountN = 64>
+class HistogramDiagnosticData: public AbstractHistogramDiagnosticData {
+public:
+    static_assert(BucketCountN > (1u << SubBucketBitsN) && BucketCountN <= MAX_BUCKET_COUNT,
+            "Invalid number of buckets");
+    static_assert(((BucketCountN - 1) >> SubBucketBitsN) + SubBucketBitsN <= 32,
+            "Range of the last bucket exceeds 32 bits");
+
+    explicit HistogramDiagnosticData(DiagnosticDataId id, const char* name = nullptr) :
+            AbstractHistogramDiagnosticData(id, name),
+            buckets_(),
+            sum_(0),
+            min_(std::numeric_limits<uint32_t>::max()),
+            max_(0) {
+    }
+
+    void record(uint32_t val) {
+        buckets_[bucketIndex(val, SubBucketBitsN, BucketCountN)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(val, std::memory_order_relaxed);
+        uint32_t v = min_.load(std::memory_order_relaxed);
+        while (val < v && !min_.compare_exchange_weak(v, val, std::memory_order_relaxed)) {
+        }
+        v = max_.load(std::memory_order_relaxed);
+        while (val > v && !max_.compare_exchange_weak(v, val, std::memory_order_relaxed)) {
+        }
+    }
+
+    void reset() {
+        for (auto& b: buckets_) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        sum_.store(0, std::memory_order_relaxed);
+        min_.store(std::numeric_limits<uint32_t>::max(), std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint32_t count() const {
+        uint32_t n = 0;
+        for (const auto& b: buckets_) {
+            n += b.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+private:
+    std::atomic<uint32_t> buckets_[BucketCountN];
+    std::atomic<uint32_t> sum_;
+    std::atomic<uint32_t> min_;
+    std::atomic<uint32_t> max_;
+
+    virtual int get(void* data, size_t& size) override { // AbstractDiagnosticData
+        const size_t n = sizeof(diag_histogram) + BucketCountN * sizeof(uint32_t);
+        if (!data) {
+            size = n;
+            return SYSTEM_ERROR_NONE;
+        }
+        if (size < n) {
+            return SYSTEM_ERROR_TOO_LARGE;
+        }
+        const auto hist = (diag_histogram*)data;
+        const auto buckets = (uint32_t*)(hist + 1);
+        uint32_t count = 0;
+        for (unsigned i = 0; i < BucketCountN; ++i) {
+            buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            count += buckets[i];
+        }
+        hist->size = sizeof(diag_histogram);
+        hist->sub_bucket_bits = SubBucketBitsN;
+        hist->bucket_count = BucketCountN;
+        hist->count = count;
+        hist->sum = sum_.load(std::memory_order_relaxed);
+        hist->min = count ? min_.load(std::memory_order_relaxed) : 0;
+        hist->max = max_.load(std::memory_order_relaxed);
+        size = n;
+        return SYSTEM_ERROR_NONE;
+    }
+};
+
+// Histogram of durations of an operation, in milliseconds. Only one operation can be timed at a time
+template<unsigned SubBucketBitsN = 2, unsigned BucketCountN = 64>
+class TimerDiagnosticData: public HistogramDiagnosticData<SubBucketBitsN, BucketCountN> {
+public:
+    explicit TimerDiagnosticData(DiagnosticDataId id, const char* name = nullptr) :
+            HistogramDiagnosticData<SubBucketBitsN, BucketCountN>(id, name),
+            start_(0),
+            running_(false) {
+    }
+
+    // Starts timing an operation. An operation that is being timed is discarded
+    void start() {
+        start_.store(HAL_Timer_Get_Milli_Seconds(), std::memory_order_relaxed);
+        running_.store(true, std::memory_order_release);
+    }
+
+    // Records the duration of the operation. Returns `false` if no operation is being timed
+    bool stop() {
+        if (!running_.exchange(false, std::memory_order_acquire)) {
+            return false;
+        }
+        this->record(HAL_Timer_Get_Milli_Seconds() - start_.load(std::memory_order_relaxed));
+        return true;
+    }
+
+    void cancel() {
+        running_.store(false, std::memory_order_relaxed);
+    }
+
+    bool isRunning() const {
+        return running_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<system_tick_t> start_;
+    std::atomic<bool> running_;
+};
+
 template<typename ValueT>
 class RetainedDiagnosticDataStorage {
 public:
@@ -464,6 +627,8 @@ private:
 typedef IntegerDiagnosticData<NoConcurrency> SimpleIntegerDiagnosticData;
 typedef IntegerDiagnosticData<AtomicConcurrency> AtomicIntegerDiagnosticData;
 typedef RetainedDiagnosticDataStorage<AbstractIntegerDiagnosticData::IntType> RetainedIntegerDiagnosticDataStorage;
+typedef HistogramDiagnosticData<> SimpleHistogramDiagnosticData;
+typedef TimerDiagnosticData<> SimpleTimerDiagnosticData;
 
 template<typename EnumT>
 using SimpleEnumDiagnosticData = EnumDiagnosticData<EnumT, NoConcurrency>;
@@ -474,6 +639,21 @@ using AtomicEnumDiagnosticData = EnumDiagnosticData<EnumT, AtomicConcurrency>;
 template<typename EnumT>
 using RetainedEnumDiagnosticDataStorage = RetainedDiagnosticDataStorage<EnumT>;
 
+// Snapshot of the integer data sources, e.g. for sampling the values periodically
+class Diagnostics {
+public:
+    typedef diag_snapshot_entry Entry;
+
+    // Copies the values of all integer data sources to `entries` in one pass (see diag_snapshot()).
+    // On input, `count` is the size of the array, on output it's set to the number of sources
+    static int snapshot(Entry* entries, size_t& count);
+    // Returns the number of integer data sources, or 0 if the service is not started
+    static size_t snapshotSize();
+    // Returns the entry of a source with a given ID, or `nullptr` if the snapshot doesn't contain
+    // such a source
+    static const Entry* find(const Entry* entries, size_t count, DiagnosticDataId id);
+};
+
 inline AbstractDiagnosticData::AbstractDiagnosticData(DiagnosticDataId id, diag_type type) :
         AbstractDiagnosticData(id, nullptr, type) {
 }
@@ -506,6 +686,10 @@ inline int AbstractDiagnosticData::get(const diag_source* src, void* data, size_
     return ret;
 }
 
+inline const volatile void* AbstractDiagnosticData::valuePtr() const {
+    return nullptr;
+}
+
 inline int AbstractDiagnosticData::callback(const diag_source* src, int cmd, void* data) {
     const auto d = static_cast<AbstractDiagnosticData*>(src->data);
     switch (cmd) {
@@ -513,11 +697,39 @@ inline int AbstractDiagnosticData::callback(const diag_source* src, int cmd, voi
         const auto cmdData = static_cast<diag_source_get_cmd_data*>(data);
         return d->get(cmdData->data, cmdData->data_size);
     }
+    case DIAG_SOURCE_CMD_GET_VALUE_PTR: {
+        const volatile void* const ptr = d->valuePtr();
+        if (!ptr) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+        *static_cast<const volatile void**>(data) = ptr;
+        return SYSTEM_ERROR_NONE;
+    }
     default:
         return SYSTEM_ERROR_NOT_SUPPORTED;
     }
 }
 
+inline int Diagnostics::snapshot(Entry* entries, size_t& count) {
+    return diag_snapshot(entries, &count, nullptr);
+}
+
+inline size_t Diagnostics::snapshotSize() {
+    size_t count = 0;
+    if (diag_snapshot(nullptr, &count, nullptr) != SYSTEM_ERROR_NONE) {
+        return 0;
+    }
+    return count;
+}
+
+inline const Diagnostics::Entry* Diagnostics::find(const Entry* entries, size_t count, DiagnosticDataId id) {
+    const Entry* const end = entries + count;
+    const Entry* const e = std::lower_bound(entries, end, id, [](const Entry& e, DiagnosticDataId id) {
+        return (e.id < id);
+    });
+    return (e != end && e->id == id) ? e : nullptr;
+}
+
 inline AbstractIntegerDiagnosticData::AbstractIntegerDiagnosticData(DiagnosticDataId id, const char* name) :
         AbstractDiagnosticData(id, name, DIAG_TYPE_INT) {
 }
@@ -552,4 +764,31 @@ inline int AbstractIntegerDiagnosticData::get(void* data, size_t& size) {
     return ret;
 }
 
+inline AbstractHistogramDiagnosticData::AbstractHistogramDiagnosticData(DiagnosticDataId id, const char* name) :
+        AbstractDiagnosticData(id, name, DIAG_TYPE_HISTOGRAM) {
+}
+
+inline unsigned AbstractHistogramDiagnosticData::bucketIndex(uint32_t val, unsigned subBucketBits, unsigned bucketCount) {
+    const uint32_t subBucketCount = (uint32_t)1 << subBucketBits;
+    unsigned index = val;
+    if (val >= subBucketCount) {
+        const unsigned exp = 31 - __builtin_clz(val); // Position of the most significant bit
+        index = ((exp - subBucketBits + 1) << subBucketBits) + ((val >> (exp - subBucketBits)) - subBucketCount);
+    }
+    return (index < bucketCount) ? index : bucketCount - 1;
+}
+
+inline uint32_t AbstractHistogramDiagnosticData::bucketLowerBound(unsigned index, unsigned subBucketBits) {
+    const uint32_t subBucketCount = (uint32_t)1 << subBucketBits;
+    if (index < subBucketCount) {
+        return index;
+    }
+    const unsigned range = index >> subBucketBits;
+    return (subBucketCount + (index & (subBucketCount - 1))) << (range - 1);
+}
+
+inline const uint32_t* AbstractHistogramDiagnosticData::buckets(const diag_histogram* hist) {
+    return (const uint32_t*)((const char*)hist + hist->size);
+}
+
 } // namespace particle
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARK_WIRING_LOG_RING_H
+#define SPARK_WIRING_LOG_RING_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+// Ring buffer of log records stored in a memory region that survives resets, such as retained
+// memory. The ring is crash-safe: the region starts with two copies of the ring's header, which
+// are updated alternately, and a record becomes visible only after it has been completely written
+// and the header has been committed. If a reset occurs while a record is being written, the ring
+// is restored to its last committed state.
+//
+// Oldest records are discarded when there's not enough space for a new record. Each record is
+// identified by a sequence number, which is preserved across resets.
+class LogRing {
+public:
+    // Record types. The values are the same as the frame types used by BinaryStreamLogHandler
+    enum RecordType {
+        BINARY_RECORD = 1,
+        TEXT_MESSAGE = 2,
+        DIRECT_OUTPUT = 3
+    };
+
+    // Record header
+    struct Record {
+        uint16_t size; // Size of the record data (category name including the term. null, and payload)
+        uint8_t type;
+        uint8_t level;
+        uint16_t flags;
+        uint16_t reserved;
+        uint32_t time;
+        uint32_t fmt; // Address of the format string of a binary record
+    };
+
+    LogRing();
+
+    // Attaches the ring to a memory region. If the region contains a valid ring, its records are
+    // restored, otherwise the ring is reset. Returns 0 on success, or a negative error code otherwise
+    int init(void* buf, size_t size);
+    // Returns `true` if the ring's contents were restored by init()
+    bool restored() const {
+        return restored_;
+    }
+
+    // Appends a record. The record data consists of the category name and the payload
+    int append(const Record& rec, const char* category, const char* data, size_t size);
+    // Reads the record with the specified sequence number. Returns the size of the record data,
+    // or a negative error code. Up to `size` bytes of the record data are copied to `data`
+    int read(uint32_t seq, Record* rec, char* data, size_t size) const;
+    // Discards all records
+    void clear();
+
+    // Sets an application-specific value stored in the ring's header, e.g. to identify the firmware
+    // that generated the records
+    void tag(uint32_t tag);
+    uint32_t tag() const;
+
+    // Returns the sequence number of the oldest stored record
+    uint32_t firstSeq() const;
+    // Returns the sequence number that will be assigned to the next record
+    uint32_t nextSeq() const;
+    // Returns the number of stored records
+    size_t count() const;
+    // Returns the maximum size of the record data
+    size_t maxDataSize() const;
+
+private:
+    struct Header;
+
+    Header* hdr_[2]; // Header copies
+    char* data_;
+    size_t dataSize_;
+    unsigned active_; // Index of the active header
+    mutable uint32_t readSeq_; // Sequence number of the last read record
+    mutable uint32_t readOffs_; // Offset of the last read record
+    mutable bool readValid_;
+    bool restored_;
+
+    const Header& header() const {
+        return *hdr_[active_];
+    }
+
+    void commit(const Header& h);
+    bool validate(const Header& h) const;
+    uint32_t recordOffset(const Header& h, uint32_t seq) const;
+    void evictOne(Header* h) const;
+
+    static uint32_t checksum(const Header& h);
+};
+
+} // namespace particle
+
+#endif // SPARK_WIRING_LOG_RING_H
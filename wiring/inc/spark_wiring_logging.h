@@ -20,6 +20,8 @@
 
 #include <cstring>
 #include <cstdarg>
+#include <atomic>
+#include <algorithm>
 
 #include "logging.h"
 
@@ -51,6 +53,39 @@ public:
 
     LogLevel level() const;
     LogLevel level(const char *category) const;
+    // Returns the logging level and the index of the message limits for a category, or -1 if
+    // the messages in that category are not limited
+    LogLevel level(const char *category, int *limit) const;
+
+    // Message limits and their current state
+    struct Limit {
+        uint16_t rate; // Maximum number of messages per second
+        uint16_t burst; // Maximum number of messages that can be logged at once
+        bool dedup; // Suppress repeated messages
+        uint32_t tokens; // Available tokens (in thousandths of a message)
+        system_tick_t time; // Time when the tokens were last updated
+        unsigned suppressed; // Number of messages dropped since the last logged message
+        const char *category; // Category of the last dropped message
+    };
+
+    // State of the deduplication of repeated messages
+    struct Repeat {
+        uint32_t hash; // Hash of the last deduplicated message
+        unsigned count; // Number of times the message was repeated
+        LogLevel level; // Level of the message
+    };
+
+    Limit& limit(int index);
+    size_t limitCount() const;
+    Repeat& repeat();
+    // Returns `true` if a message needs to be checked against the limits. Messages that are not
+    // limited still need to be checked if there's a pending repeated message
+    bool isLimited(int limit) const;
+
+    // Set if any of the filters has dropped messages that haven't been reported yet. The flag can
+    // be checked without locking the log manager's mutex
+    static void suppressed(bool suppressed);
+    static bool suppressed();
 
     // This class in non-copyable
     LogFilter(const LogFilter&) = delete;
@@ -59,13 +94,62 @@ public:
 private:
     struct Node;
 
+    static std::atomic<bool> s_suppressed;
+
     Vector<String> cats_; // Category filter strings
     Vector<Node> nodes_; // Lookup table
+    Vector<Limit> limits_; // Message limits
+    Repeat repeat_;
     LogLevel level_; // Default level
 
     static int nodeIndex(const Vector<Node> &nodes, const char *name, size_t size, bool &found);
 };
 
+// Buffer used by the stream-based handlers to format messages. The buffer writes its contents to
+// the destination stream in one call per message, or per batch of messages if batching is enabled
+class LogBuffer: public Print {
+public:
+    // Default buffer size. Longer messages are written to the stream in several chunks
+    static const size_t DEFAULT_SIZE = LOG_MAX_STRING_LENGTH + 64;
+
+    explicit LogBuffer(Print *stream);
+    ~LogBuffer();
+
+    void setBatching(size_t threshold, system_tick_t interval);
+    // Called when a complete message has been written to the buffer
+    void commit();
+    void flush();
+    // Flushes the buffer if the batching interval has elapsed
+    void flushExpired();
+
+    // Returns `true` if batching is enabled for any buffer
+    static bool batchingEnabled() {
+        return s_batchingCount.load(std::memory_order_relaxed) != 0;
+    }
+
+    virtual size_t write(uint8_t c) override; // Print
+    virtual size_t write(const uint8_t *data, size_t size) override; // Print
+
+    using Print::write;
+
+    // This class is non-copyable
+    LogBuffer(const LogBuffer&) = delete;
+    LogBuffer& operator=(const LogBuffer&) = delete;
+
+private:
+    Print *stream_;
+    char *buf_;
+    size_t size_; // Size of the buffered data
+    size_t capacity_;
+    size_t threshold_; // Batching threshold in bytes
+    system_tick_t interval_; // Maximum time the data can be kept in the buffer
+    system_tick_t time_; // Time when the first buffered message was committed
+    bool timeSet_; // Set if there are committed messages in the buffer
+    bool allocFailed_;
+
+    static std::atomic<unsigned> s_batchingCount; // Number of buffers with batching enabled
+};
+
 } // namespace spark::detail
 
 class LogCategoryFilter {
@@ -77,9 +161,33 @@ public:
     const char* category() const;
     LogLevel level() const;
 
+    /*!
+        \brief Limits the rate of messages in this category and its subcategories.
+        \param rate Maximum number of messages per second (0 to disable the limit).
+        \param burst Maximum number of messages that can be logged at once (defaults to `rate`).
+
+        Messages exceeding the limit are dropped; their number is reported with the next message
+        that passes the limit.
+    */
+    LogCategoryFilter& rateLimit(unsigned rate, unsigned burst = 0);
+    /*!
+        \brief Enables suppression of repeated messages in this category and its subcategories.
+
+        Identical consecutive messages are logged once; the number of repetitions is reported
+        when a different message is logged.
+    */
+    LogCategoryFilter& deduplicate(bool enabled = true);
+
+    unsigned rate() const;
+    unsigned burst() const;
+    bool isDeduplicated() const;
+
 private:
     String cat_;
     LogLevel level_;
+    uint16_t rate_;
+    uint16_t burst_;
+    bool dedup_;
 
     friend class detail::LogFilter;
 };
@@ -125,6 +233,25 @@ public:
     // These methods are called by the LogManager
     void message(const char *msg, LogLevel level, const char *category, const LogAttributes &attr);
     void write(const char *data, size_t size, LogLevel level, const char *category);
+    void binary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category);
+    // Reports the messages dropped by the rate limits once the limits allow logging again. Returns
+    // `true` if some of the dropped messages are still not reported
+    bool reportSuppressed();
+    /*!
+        \brief Writes buffered output to output stream.
+
+        This method is called by the LogManager when there are no more pending messages in
+        asynchronous mode, and from `LogManager::flush()`. Default implementation does nothing.
+    */
+    virtual void flush();
+    /*!
+        \brief Writes buffered output that has been kept longer than allowed.
+
+        This method is called by the LogManager after each iteration of the application loop, if
+        batching is enabled for any of the stream-based handlers or if the rate limits have dropped
+        messages that haven't been reported yet. Default implementation does nothing.
+    */
+    virtual void flushExpired();
 
     // This class is non-copyable
     LogHandler(const LogHandler&) = delete;
@@ -149,9 +276,30 @@ protected:
         Default implementation does nothing.
     */
     virtual void write(const char *data, size_t size);
+    /*!
+        \brief Performs processing of a binary log record.
+        \param record Record data.
+        \param size Record size.
+        \param level Logging level.
+        \param category Category name (can be null).
+
+        Default implementation formats the record and passes resulting message to `logMessage()`.
+    */
+    virtual void logBinary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category);
+    /*!
+        \brief Returns the current time in milliseconds.
+
+        The time is used to enforce the message rate limits. Default implementation returns the
+        system tick count.
+    */
+    virtual system_tick_t currentTime() const;
 
 private:
     detail::LogFilter filter_;
+
+    bool checkLimits(int limit, uint32_t seed, const char *data, size_t size, LogLevel level, const char *category);
+
+    static void updateTokens(detail::LogFilter::Limit *limit, system_tick_t now);
 };
 
 /*!
@@ -172,6 +320,26 @@ public:
         \brief Returns output stream.
     */
     Print* stream() const;
+    /*!
+        \brief Enables batching of the output.
+
+        \param threshold Number of bytes after which the buffered messages are written to output stream.
+        \param interval Maximum time in milliseconds a message can be kept in the buffer.
+
+        By default, each formatted message is written to output stream as soon as it's generated, using
+        a single call to `Print::write()`. If batching is enabled, several messages are collected in the
+        buffer before writing them, which reduces the number of transfers on slow streams. The buffer is
+        also flushed when asynchronous logging becomes idle and when `LogManager::flush()` is called.
+        The interval is checked when new messages are logged and after each iteration of the application
+        loop, so a message may be kept longer if `loop()` doesn't return.
+        Set `threshold` to 0 to disable batching.
+    */
+    void setBatching(size_t threshold, system_tick_t interval = 1000);
+    /*!
+        \brief Writes buffered messages to output stream.
+    */
+    virtual void flush() override;
+    virtual void flushExpired() override;
 
 protected:
     /*!
@@ -190,7 +358,7 @@ protected:
         \param data Buffer.
         \param size Buffer size.
 
-        This method is equivalent to `stream()->write((const uint8_t*)data, size)`.
+        This method writes buffered messages, if any, and then calls `stream()->write((const uint8_t*)data, size)`.
     */
     virtual void write(const char *data, size_t size) override;
     /*!
@@ -213,9 +381,16 @@ protected:
     */
     template<typename... ArgsT>
     void printf(const char *fmt, ArgsT... args);
+    /*!
+        \brief Returns the buffer used to format messages.
+
+        The buffered data is written to output stream when `buffer().commit()` is called.
+    */
+    detail::LogBuffer& buffer();
 
 private:
     Print *stream_;
+    detail::LogBuffer buf_;
 };
 
 class JSONStreamLogHandler: public StreamLogHandler {
@@ -227,6 +402,51 @@ protected:
     virtual void write(const char *data, size_t size) override;
 };
 
+/*!
+    \brief Binary stream log handler.
+
+    Writes binary log records generated by `LOG_BINARY()` to output stream without formatting them.
+    Text messages and direct logging output are written as binary frames too, so that the entire
+    stream can be decoded on the host using the ELF files of the firmware modules (see build/log_decode.py).
+
+    Each frame starts with the following 16-byte header (all fields are little-endian):
+
+    Offset | Size | Description
+    -------|------|------------
+    0      | 2    | Frame signature (`0xb1 0x0c`)
+    2      | 1    | Frame type: 1 - binary record, 2 - text message, 3 - direct logging output
+    3      | 1    | Logging level (0 for direct logging output)
+    4      | 2    | Payload size
+    6      | 2    | Record flags (`LogBinaryRecordFlag`)
+    8      | 4    | Timestamp
+    12     | 4    | Address of the format string (binary records only)
+
+    The payload starts with a null-terminated category name, followed by the record's argument data,
+    the message text or the output data, respectively.
+*/
+class BinaryStreamLogHandler: public StreamLogHandler {
+public:
+    /*!
+        \brief Frame types.
+    */
+    enum FrameType {
+        BINARY_RECORD = 1,
+        TEXT_MESSAGE = 2,
+        DIRECT_OUTPUT = 3
+    };
+
+    using StreamLogHandler::StreamLogHandler;
+
+protected:
+    virtual void logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) override;
+    virtual void logBinary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category) override;
+    virtual void write(const char *data, size_t size) override;
+
+private:
+    void writeFrame(FrameType type, int level, unsigned flags, uint32_t time, uintptr_t fmt, const char *category,
+            const char *data, size_t size);
+};
+
 class AttributedLogger;
 
 /*!
@@ -249,6 +469,8 @@ public:
         \param name Category name.
 
         Default-constructed logger uses category name specified at module level (typically, "app").
+        The name is not copied and is expected to have static storage duration, as the effective
+        logging levels are cached by category name pointer.
     */
     explicit Logger(const char *name = LOG_MODULE_CATEGORY);
     /*!
@@ -563,6 +785,73 @@ public:
 
 #endif // Wiring_LogConfig
 
+#if PLATFORM_THREADING
+
+    /*!
+        \brief Default size of the queue used in asynchronous mode.
+    */
+    static const size_t DEFAULT_ASYNC_QUEUE_SIZE = 16;
+
+    /*!
+        \brief Enables asynchronous logging.
+
+        In asynchronous mode, generated log messages are copied to a preallocated lock-free queue
+        and delivered to the registered handlers in batches by a low-priority background thread.
+        The logging threads don't wait for the handlers and don't block on each other. Messages
+        generated while the queue is full are dropped, and the number of dropped messages is
+        reported to the handlers as a separate warning message.
+
+        \param queueSize Maximum number of pending messages.
+        \return `false` in case of error.
+    */
+    bool enableAsyncMode(size_t queueSize = DEFAULT_ASYNC_QUEUE_SIZE);
+    /*!
+        \brief Disables asynchronous logging.
+
+        Pending messages are delivered to the handlers before this method returns. Messages
+        queued concurrently by other threads are delivered by the logging threads themselves.
+    */
+    void disableAsyncMode();
+    /*!
+        \brief Returns `true` if asynchronous logging is enabled.
+    */
+    bool isAsyncMode() const;
+    /*!
+        \brief Returns the total number of messages dropped in asynchronous mode.
+    */
+    unsigned droppedMessageCount() const;
+
+#endif // PLATFORM_THREADING
+
+    /*!
+        \brief Delivers pending messages to the handlers and flushes the handlers' buffers.
+
+        This method can be used to make sure all messages are written before a reset, for example.
+    */
+    void flush();
+    /*!
+        \brief Flushes the handlers' buffers whose batching interval has elapsed.
+
+        The messages dropped by the rate limits are reported as well, once the limits allow logging
+        again, even if no more messages are logged in their categories.
+
+        This method is called by the system after each iteration of the application loop, if
+        batchingEnabled() or messagesSuppressed() returns `true`.
+    */
+    void flushExpired();
+    /*!
+        \brief Returns `true` if batching is enabled for any of the stream-based handlers.
+
+        This method doesn't lock the log manager's mutex.
+    */
+    static bool batchingEnabled();
+    /*!
+        \brief Returns `true` if the rate limits have dropped messages that haven't been reported yet.
+
+        This method doesn't lock the log manager's mutex.
+    */
+    static bool messagesSuppressed();
+
     /*!
         \brief Returns log manager's instance.
     */
@@ -575,7 +864,21 @@ public:
 private:
     struct FactoryHandler;
 
+    // Entry of the cache of effective logging levels. Entries are updated using the seqlock pattern,
+    // so that logEnabled() doesn't need to lock the mutex when the level is cached. Categories are
+    // identified by pointer, which assumes category names have static storage duration
+    struct LevelCacheEntry {
+        std::atomic<uint32_t> seq; // Odd while the entry is being updated
+        std::atomic<const char*> category;
+        std::atomic<int> level;
+        std::atomic<uint32_t> generation;
+    };
+
+    static const size_t LEVEL_CACHE_SIZE = 16;
+
     Vector<LogHandler*> activeHandlers_;
+    LevelCacheEntry levelCache_[LEVEL_CACHE_SIZE]; // Cached levels by category name pointer
+    std::atomic<uint32_t> generation_; // Incremented every time the set of active handlers changes
 
 #if Wiring_LogConfig
     Vector<FactoryHandler> factoryHandlers_;
@@ -584,7 +887,10 @@ private:
 #endif
 
 #if PLATFORM_THREADING
+    struct AsyncState;
+
     Mutex mutex_; // TODO: Use read-write lock?
+    AsyncState* volatile async_;
 #endif
 
     // This class can be instantiated only via instance() method
@@ -598,10 +904,35 @@ private:
     static void setSystemCallbacks();
     static void resetSystemCallbacks();
 
+    int cachedLevel(const char *category) const;
+    void cacheLevel(const char *category, int level);
+
+    void invalidateLevelCache() {
+        generation_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void flushHandlers();
+
+    static size_t levelCacheIndex(const char *category) {
+        const uintptr_t p = (uintptr_t)category;
+        return (p ^ (p >> 5)) % LEVEL_CACHE_SIZE;
+    }
+
+#if PLATFORM_THREADING
+    bool pushMessage(const char *msg, int level, const char *category, const LogAttributes *attr);
+    bool pushWrite(const char *data, size_t size, int level, const char *category);
+    bool pushBinary(const LogBinaryRecord *record, size_t size, int level, const char *category);
+    void processQueue();
+    void stopAsyncThread();
+
+    static os_thread_return_t asyncThread(void *data);
+#endif
+
     // System callbacks
     static void logMessage(const char *msg, int level, const char *category, const LogAttributes *attr, void *reserved);
     static void logWrite(const char *data, size_t size, int level, const char *category, void *reserved);
     static int logEnabled(int level, const char *category, void *reserved);
+    static void logBinary(const LogBinaryRecord *record, size_t size, int level, const char *category, void *reserved);
 };
 
 #if Wiring_LogConfig
@@ -627,20 +958,80 @@ inline LogLevel spark::detail::LogFilter::level() const {
     return level_;
 }
 
+inline LogLevel spark::detail::LogFilter::level(const char *category) const {
+    return level(category, nullptr);
+}
+
+inline spark::detail::LogFilter::Limit& spark::detail::LogFilter::limit(int index) {
+    return limits_.at(index);
+}
+
+inline size_t spark::detail::LogFilter::limitCount() const {
+    return limits_.size();
+}
+
+inline void spark::detail::LogFilter::suppressed(bool suppressed) {
+    s_suppressed.store(suppressed, std::memory_order_relaxed);
+}
+
+inline bool spark::detail::LogFilter::suppressed() {
+    return s_suppressed.load(std::memory_order_relaxed);
+}
+
+inline spark::detail::LogFilter::Repeat& spark::detail::LogFilter::repeat() {
+    return repeat_;
+}
+
+inline bool spark::detail::LogFilter::isLimited(int limit) const {
+    return limit >= 0 || repeat_.hash != 0;
+}
+
 // spark::LogCategoryFilter
 inline spark::LogCategoryFilter::LogCategoryFilter(String category, LogLevel level) :
         cat_(category),
-        level_(level) {
+        level_(level),
+        rate_(0),
+        burst_(0),
+        dedup_(false) {
 }
 
 inline spark::LogCategoryFilter::LogCategoryFilter(const char *category, LogLevel level) :
         cat_(category),
-        level_(level) {
+        level_(level),
+        rate_(0),
+        burst_(0),
+        dedup_(false) {
 }
 
 inline spark::LogCategoryFilter::LogCategoryFilter(const char *category, size_t length, LogLevel level) :
         cat_(category, length),
-        level_(level) {
+        level_(level),
+        rate_(0),
+        burst_(0),
+        dedup_(false) {
+}
+
+inline spark::LogCategoryFilter& spark::LogCategoryFilter::rateLimit(unsigned rate, unsigned burst) {
+    rate_ = std::min(rate, 0xffffu);
+    burst_ = std::min(burst ? burst : rate, 0xffffu);
+    return *this;
+}
+
+inline spark::LogCategoryFilter& spark::LogCategoryFilter::deduplicate(bool enabled) {
+    dedup_ = enabled;
+    return *this;
+}
+
+inline unsigned spark::LogCategoryFilter::rate() const {
+    return rate_;
+}
+
+inline unsigned spark::LogCategoryFilter::burst() const {
+    return burst_;
+}
+
+inline bool spark::LogCategoryFilter::isDeduplicated() const {
+    return dedup_;
 }
 
 inline const char* spark::LogCategoryFilter::category() const {
@@ -673,7 +1064,9 @@ inline const char* spark::LogHandler::levelName(LogLevel level) {
 }
 
 inline void spark::LogHandler::message(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) {
-    if (level >= filter_.level(category)) {
+    int limit = -1;
+    if (level >= filter_.level(category, &limit) &&
+            (!filter_.isLimited(limit) || checkLimits(limit, 0, msg, msg ? strlen(msg) : 0, level, category))) {
         logMessage(msg, level, category, attr);
     }
 }
@@ -684,6 +1077,15 @@ inline void spark::LogHandler::write(const char *data, size_t size, LogLevel lev
     }
 }
 
+inline void spark::LogHandler::binary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category) {
+    int limit = -1;
+    if (level >= filter_.level(category, &limit) &&
+            (!filter_.isLimited(limit) || checkLimits(limit, (uintptr_t)record.fmt, record.args,
+                    std::min<size_t>(record.size, size - std::min(size, sizeof(LogBinaryRecord))), level, category))) {
+        logBinary(record, size, level, category);
+    }
+}
+
 inline void spark::LogHandler::write(const char *data, size_t size) {
     // Default implementation does nothing
 }
@@ -691,14 +1093,40 @@ inline void spark::LogHandler::write(const char *data, size_t size) {
 // spark::StreamLogHandler
 inline spark::StreamLogHandler::StreamLogHandler(Print &stream, LogLevel level, LogCategoryFilters filters) :
         LogHandler(level, filters),
-        stream_(&stream) {
+        stream_(&stream),
+        buf_(&stream) {
 }
 
 inline Print* spark::StreamLogHandler::stream() const {
     return stream_;
 }
 
+inline bool spark::LogManager::batchingEnabled() {
+    return detail::LogBuffer::batchingEnabled();
+}
+
+inline bool spark::LogManager::messagesSuppressed() {
+    return detail::LogFilter::suppressed();
+}
+
+inline void spark::StreamLogHandler::setBatching(size_t threshold, system_tick_t interval) {
+    buf_.setBatching(threshold, interval);
+}
+
+inline void spark::StreamLogHandler::flush() {
+    buf_.flush();
+}
+
+inline void spark::StreamLogHandler::flushExpired() {
+    buf_.flushExpired();
+}
+
+inline spark::detail::LogBuffer& spark::StreamLogHandler::buffer() {
+    return buf_;
+}
+
 inline void spark::StreamLogHandler::write(const char *data, size_t size) {
+    buf_.flush(); // Preserve the order of the output
     stream_->write((const uint8_t*)data, size);
 }
 
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARK_WIRING_RETAINED_LOG_HANDLER_H
+#define SPARK_WIRING_RETAINED_LOG_HANDLER_H
+
+#include "spark_wiring_logging.h"
+#include "spark_wiring_log_ring.h"
+#include "spark_wiring_cloud.h"
+#include "spark_wiring_thread.h"
+
+#include "system_control.h"
+
+namespace spark {
+
+/*!
+    \brief Log handler storing recent messages in retained memory.
+
+    The handler stores messages in a ring buffer that survives resets, so that the messages logged
+    before a panic or a watchdog reset can be retrieved after the device restarts. Binary log records
+    are stored without formatting. The buffer needs to be allocated by the application:
+
+    ```
+    retained char logBuf[2048];
+    RetainedLogHandler logHandler(logBuf, sizeof(logBuf), LOG_LEVEL_WARN);
+
+    void loop() {
+        if (Particle.connected() && logHandler.hasPreviousRecords()) {
+            logHandler.publishPrevious("crash_log"); // Publish the messages logged before the reset
+        }
+    }
+    ```
+
+    Stored messages can also be read over USB using the `CTRL_REQUEST_GET_RETAINED_LOG` control
+    request. The request data contains an optional sequence number of the first record to read
+    (uint32, little endian). The reply data contains the sequence number of the record following
+    the last returned record, the sequence number following the newest stored record, the sequence
+    number of the first record logged after the device restarted (uint32, little endian), and
+    the records in the format used by `BinaryStreamLogHandler`.
+
+    Only one instance of this handler can be registered for the control request at a time.
+*/
+class RetainedLogHandler: public LogHandler {
+public:
+    /*!
+        \brief Constructs a handler.
+
+        \param buf Memory region for the stored messages, typically a retained variable.
+        \param size Size of the memory region.
+        \param level Default logging level.
+        \param filters Category filters.
+    */
+    RetainedLogHandler(void *buf, size_t size, LogLevel level = LOG_LEVEL_INFO, LogCategoryFilters filters = {});
+    virtual ~RetainedLogHandler();
+    /*!
+        \brief Returns `true` if there are unpublished messages logged before the device restarted.
+    */
+    bool hasPreviousRecords() const;
+    /*!
+        \brief Publishes messages logged before the device restarted.
+
+        Messages are formatted as text and published in chunks not exceeding the maximum size of
+        the event data. This method publishes one event per call.
+
+        \return Number of messages that remain to be published, or a negative error code.
+    */
+    int publishPrevious(const char *eventName = "log", PublishFlags flags = PRIVATE);
+    /*!
+        \brief Discards all stored messages.
+    */
+    void clear();
+    /*!
+        \brief Returns the ring buffer storing the messages.
+    */
+    const particle::LogRing& ring() const;
+
+    static void processControlRequest(ctrl_request* req);
+
+protected:
+    virtual void logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) override;
+    virtual void logBinary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category) override;
+    virtual void write(const char *data, size_t size) override;
+
+private:
+    particle::LogRing ring_;
+    uint32_t bootSeq_; // Sequence number of the first record logged after the device restarted
+    uint32_t publishSeq_; // Sequence number of the next record to publish
+    bool sameFirmware_; // Set to `true` if the stored records were generated by the running firmware
+#if PLATFORM_THREADING
+    Mutex mutex_;
+#endif
+
+    static RetainedLogHandler* s_instance;
+
+    void append(particle::LogRing::RecordType type, int level, uint16_t flags, uint32_t time, uintptr_t fmt,
+            const char *category, const char *data, size_t size);
+    size_t formatRecord(uint32_t seq, char *buf, size_t size);
+};
+
+inline const particle::LogRing& RetainedLogHandler::ring() const {
+    return ring_;
+}
+
+} // namespace spark
+
+#endif // SPARK_WIRING_RETAINED_LOG_HANDLER_H
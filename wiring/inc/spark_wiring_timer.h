@@ -19,7 +19,7 @@
 
 #pragma once
 
-#if PLATFORM_ID!=3
+#if PLATFORM_ID!=3 || PLATFORM_THREADING
 #include "stddef.h"
 #include "concurrent_hal.h"
 #include <functional>
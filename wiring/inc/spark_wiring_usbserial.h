@@ -32,6 +32,9 @@
 #include "usb_hal.h"
 #include "system_task.h"
 #include "spark_wiring_startup.h"
+#if PLATFORM_THREADING
+#include "concurrent_hal.h"
+#endif
 
 class USBSerial : public Stream
 {
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARK_WIRING_WORKER_POOL_H
+#define SPARK_WIRING_WORKER_POOL_H
+
+#if PLATFORM_THREADING
+
+#include "spark_wiring_async.h"
+#include "spark_wiring_thread.h"
+
+#include "concurrent_hal.h"
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+namespace particle {
+
+namespace detail {
+
+// Base class for a task submitted to a worker pool
+class WorkerTask {
+public:
+    virtual ~WorkerTask() = default;
+
+    virtual void run() = 0;
+
+private:
+    WorkerTask* prev_ = nullptr;
+    WorkerTask* next_ = nullptr;
+
+    friend class WorkerQueue;
+};
+
+// Double-ended queue of tasks. The owning worker takes tasks from the back of the queue, while
+// other workers steal tasks from the front
+class WorkerQueue {
+public:
+    WorkerQueue() :
+            first_(nullptr),
+            last_(nullptr) {
+    }
+
+    void pushBack(WorkerTask* task);
+    WorkerTask* popBack();
+    WorkerTask* popFront();
+
+private:
+    WorkerTask* first_;
+    WorkerTask* last_;
+    Mutex mutex_;
+};
+
+template<typename ResultT, typename FunctionT>
+inline void invokeWorkerTask(Promise<ResultT>& promise, FunctionT& func) {
+    promise.setResult(func());
+}
+
+template<typename FunctionT>
+inline void invokeWorkerTask(Promise<void>& promise, FunctionT& func) {
+    func();
+    promise.setResult();
+}
+
+template<typename ResultT, typename FunctionT>
+class WorkerTaskImpl: public WorkerTask {
+public:
+    WorkerTaskImpl(FunctionT func, Promise<ResultT> promise) :
+            func_(std::move(func)),
+            promise_(std::move(promise)) {
+    }
+
+    void run() override {
+        // Skip the task if its future has been cancelled
+        if (!promise_.isDone()) {
+            invokeWorkerTask(promise_, func_);
+        }
+    }
+
+private:
+    FunctionT func_;
+    Promise<ResultT> promise_;
+};
+
+} // namespace particle::detail
+
+/**
+ * A fixed pool of worker threads executing application tasks.
+ *
+ * Each worker has its own task queue. Tasks submitted from a worker thread are put into that
+ * worker's queue, other tasks are distributed between the workers in a round-robin fashion. A
+ * worker that runs out of tasks steals tasks from the queues of other workers.
+ */
+class WorkerPool {
+public:
+    static const unsigned DEFAULT_WORKER_COUNT = 2;
+
+    explicit WorkerPool(unsigned workerCount = DEFAULT_WORKER_COUNT, size_t stackSize = OS_THREAD_STACK_SIZE_DEFAULT,
+            os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT);
+    ~WorkerPool();
+
+    /**
+     * Submits a task for execution.
+     *
+     * Returns a future that is completed with the task's result. A task whose future has been
+     * cancelled before the task started running is not executed.
+     */
+    template<typename FunctionT, typename ResultT = typename std::result_of<FunctionT()>::type>
+    Future<ResultT> submit(FunctionT func) {
+        Promise<ResultT> p;
+        const auto task = new(std::nothrow) detail::WorkerTaskImpl<ResultT, FunctionT>(std::move(func), p);
+        if (!task) {
+            return Future<ResultT>(Error::NO_MEMORY);
+        }
+        if (!enqueue(task)) {
+            delete task;
+            return Future<ResultT>(Error::INVALID_STATE);
+        }
+        return p.future();
+    }
+
+    /**
+     * Executes all pending tasks and stops the worker threads.
+     *
+     * This method should not be called from a task running in the pool.
+     */
+    void stop();
+
+    /**
+     * Returns the number of running worker threads.
+     */
+    unsigned size() const {
+        return count_;
+    }
+
+    // This class is non-copyable
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+private:
+    struct Worker {
+        detail::WorkerQueue queue;
+        os_thread_t thread;
+        WorkerPool* pool;
+        unsigned index;
+    };
+
+    Worker* workers_;
+    unsigned count_;
+    os_semaphore_t sem_;
+    std::atomic<unsigned> next_;
+    std::atomic<bool> stop_;
+
+    bool enqueue(detail::WorkerTask* task);
+    detail::WorkerTask* take(unsigned index);
+    int currentWorker() const;
+
+    static os_thread_return_t run(void* data);
+};
+
+} // namespace particle
+
+#endif // PLATFORM_THREADING
+
+#endif // SPARK_WIRING_WORKER_POOL_H
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_log_ring.h"
+
+#include "system_error.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+const uint32_t RING_MAGIC = 0x4c4f4752; // "LOGR"
+
+inline size_t alignSize(size_t size) {
+    return (size + 3) & ~(size_t)3;
+}
+
+} // namespace
+
+// Header of the ring. Records are stored in the [head, tail) range of the data area; if the range
+// is wrapped, the records are stored in the [head, end) and [0, tail) ranges
+struct particle::LogRing::Header {
+    uint32_t magic;
+    uint32_t counter; // Incremented every time the header is committed
+    uint32_t tag;
+    uint32_t size; // Size of the data area
+    uint32_t head; // Offset of the oldest record
+    uint32_t tail; // Offset following the newest record
+    uint32_t end; // End of the upper part of the wrapped range
+    uint32_t count; // Number of records
+    uint32_t firstSeq; // Sequence number of the oldest record
+    uint32_t checksum;
+
+    bool wrapped() const {
+        return count > 0 && head >= tail;
+    }
+};
+
+particle::LogRing::LogRing() :
+        hdr_{ nullptr, nullptr },
+        data_(nullptr),
+        dataSize_(0),
+        active_(0),
+        readSeq_(0),
+        readOffs_(0),
+        readValid_(false),
+        restored_(false) {
+}
+
+int particle::LogRing::init(void* buf, size_t size) {
+    // Align the memory region
+    const uintptr_t addr = (uintptr_t)buf;
+    const size_t offs = alignSize(addr) - addr;
+    if (size < offs + sizeof(Header) * 2 + sizeof(Record) + 4) {
+        return SYSTEM_ERROR_TOO_LARGE; // The region is too small
+    }
+    char* const p = (char*)buf + offs;
+    size = (size - offs) & ~(size_t)3;
+    hdr_[0] = (Header*)p;
+    hdr_[1] = (Header*)(p + sizeof(Header));
+    data_ = p + sizeof(Header) * 2;
+    dataSize_ = size - sizeof(Header) * 2;
+    readValid_ = false;
+    restored_ = false;
+    // Find the most recently committed valid header
+    Header h[2];
+    memcpy(&h[0], hdr_[0], sizeof(Header));
+    memcpy(&h[1], hdr_[1], sizeof(Header));
+    const bool valid[2] = { validate(h[0]), validate(h[1]) };
+    int index = -1;
+    if (valid[0] && valid[1]) {
+        index = ((int32_t)(h[1].counter - h[0].counter) > 0) ? 1 : 0;
+    } else if (valid[0] || valid[1]) {
+        index = valid[0] ? 0 : 1;
+    }
+    if (index >= 0) {
+        active_ = index;
+        restored_ = true;
+        return 0;
+    }
+    // Reset the ring
+    Header r = {};
+    r.magic = RING_MAGIC;
+    r.size = dataSize_;
+    memset(hdr_[0], 0, sizeof(Header));
+    memset(hdr_[1], 0, sizeof(Header));
+    active_ = 0;
+    commit(r);
+    return 0;
+}
+
+int particle::LogRing::append(const Record& rec, const char* category, const char* data, size_t size) {
+    if (!data_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    if (!category) {
+        category = "";
+    }
+    const size_t catSize = strlen(category) + 1;
+    const size_t recSize = catSize + size;
+    const size_t total = alignSize(sizeof(Record) + recSize);
+    if (recSize > 0xffff || total > dataSize_) {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    // Discard oldest records until there's enough space for the new record
+    Header h = header();
+    size_t pos = 0;
+    bool wrap = false;
+    for (;;) {
+        if (h.count == 0) {
+            h.head = 0;
+            h.tail = 0;
+            h.end = 0;
+            break;
+        }
+        if (!h.wrapped()) {
+            if (dataSize_ - h.tail >= total) {
+                pos = h.tail;
+                break;
+            }
+            if (h.head >= total) {
+                wrap = true; // Continue at the beginning of the data area
+                break;
+            }
+        } else if (h.head - h.tail >= total) {
+            pos = h.tail;
+            break;
+        }
+        evictOne(&h);
+    }
+    if (memcmp(&h, &header(), sizeof(Header)) != 0) {
+        // Make sure the discarded records are not referenced by the header before overwriting them
+        commit(h);
+    }
+    Record r = rec;
+    r.size = recSize;
+    r.reserved = 0;
+    char* const d = data_ + pos;
+    memcpy(d, &r, sizeof(Record));
+    memcpy(d + sizeof(Record), category, catSize);
+    memcpy(d + sizeof(Record) + catSize, data, size);
+    if (wrap) {
+        h.end = h.tail;
+    }
+    h.tail = pos + total;
+    ++h.count;
+    commit(h);
+    return 0;
+}
+
+int particle::LogRing::read(uint32_t seq, Record* rec, char* data, size_t size) const {
+    if (!data_) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    const Header& h = header();
+    if (seq - h.firstSeq >= h.count) {
+        return SYSTEM_ERROR_NOT_FOUND;
+    }
+    const char* const d = data_ + recordOffset(h, seq);
+    Record r;
+    memcpy(&r, d, sizeof(Record));
+    if (rec) {
+        *rec = r;
+    }
+    if (data && size > 0) {
+        memcpy(data, d + sizeof(Record), std::min<size_t>(size, r.size));
+    }
+    return r.size;
+}
+
+void particle::LogRing::clear() {
+    if (!data_) {
+        return;
+    }
+    Header h = header();
+    h.firstSeq += h.count;
+    h.count = 0;
+    h.head = 0;
+    h.tail = 0;
+    h.end = 0;
+    commit(h);
+}
+
+void particle::LogRing::tag(uint32_t tag) {
+    if (!data_ || header().tag == tag) {
+        return;
+    }
+    Header h = header();
+    h.tag = tag;
+    commit(h);
+}
+
+uint32_t particle::LogRing::tag() const {
+    return data_ ? header().tag : 0;
+}
+
+uint32_t particle::LogRing::firstSeq() const {
+    return data_ ? header().firstSeq : 0;
+}
+
+uint32_t particle::LogRing::nextSeq() const {
+    return data_ ? header().firstSeq + header().count : 0;
+}
+
+size_t particle::LogRing::count() const {
+    return data_ ? header().count : 0;
+}
+
+size_t particle::LogRing::maxDataSize() const {
+    return (dataSize_ > sizeof(Record)) ? std::min<size_t>(dataSize_ - sizeof(Record), 0xffff) : 0;
+}
+
+void particle::LogRing::commit(const Header& h) {
+    Header c = h;
+    c.counter = header().counter + 1;
+    c.checksum = checksum(c);
+    // Make sure the record data is written before the header
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    const unsigned index = active_ ^ 1;
+    memcpy(hdr_[index], &c, sizeof(Header));
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    active_ = index;
+}
+
+bool particle::LogRing::validate(const Header& h) const {
+    if (h.magic != RING_MAGIC || h.checksum != checksum(h) || h.size != dataSize_) {
+        return false;
+    }
+    if (h.head >= dataSize_ || h.tail > dataSize_ || h.end > dataSize_ || h.count > dataSize_ / sizeof(Record)) {
+        return false;
+    }
+    // Walk the records
+    uint32_t offs = h.head;
+    bool upper = h.wrapped();
+    for (uint32_t i = 0; i < h.count; ++i) {
+        const uint32_t end = upper ? h.end : h.tail;
+        if (offs + sizeof(Record) > end) {
+            return false;
+        }
+        Record r;
+        memcpy(&r, data_ + offs, sizeof(Record));
+        offs += alignSize(sizeof(Record) + r.size);
+        if (offs > end) {
+            return false;
+        }
+        if (upper && offs == h.end) {
+            offs = 0;
+            upper = false;
+        }
+    }
+    return !upper && offs == h.tail;
+}
+
+uint32_t particle::LogRing::recordOffset(const Header& h, uint32_t seq) const {
+    uint32_t offs = h.head;
+    uint32_t n = seq - h.firstSeq;
+    // Records are usually read in order, so the walk continues from the last read record if it
+    // hasn't been discarded yet. Stored records never move, so its offset is still valid
+    if (readValid_ && readSeq_ - h.firstSeq <= n) {
+        offs = readOffs_;
+        n = seq - readSeq_;
+    }
+    bool upper = h.wrapped() && offs >= h.head;
+    for (; n > 0; --n) {
+        Record r;
+        memcpy(&r, data_ + offs, sizeof(Record));
+        offs += alignSize(sizeof(Record) + r.size);
+        if (upper && offs >= h.end) {
+            offs = 0;
+            upper = false;
+        }
+    }
+    readSeq_ = seq;
+    readOffs_ = offs;
+    readValid_ = true;
+    return offs;
+}
+
+void particle::LogRing::evictOne(Header* h) const {
+    const bool upper = h->wrapped();
+    Record r;
+    memcpy(&r, data_ + h->head, sizeof(Record));
+    h->head += alignSize(sizeof(Record) + r.size);
+    ++h->firstSeq;
+    if (--h->count == 0) {
+        h->head = 0;
+        h->tail = 0;
+        h->end = 0;
+    } else if (upper && h->head >= h->end) {
+        h->head = 0;
+    }
+}
+
+uint32_t particle::LogRing::checksum(const Header& h) {
+    // FNV-1a hash of all fields except the checksum itself
+    const uint8_t* p = (const uint8_t*)&h;
+    const size_t n = offsetof(Header, checksum);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
@@ -30,6 +30,13 @@
 #include "spark_wiring_usartserial.h"
 
 #include "spark_wiring_interrupts.h"
+#include "spark_wiring_diagnostics.h"
+
+#include "timer_hal.h"
+
+#if PLATFORM_THREADING
+#include "mpsc_queue.h"
+#endif
 
 // Uncomment to enable logging in interrupt handlers
 // #define LOG_FROM_ISR
@@ -71,6 +78,12 @@ using namespace spark;
       "filt": [ // Category filters
         {
           "app": "all" // Category name and logging level
+        },
+        {
+          "comm.dtls": "info",
+          "rate": 5, // Maximum number of messages per second (optional)
+          "burst": 10, // Maximum number of messages that can be logged at once (optional)
+          "dedup": true // Suppress repeated messages (optional)
         }
       ],
       "lvl": "warn" // Default logging level
@@ -188,6 +201,9 @@ private:
         while (it.next()) {
             JSONString cat;
             LogLevel level = LOG_LEVEL_INFO; // Default level
+            int rate = 0;
+            int burst = 0;
+            bool dedup = false;
             JSONObjectIterator it2(it.value());
             if (it2.next()) {
                 cat = it2.name();
@@ -197,8 +213,23 @@ private:
                 if (!parseLevel(it2.value(), &level)) {
                     return false;
                 }
+                // Optional message limits
+                while (it2.next()) {
+                    if (it2.name() == "rate") {
+                        rate = it2.value().toInt();
+                    } else if (it2.name() == "burst") {
+                        burst = it2.value().toInt();
+                    } else if (it2.name() == "dedup") {
+                        dedup = it2.value().toBool();
+                    }
+                    if (rate < 0 || burst < 0) {
+                        return false;
+                    }
+                }
             }
-            filters->append(LogCategoryFilter((String)cat, level));
+            LogCategoryFilter filter((String)cat, level);
+            filter.rateLimit(rate, burst).deduplicate(dedup);
+            filters->append(std::move(filter));
         }
         return true;
     }
@@ -345,6 +376,76 @@ const char* extractFuncName(const char *s, size_t *size) {
     return s1;
 }
 
+// Number of messages dropped by the rate limits and the deduplication of repeated messages
+particle::AtomicIntegerDiagnosticData g_suppressedMessages(DIAG_ID_LOG_SUPPRESSED_MESSAGES, DIAG_NAME_LOG_SUPPRESSED_MESSAGES);
+
+// Computes a hash of a message for the deduplication of repeated messages (FNV-1a)
+uint32_t messageHash(uint32_t seed, const char *data, size_t size, LogLevel level, const char *category) {
+    uint32_t h = 2166136261u;
+    const auto update = [&h](const void *data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            h = (h ^ ((const uint8_t*)data)[i]) * 16777619u;
+        }
+    };
+    update(&seed, sizeof(seed));
+    update(&level, sizeof(level));
+    if (category) {
+        update(category, strlen(category));
+    }
+    update(data, size);
+    return h ? h : 1; // 0 is reserved
+}
+
+#if PLATFORM_THREADING
+
+// Size of the buffer for the message data, category name and additional information of a queued record
+const size_t ASYNC_RECORD_BUFFER_SIZE = LOG_MAX_STRING_LENGTH + 64;
+// Maximum number of records delivered to the handlers while the log manager's mutex is locked
+const size_t ASYNC_BATCH_SIZE = 4;
+// Priority of the thread delivering queued records to the handlers
+const os_thread_prio_t ASYNC_THREAD_PRIORITY = OS_THREAD_PRIORITY_DEFAULT - 1;
+// Records queued in interrupt handlers don't wake the thread up, so it checks the queue periodically
+const system_tick_t ASYNC_POLL_INTERVAL = 100;
+
+// Log message or a chunk of the direct logging output queued in asynchronous mode
+struct LogRecord {
+    enum Type {
+        MESSAGE,
+        WRITE,
+        BINARY
+    };
+
+    LogAttributes attr;
+    uint16_t size; // Size of the message data
+    int16_t categoryOffs; // Offsets in the buffer, or -1 if not set
+    int16_t detailsOffs;
+    uint8_t type;
+    uint8_t level;
+    alignas(LogBinaryRecord) char buf[ASYNC_RECORD_BUFFER_SIZE];
+
+    int16_t append(const char *data, size_t size, size_t *offs) {
+        if (*offs >= sizeof(buf)) {
+            return -1;
+        }
+        size = std::min(size, sizeof(buf) - *offs - 1);
+        memcpy(buf + *offs, data, size);
+        buf[*offs + size] = '\0';
+        const int16_t pos = *offs;
+        *offs += size + 1;
+        return pos;
+    }
+
+    int16_t appendString(const char *str, size_t *offs) {
+        return str ? append(str, strlen(str), offs) : -1;
+    }
+
+    const char* string(int16_t offs) const {
+        return (offs >= 0) ? buf + offs : nullptr;
+    }
+};
+
+#endif // PLATFORM_THREADING
+
 } // namespace
 
 // Default logger instance. This code is compiled as part of the wiring library which has its own
@@ -373,24 +474,30 @@ const spark::Logger spark::Log("app");
 */
 
 // spark::detail::LogFilter
+std::atomic<bool> spark::detail::LogFilter::s_suppressed(false);
+
 struct spark::detail::LogFilter::Node {
     const char *name; // Subcategory name
     uint16_t size; // Name length
     int16_t level; // Logging level (-1 if not specified for this node)
+    int16_t limit; // Index of the message limits (-1 if not specified for this node)
     Vector<Node> nodes; // Children nodes
 
     Node(const char *name, uint16_t size) :
             name(name),
             size(size),
-            level(-1) {
+            level(-1),
+            limit(-1) {
     }
 };
 
 spark::detail::LogFilter::LogFilter(LogLevel level) :
+        repeat_(),
         level_(level) {
 }
 
 spark::detail::LogFilter::LogFilter(LogLevel level, LogCategoryFilters filters) :
+        repeat_(),
         level_(LOG_LEVEL_NONE) { // Fallback level that will be used in case of construction errors
     // Store category names
     Vector<String> cats;
@@ -402,6 +509,7 @@ spark::detail::LogFilter::LogFilter(LogLevel level, LogCategoryFilters filters)
     }
     // Process category filters
     Vector<Node> nodes;
+    Vector<Limit> limits;
     for (int i = 0; i < cats.size(); ++i) {
         const char *category = cats.at(i).c_str();
         if (!category) {
@@ -418,7 +526,19 @@ spark::detail::LogFilter::LogFilter(LogLevel level, LogCategoryFilters filters)
             }
             Node &node = pNodes->at(index);
             if (!*category) { // Check if it's last subcategory
-                node.level = filters.at(i).level_;
+                const LogCategoryFilter &filter = filters.at(i);
+                node.level = filter.level_;
+                if (filter.rate_ > 0 || filter.dedup_) {
+                    Limit limit = {};
+                    limit.rate = filter.rate_;
+                    limit.burst = filter.burst_;
+                    limit.dedup = filter.dedup_;
+                    limit.tokens = (uint32_t)filter.burst_ * 1000; // The time is set when the bucket is first used
+                    if (!limits.append(limit)) {
+                        return;
+                    }
+                    node.limit = limits.size() - 1;
+                }
             }
             pNodes = &node.nodes;
         }
@@ -426,13 +546,14 @@ spark::detail::LogFilter::LogFilter(LogLevel level, LogCategoryFilters filters)
     using std::swap;
     swap(cats_, cats);
     swap(nodes_, nodes);
+    swap(limits_, limits);
     level_ = level;
 }
 
 spark::detail::LogFilter::~LogFilter() {
 }
 
-LogLevel spark::detail::LogFilter::level(const char *category) const {
+LogLevel spark::detail::LogFilter::level(const char *category, int *limit) const {
     LogLevel level = level_; // Default level
     if (!nodes_.isEmpty() && category) {
         const Vector<Node> *pNodes = &nodes_; // Root nodes
@@ -448,6 +569,9 @@ LogLevel spark::detail::LogFilter::level(const char *category) const {
             if (node.level >= 0) {
                 level = (LogLevel)node.level;
             }
+            if (node.limit >= 0 && limit) {
+                *limit = node.limit;
+            }
             pNodes = &node.nodes;
         }
     }
@@ -470,72 +594,278 @@ int spark::detail::LogFilter::nodeIndex(const Vector<Node> &nodes, const char *n
             }));
 }
 
+// spark::detail::LogBuffer
+std::atomic<unsigned> spark::detail::LogBuffer::s_batchingCount(0);
+
+spark::detail::LogBuffer::LogBuffer(Print *stream) :
+        stream_(stream),
+        buf_(nullptr),
+        size_(0),
+        capacity_(0),
+        threshold_(0),
+        interval_(0),
+        time_(0),
+        timeSet_(false),
+        allocFailed_(false) {
+}
+
+spark::detail::LogBuffer::~LogBuffer() {
+    flush();
+    delete[] buf_;
+    if (threshold_ > 0) {
+        s_batchingCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void spark::detail::LogBuffer::setBatching(size_t threshold, system_tick_t interval) {
+    flush();
+    if (threshold > 0 && threshold_ == 0) {
+        s_batchingCount.fetch_add(1, std::memory_order_relaxed);
+    } else if (threshold == 0 && threshold_ > 0) {
+        s_batchingCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (threshold > capacity_) {
+        // Reallocate the buffer on next write
+        delete[] buf_;
+        buf_ = nullptr;
+        capacity_ = 0;
+        allocFailed_ = false;
+    }
+    threshold_ = threshold;
+    interval_ = interval;
+}
+
+void spark::detail::LogBuffer::commit() {
+    if (size_ == 0) {
+        return;
+    }
+    if (threshold_ == 0 || size_ >= threshold_) {
+        flush();
+        return;
+    }
+    const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+    if (!timeSet_) {
+        time_ = now;
+        timeSet_ = true;
+    } else if (now - time_ >= interval_) {
+        flush();
+    }
+}
+
+void spark::detail::LogBuffer::flush() {
+    if (size_ > 0) {
+        stream_->write((const uint8_t*)buf_, size_);
+        size_ = 0;
+    }
+    timeSet_ = false;
+}
+
+void spark::detail::LogBuffer::flushExpired() {
+    if (timeSet_ && HAL_Timer_Get_Milli_Seconds() - time_ >= interval_) {
+        flush();
+    }
+}
+
+size_t spark::detail::LogBuffer::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t spark::detail::LogBuffer::write(const uint8_t *data, size_t size) {
+    if (!buf_ && !allocFailed_) {
+        size_t capacity = threshold_ + DEFAULT_SIZE / 2;
+        if (capacity < DEFAULT_SIZE) {
+            capacity = DEFAULT_SIZE;
+        }
+        buf_ = new(std::nothrow) char[capacity];
+        if (buf_) {
+            capacity_ = capacity;
+        } else {
+            allocFailed_ = true; // Don't retry on every write
+        }
+    }
+    if (size > capacity_ - size_) {
+        flush();
+        if (size > capacity_) {
+            // The data doesn't fit into the buffer, write it directly
+            return stream_->write(data, size);
+        }
+    }
+    memcpy(buf_ + size_, data, size);
+    size_ += size;
+    return size;
+}
+
+// spark::LogHandler
+void spark::LogHandler::flush() {
+}
+
+void spark::LogHandler::flushExpired() {
+}
+
+system_tick_t spark::LogHandler::currentTime() const {
+    return HAL_Timer_Get_Milli_Seconds();
+}
+
+bool spark::LogHandler::reportSuppressed() {
+    bool pending = false;
+    const system_tick_t now = currentTime();
+    for (size_t i = 0; i < filter_.limitCount(); ++i) {
+        detail::LogFilter::Limit &limit = filter_.limit(i);
+        if (limit.suppressed == 0) {
+            continue;
+        }
+        updateTokens(&limit, now);
+        if (limit.tokens < 1000) {
+            pending = true; // The category is still limited
+            continue;
+        }
+        LogAttributes attr = {};
+        attr.size = sizeof(LogAttributes);
+        LOG_ATTR_SET(attr, time, now);
+        char msg[48];
+        snprintf(msg, sizeof(msg), "%u message(s) suppressed", limit.suppressed);
+        logMessage(msg, LOG_LEVEL_WARN, limit.category, attr);
+        limit.suppressed = 0;
+    }
+    return pending;
+}
+
+void spark::LogHandler::updateTokens(detail::LogFilter::Limit *limit, system_tick_t now) {
+    // Refill the token bucket
+    const uint64_t tokens = limit->tokens + (uint64_t)(now - limit->time) * limit->rate;
+    limit->tokens = std::min<uint64_t>(tokens, (uint64_t)limit->burst * 1000);
+    limit->time = now;
+}
+
+bool spark::LogHandler::checkLimits(int index, uint32_t seed, const char *data, size_t size, LogLevel level,
+        const char *category) {
+    detail::LogFilter::Limit *limit = (index >= 0) ? &filter_.limit(index) : nullptr;
+    detail::LogFilter::Repeat &repeat = filter_.repeat();
+    uint32_t hash = 0;
+    if (limit && limit->dedup) {
+        hash = messageHash(seed, data, size, level, category);
+        if (hash == repeat.hash) {
+            ++repeat.count;
+            ++g_suppressedMessages;
+            return false;
+        }
+    }
+    const system_tick_t now = currentTime();
+    if (limit && limit->rate > 0) {
+        updateTokens(limit, now);
+        if (limit->tokens < 1000) {
+            ++limit->suppressed;
+            limit->category = category;
+            ++g_suppressedMessages;
+            detail::LogFilter::suppressed(true); // Reported by LogManager::flushExpired() if the category goes quiet
+            return false;
+        }
+        limit->tokens -= 1000;
+    }
+    if (repeat.count > 0 || (limit && limit->suppressed > 0)) {
+        LogAttributes attr = {};
+        attr.size = sizeof(LogAttributes);
+        LOG_ATTR_SET(attr, time, now);
+        char msg[48];
+        if (repeat.count > 0) {
+            snprintf(msg, sizeof(msg), "Last message repeated %u time(s)", repeat.count);
+            logMessage(msg, repeat.level, nullptr, attr);
+            repeat.count = 0;
+        }
+        if (limit && limit->suppressed > 0) {
+            snprintf(msg, sizeof(msg), "%u message(s) suppressed", limit->suppressed);
+            logMessage(msg, LOG_LEVEL_WARN, category, attr);
+            limit->suppressed = 0;
+        }
+    }
+    // Only consecutive messages are deduplicated
+    repeat.hash = hash;
+    repeat.level = level;
+    return true;
+}
+
+void spark::LogHandler::logBinary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category) {
+    char msg[LOG_MAX_STRING_LENGTH];
+    const int n = log_binary_format(&record, size, msg, sizeof(msg), nullptr);
+    if (n > (int)sizeof(msg) - 1) {
+        msg[sizeof(msg) - 2] = '~';
+    }
+    LogAttributes attr;
+    attr.size = sizeof(LogAttributes);
+    attr.flags = 0;
+    LOG_ATTR_SET(attr, time, record.time);
+    logMessage(msg, level, category, attr);
+}
+
 // spark::StreamLogHandler
 void spark::StreamLogHandler::logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) {
+    detail::LogBuffer &b = buf_;
     const char *s = nullptr;
     // Timestamp
     if (attr.has_time) {
-        printf("%010u ", (unsigned)attr.time);
+        b.printf("%010u ", (unsigned)attr.time);
     }
     // Category
     if (category) {
-        write('[');
-        write(category);
-        write("] ", 2);
+        b.write((uint8_t)'[');
+        b.write(category);
+        b.write((const uint8_t*)"] ", 2);
     }
     // Source file
     if (attr.has_file) {
         s = extractFileName(attr.file); // Strip directory path
-        write(s); // File name
+        b.write(s); // File name
         if (attr.has_line) {
-            write(':');
-            printf("%d", (int)attr.line); // Line number
+            b.write((uint8_t)':');
+            b.printf("%d", (int)attr.line); // Line number
         }
         if (attr.has_function) {
-            write(", ", 2);
+            b.write((const uint8_t*)", ", 2);
         } else {
-            write(": ", 2);
+            b.write((const uint8_t*)": ", 2);
         }
     }
     // Function name
     if (attr.has_function) {
         size_t n = 0;
         s = extractFuncName(attr.function, &n); // Strip argument and return types
-        write(s, n);
-        write("(): ", 4);
+        b.write((const uint8_t*)s, n);
+        b.write((const uint8_t*)"(): ", 4);
     }
     // Level
     s = levelName(level);
-    write(s);
-    write(": ", 2);
+    b.write(s);
+    b.write((const uint8_t*)": ", 2);
     // Message
     if (msg) {
-        write(msg);
+        b.write(msg);
     }
     // Additional attributes
     if (attr.has_code || attr.has_details) {
-        write(" [", 2);
+        b.write((const uint8_t*)" [", 2);
         // Code
         if (attr.has_code) {
-            write("code = ", 7);
-            printf("%" PRIiPTR, (intptr_t)attr.code);
+            b.write((const uint8_t*)"code = ", 7);
+            b.printf("%" PRIiPTR, (intptr_t)attr.code);
         }
         // Details
         if (attr.has_details) {
             if (attr.has_code) {
-                write(", ", 2);
+                b.write((const uint8_t*)", ", 2);
             }
-            write("details = ", 10);
-            write(attr.details);
+            b.write((const uint8_t*)"details = ", 10);
+            b.write(attr.details);
         }
-        write(']');
+        b.write((uint8_t)']');
     }
-    write("\r\n", 2);
+    b.write((const uint8_t*)"\r\n", 2);
+    b.commit();
 }
 
 // spark::JSONStreamLogHandler
 void spark::JSONStreamLogHandler::logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) {
-    JSONStreamWriter json(*this->stream());
+    detail::LogBuffer &b = buffer();
+    JSONStreamWriter json(b);
     json.beginObject();
     // Level
     const char *s = levelName(level);
@@ -576,7 +906,46 @@ void spark::JSONStreamLogHandler::logMessage(const char *msg, LogLevel level, co
         json.name("detail", 6).value(attr.details);
     }
     json.endObject();
-    this->stream()->write((const uint8_t*)"\r\n", 2);
+    b.write((const uint8_t*)"\r\n", 2);
+    b.commit();
+}
+
+// spark::BinaryStreamLogHandler
+void spark::BinaryStreamLogHandler::logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) {
+    writeFrame(TEXT_MESSAGE, level, 0, attr.has_time ? attr.time : 0, 0, category, msg, strlen(msg));
+}
+
+void spark::BinaryStreamLogHandler::logBinary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category) {
+    const size_t argsSize = std::min<size_t>(record.size, size - std::min(size, sizeof(LogBinaryRecord)));
+    writeFrame(BINARY_RECORD, level, record.flags, record.time, (uintptr_t)record.fmt, category, record.args, argsSize);
+}
+
+void spark::BinaryStreamLogHandler::write(const char *data, size_t size) {
+    writeFrame(DIRECT_OUTPUT, 0, 0, 0, 0, nullptr, data, size);
+}
+
+void spark::BinaryStreamLogHandler::writeFrame(FrameType type, int level, unsigned flags, uint32_t time, uintptr_t fmt,
+        const char *category, const char *data, size_t size) {
+    const size_t catSize = category ? strlen(category) + 1 : 1;
+    const size_t payloadSize = std::min<size_t>(catSize + size, 0xffff);
+    size = payloadSize - catSize;
+    uint8_t h[16];
+    h[0] = 0xb1;
+    h[1] = 0x0c;
+    h[2] = type;
+    h[3] = level;
+    h[4] = payloadSize & 0xff;
+    h[5] = payloadSize >> 8;
+    h[6] = flags & 0xff;
+    h[7] = (flags >> 8) & 0xff;
+    for (int i = 0; i < 4; ++i) {
+        h[8 + i] = (time >> (i * 8)) & 0xff;
+        h[12 + i] = (fmt >> (i * 8)) & 0xff;
+    }
+    Print* const strm = stream();
+    strm->write(h, sizeof(h));
+    strm->write((const uint8_t*)(category ? category : ""), catSize);
+    strm->write((const uint8_t*)data, size);
 }
 
 #if Wiring_LogConfig
@@ -594,6 +963,11 @@ LogHandler* spark::DefaultLogHandlerFactory::createHandler(const char *type, Log
             return nullptr;
         }
         return new(std::nothrow) StreamLogHandler(*stream, level, std::move(filters));
+    } else if (strcmp(type, "BinaryStreamLogHandler") == 0) {
+        if (!stream) {
+            return nullptr;
+        }
+        return new(std::nothrow) BinaryStreamLogHandler(*stream, level, std::move(filters));
     }
     return nullptr; // Unknown handler type
 }
@@ -669,14 +1043,55 @@ struct spark::LogManager::FactoryHandler {
 
 #endif // Wiring_LogConfig
 
-spark::LogManager::LogManager() {
+#if PLATFORM_THREADING
+
+struct spark::LogManager::AsyncState {
+    particle::MpscQueue<LogRecord> queue;
+    os_semaphore_t sem; // Signaled when new records are queued
+    os_thread_t thread;
+    std::atomic<bool> active;
+    volatile bool stop;
+    unsigned dropped; // Total number of dropped records
+
+    AsyncState() :
+            sem(nullptr),
+            thread(OS_THREAD_INVALID_HANDLE),
+            active(false),
+            stop(false),
+            dropped(0) {
+    }
+
+    ~AsyncState() {
+        if (sem) {
+            os_semaphore_destroy(sem);
+        }
+    }
+};
+
+#endif // PLATFORM_THREADING
+
+spark::LogManager::LogManager() :
+        generation_(1) { // Zero-initialized cache entries don't match any generation
+    for (LevelCacheEntry &e: levelCache_) {
+        e.seq = 0;
+        e.category = nullptr;
+        e.level = LOG_LEVEL_NONE;
+        e.generation = 0;
+    }
 #if Wiring_LogConfig
     handlerFactory_ = DefaultLogHandlerFactory::instance();
     streamFactory_ = DefaultOutputStreamFactory::instance();
 #endif
+#if PLATFORM_THREADING
+    async_ = nullptr;
+#endif
 }
 
 spark::LogManager::~LogManager() {
+#if PLATFORM_THREADING
+    disableAsyncMode();
+    delete async_;
+#endif
     resetSystemCallbacks();
 #if Wiring_LogConfig
     LOG_WITH_LOCK(mutex_) {
@@ -690,6 +1105,7 @@ bool spark::LogManager::addHandler(LogHandler *handler) {
         if (activeHandlers_.contains(handler) || !activeHandlers_.append(handler)) {
             return false;
         }
+        invalidateLevelCache();
         if (activeHandlers_.size() == 1) {
             setSystemCallbacks();
         }
@@ -699,7 +1115,11 @@ bool spark::LogManager::addHandler(LogHandler *handler) {
 
 void spark::LogManager::removeHandler(LogHandler *handler) {
     LOG_WITH_LOCK(mutex_) {
-        if (activeHandlers_.removeOne(handler) && activeHandlers_.isEmpty()) {
+        if (!activeHandlers_.removeOne(handler)) {
+            return;
+        }
+        invalidateLevelCache();
+        if (activeHandlers_.isEmpty()) {
             resetSystemCallbacks();
         }
     }
@@ -710,6 +1130,213 @@ spark::LogManager* spark::LogManager::instance() {
     return &mgr;
 }
 
+void spark::LogManager::flush() {
+#if PLATFORM_THREADING
+    if (async_) {
+        processQueue();
+    }
+#endif
+    flushHandlers();
+}
+
+void spark::LogManager::flushExpired() {
+    LOG_WITH_LOCK(mutex_) {
+        bool suppressed = false;
+        for (LogHandler *handler: activeHandlers_) {
+            if (handler->reportSuppressed()) {
+                suppressed = true;
+            }
+            handler->flushExpired();
+        }
+        // Messages are delivered to the handlers with the mutex locked, so the flag can't be set
+        // concurrently
+        detail::LogFilter::suppressed(suppressed);
+    }
+}
+
+void spark::LogManager::flushHandlers() {
+    LOG_WITH_LOCK(mutex_) {
+        for (LogHandler *handler: activeHandlers_) {
+            handler->flush();
+        }
+    }
+}
+
+#if PLATFORM_THREADING
+
+bool spark::LogManager::enableAsyncMode(size_t queueSize) {
+    AsyncState *s = async_;
+    if (s && s->active) {
+        return true;
+    }
+    if (!s) {
+        // The queue is never freed while the log manager exists, since producers may still be
+        // accessing it after asynchronous mode has been disabled
+        std::unique_ptr<AsyncState> state(new(std::nothrow) AsyncState);
+        if (!state || state->queue.init(queueSize) != 0 || os_semaphore_create(&state->sem, 1, 0) != 0) {
+            return false;
+        }
+        s = state.release();
+        async_ = s;
+    }
+    s->stop = false;
+    if (os_thread_create(&s->thread, "log", ASYNC_THREAD_PRIORITY, asyncThread, this, OS_THREAD_STACK_SIZE_DEFAULT) != 0) {
+        s->thread = OS_THREAD_INVALID_HANDLE;
+        return false;
+    }
+    s->active = true;
+    return true;
+}
+
+void spark::LogManager::disableAsyncMode() {
+    AsyncState *s = async_;
+    if (!s || !s->active) {
+        return;
+    }
+    s->active = false;
+    stopAsyncThread();
+    processQueue();
+}
+
+bool spark::LogManager::isAsyncMode() const {
+    const AsyncState *s = async_;
+    return s && s->active;
+}
+
+unsigned spark::LogManager::droppedMessageCount() const {
+    unsigned count = 0;
+    const AsyncState *s = async_;
+    if (s) {
+        count = s->dropped;
+    }
+    return count;
+}
+
+bool spark::LogManager::pushMessage(const char *msg, int level, const char *category, const LogAttributes *attr) {
+    const bool ok = async_->queue.push([=](LogRecord &r) {
+        r.type = LogRecord::MESSAGE;
+        r.level = level;
+        // The attributes structure may be smaller if it was created by an older module
+        memset(&r.attr, 0, sizeof(r.attr));
+        memcpy(&r.attr, attr, std::min(attr->size, sizeof(r.attr)));
+        size_t offs = 0;
+        const size_t size = strnlen(msg, LOG_MAX_STRING_LENGTH - 1);
+        r.append(msg, size, &offs);
+        r.size = size;
+        r.categoryOffs = r.appendString(category, &offs);
+        r.detailsOffs = -1;
+        if (r.attr.has_details) {
+            r.detailsOffs = r.appendString(r.attr.details, &offs);
+            r.attr.details = r.string(r.detailsOffs);
+            if (!r.attr.details) {
+                r.attr.has_details = 0;
+            }
+        }
+    });
+    return ok;
+}
+
+bool spark::LogManager::pushWrite(const char *data, size_t size, int level, const char *category) {
+    // Larger chunks of data are split into several records
+    while (size > 0) {
+        const size_t n = std::min(size, (size_t)LOG_MAX_STRING_LENGTH);
+        const bool ok = async_->queue.push([=](LogRecord &r) {
+            r.type = LogRecord::WRITE;
+            r.level = level;
+            size_t offs = 0;
+            r.append(data, n, &offs);
+            r.size = n;
+            r.categoryOffs = r.appendString(category, &offs);
+            r.detailsOffs = -1;
+        });
+        if (!ok) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool spark::LogManager::pushBinary(const LogBinaryRecord *record, size_t size, int level, const char *category) {
+    const bool ok = async_->queue.push([=](LogRecord &r) {
+        r.type = LogRecord::BINARY;
+        r.level = level;
+        size_t offs = 0;
+        r.append((const char*)record, size, &offs);
+        r.size = std::min(size, sizeof(r.buf) - 1);
+        r.categoryOffs = r.appendString(category, &offs);
+        r.detailsOffs = -1;
+    });
+    return ok;
+}
+
+void spark::LogManager::processQueue() {
+    AsyncState *s = async_;
+    bool done = false;
+    while (!done) {
+        // The mutex is released between batches so that the handlers can be added or removed
+        // while a large number of records is being processed
+        LOG_WITH_LOCK(mutex_) {
+            const unsigned dropped = s->queue.takeDroppedCount();
+            if (dropped > 0) {
+                s->dropped += dropped;
+                char msg[32];
+                snprintf(msg, sizeof(msg), "%u message(s) dropped", dropped);
+                LogAttributes attr = {};
+                attr.size = sizeof(LogAttributes);
+                LOG_ATTR_SET(attr, time, HAL_Timer_Get_Milli_Seconds());
+                for (LogHandler *handler: activeHandlers_) {
+                    handler->message(msg, LOG_LEVEL_WARN, nullptr, attr);
+                }
+            }
+            size_t count = 0;
+            while (count < ASYNC_BATCH_SIZE && s->queue.pop([this](const LogRecord &r) {
+                const char *category = r.string(r.categoryOffs);
+                for (LogHandler *handler: activeHandlers_) {
+                    if (r.type == LogRecord::MESSAGE) {
+                        handler->message(r.buf, (LogLevel)r.level, category, r.attr);
+                    } else if (r.type == LogRecord::BINARY) {
+                        handler->binary(*(const LogBinaryRecord*)r.buf, r.size, (LogLevel)r.level, category);
+                    } else {
+                        handler->write(r.buf, r.size, (LogLevel)r.level, category);
+                    }
+                }
+            })) {
+                ++count;
+            }
+            done = (count < ASYNC_BATCH_SIZE);
+        }
+    }
+}
+
+void spark::LogManager::stopAsyncThread() {
+    AsyncState *s = async_;
+    if (s->thread != OS_THREAD_INVALID_HANDLE) {
+        s->stop = true;
+        os_semaphore_give(s->sem, false);
+        os_thread_join(s->thread);
+        os_thread_cleanup(s->thread);
+        s->thread = OS_THREAD_INVALID_HANDLE;
+    }
+}
+
+os_thread_return_t spark::LogManager::asyncThread(void *data) {
+    LogManager *that = static_cast<LogManager*>(data);
+    AsyncState *s = that->async_;
+    while (!s->stop) {
+        const bool idle = (os_semaphore_take(s->sem, ASYNC_POLL_INTERVAL, false) != 0);
+        that->processQueue();
+        if (idle) {
+            // Write batched output if no messages were logged during the poll interval
+            that->flushHandlers();
+        }
+    }
+    os_thread_exit(nullptr);
+}
+
+#endif // PLATFORM_THREADING
+
 #if Wiring_LogConfig
 
 bool spark::LogManager::addFactoryHandler(const char *id, const char *handlerType, LogLevel level, LogCategoryFilters filters,
@@ -748,6 +1375,7 @@ bool spark::LogManager::addFactoryHandler(const char *id, const char *handlerTyp
             factoryHandlers_.takeLast(); // Revert factoryHandlers_.append()
             return false;
         }
+        invalidateLevelCache();
         if (activeHandlers_.size() == 1) {
             setSystemCallbacks();
         }
@@ -794,6 +1422,7 @@ void spark::LogManager::destroyFactoryHandler(const char *id) {
         const FactoryHandler &h = factoryHandlers_.at(i);
         if (h.id == id) {
             activeHandlers_.removeOne(h.handler);
+            invalidateLevelCache();
             if (activeHandlers_.isEmpty()) {
                 resetSystemCallbacks();
             }
@@ -810,6 +1439,7 @@ void spark::LogManager::destroyFactoryHandler(const char *id) {
 void spark::LogManager::destroyFactoryHandlers() {
     for (const FactoryHandler &h: factoryHandlers_) {
         activeHandlers_.removeOne(h.handler);
+        invalidateLevelCache();
         if (activeHandlers_.isEmpty()) {
             resetSystemCallbacks();
         }
@@ -825,10 +1455,12 @@ void spark::LogManager::destroyFactoryHandlers() {
 
 void spark::LogManager::setSystemCallbacks() {
     log_set_callbacks(logMessage, logWrite, logEnabled, nullptr);
+    log_set_binary_callback(logBinary, nullptr);
 }
 
 void spark::LogManager::resetSystemCallbacks() {
     log_set_callbacks(nullptr, nullptr, nullptr, nullptr);
+    log_set_binary_callback(nullptr, nullptr);
 }
 
 void spark::LogManager::logMessage(const char *msg, int level, const char *category, const LogAttributes *attr, void *reserved) {
@@ -838,6 +1470,23 @@ void spark::LogManager::logMessage(const char *msg, int level, const char *categ
     }
 #endif
     LogManager *that = instance();
+#if PLATFORM_THREADING
+    AsyncState *s = that->async_;
+    if (s && s->active) {
+        if (that->pushMessage(msg, level, category, attr) && !HAL_IsISR()) {
+            os_semaphore_give(s->sem, false);
+        }
+        if (!s->active && !HAL_IsISR()) {
+            // Asynchronous mode has been disabled while the record was being queued
+            that->processQueue();
+        }
+        return;
+    }
+    if (s) {
+        // Deliver the records left in the queue before this one
+        that->processQueue();
+    }
+#endif
     LOG_WITH_LOCK(that->mutex_) {
         for (LogHandler *handler: that->activeHandlers_) {
             handler->message(msg, (LogLevel)level, category, *attr);
@@ -852,6 +1501,23 @@ void spark::LogManager::logWrite(const char *data, size_t size, int level, const
     }
 #endif
     LogManager *that = instance();
+#if PLATFORM_THREADING
+    AsyncState *s = that->async_;
+    if (s && s->active) {
+        if (that->pushWrite(data, size, level, category) && !HAL_IsISR()) {
+            os_semaphore_give(s->sem, false);
+        }
+        if (!s->active && !HAL_IsISR()) {
+            // Asynchronous mode has been disabled while the record was being queued
+            that->processQueue();
+        }
+        return;
+    }
+    if (s) {
+        // Deliver the records left in the queue before this one
+        that->processQueue();
+    }
+#endif
     LOG_WITH_LOCK(that->mutex_) {
         for (LogHandler *handler: that->activeHandlers_) {
             handler->write(data, size, (LogLevel)level, category);
@@ -859,25 +1525,90 @@ void spark::LogManager::logWrite(const char *data, size_t size, int level, const
     }
 }
 
-int spark::LogManager::logEnabled(int level, const char *category, void *reserved) {
+void spark::LogManager::logBinary(const LogBinaryRecord *record, size_t size, int level, const char *category, void *reserved) {
+    LogManager *that = instance();
+#if PLATFORM_THREADING
+    // Queueing a record is lock-free, so binary records can be generated in interrupt handlers
+    AsyncState *s = that->async_;
+    if (s && s->active) {
+        if (that->pushBinary(record, size, level, category) && !HAL_IsISR()) {
+            os_semaphore_give(s->sem, false);
+        }
+        if (!s->active && !HAL_IsISR()) {
+            // Asynchronous mode has been disabled while the record was being queued
+            that->processQueue();
+        }
+        return;
+    }
+    if (s && !HAL_IsISR()) {
+        // Deliver the records left in the queue before this one
+        that->processQueue();
+    }
+#endif
 #ifndef LOG_FROM_ISR
     if (HAL_IsISR()) {
-        return 0;
+        return;
     }
 #endif
-    LogManager *that = instance();
-    int minLevel = LOG_LEVEL_NONE;
     LOG_WITH_LOCK(that->mutex_) {
         for (LogHandler *handler: that->activeHandlers_) {
-            const int level = handler->level(category);
-            if (level < minLevel) {
-                minLevel = level;
+            handler->binary(*record, size, (LogLevel)level, category);
+        }
+    }
+}
+
+int spark::LogManager::logEnabled(int level, const char *category, void *reserved) {
+    LogManager *that = instance();
+    // Looking up the cache doesn't require locking, so it's done in interrupt handlers as well
+    int minLevel = that->cachedLevel(category);
+    if (minLevel < 0) {
+#ifndef LOG_FROM_ISR
+        if (HAL_IsISR()) {
+            return 0;
+        }
+#endif
+        LOG_WITH_LOCK(that->mutex_) {
+            minLevel = LOG_LEVEL_NONE;
+            for (LogHandler *handler: that->activeHandlers_) {
+                const int level = handler->level(category);
+                if (level < minLevel) {
+                    minLevel = level;
+                }
             }
+            that->cacheLevel(category, minLevel);
         }
     }
     return (level >= minLevel);
 }
 
+int spark::LogManager::cachedLevel(const char *category) const {
+    const LevelCacheEntry &e = levelCache_[levelCacheIndex(category)];
+    const uint32_t seq = e.seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+        return -1; // The entry is being updated
+    }
+    const char* const cat = e.category.load(std::memory_order_relaxed);
+    const int level = e.level.load(std::memory_order_relaxed);
+    const uint32_t gen = e.generation.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (e.seq.load(std::memory_order_relaxed) != seq || cat != category || gen != generation_.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+    return level;
+}
+
+void spark::LogManager::cacheLevel(const char *category, int level) {
+    // This method is called with the mutex locked, so there's only one writer at a time
+    LevelCacheEntry &e = levelCache_[levelCacheIndex(category)];
+    const uint32_t seq = e.seq.load(std::memory_order_relaxed);
+    e.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.category.store(category, std::memory_order_relaxed);
+    e.level.store(level, std::memory_order_relaxed);
+    e.generation.store(generation_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    e.seq.store(seq + 2, std::memory_order_release);
+}
+
 #if Wiring_LogConfig
 
 // spark::
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_retained_log_handler.h"
+
+#include "spark_wiring_ticks.h"
+#include "system_version.h"
+#include "system_error.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+extern void(*retained_log_ctrl_request_callback)(ctrl_request* req);
+
+namespace {
+
+using namespace particle;
+
+// Maximum size of the event data
+const size_t EVENT_DATA_SIZE = 255;
+
+// Maximum size of the reply data of a control request
+const size_t CTRL_REPLY_DATA_SIZE = 1024;
+
+// Size of the header of a frame in the format used by BinaryStreamLogHandler
+const size_t FRAME_HEADER_SIZE = 16;
+
+// Maximum size of the record data
+const size_t MAX_RECORD_DATA_SIZE = LOG_MAX_STRING_LENGTH + 64;
+
+#if defined(STM32F2XX)
+// CRC-32 of the module image, which is written to the end of the module after it has been linked
+extern char link_module_info_crc_start;
+#endif
+
+// Identifies the firmware build. Format strings of the stored binary records can only be accessed
+// if the records were generated by the same build
+uint32_t firmwareTag() {
+#if defined(STM32F2XX)
+    uint32_t crc = 0;
+    memcpy(&crc, &link_module_info_crc_start, sizeof(crc));
+    return crc ^ SYSTEM_VERSION;
+#else
+    return SYSTEM_VERSION; // Retained memory is not supported on other platforms
+#endif
+}
+
+inline void writeUint32(char* buf, uint32_t val) {
+    for (int i = 0; i < 4; ++i) {
+        buf[i] = (val >> (i * 8)) & 0xff;
+    }
+}
+
+inline uint32_t readUint32(const char* buf) {
+    uint32_t val = 0;
+    for (int i = 0; i < 4; ++i) {
+        val |= (uint32_t)(uint8_t)buf[i] << (i * 8);
+    }
+    return val;
+}
+
+} // namespace
+
+spark::RetainedLogHandler* spark::RetainedLogHandler::s_instance = nullptr;
+
+spark::RetainedLogHandler::RetainedLogHandler(void *buf, size_t size, LogLevel level, LogCategoryFilters filters) :
+        LogHandler(level, filters),
+        bootSeq_(0),
+        publishSeq_(0),
+        sameFirmware_(false) {
+    if (ring_.init(buf, size) == 0) {
+        const uint32_t tag = firmwareTag();
+        sameFirmware_ = (ring_.restored() && ring_.tag() == tag);
+        ring_.tag(tag);
+        bootSeq_ = ring_.nextSeq();
+        publishSeq_ = ring_.firstSeq();
+    }
+    s_instance = this;
+    retained_log_ctrl_request_callback = processControlRequest;
+    LogManager::instance()->addHandler(this);
+}
+
+spark::RetainedLogHandler::~RetainedLogHandler() {
+    LogManager::instance()->removeHandler(this);
+    if (s_instance == this) {
+        retained_log_ctrl_request_callback = nullptr;
+        s_instance = nullptr;
+    }
+}
+
+bool spark::RetainedLogHandler::hasPreviousRecords() const {
+    return (int32_t)(bootSeq_ - std::max(publishSeq_, ring_.firstSeq())) > 0;
+}
+
+int spark::RetainedLogHandler::publishPrevious(const char *eventName, PublishFlags flags) {
+    char data[EVENT_DATA_SIZE + 1];
+    size_t size = 0;
+    uint32_t seq = 0;
+    WITH_LOCK(mutex_) {
+        seq = std::max(publishSeq_, ring_.firstSeq());
+        while ((int32_t)(bootSeq_ - seq) > 0) {
+            char line[EVENT_DATA_SIZE + 1];
+            size_t n = formatRecord(seq, line, sizeof(line));
+            if (size > 0 && size + n > EVENT_DATA_SIZE) {
+                break; // Publish the message with the next event
+            }
+            n = std::min(n, EVENT_DATA_SIZE - size); // Truncate long messages
+            memcpy(data + size, line, n);
+            size += n;
+            ++seq;
+        }
+    }
+    if (size == 0) {
+        return 0;
+    }
+    data[size] = '\0';
+    if (!Particle.publish(eventName, data, flags)) {
+        return SYSTEM_ERROR_IO;
+    }
+    publishSeq_ = seq;
+    return (int32_t)(bootSeq_ - seq) > 0 ? bootSeq_ - seq : 0;
+}
+
+void spark::RetainedLogHandler::clear() {
+    WITH_LOCK(mutex_) {
+        ring_.clear();
+    }
+}
+
+void spark::RetainedLogHandler::logMessage(const char *msg, LogLevel level, const char *category, const LogAttributes &attr) {
+    const uint32_t time = attr.has_time ? attr.time : millis();
+    append(LogRing::TEXT_MESSAGE, level, 0, time, 0, category, msg, msg ? strlen(msg) : 0);
+}
+
+void spark::RetainedLogHandler::logBinary(const LogBinaryRecord &record, size_t size, LogLevel level, const char *category) {
+    const size_t argsSize = std::min<size_t>(record.size, size - std::min(size, sizeof(LogBinaryRecord)));
+    append(LogRing::BINARY_RECORD, level, record.flags, record.time, (uintptr_t)record.fmt, category, record.args, argsSize);
+}
+
+void spark::RetainedLogHandler::write(const char *data, size_t size) {
+    append(LogRing::DIRECT_OUTPUT, 0, 0, millis(), 0, nullptr, data, size);
+}
+
+void spark::RetainedLogHandler::append(LogRing::RecordType type, int level, uint16_t flags, uint32_t time, uintptr_t fmt,
+        const char *category, const char *data, size_t size) {
+    LogRing::Record rec = {};
+    rec.type = type;
+    rec.level = level;
+    rec.flags = flags;
+    rec.time = time;
+    rec.fmt = fmt;
+    const size_t catSize = category ? strlen(category) + 1 : 1;
+    const size_t maxSize = std::min(ring_.maxDataSize(), MAX_RECORD_DATA_SIZE);
+    if (catSize + size > maxSize) {
+        if (catSize >= maxSize) {
+            return;
+        }
+        size = maxSize - catSize;
+        rec.flags |= LOG_BINARY_RECORD_TRUNCATED;
+    }
+    WITH_LOCK(mutex_) {
+        ring_.append(rec, category, data, size);
+    }
+}
+
+size_t spark::RetainedLogHandler::formatRecord(uint32_t seq, char *buf, size_t size) {
+    char data[MAX_RECORD_DATA_SIZE];
+    LogRing::Record rec = {};
+    const int n = ring_.read(seq, &rec, data, sizeof(data));
+    if (n <= 0) {
+        return 0;
+    }
+    const size_t dataSize = std::min<size_t>(n, sizeof(data));
+    const char* const category = data;
+    const size_t catSize = strnlen(data, dataSize) + 1;
+    if (catSize > dataSize) {
+        return 0;
+    }
+    const char* const payload = data + catSize;
+    const size_t payloadSize = dataSize - catSize;
+    if (rec.type == LogRing::DIRECT_OUTPUT) {
+        const size_t len = std::min(payloadSize, size);
+        memcpy(buf, payload, len);
+        return len;
+    }
+    char msg[LOG_MAX_STRING_LENGTH];
+    if (rec.type == LogRing::BINARY_RECORD) {
+        // Format string addresses are stored as 32-bit values
+        if (sameFirmware_ && sizeof(uintptr_t) <= sizeof(rec.fmt)) {
+            union {
+                LogBinaryRecord record;
+                char buf[sizeof(LogBinaryRecord) + MAX_RECORD_DATA_SIZE];
+            } r;
+            r.record.fmt = (const char*)(uintptr_t)rec.fmt;
+            r.record.time = rec.time;
+            r.record.size = payloadSize;
+            r.record.flags = rec.flags;
+            memcpy(r.record.args, payload, payloadSize);
+            log_binary_format(&r.record, sizeof(LogBinaryRecord) + payloadSize, msg, sizeof(msg), nullptr);
+        } else {
+            // The format string is not accessible
+            snprintf(msg, sizeof(msg), "<binary record 0x%08x>", (unsigned)rec.fmt);
+        }
+    } else {
+        const size_t len = std::min(payloadSize, sizeof(msg) - 1);
+        memcpy(msg, payload, len);
+        msg[len] = '\0';
+    }
+    int len = 0;
+    if (catSize > 1) {
+        len = snprintf(buf, size, "%010u [%s] %s: %s%s\n", (unsigned)rec.time, category, levelName((LogLevel)rec.level), msg,
+                (rec.type == LogRing::TEXT_MESSAGE && (rec.flags & LOG_BINARY_RECORD_TRUNCATED)) ? "~" : "");
+    } else {
+        len = snprintf(buf, size, "%010u %s: %s%s\n", (unsigned)rec.time, levelName((LogLevel)rec.level), msg,
+                (rec.type == LogRing::TEXT_MESSAGE && (rec.flags & LOG_BINARY_RECORD_TRUNCATED)) ? "~" : "");
+    }
+    return std::min<size_t>(std::max(len, 0), size - 1);
+}
+
+void spark::RetainedLogHandler::processControlRequest(ctrl_request* req) {
+    RetainedLogHandler* const h = s_instance;
+    if (!h) {
+        system_ctrl_set_result(req, SYSTEM_ERROR_NOT_SUPPORTED, nullptr, nullptr, nullptr);
+        return;
+    }
+    if (system_ctrl_alloc_reply_data(req, CTRL_REPLY_DATA_SIZE, nullptr) != 0) {
+        system_ctrl_set_result(req, SYSTEM_ERROR_NO_MEMORY, nullptr, nullptr, nullptr);
+        return;
+    }
+    char* const reply = req->reply_data;
+    size_t offs = 12; // Sequence numbers
+    uint32_t seq = 0;
+    uint32_t next = 0;
+    WITH_LOCK(h->mutex_) {
+        const LogRing& ring = h->ring_;
+        seq = ring.firstSeq();
+        next = ring.nextSeq();
+        if (req->request_size >= 4) {
+            const uint32_t s = readUint32(req->request_data);
+            if ((int32_t)(s - seq) > 0) {
+                seq = s;
+            }
+        }
+        for (; (int32_t)(next - seq) > 0; ++seq) {
+            LogRing::Record rec = {};
+            const int n = ring.read(seq, &rec, nullptr, 0);
+            if (n < 0 || offs + FRAME_HEADER_SIZE + n > CTRL_REPLY_DATA_SIZE) {
+                break;
+            }
+            char* const f = reply + offs;
+            f[0] = 0xb1;
+            f[1] = 0x0c;
+            f[2] = rec.type;
+            f[3] = rec.level;
+            f[4] = n & 0xff;
+            f[5] = (n >> 8) & 0xff;
+            f[6] = rec.flags & 0xff;
+            f[7] = (rec.flags >> 8) & 0xff;
+            writeUint32(f + 8, rec.time);
+            writeUint32(f + 12, rec.fmt);
+            ring.read(seq, nullptr, f + FRAME_HEADER_SIZE, n);
+            offs += FRAME_HEADER_SIZE + n;
+        }
+    }
+    writeUint32(reply, seq);
+    writeUint32(reply + 4, next);
+    writeUint32(reply + 8, h->bootSeq_);
+    req->reply_size = offs;
+    system_ctrl_set_result(req, SYSTEM_ERROR_NONE, nullptr, nullptr, nullptr);
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_worker_pool.h"
+
+#if PLATFORM_THREADING
+
+#include <mutex>
+#include <new>
+
+namespace {
+
+// Maximum number of pending wakeup signals
+const unsigned MAX_SEMAPHORE_COUNT = 0xffff;
+
+} // namespace
+
+void particle::detail::WorkerQueue::pushBack(WorkerTask* task) {
+    std::lock_guard<Mutex> lock(mutex_);
+    task->next_ = nullptr;
+    task->prev_ = last_;
+    if (last_) {
+        last_->next_ = task;
+    } else {
+        first_ = task;
+    }
+    last_ = task;
+}
+
+particle::detail::WorkerTask* particle::detail::WorkerQueue::popBack() {
+    std::lock_guard<Mutex> lock(mutex_);
+    const auto task = last_;
+    if (task) {
+        last_ = task->prev_;
+        if (last_) {
+            last_->next_ = nullptr;
+        } else {
+            first_ = nullptr;
+        }
+    }
+    return task;
+}
+
+particle::detail::WorkerTask* particle::detail::WorkerQueue::popFront() {
+    std::lock_guard<Mutex> lock(mutex_);
+    const auto task = first_;
+    if (task) {
+        first_ = task->next_;
+        if (first_) {
+            first_->prev_ = nullptr;
+        } else {
+            last_ = nullptr;
+        }
+    }
+    return task;
+}
+
+particle::WorkerPool::WorkerPool(unsigned workerCount, size_t stackSize, os_thread_prio_t priority) :
+        workers_(nullptr),
+        count_(0),
+        sem_(nullptr),
+        next_(0),
+        stop_(false) {
+    if (workerCount == 0 || os_semaphore_create(&sem_, MAX_SEMAPHORE_COUNT, 0) != 0) {
+        sem_ = nullptr;
+        return;
+    }
+    workers_ = new(std::nothrow) Worker[workerCount];
+    if (!workers_) {
+        return;
+    }
+    for (unsigned i = 0; i < workerCount; ++i) {
+        Worker& w = workers_[i];
+        w.pool = this;
+        w.index = i;
+        w.thread = OS_THREAD_INVALID_HANDLE;
+    }
+    // Workers are started only after all queues are initialized, since they may steal tasks from
+    // each other as soon as they're running
+    unsigned count = 0;
+    for (; count < workerCount; ++count) {
+        Worker& w = workers_[count];
+        if (os_thread_create(&w.thread, "worker", priority, run, &w, stackSize) != 0) {
+            w.thread = OS_THREAD_INVALID_HANDLE;
+            break;
+        }
+    }
+    count_ = count;
+}
+
+particle::WorkerPool::~WorkerPool() {
+    stop();
+    delete[] workers_;
+    if (sem_) {
+        os_semaphore_destroy(sem_);
+    }
+}
+
+void particle::WorkerPool::stop() {
+    if (count_ == 0) {
+        return;
+    }
+    stop_.store(true, std::memory_order_release);
+    for (unsigned i = 0; i < count_; ++i) {
+        os_semaphore_give(sem_, false);
+    }
+    for (unsigned i = 0; i < count_; ++i) {
+        const os_thread_t thread = workers_[i].thread;
+        os_thread_join(thread);
+        os_thread_cleanup(thread);
+        workers_[i].thread = OS_THREAD_INVALID_HANDLE;
+    }
+    count_ = 0;
+}
+
+bool particle::WorkerPool::enqueue(detail::WorkerTask* task) {
+    if (count_ == 0) {
+        return false;
+    }
+    // Tasks submitted by a running task are always accepted, since the worker drains its own
+    // queue before exiting
+    int index = currentWorker();
+    if (index < 0) {
+        if (stop_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        index = next_.fetch_add(1, std::memory_order_relaxed) % count_;
+    }
+    workers_[index].queue.pushBack(task);
+    os_semaphore_give(sem_, false);
+    return true;
+}
+
+particle::detail::WorkerTask* particle::WorkerPool::take(unsigned index) {
+    // Take the most recently submitted task from the worker's own queue
+    detail::WorkerTask* task = workers_[index].queue.popBack();
+    if (!task) {
+        // Steal the oldest task from one of the other workers
+        for (unsigned i = 1; i < count_ && !task; ++i) {
+            task = workers_[(index + i) % count_].queue.popFront();
+        }
+    }
+    return task;
+}
+
+int particle::WorkerPool::currentWorker() const {
+    for (unsigned i = 0; i < count_; ++i) {
+        if (os_thread_is_current(workers_[i].thread)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+os_thread_return_t particle::WorkerPool::run(void* data) {
+    const auto w = static_cast<Worker*>(data);
+    const auto pool = w->pool;
+    for (;;) {
+        // Workers don't access the pool until they receive their first wakeup signal
+        os_semaphore_take(pool->sem_, CONCURRENT_WAIT_FOREVER, false);
+        detail::WorkerTask* task = nullptr;
+        while ((task = pool->take(w->index))) {
+            task->run();
+            delete task;
+        }
+        if (pool->stop_.load(std::memory_order_acquire)) {
+            break;
+        }
+    }
+    os_thread_exit(nullptr);
+}
+
+#endif // PLATFORM_THREADING
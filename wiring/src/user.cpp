@@ -92,6 +92,11 @@ void serialEvent5() __attribute__((weak));
 void _post_loop()
 {
 	serialEventRun();
+	// Write batched log messages that have been kept for too long, and report the messages dropped
+	// by the rate limits
+	if (spark::LogManager::batchingEnabled() || spark::LogManager::messagesSuppressed()) {
+		spark::LogManager::instance()->flushExpired();
+	}
 	application_checkin();
 }
 
@@ -174,6 +179,9 @@ void __attribute((weak)) ctrl_request_custom_handler(ctrl_request* req) {
 void(*log_process_ctrl_request_callback)(ctrl_request* req) = nullptr;
 #endif
 
+// Callback invoked to read the messages stored by RetainedLogHandler
+void(*retained_log_ctrl_request_callback)(ctrl_request* req) = nullptr;
+
 // Application handler for control requests
 static void ctrl_request_handler(ctrl_request* req) {
     switch (req->type) {
@@ -187,6 +195,14 @@ static void ctrl_request_handler(ctrl_request* req) {
         break;
     }
 #endif
+    case CTRL_REQUEST_GET_RETAINED_LOG: {
+        if (retained_log_ctrl_request_callback) {
+            retained_log_ctrl_request_callback(req);
+        } else {
+            system_ctrl_set_result(req, SYSTEM_ERROR_NOT_SUPPORTED, nullptr, nullptr, nullptr);
+        }
+        break;
+    }
     case CTRL_REQUEST_APP_CUSTOM: {
         ctrl_request_custom_handler(req);
         break;